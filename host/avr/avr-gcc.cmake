@@ -0,0 +1,21 @@
+# Toolchain for the Mega 2560 with avr-gcc, flags as the Arduino IDE uses
+# them, plus -fstack-usage so each object leaves a .su file of stack use
+# per function.
+
+set(CMAKE_SYSTEM_NAME Generic)
+set(CMAKE_SYSTEM_PROCESSOR avr)
+
+set(CMAKE_C_COMPILER avr-gcc)
+set(CMAKE_CXX_COMPILER avr-g++)
+set(CMAKE_ASM_COMPILER avr-gcc)
+set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+set(AVR_MCU_FLAGS "-mmcu=atmega2560 -DF_CPU=16000000L")
+set(CMAKE_C_FLAGS_INIT "${AVR_MCU_FLAGS} -ffunction-sections -fdata-sections -fstack-usage")
+set(CMAKE_CXX_FLAGS_INIT "${AVR_MCU_FLAGS} -ffunction-sections -fdata-sections -fstack-usage -fno-exceptions -fno-threadsafe-statics")
+set(CMAKE_ASM_FLAGS_INIT "${AVR_MCU_FLAGS} -x assembler-with-cpp")
+set(CMAKE_EXE_LINKER_FLAGS_INIT "-mmcu=atmega2560 -Wl,--gc-sections")
+
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
@@ -0,0 +1,254 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * avr_bench - Cycle counts of the sketch's hot paths on the ATmega2560.
+ *
+ * Built for the Mega against the Arduino core and run under simavr,
+ * which executes it cycle for cycle. Timer3 counts at the CPU clock and
+ * interrupts are off around each call, so TCNT3 after the call is the
+ * exact cycles it took. An empty call is timed the same way and taken
+ * off every result. Timer3 only drives PWM on pins 2, 3 and 5, and
+ * nothing here uses them.
+ *
+ * Most of these take data dependent paths, so each benchmark runs with
+ * INPUTS different arguments and prints one line to Serial:
+ *   BENCH name min mean max symbols
+ * symbols are the functions whose flash and stack the report adds up
+ * for it, joined with '+'. Inlined code is timed through a wrapper in
+ * AvrBench and sized through that. The run ends by sleeping with
+ * interrupts off, which simavr takes as the end of the program.
+ */
+
+#include <Arduino.h>
+#include <avr/sleep.h>
+
+#include "connections.h"
+#include "fastHBridge.h"
+#include "input.h"
+#include "motor.h"
+#include "speedController.h"
+
+namespace AvrBench
+{
+  typedef void (*Run)(uint8_t input);
+
+  struct Benchmark
+  {
+    const char* name;
+    Run run;
+    const char* symbols;
+  };
+
+  /* Arguments each benchmark is run with, 0..INPUTS-1 */
+  constexpr uint8_t INPUTS = 64;
+
+  /* Results go here so nothing is optimised away */
+  volatile int32_t sink;
+
+  Motor::HBridge bridge(ENGINE_INPUT_1, ENGINE_INPUT_2);
+  Motor::HBridgePWM pwmBridge(ENGINE_INPUT_1, ENGINE_INPUT_2, ENGINE_PWM);
+  Motor::FastHBridge<ENGINE_INPUT_1, ENGINE_INPUT_2> fastBridge;
+  Motor::FastHBridgePWM<ENGINE_INPUT_1, ENGINE_INPUT_2, ENGINE_PWM> fastPwmBridge;
+  Motor::RpmEstimator estimator;
+  Motor::SpeedController controller(Motor::DEFAULT_SPEED_GAINS);
+  int32_t count;
+  uint32_t now;
+
+  /* A stick position, running a little past both ends of the range */
+  uint16_t raw(uint8_t input)
+  {
+    return Data::MIN_RAW_INPUT - 8 + input * 16;
+  }
+
+  void __attribute__((noinline)) nothing(uint8_t)
+  {
+  }
+
+  /* What Input::Read() used before LinearMap */
+  void __attribute__((noinline)) arduinoMap(uint8_t input)
+  {
+    sink = map(raw(input), Data::MIN_RAW_INPUT, Data::MAX_RAW_INPUT, Data::MIN_RUDDER_ANGLE, Data::MAX_RUDDER_ANGLE);
+  }
+
+  void __attribute__((noinline)) rudderMap(uint8_t input)
+  {
+    sink = Data::RudderMap::apply(raw(input));
+  }
+
+  void __attribute__((noinline)) hbridgeForward(uint8_t)
+  {
+    bridge.forward();
+  }
+
+  void __attribute__((noinline)) fastForward(uint8_t)
+  {
+    fastBridge.forward();
+  }
+
+  void __attribute__((noinline)) hbridgeBackward(uint8_t)
+  {
+    bridge.backward();
+  }
+
+  void __attribute__((noinline)) fastBackward(uint8_t)
+  {
+    fastBridge.backward();
+  }
+
+  void __attribute__((noinline)) hbridgeStop(uint8_t)
+  {
+    bridge.stop();
+  }
+
+  void __attribute__((noinline)) fastStop(uint8_t)
+  {
+    fastBridge.stop();
+  }
+
+  void __attribute__((noinline)) hbridgeOff(uint8_t)
+  {
+    bridge.off();
+  }
+
+  void __attribute__((noinline)) fastOff(uint8_t)
+  {
+    fastBridge.off();
+  }
+
+  void __attribute__((noinline)) hbridgePwmSet(uint8_t input)
+  {
+    pwmBridge.set(Motor::FORWARD, input * 4);
+  }
+
+  void __attribute__((noinline)) fastPwmSet(uint8_t input)
+  {
+    fastPwmBridge.set(Motor::FORWARD, input * 4);
+  }
+
+  /* From a crawl that times edges to full speed that divides by the period */
+  void __attribute__((noinline)) rpmSample(uint8_t input)
+  {
+    count += input;
+    now += Motor::RPM_SAMPLE_PERIOD;
+    estimator.sample(count, now);
+  }
+
+  void __attribute__((noinline)) speedUpdate(uint8_t input)
+  {
+    sink = controller.update(150, int32_t(input) * 4);
+  }
+
+  const Benchmark BENCHMARKS[] = {
+    { "arduino_map", arduinoMap, "map" },
+    { "rudder_map", rudderMap, "AvrBench::rudderMap" },
+    { "hbridge_forward", hbridgeForward, "Motor::HBridge::forward+digitalWrite" },
+    { "fast_hbridge_forward", fastForward, "AvrBench::fastForward" },
+    { "hbridge_backward", hbridgeBackward, "Motor::HBridge::backward+digitalWrite" },
+    { "fast_hbridge_backward", fastBackward, "AvrBench::fastBackward" },
+    { "hbridge_stop", hbridgeStop, "Motor::HBridge::stop+digitalWrite" },
+    { "fast_hbridge_stop", fastStop, "AvrBench::fastStop" },
+    { "hbridge_off", hbridgeOff, "Motor::HBridge::off+digitalWrite" },
+    { "fast_hbridge_off", fastOff, "AvrBench::fastOff" },
+    { "hbridge_pwm_set", hbridgePwmSet, "Motor::HBridgePWM::set+Motor::HBridgePWM::setSpeed+Motor::HBridge::forward+digitalWrite+analogWrite" },
+    { "fast_hbridge_pwm_set", fastPwmSet, "AvrBench::fastPwmSet+analogWrite" },
+    { "rpm_sample", rpmSample, "Motor::RpmEstimator::sample+Motor::RpmEstimator::filter" },
+    { "speed_update", speedUpdate, "Motor::SpeedController::update" }
+  };
+
+  /* Cycles one call takes, calling overhead included */
+  uint16_t cycles(Run run, uint8_t input)
+  {
+    uint8_t sreg = SREG;
+    cli();
+    TIFR3 = _BV(TOV3);
+    TCNT3 = 0;
+    run(input);
+    uint16_t taken = TCNT3;
+    bool overflowed = TIFR3 & _BV(TOV3);
+    SREG = sreg;
+    return overflowed ? UINT16_MAX : taken;
+  }
+
+  /* Least cycles run() ever takes */
+  uint16_t fastest(Run run)
+  {
+    uint16_t least = UINT16_MAX;
+    for (uint8_t input = 0; input < INPUTS; input++)
+    {
+      uint16_t taken = cycles(run, input);
+      least = taken < least ? taken : least;
+    }
+    return least;
+  }
+
+  void report(const Benchmark& benchmark, uint16_t overhead)
+  {
+    uint16_t least = UINT16_MAX;
+    uint16_t most = 0;
+    uint32_t total = 0;
+    for (uint8_t input = 0; input < INPUTS; input++)
+    {
+      uint16_t taken = cycles(benchmark.run, input);
+      taken = taken > overhead ? taken - overhead : 0;
+      least = taken < least ? taken : least;
+      most = taken > most ? taken : most;
+      total += taken;
+    }
+    Serial.print(F("BENCH "));
+    Serial.print(benchmark.name);
+    Serial.print(' ');
+    Serial.print(least);
+    Serial.print(' ');
+    Serial.print((total + INPUTS / 2) / INPUTS);
+    Serial.print(' ');
+    Serial.print(most);
+    Serial.print(' ');
+    Serial.println(benchmark.symbols);
+  }
+}
+
+void setup()
+{
+  Serial.begin(115200);
+
+  // Timer3 free running at the CPU clock
+  TCCR3A = 0;
+  TCCR3B = _BV(CS30);
+
+  AvrBench::estimator.begin(0, 0);
+  AvrBench::controller.reset(0);
+  uint16_t overhead = AvrBench::fastest(AvrBench::nothing);
+  for (const AvrBench::Benchmark& benchmark : AvrBench::BENCHMARKS)
+  {
+    AvrBench::report(benchmark, overhead);
+  }
+  Serial.print(F("BENCH_DONE "));
+  Serial.println(overhead);
+  Serial.flush();
+
+  cli();
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+  sleep_cpu();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,34 @@
+# Runs avr_bench.elf under simavr and gathers what avr_bench_report reads:
+# the benchmark output, the symbol sizes and the stack use files.
+#
+#   cmake -DRUN_AVR=... -DAVR_NM=... -DBUILD=<avr build dir> -DOUT=<dir> -P run.cmake
+
+set(ELF ${BUILD}/avr_bench.elf)
+
+# simavr prints the UART on stderr, so both streams go to the one file
+execute_process(
+  COMMAND ${RUN_AVR} -m atmega2560 -f 16000000 ${ELF}
+  OUTPUT_FILE ${OUT}/avr_bench.out
+  ERROR_FILE ${OUT}/avr_bench.out
+  RESULT_VARIABLE result
+  TIMEOUT 120
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "run_avr failed (${result}), see ${OUT}/avr_bench.out")
+endif()
+
+execute_process(
+  COMMAND ${AVR_NM} -C --print-size --size-sort ${ELF}
+  OUTPUT_FILE ${OUT}/avr_bench.sym
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "avr-nm failed (${result})")
+endif()
+
+file(GLOB_RECURSE STACK_FILES ${BUILD}/*.su)
+file(WRITE ${OUT}/avr_bench.su "")
+foreach(stackFile ${STACK_FILES})
+  file(READ ${stackFile} usage)
+  file(APPEND ${OUT}/avr_bench.su "${usage}")
+endforeach()
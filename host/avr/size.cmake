@@ -0,0 +1,12 @@
+# Sizes the sketch's image for avr_ram_report.
+#
+#   cmake -DAVR_SIZE=... -DELF=<sketch image> -DOUT=<file> -P size.cmake
+
+execute_process(
+  COMMAND ${AVR_SIZE} -A ${ELF}
+  OUTPUT_FILE ${OUT}
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "avr-size failed (${result})")
+endif()
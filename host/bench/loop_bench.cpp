@@ -0,0 +1,228 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * loop_bench - Per-stage cost of the control loop on the host.
+ *
+ * Runs setup() once against the simulated board, then times each stage
+ * of loop() on its own, plus all the scheduler work that falls due in one
+ * receiver frame. The virtual clock is moved
+ * between calls so every timed call takes its "work" path rather than an
+ * early return. Numbers are host nanoseconds; use them to compare changes,
+ * not to predict AVR cycle counts.
+ *
+ * usage: loop_bench [iterations]
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "sketch.h"
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  struct Stats
+  {
+    const char* name;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint32_t count;
+  };
+
+  /* Mirrors RX_PERIOD in the sketch */
+  constexpr uint32_t TICK_US = 7000;
+
+  uint64_t overhead = 0;
+
+  uint64_t elapsed(Clock::time_point start, Clock::time_point end)
+  {
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    return ns > overhead ? ns - overhead : 0;
+  }
+
+  void record(Stats& stats, uint64_t ns)
+  {
+    stats.total += ns;
+    stats.count++;
+    if (ns < stats.min)
+    {
+      stats.min = ns;
+    }
+    if (ns > stats.max)
+    {
+      stats.max = ns;
+    }
+  }
+
+  Stats makeStats(const char* name)
+  {
+    Stats stats = { name, 0, UINT64_MAX, 0, 0 };
+    return stats;
+  }
+
+  void report(const Stats& stats)
+  {
+    printf("%-32s %10.1f %10llu %10llu %10u\n",
+      stats.name,
+      stats.count ? double(stats.total) / stats.count : 0.0,
+      (unsigned long long)(stats.count ? stats.min : 0),
+      (unsigned long long)stats.max,
+      stats.count);
+  }
+
+  /* Cost of taking two timestamps back to back, subtracted from every sample */
+  void calibrate()
+  {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 10000; i++)
+    {
+      Clock::time_point start = Clock::now();
+      Clock::time_point end = Clock::now();
+      uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      if (ns < best)
+      {
+        best = ns;
+      }
+    }
+    overhead = best;
+  }
+
+  /* Sweeps the sticks and flips the switches so change detection fires */
+  void moveSticks(uint32_t i)
+  {
+    uint16_t sweep = 1000 + (i * 7) % 1001;
+    Sim::setChannel(Data::RUDDER_INDEX, sweep);
+    Sim::setChannel(Data::DIVE_PLANE_INDEX, 3000 - sweep);
+    Sim::setChannel(Data::THROTTLE_INDEX, sweep);
+    Sim::setChannel(Data::SWA_INDEX, (i / 64) % 2 ? 2000 : 1000);
+    Sim::setChannel(Data::SWC_INDEX, 1000 + 500 * ((i / 32) % 3));
+    Sim::deliverFrame();
+  }
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+
+  calibrate();
+  Sim::reset();
+  setup();
+
+  Stats loopIdle = makeStats("loop() idle");
+  Stats loopTick = makeStats("loop() frame");
+  Stats rxRead = makeStats("Data::Input::Read");
+  Stats actuators = makeStats("updateActuators");
+  Stats servoFlush = makeStats("Actuator::ServoBank::flush");
+  Stats txSet = makeStats("Data::Output::SetSensors");
+  Stats encRead = makeStats("Motor::HBridgePWMEnc::read");
+  Stats speedUpdate = makeStats("Motor::SpeedController::update");
+  Stats slowBridge = makeStats("Motor::HBridge forward+off");
+  Stats fastBridge = makeStats("Motor::FastHBridge forward+off");
+  Stats headingFuse = makeStats("Sensor::Compass::fuse");
+  Motor::SpeedController controller(Motor::DEFAULT_SPEED_GAINS);
+  Motor::HBridge runtimePins(WATER_PUMP_INPUT_1, WATER_PUMP_INPUT_2);
+  Motor::HBridge& bridge = runtimePins; // Called through the base, as HBridgePWMEnc is
+
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    // Decode on its own, then the per-frame control path it normally triggers
+    moveSticks(i);
+    Rx.OnFrame(nullptr);
+    Clock::time_point start = Clock::now();
+    Rx.Read();
+    record(rxRead, elapsed(start, Clock::now()));
+    Rx.OnFrame(updateActuators);
+
+    start = Clock::now();
+    updateActuators(Rx);
+    record(actuators, elapsed(start, Clock::now()));
+
+    start = Clock::now();
+    servos.flush(micros());
+    record(servoFlush, elapsed(start, Clock::now()));
+
+    start = Clock::now();
+    Tx.SetSensors(engine.getRpm(), adc.read(batterySlot), depthSensor.pressure(), depthSensor.depth(), compass.degrees());
+    record(txSet, elapsed(start, Clock::now()));
+
+    Sim::advanceMicros(Motor::RPM_SAMPLE_PERIOD);
+    Sim::moveEncoder(ENGINE_ENCODER_TRIGGER_1, 70 + i % 10);
+    start = Clock::now();
+    engine.read();
+    record(encRead, elapsed(start, Clock::now()));
+
+    start = Clock::now();
+    controller.update(150, engine.getRpm());
+    record(speedUpdate, elapsed(start, Clock::now()));
+
+    start = Clock::now();
+    bridge.forward();
+    bridge.off();
+    record(slowBridge, elapsed(start, Clock::now()));
+
+    start = Clock::now();
+    waterPump.forward();
+    waterPump.off();
+    record(fastBridge, elapsed(start, Clock::now()));
+
+    // Pitch and roll the boat a little so every fuse() has new vectors
+    Sim::setImu(int16_t(i % 97) - 48, int16_t(i % 89) - 44, 990, 200 - int16_t(i % 50), int16_t(i % 31), -450);
+    compass.update();
+    compass.update();
+    start = Clock::now();
+    compass.fuse();
+    record(headingFuse, elapsed(start, Clock::now()));
+
+    // One receiver frame of time, then every task that fell due
+    moveSticks(i + 1);
+    Sim::advanceMicros(TICK_US);
+    start = Clock::now();
+    while (scheduler.run())
+    {
+    }
+    record(loopTick, elapsed(start, Clock::now()));
+
+    start = Clock::now();
+    loop();
+    record(loopIdle, elapsed(start, Clock::now()));
+  }
+
+  printf("%-32s %10s %10s %10s %10s\n", "stage", "mean ns", "min ns", "max ns", "calls");
+  report(loopTick);
+  report(loopIdle);
+  report(rxRead);
+  report(actuators);
+  report(servoFlush);
+  report(txSet);
+  report(encRead);
+  report(speedUpdate);
+  report(slowBridge);
+  report(fastBridge);
+  report(headingFuse);
+
+  printf("\nservo bus: %u bytes over %.1f s, %u bytes/s in the last second, %u transactions on Wire\n",
+    servos.busBytes(), Sim::now() / 1e6, servos.busRate(), Wire.transactions);
+
+  return 0;
+}
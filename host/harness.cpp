@@ -0,0 +1,83 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "harness.h"
+#include "sim.h"
+
+namespace
+{
+  uint32_t nextFrame = 0;
+  bool receiving = true;
+  bool watchdogBit = false;
+}
+
+void Harness::resetBoard()
+{
+  Sim::reset();
+  Sim::setAnalog(Data::BATTERY_PIN, HEALTHY_BATTERY);
+}
+
+void Harness::startSketch()
+{
+  setup();
+  nextFrame = micros();
+  receiving = true;
+  watchdogBit = false;
+}
+
+void Harness::runSketchFor(uint32_t us, uint32_t stepUs, StepHook hook)
+{
+  for (uint32_t t = 0; t < us; t += stepUs)
+  {
+    if (receiving && int32_t(micros() - nextFrame) >= 0)
+    {
+      Sim::deliverFrame();
+      nextFrame += FRAME_US;
+    }
+    for (uint8_t i = 0; i < LOOPS_PER_STEP; i++)
+    {
+      loop();
+    }
+    watchdogBit |= Sim::watchdogExpired();
+    Sim::advanceMicros(stepUs);
+    if (hook)
+    {
+      hook();
+    }
+  }
+}
+
+void Harness::setReceiving(bool on)
+{
+  if (on && !receiving)
+  {
+    nextFrame = micros();
+  }
+  receiving = on;
+}
+
+uint32_t Harness::lastFrame()
+{
+  return nextFrame - FRAME_US;
+}
+
+bool Harness::watchdogFired()
+{
+  return watchdogBit;
+}
@@ -0,0 +1,65 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * harness.h - Runs the linked sketch on the simulated board, with a
+ * receiver sending frames, for tests that drive it end to end.
+ */
+
+#ifndef HARNESS_h
+#define HARNESS_h
+
+#include <stdint.h>
+
+#include "sketch.h"
+
+namespace Harness
+{
+  /* iBus frame spacing from the receiver */
+  static constexpr uint32_t FRAME_US = 7000;
+
+  /* About 12 V through the 3:1 divider on a 10 bit reading */
+  static constexpr int HEALTHY_BATTERY = 820;
+
+  /* loop() calls per step, enough for every task due in it to run */
+  static constexpr uint8_t LOOPS_PER_STEP = 8;
+
+  /* Called once per step after the clock moves, to model what the outputs drive */
+  typedef void (*StepHook)();
+
+  /* Power-on state with a healthy battery; stage the channels after this */
+  void resetBoard();
+
+  /* Runs setup() and has the receiver send a frame now and every FRAME_US after */
+  void startSketch();
+
+  /* Runs the sketch for us of virtual time, a step of stepUs at a time */
+  void runSketchFor(uint32_t us, uint32_t stepUs, StepHook hook = nullptr);
+
+  /* Stops the frames, as a lost link would, or starts them again from now */
+  void setReceiving(bool on);
+
+  /* micros() when the last frame went out */
+  uint32_t lastFrame();
+
+  /* Whether the watchdog expired at any step since startSketch() */
+  bool watchdogFired();
+}
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "Adafruit_PWMServoDriver.h"
+#include "sim.h"
+#include "simDetail.h"
+
+namespace
+{
+  /* The board's PCA9685, as measured for the sketch's SERVO_OSCILLATOR */
+  constexpr uint32_t BOARD_OSCILLATOR = 27000000;
+
+  /* Register file of the PCA9685, with its auto-increment pointer */
+  class Pca9685 : public Sim::I2cDevice
+  {
+    public:
+      void reset()
+      {
+        memset(registers, 0, sizeof(registers));
+        registers[PCA9685_MODE1] = MODE1_SLEEP;
+        registers[PCA9685_PRESCALE] = 0x1E;
+        pointer = 0;
+        updates = 0;
+        oscillator = BOARD_OSCILLATOR;
+      }
+
+      void receive(const uint8_t* data, uint8_t size) override
+      {
+        if (size == 0)
+        {
+          return;
+        }
+        pointer = data[0];
+        for (uint8_t i = 1; i < size; i++)
+        {
+          registers[pointer] = data[i];
+          if (pointer >= PCA9685_LED0_ON_L && pointer < PCA9685_LED0_ON_L + 4 * Sim::NUM_SERVO_CHANNELS && (pointer & 3) == 1)
+          {
+            updates++;
+          }
+          advance();
+        }
+      }
+
+      uint8_t request(uint8_t* data, uint8_t size) override
+      {
+        for (uint8_t i = 0; i < size; i++)
+        {
+          data[i] = registers[pointer];
+          advance();
+        }
+        return size;
+      }
+
+      uint16_t micros(uint8_t channel) const
+      {
+        uint8_t base = PCA9685_LED0_ON_L + 4 * channel;
+        uint32_t off = registers[base + 2] | (registers[base + 3] & 0x0F) << 8;
+        uint64_t period = uint64_t(off) * (registers[PCA9685_PRESCALE] + 1) * 1000000;
+        return uint16_t((period + oscillator / 2) / oscillator);
+      }
+
+      uint32_t updates;
+
+      /* What the chip's oscillator really runs at; the driver can still set it */
+      uint32_t oscillator;
+
+    private:
+      void advance()
+      {
+        if (registers[PCA9685_MODE1] & MODE1_AI)
+        {
+          pointer++;
+        }
+      }
+
+      uint8_t registers[256];
+      uint8_t pointer;
+  };
+
+  Pca9685 chip;
+}
+
+void Sim::Detail::resetServoDriver()
+{
+  chip.reset();
+  attachI2c(PCA9685_I2C_ADDRESS, &chip);
+}
+
+uint16_t Sim::servoMicros(uint8_t channel)
+{
+  return channel < NUM_SERVO_CHANNELS ? chip.micros(channel) : 0;
+}
+
+uint32_t Sim::servoWrites()
+{
+  return chip.updates;
+}
+
+Adafruit_PWMServoDriver::Adafruit_PWMServoDriver(const uint8_t addr, TwoWire& i2c)
+  : address(addr), wire(&i2c)
+{
+}
+
+bool Adafruit_PWMServoDriver::begin(uint8_t prescale)
+{
+  (void)prescale;
+  wire->begin();
+  reset();
+  setPWMFreq(1000);
+  return true;
+}
+
+void Adafruit_PWMServoDriver::reset()
+{
+  write8(PCA9685_MODE1, MODE1_RESTART);
+  delay(10);
+}
+
+void Adafruit_PWMServoDriver::setOscillatorFrequency(uint32_t freq)
+{
+  oscillatorFreq = freq;
+  chip.oscillator = freq;
+}
+
+uint32_t Adafruit_PWMServoDriver::getOscillatorFrequency(void)
+{
+  return oscillatorFreq;
+}
+
+void Adafruit_PWMServoDriver::setPWMFreq(float freq)
+{
+  freq = constrain(freq, 1.0f, 3500.0f);
+  float prescaleval = ((oscillatorFreq / (freq * 4096.0)) + 0.5) - 1;
+  prescaleval = constrain(prescaleval, float(PCA9685_PRESCALE_MIN), float(PCA9685_PRESCALE_MAX));
+  uint8_t prescale = uint8_t(prescaleval);
+
+  uint8_t oldmode = read8(PCA9685_MODE1);
+  uint8_t newmode = (oldmode & ~MODE1_RESTART) | MODE1_SLEEP;
+  write8(PCA9685_MODE1, newmode);
+  write8(PCA9685_PRESCALE, prescale);
+  write8(PCA9685_MODE1, oldmode);
+  delay(5);
+  write8(PCA9685_MODE1, oldmode | MODE1_RESTART | MODE1_AI);
+}
+
+uint8_t Adafruit_PWMServoDriver::readPrescale(void)
+{
+  return read8(PCA9685_PRESCALE);
+}
+
+uint8_t Adafruit_PWMServoDriver::setPWM(uint8_t num, uint16_t on, uint16_t off)
+{
+  wire->beginTransmission(address);
+  wire->write(uint8_t(PCA9685_LED0_ON_L + 4 * num));
+  wire->write(uint8_t(on));
+  wire->write(uint8_t(on >> 8));
+  wire->write(uint8_t(off));
+  wire->write(uint8_t(off >> 8));
+  return wire->endTransmission();
+}
+
+void Adafruit_PWMServoDriver::writeMicroseconds(uint8_t num, uint16_t Microseconds)
+{
+  double pulse = Microseconds;
+  double pulselength = 1000000;
+  uint16_t prescale = readPrescale() + 1;
+  pulselength *= prescale;
+  pulselength /= oscillatorFreq;
+  pulse /= pulselength;
+  setPWM(num, 0, uint16_t(pulse));
+}
+
+uint8_t Adafruit_PWMServoDriver::read8(uint8_t addr)
+{
+  wire->beginTransmission(address);
+  wire->write(addr);
+  wire->endTransmission();
+  wire->requestFrom(address, uint8_t(1));
+  return uint8_t(wire->read());
+}
+
+void Adafruit_PWMServoDriver::write8(uint8_t addr, uint8_t d)
+{
+  wire->beginTransmission(address);
+  wire->write(addr);
+  wire->write(d);
+  wire->endTransmission();
+}
@@ -0,0 +1,72 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Adafruit_PWMServoDriver.h - Host stand-in for the PCA9685 driver.
+ *
+ * Talks to the chip over Wire the way the Adafruit library does,
+ * including reading the prescaler back on every writeMicroseconds(),
+ * so bus traffic and blocking time match the real thing. The chip
+ * itself is simulated behind Sim::attachI2c().
+ */
+
+#ifndef _ADAFRUIT_PWMServoDriver_H
+#define _ADAFRUIT_PWMServoDriver_H
+
+#include <stdint.h>
+
+#include "Wire.h"
+
+#define PCA9685_MODE1 0x00
+#define PCA9685_LED0_ON_L 0x06
+#define PCA9685_PRESCALE 0xFE
+
+#define MODE1_AI 0x20
+#define MODE1_SLEEP 0x10
+#define MODE1_RESTART 0x80
+
+#define PCA9685_I2C_ADDRESS 0x40
+#define FREQUENCY_OSCILLATOR 25000000
+#define PCA9685_PRESCALE_MIN 3
+#define PCA9685_PRESCALE_MAX 255
+
+class Adafruit_PWMServoDriver
+{
+  public:
+    Adafruit_PWMServoDriver(const uint8_t addr = PCA9685_I2C_ADDRESS, TwoWire& i2c = Wire);
+
+    bool begin(uint8_t prescale = 0);
+    void setOscillatorFrequency(uint32_t freq);
+    uint32_t getOscillatorFrequency(void);
+    void reset();
+    void setPWMFreq(float freq);
+    uint8_t readPrescale(void);
+    uint8_t setPWM(uint8_t num, uint16_t on, uint16_t off);
+    void writeMicroseconds(uint8_t num, uint16_t Microseconds);
+
+  private:
+    uint8_t read8(uint8_t addr);
+    void write8(uint8_t addr, uint8_t d);
+
+    uint8_t address;
+    TwoWire* wire;
+    uint32_t oscillatorFreq = FREQUENCY_OSCILLATOR;
+};
+
+#endif
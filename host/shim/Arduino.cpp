@@ -0,0 +1,212 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "sim.h"
+#include "simDetail.h"
+
+namespace
+{
+  uint64_t clockMicros = 0;
+  uint8_t modes[Sim::NUM_PINS];
+
+  /* Output register and bit behind each pin, as in the core's pins_arduino.h */
+  volatile uint8_t* const PORTS[Sim::NUM_PINS] = {
+    &PORTE, &PORTE, &PORTE, &PORTE, &PORTG, &PORTE, &PORTH, &PORTH, &PORTH, &PORTH,
+    &PORTB, &PORTB, &PORTB, &PORTB, &PORTJ, &PORTJ, &PORTH, &PORTH, &PORTD, &PORTD,
+    &PORTD, &PORTD, &PORTA, &PORTA, &PORTA, &PORTA, &PORTA, &PORTA, &PORTA, &PORTA,
+    &PORTC, &PORTC, &PORTC, &PORTC, &PORTC, &PORTC, &PORTC, &PORTC, &PORTD, &PORTG,
+    &PORTG, &PORTG, &PORTL, &PORTL, &PORTL, &PORTL, &PORTL, &PORTL, &PORTL, &PORTL,
+    &PORTB, &PORTB, &PORTB, &PORTB, &PORTF, &PORTF, &PORTF, &PORTF, &PORTF, &PORTF,
+    &PORTF, &PORTF, &PORTK, &PORTK, &PORTK, &PORTK, &PORTK, &PORTK, &PORTK, &PORTK
+  };
+  const uint8_t BITS[Sim::NUM_PINS] = {
+    0, 1, 4, 5, 5, 3, 3, 4, 5, 6,
+    4, 5, 6, 7, 1, 0, 1, 0, 3, 2,
+    1, 0, 0, 1, 2, 3, 4, 5, 6, 7,
+    7, 6, 5, 4, 3, 2, 1, 0, 7, 2,
+    1, 0, 7, 6, 5, 4, 3, 2, 1, 0,
+    3, 2, 1, 0, 0, 1, 2, 3, 4, 5,
+    6, 7, 0, 1, 2, 3, 4, 5, 6, 7
+  };
+
+  uint8_t outputLevel(uint8_t pin)
+  {
+    return *PORTS[pin] & _BV(BITS[pin]) ? HIGH : LOW;
+  }
+  uint8_t inputs[Sim::NUM_PINS];
+  int analogValues[Sim::NUM_PINS];
+  int pwmValues[Sim::NUM_PINS];
+  uint32_t writeCount = 0;
+}
+
+void Sim::Detail::resetCore()
+{
+  clockMicros = 0;
+  writeCount = 0;
+  for (uint8_t i = 0; i < NUM_PINS; i++)
+  {
+    modes[i] = INPUT;
+    inputs[i] = LOW;
+    analogValues[i] = 0;
+    pwmValues[i] = 0;
+  }
+}
+
+void Sim::reset()
+{
+  Detail::resetCore();
+  Detail::resetRegisters();
+  Detail::resetSerial();
+  Detail::resetIBus();
+  Detail::resetEncoders();
+  Detail::resetWire();
+  Detail::resetServoDriver();
+  Detail::resetPressureSensor();
+  Detail::resetImu();
+}
+
+uint64_t Sim::now()
+{
+  return clockMicros;
+}
+
+void Sim::advanceMicros(uint32_t us)
+{
+  clockMicros += us;
+  Detail::runAdc();
+}
+
+void Sim::advanceMillis(uint32_t ms)
+{
+  clockMicros += uint64_t(ms) * 1000;
+  Detail::runAdc();
+}
+
+uint8_t Sim::pinMode(uint8_t pin)
+{
+  return pin < NUM_PINS ? modes[pin] : INPUT;
+}
+
+uint8_t Sim::pinLevel(uint8_t pin)
+{
+  return pin < NUM_PINS ? outputLevel(pin) : LOW;
+}
+
+int Sim::pwmLevel(uint8_t pin)
+{
+  return pin < NUM_PINS ? pwmValues[pin] : 0;
+}
+
+void Sim::setPinInput(uint8_t pin, uint8_t level)
+{
+  if (pin < NUM_PINS)
+  {
+    inputs[pin] = level;
+  }
+}
+
+void Sim::setAnalog(uint8_t pin, int value)
+{
+  if (pin < NUM_PINS)
+  {
+    analogValues[pin] = value;
+  }
+}
+
+uint32_t Sim::digitalWrites()
+{
+  return writeCount;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < Sim::NUM_PINS)
+  {
+    modes[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  writeCount++;
+  if (pin < Sim::NUM_PINS)
+  {
+    if (val)
+    {
+      *PORTS[pin] |= _BV(BITS[pin]);
+    }
+    else
+    {
+      *PORTS[pin] &= ~_BV(BITS[pin]);
+    }
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  if (pin >= Sim::NUM_PINS)
+  {
+    return LOW;
+  }
+  return modes[pin] == OUTPUT ? outputLevel(pin) : inputs[pin];
+}
+
+int analogRead(uint8_t pin)
+{
+  // Both A1 and 1 address the same channel on the real core
+  if (pin < Sim::NUM_PINS - A0)
+  {
+    pin += A0;
+  }
+  return pin < Sim::NUM_PINS ? analogValues[pin] : 0;
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+  if (pin < Sim::NUM_PINS)
+  {
+    pwmValues[pin] = val;
+  }
+}
+
+unsigned long millis(void)
+{
+  return uint32_t(clockMicros / 1000);
+}
+
+unsigned long micros(void)
+{
+  return uint32_t(clockMicros);
+}
+
+void delay(unsigned long ms)
+{
+  Sim::advanceMillis(ms);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  Sim::advanceMicros(us);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+  return int32_t(int32_t(x - in_min) * int32_t(out_max - out_min) / int32_t(in_max - in_min) + out_min);
+}
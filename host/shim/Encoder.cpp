@@ -0,0 +1,92 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Encoder.h"
+#include "sim.h"
+#include "simDetail.h"
+
+namespace
+{
+  /* The real library supports as many encoders as there are interrupt pins */
+  constexpr uint8_t MAX_ENCODERS = 6;
+  Encoder* encoders[MAX_ENCODERS];
+}
+
+void Sim::Detail::resetEncoders()
+{
+  for (uint8_t i = 0; i < MAX_ENCODERS; i++)
+  {
+    if (encoders[i])
+    {
+      encoders[i]->write(0);
+    }
+  }
+}
+
+void Sim::moveEncoder(uint8_t pinA, int32_t counts)
+{
+  for (uint8_t i = 0; i < MAX_ENCODERS; i++)
+  {
+    if (encoders[i] && encoders[i]->pinA() == pinA)
+    {
+      encoders[i]->position += counts;
+    }
+  }
+}
+
+Encoder::Encoder(uint8_t pin1, uint8_t pin2)
+  : position(0), pin1(pin1), pin2(pin2)
+{
+  for (uint8_t i = 0; i < MAX_ENCODERS; i++)
+  {
+    if (!encoders[i])
+    {
+      encoders[i] = this;
+      break;
+    }
+  }
+}
+
+Encoder::~Encoder()
+{
+  for (uint8_t i = 0; i < MAX_ENCODERS; i++)
+  {
+    if (encoders[i] == this)
+    {
+      encoders[i] = nullptr;
+    }
+  }
+}
+
+int32_t Encoder::read()
+{
+  return position;
+}
+
+int32_t Encoder::readAndReset()
+{
+  int32_t p = position;
+  position = 0;
+  return p;
+}
+
+void Encoder::write(int32_t p)
+{
+  position = p;
+}
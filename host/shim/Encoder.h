@@ -0,0 +1,55 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Encoder.h - Host stand-in for the PJRC Encoder library.
+ *
+ * Counts only change when a test calls Sim::moveEncoder().
+ */
+
+#ifndef Encoder_h_
+#define Encoder_h_
+
+#include <stdint.h>
+
+class Encoder
+{
+  public:
+    Encoder(uint8_t pin1, uint8_t pin2);
+    ~Encoder();
+
+    int32_t read();
+    int32_t readAndReset();
+    void write(int32_t p);
+
+    /* Host only: pin the A channel is wired to */
+    uint8_t pinA() const
+    {
+      return pin1;
+    }
+
+    /* Host only: counts added by the simulation */
+    volatile int32_t position;
+
+  private:
+    uint8_t pin1;
+    uint8_t pin2;
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "HardwareSerial.h"
+#include "WString.h"
+#include "simDetail.h"
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
+
+namespace
+{
+  /* Same size as the AVR core's transmit ring */
+  constexpr int TX_BUFFER_SIZE = 64;
+
+  void resetPort(HardwareSerial& port)
+  {
+    port.end();
+    port.output.clear();
+    port.txFree = TX_BUFFER_SIZE - 1;
+    while (port.available())
+    {
+      port.read();
+    }
+  }
+}
+
+void Sim::Detail::resetSerial()
+{
+  resetPort(Serial);
+  resetPort(Serial1);
+  resetPort(Serial2);
+  resetPort(Serial3);
+}
+
+void HardwareSerial::begin(unsigned long rate, uint8_t config)
+{
+  (void)config;
+  baud = rate;
+}
+
+void HardwareSerial::end()
+{
+  baud = 0;
+}
+
+int HardwareSerial::available()
+{
+  return rx.size();
+}
+
+int HardwareSerial::availableForWrite()
+{
+  return txFree;
+}
+
+int HardwareSerial::read()
+{
+  if (rx.empty())
+  {
+    return -1;
+  }
+  uint8_t c = rx.front();
+  rx.pop_front();
+  return c;
+}
+
+void HardwareSerial::flush()
+{
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  output.push_back(char(c));
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+  output.append(reinterpret_cast<const char*>(buffer), size);
+  return size;
+}
+
+size_t HardwareSerial::print(const char* str)
+{
+  size_t n = strlen(str);
+  output.append(str, n);
+  return n;
+}
+
+size_t HardwareSerial::print(const String& str)
+{
+  return print(str.c_str());
+}
+
+size_t HardwareSerial::print(char c)
+{
+  return write(uint8_t(c));
+}
+
+size_t HardwareSerial::print(long n, int base)
+{
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), base == HEX ? "%lX" : "%ld", n);
+  return print(buffer);
+}
+
+size_t HardwareSerial::print(unsigned long n, int base)
+{
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), base == HEX ? "%lX" : "%lu", n);
+  return print(buffer);
+}
+
+size_t HardwareSerial::print(double n, int digits)
+{
+  char buffer[48];
+  snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+  return print(buffer);
+}
+
+size_t HardwareSerial::println()
+{
+  return print("\r\n");
+}
+
+void HardwareSerial::inject(const uint8_t* data, size_t size)
+{
+  rx.insert(rx.end(), data, data + size);
+}
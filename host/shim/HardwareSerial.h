@@ -0,0 +1,109 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * HardwareSerial.h - Host stand-in for the AVR UARTs.
+ *
+ * Everything written is appended to an in-memory buffer that tests can
+ * inspect, received bytes are queued with inject().
+ */
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <deque>
+
+class String;
+
+#define SERIAL_8N1 0x06
+
+#define DEC 10
+#define HEX 16
+
+class HardwareSerial
+{
+  public:
+    void begin(unsigned long baud, uint8_t config = SERIAL_8N1);
+    void end();
+
+    int available();
+    int availableForWrite();
+    int read();
+    void flush();
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buffer, size_t size);
+
+    size_t print(const char* str);
+    size_t print(const String& str);
+    size_t print(char c);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(int n, int base = DEC)
+    {
+      return print((long)n, base);
+    }
+    size_t print(unsigned int n, int base = DEC)
+    {
+      return print((unsigned long)n, base);
+    }
+    size_t print(unsigned char n, int base = DEC)
+    {
+      return print((unsigned long)n, base);
+    }
+    size_t print(double n, int digits = 2);
+
+    size_t println();
+    template <typename T>
+    size_t println(T value)
+    {
+      size_t n = print(value);
+      return n + println();
+    }
+
+    operator bool() const
+    {
+      return true;
+    }
+
+    /* Host only: queue bytes as if they arrived on the wire */
+    void inject(const uint8_t* data, size_t size);
+
+    /* Host only: everything the sketch has written so far */
+    std::string output;
+
+    /* Host only: baud rate passed to begin(), 0 when closed */
+    unsigned long baud = 0;
+
+    /* Host only: what availableForWrite() reports; the wire itself drains instantly */
+    int txFree = 63;
+
+  private:
+    std::deque<uint8_t> rx;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * WString.h - Host stand-in for the Arduino String class.
+ */
+
+#ifndef String_class_h
+#define String_class_h
+
+#include <string>
+
+class String
+{
+  public:
+    String(const char* str = "") : value(str) {};
+
+    const char* c_str() const
+    {
+      return value.c_str();
+    }
+
+    unsigned int length() const
+    {
+      return value.length();
+    }
+
+    bool operator==(const String& rhs) const
+    {
+      return value == rhs.value;
+    }
+
+  private:
+    std::string value;
+};
+
+#endif
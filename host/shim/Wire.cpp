@@ -0,0 +1,121 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Wire.h"
+#include "sim.h"
+#include "simDetail.h"
+
+TwoWire Wire;
+
+namespace
+{
+  Sim::I2cDevice* devices[128];
+}
+
+void Sim::Detail::resetWire()
+{
+  for (uint8_t i = 0; i < 128; i++)
+  {
+    devices[i] = nullptr;
+  }
+  Wire = TwoWire();
+}
+
+void Sim::attachI2c(uint8_t address, I2cDevice* device)
+{
+  devices[address & 0x7F] = device;
+}
+
+void TwoWire::begin()
+{
+  clockHz = 100000;
+}
+
+void TwoWire::setClock(uint32_t clock)
+{
+  clockHz = clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  txAddress = address;
+  txLength = 0;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  (void)sendStop;
+  transactions++;
+  bytesWritten += 1 + txLength;
+  busy(1 + txLength);
+
+  Sim::I2cDevice* device = devices[txAddress & 0x7F];
+  uint8_t length = txLength;
+  txLength = 0;
+  if (device == nullptr)
+  {
+    // Address not acknowledged
+    return 2;
+  }
+  device->receive(txBuffer, length);
+  return 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (txLength >= BUFFER_LENGTH)
+  {
+    return 0;
+  }
+  txBuffer[txLength++] = data;
+  return 1;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop)
+{
+  (void)sendStop;
+  if (quantity > BUFFER_LENGTH)
+  {
+    quantity = BUFFER_LENGTH;
+  }
+  transactions++;
+  bytesWritten++;
+  bytesRead += quantity;
+  busy(1 + quantity);
+
+  Sim::I2cDevice* device = devices[address & 0x7F];
+  rxLength = device != nullptr ? device->request(rxBuffer, quantity) : 0;
+  rxIndex = 0;
+  return rxLength;
+}
+
+int TwoWire::available()
+{
+  return rxLength - rxIndex;
+}
+
+int TwoWire::read()
+{
+  return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1;
+}
+
+void TwoWire::busy(uint8_t bytes)
+{
+  Sim::advanceMicros(uint32_t(bytes) * 9 * 1000000 / clockHz);
+}
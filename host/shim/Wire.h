@@ -0,0 +1,70 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Wire.h - Host stand-in for the Arduino TwoWire library.
+ *
+ * Transactions go to whichever Sim::I2cDevice is attached at the
+ * address; with none there they are acknowledged and reads return
+ * nothing. Like the AVR library every call blocks, so the virtual clock
+ * moves on by the time the bytes take at the bus clock. Bytes are
+ * counted so benchmarks can see how much traffic a stage generates.
+ */
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BUFFER_LENGTH 32
+
+class TwoWire
+{
+  public:
+    void begin();
+    void setClock(uint32_t clock);
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(bool sendStop = true);
+    size_t write(uint8_t data);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = true);
+    int available();
+    int read();
+
+    /* Host only: bus statistics */
+    uint32_t clockHz = 100000;
+    uint32_t bytesWritten = 0;
+    uint32_t bytesRead = 0;
+    uint32_t transactions = 0;
+
+  private:
+    /* Blocks for the time some bytes take on the wire, 9 clocks each */
+    void busy(uint8_t bytes);
+
+    uint8_t txAddress = 0;
+    uint8_t txBuffer[BUFFER_LENGTH];
+    uint8_t txLength = 0;
+    uint8_t rxBuffer[BUFFER_LENGTH];
+    uint8_t rxLength = 0;
+    uint8_t rxIndex = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
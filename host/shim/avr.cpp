@@ -0,0 +1,410 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "avr/io.h"
+#include "avr/eeprom.h"
+#include "avr/interrupt.h"
+#include "avr/wdt.h"
+#include "sim.h"
+#include "simDetail.h"
+
+volatile uint8_t SREG;
+
+uint8_t Sim::sram[Sim::RAM_SIZE];
+volatile uintptr_t SP;
+char* __malloc_heap_start;
+volatile uint8_t MCUSR;
+
+volatile uint8_t PORTA;
+volatile uint8_t PORTB;
+volatile uint8_t PORTC;
+volatile uint8_t PORTD;
+volatile uint8_t PORTE;
+volatile uint8_t PORTF;
+volatile uint8_t PORTG;
+volatile uint8_t PORTH;
+volatile uint8_t PORTJ;
+volatile uint8_t PORTK;
+volatile uint8_t PORTL;
+
+volatile uint8_t TCNT0;
+volatile uint8_t OCR0B;
+volatile uint8_t TIMSK0;
+volatile uint8_t TIFR0;
+
+volatile uint8_t TCCR5A;
+volatile uint8_t TCCR5B;
+volatile uint16_t TCNT5;
+volatile uint8_t TIMSK5;
+
+volatile uint8_t ADMUX;
+volatile uint8_t ADCSRA;
+volatile uint8_t ADCSRB;
+volatile uint16_t ADC;
+volatile uint8_t DIDR0;
+volatile uint8_t DIDR2;
+
+volatile uint8_t UCSR2A;
+volatile uint8_t UCSR2B;
+volatile uint8_t UCSR2C;
+volatile uint16_t UBRR2;
+Sim::UartData UDR2(2);
+
+volatile uint8_t UCSR3A;
+volatile uint8_t UCSR3B;
+volatile uint8_t UCSR3C;
+volatile uint16_t UBRR3;
+Sim::UartData UDR3(3);
+
+/* Vectors the sketch does not define do nothing, as on the real part */
+extern "C"
+{
+  __attribute__((weak)) void TIMER0_COMPB_vect(void) {}
+  __attribute__((weak)) void ADC_vect(void) {}
+  __attribute__((weak)) void USART2_RX_vect(void) {}
+  __attribute__((weak)) void USART3_RX_vect(void) {}
+  __attribute__((weak)) void USART3_UDRE_vect(void) {}
+}
+
+namespace
+{
+  constexpr uint8_t NUM_UARTS = 4;
+
+  /* One start, eight data and one stop bit at 115200 baud, rounded up */
+  constexpr uint32_t BYTE_TIME = 87;
+
+  /* Timer0 runs at F_CPU / 64, 4 us a tick */
+  constexpr uint32_t TIMER0_TICK = 4;
+
+  /* Watchdog period, 0 while disabled, and when it was last reset */
+  uint32_t watchdogPeriod = 0;
+  uint64_t watchdogKicked = 0;
+
+  /* EEPROM contents, erased until written; Sim::reset() leaves them alone */
+  struct Eeprom
+  {
+    Eeprom()
+    {
+      memset(bytes, 0xFF, sizeof(bytes));
+    }
+
+    uint8_t bytes[E2END + 1];
+  } eeprom;
+
+  /* When the byte being written is done, and bytes written since reset */
+  uint64_t eepromBusy = 0;
+  uint32_t eepromWriteCount = 0;
+
+  /* ADC clock cycles in a normal conversion */
+  constexpr uint32_t ADC_CONVERSION_CYCLES = 13;
+
+  /* When the conversion in progress finishes, 0 if none is */
+  uint64_t adcDone = 0;
+
+  /* Clock at the last look at the ADC; anything started since, started then */
+  uint64_t adcChecked = 0;
+
+  std::vector<uint8_t> transmitted[NUM_UARTS];
+  bool echo[NUM_UARTS];
+
+  struct Uart
+  {
+    volatile uint8_t* control;
+    Sim::UartData* data;
+    uint8_t rxEnable;
+    uint8_t rxInterrupt;
+    uint8_t udrInterrupt;
+    void (*rxVector)(void);
+    void (*udreVector)(void);
+  };
+
+  /* Only the USARTs the sketch drives directly are modelled */
+  Uart uart(uint8_t index)
+  {
+    static void (*const none)(void) = nullptr;
+    switch (index)
+    {
+      case 2:
+        return { &UCSR2B, &UDR2, RXEN2, RXCIE2, UDRIE2, USART2_RX_vect, none };
+      case 3:
+        return { &UCSR3B, &UDR3, RXEN3, RXCIE3, UDRIE3, USART3_RX_vect, USART3_UDRE_vect };
+      default:
+        return { nullptr, nullptr, 0, 0, 0, none, none };
+    }
+  }
+
+  void receiveByte(const Uart& port, uint8_t byte)
+  {
+    uint8_t enabled = _BV(port.rxEnable) | _BV(port.rxInterrupt);
+    if (port.control && (*port.control & enabled) == enabled)
+    {
+      port.data->received = byte;
+      port.rxVector();
+    }
+  }
+}
+
+Sim::UartData& Sim::UartData::operator=(uint8_t data)
+{
+  transmitted[uart].push_back(data);
+  return *this;
+}
+
+void Sim::setStaticRam(uint16_t bytes)
+{
+  __malloc_heap_start = reinterpret_cast<char*>(sram + (bytes < RAM_SIZE ? bytes : RAM_SIZE));
+}
+
+void Sim::setStackDepth(uint16_t bytes)
+{
+  bytes = bytes < RAM_SIZE ? bytes : RAM_SIZE;
+  for (uint16_t i = 0; i < bytes; i++)
+  {
+    sram[RAM_SIZE - 1 - i] = uint8_t(i);
+  }
+  SP = RAMEND - bytes;
+}
+
+void Sim::Detail::resetRegisters()
+{
+  memset(sram, 0, sizeof(sram));
+  setStaticRam(DEFAULT_STATIC_RAM);
+  SP = RAMEND;
+  SREG = _BV(SREG_I);
+  MCUSR = _BV(PORF);
+  watchdogPeriod = 0;
+  watchdogKicked = 0;
+  eepromBusy = 0;
+  eepromWriteCount = 0;
+  PORTA = PORTB = PORTC = PORTD = PORTE = PORTF = PORTG = 0;
+  PORTH = PORTJ = PORTK = PORTL = 0;
+  TCNT0 = OCR0B = TIMSK0 = TIFR0 = 0;
+  TCCR5A = TCCR5B = TIMSK5 = 0;
+  TCNT5 = 0;
+  ADMUX = ADCSRA = ADCSRB = 0;
+  ADC = 0;
+  DIDR0 = DIDR2 = 0;
+  adcDone = 0;
+  adcChecked = 0;
+  UCSR2A = UCSR2B = UCSR2C = 0;
+  UBRR2 = 0;
+  UCSR3A = UCSR3B = UCSR3C = 0;
+  UBRR3 = 0;
+  UDR2.received = UDR3.received = 0;
+  for (uint8_t i = 0; i < NUM_UARTS; i++)
+  {
+    transmitted[i].clear();
+    echo[i] = false;
+  }
+}
+
+void Sim::uartReceive(uint8_t index, const uint8_t* data, uint8_t size)
+{
+  Uart port = uart(index);
+  for (uint8_t i = 0; i < size; i++)
+  {
+    receiveByte(port, data[i]);
+  }
+}
+
+void Sim::setUartEcho(uint8_t index, bool enabled)
+{
+  if (index < NUM_UARTS)
+  {
+    echo[index] = enabled;
+  }
+}
+
+const std::vector<uint8_t>& Sim::uartTransmitted(uint8_t index)
+{
+  return transmitted[index < NUM_UARTS ? index : 0];
+}
+
+void Sim::clearUartTransmitted(uint8_t index)
+{
+  if (index < NUM_UARTS)
+  {
+    transmitted[index].clear();
+  }
+}
+
+void Sim::service()
+{
+  bool pending = true;
+  while (pending)
+  {
+    pending = false;
+
+    if (TIMSK0 & _BV(OCIE0B))
+    {
+      advanceMicros(uint8_t(OCR0B - TCNT0) * TIMER0_TICK);
+      TIMER0_COMPB_vect();
+      pending = true;
+    }
+
+    for (uint8_t index = 0; index < NUM_UARTS; index++)
+    {
+      Uart port = uart(index);
+      if (!port.udreVector || !(*port.control & _BV(port.udrInterrupt)))
+      {
+        continue;
+      }
+      size_t before = transmitted[index].size();
+      port.udreVector();
+      if (transmitted[index].size() > before)
+      {
+        advanceMicros(BYTE_TIME);
+        if (echo[index])
+        {
+          receiveByte(port, transmitted[index].back());
+        }
+        pending = true;
+      }
+    }
+  }
+}
+
+void Sim::Detail::runAdc()
+{
+  while ((ADCSRA & _BV(ADEN)) && (ADCSRA & _BV(ADSC)))
+  {
+    uint32_t prescale = uint32_t(1) << ((ADCSRA & 7) ? (ADCSRA & 7) : 1);
+    if (adcDone == 0)
+    {
+      adcDone = adcChecked + ADC_CONVERSION_CYCLES * prescale * 1000000 / F_CPU;
+    }
+    if (adcDone > now())
+    {
+      adcChecked = now();
+      return;
+    }
+
+    uint8_t channel = (ADMUX & 0x07) | (ADCSRB & _BV(MUX5));
+    ADC = uint16_t(constrain(analogRead(A0 + channel), 0, 1023));
+    ADCSRA &= ~_BV(ADSC);
+    ADCSRA |= _BV(ADIF);
+    uint64_t finished = adcDone;
+    adcDone = 0;
+
+    if ((ADCSRA & _BV(ADIE)) && (SREG & _BV(SREG_I)))
+    {
+      ADCSRA &= ~_BV(ADIF);
+      ADC_vect();
+    }
+
+    // A conversion the interrupt started back to back runs from when the last one finished
+    if (ADCSRA & _BV(ADSC))
+    {
+      adcDone = finished + ADC_CONVERSION_CYCLES * prescale * 1000000 / F_CPU;
+    }
+  }
+  adcDone = 0;
+  adcChecked = now();
+}
+
+bool Sim::watchdogExpired()
+{
+  return watchdogPeriod && now() - watchdogKicked >= watchdogPeriod;
+}
+
+uint32_t Sim::watchdogTimeout()
+{
+  return watchdogPeriod;
+}
+
+void wdt_enable(uint8_t timeout)
+{
+  // Nominal periods; the real oscillator is only good to about 10 %
+  watchdogPeriod = uint32_t(16000) << timeout;
+  watchdogKicked = Sim::now();
+}
+
+void wdt_disable()
+{
+  watchdogPeriod = 0;
+}
+
+void wdt_reset()
+{
+  watchdogKicked = Sim::now();
+}
+
+void Sim::eraseEeprom()
+{
+  memset(eeprom.bytes, 0xFF, sizeof(eeprom.bytes));
+}
+
+uint8_t* Sim::eepromData()
+{
+  return eeprom.bytes;
+}
+
+uint32_t Sim::eepromWrites()
+{
+  return eepromWriteCount;
+}
+
+int eeprom_is_ready()
+{
+  return Sim::now() >= eepromBusy;
+}
+
+uint8_t eeprom_read_byte(const uint8_t* address)
+{
+  return eeprom.bytes[uintptr_t(address) & E2END];
+}
+
+void eeprom_read_block(void* destination, const void* source, size_t size)
+{
+  uint8_t* to = static_cast<uint8_t*>(destination);
+  for (size_t i = 0; i < size; i++)
+  {
+    to[i] = eeprom_read_byte(static_cast<const uint8_t*>(source) + i);
+  }
+}
+
+void eeprom_update_byte(uint8_t* address, uint8_t value)
+{
+  uint8_t& cell = eeprom.bytes[uintptr_t(address) & E2END];
+  if (cell == value)
+  {
+    return;
+  }
+  // avr-libc spins until the last write is done
+  if (!eeprom_is_ready())
+  {
+    Sim::advanceMicros(uint32_t(eepromBusy - Sim::now()));
+  }
+  cell = value;
+  eepromBusy = Sim::now() + EEPROM_WRITE_TIME;
+  eepromWriteCount++;
+}
+
+void Sim::clockT5(uint32_t edges)
+{
+  // Only clock select 7 (external, rising edge) counts T5 edges
+  if ((TCCR5B & (_BV(CS52) | _BV(CS51) | _BV(CS50))) == (_BV(CS52) | _BV(CS51) | _BV(CS50)))
+  {
+    TCNT5 = uint16_t(TCNT5 + edges);
+  }
+}
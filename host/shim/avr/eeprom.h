@@ -0,0 +1,49 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * avr/eeprom.h - Host stand-in for the avr-libc EEPROM interface.
+ *
+ * The 4 KB EEPROM keeps its contents through Sim::reset(), as the chip
+ * does through a power cycle; Sim::eraseEeprom() blanks it. Each byte
+ * written keeps the EEPROM busy for EEPROM_WRITE_TIME on the virtual
+ * clock, and a write started while busy waits that out first.
+ */
+
+#ifndef _AVR_EEPROM_H_
+#define _AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END 0x0FFF
+
+/* Atomic erase and write of one byte, from the datasheet */
+#define EEPROM_WRITE_TIME 3400
+
+/* Nonzero once the last write has finished */
+int eeprom_is_ready();
+
+uint8_t eeprom_read_byte(const uint8_t* address);
+void eeprom_read_block(void* destination, const void* source, size_t size);
+
+/* Writes only if the byte differs, as avr-libc does */
+void eeprom_update_byte(uint8_t* address, uint8_t value);
+
+#endif
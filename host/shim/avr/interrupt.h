@@ -0,0 +1,56 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * avr/interrupt.h - Host stand-in for avr-libc interrupt handling.
+ *
+ * ISR() declares an ordinary C function named after the vector, so the
+ * simulation can "raise" an interrupt by calling it. Every vector the
+ * sketch may define has a weak empty default in the shim.
+ */
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#include "avr/io.h"
+
+#define ISR(vector, ...) extern "C" void vector(void)
+
+extern "C"
+{
+  void TIMER0_COMPB_vect(void);
+  void ADC_vect(void);
+  void USART2_RX_vect(void);
+  void USART3_RX_vect(void);
+  void USART3_UDRE_vect(void);
+}
+
+#define SREG_I 7
+
+inline void sei()
+{
+  SREG |= _BV(SREG_I);
+}
+
+inline void cli()
+{
+  SREG &= ~_BV(SREG_I);
+}
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * avr/io.h - Host stand-in for the ATmega2560 register file.
+ *
+ * Only the registers and bit names the sketch touches exist. Registers
+ * are plain variables, except the UART data registers which record what
+ * is written to them so tests can see transmitted bytes.
+ */
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define _BV(bit) (1 << (bit))
+
+namespace Sim
+{
+  /* A UARTn data register: reads return the received byte, writes are transmitted */
+  class UartData
+  {
+    public:
+      UartData(uint8_t uart)
+        : uart(uart), received(0) {};
+
+      operator uint8_t() const
+      {
+        return received;
+      }
+
+      UartData& operator=(uint8_t data);
+
+      /* Which USART this register belongs to */
+      const uint8_t uart;
+
+      /* Byte the next read returns */
+      uint8_t received;
+  };
+}
+
+extern volatile uint8_t SREG;
+
+/*
+ * 8 KB of simulated SRAM, see Sim::setStaticRam(). The stack pointer
+ * holds a host address inside it, as SP holds a RAM address on the Mega.
+ */
+namespace Sim
+{
+  static constexpr uint16_t RAM_SIZE = 8192;
+  extern uint8_t sram[RAM_SIZE];
+}
+
+#define RAMSTART (uintptr_t(Sim::sram))
+#define RAMEND (RAMSTART + Sim::RAM_SIZE - 1)
+
+extern volatile uintptr_t SP;
+
+/* End of the static data, where the heap would start; avr-libc has it in stdlib.h */
+extern char* __malloc_heap_start;
+
+/* Reset cause */
+extern volatile uint8_t MCUSR;
+
+#define WDRF 3
+#define BORF 2
+#define EXTRF 1
+#define PORF 0
+
+/* Digital port output registers; the Mega has no port I */
+extern volatile uint8_t PORTA;
+extern volatile uint8_t PORTB;
+extern volatile uint8_t PORTC;
+extern volatile uint8_t PORTD;
+extern volatile uint8_t PORTE;
+extern volatile uint8_t PORTF;
+extern volatile uint8_t PORTG;
+extern volatile uint8_t PORTH;
+extern volatile uint8_t PORTJ;
+extern volatile uint8_t PORTK;
+extern volatile uint8_t PORTL;
+
+/* Timer/Counter0 */
+extern volatile uint8_t TCNT0;
+extern volatile uint8_t OCR0B;
+extern volatile uint8_t TIMSK0;
+extern volatile uint8_t TIFR0;
+
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0 0
+#define OCF0B 2
+
+/* Timer/Counter5 */
+extern volatile uint8_t TCCR5A;
+extern volatile uint8_t TCCR5B;
+extern volatile uint16_t TCNT5;
+extern volatile uint8_t TIMSK5;
+
+#define CS52 2
+#define CS51 1
+#define CS50 0
+
+/* Port L, T5 is PL2 */
+#define PL2 2
+
+/* ADC */
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint16_t ADC;
+extern volatile uint8_t DIDR0;
+extern volatile uint8_t DIDR2;
+
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define MUX5 3
+
+/* USART2 */
+extern volatile uint8_t UCSR2A;
+extern volatile uint8_t UCSR2B;
+extern volatile uint8_t UCSR2C;
+extern volatile uint16_t UBRR2;
+extern Sim::UartData UDR2;
+
+/* USART3 */
+extern volatile uint8_t UCSR3A;
+extern volatile uint8_t UCSR3B;
+extern volatile uint8_t UCSR3C;
+extern volatile uint16_t UBRR3;
+extern Sim::UartData UDR3;
+
+#define RXC2 7
+#define TXC2 6
+#define UDRE2 5
+#define FE2 4
+#define DOR2 3
+#define UPE2 2
+#define U2X2 1
+#define RXCIE2 7
+#define TXCIE2 6
+#define UDRIE2 5
+#define RXEN2 4
+#define TXEN2 3
+#define UCSZ21 2
+#define UCSZ20 1
+
+#define RXC3 7
+#define TXC3 6
+#define UDRE3 5
+#define FE3 4
+#define DOR3 3
+#define UPE3 2
+#define U2X3 1
+#define RXCIE3 7
+#define TXCIE3 6
+#define UDRIE3 5
+#define RXEN3 4
+#define TXEN3 3
+#define UCSZ31 2
+#define UCSZ30 1
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sim.h"
+#include "simDetail.h"
+
+namespace
+{
+  uint16_t staged[Sim::NUM_IBUS_CHANNELS];
+
+  /* Length, command, 14 channels, checksum */
+  constexpr uint8_t FRAME_LENGTH = 0x20;
+  constexpr uint8_t COMMAND_SERVO = 0x40;
+
+  /* The receiver's servo output is wired to USART2 */
+  constexpr uint8_t SERVO_UART = 2;
+}
+
+void Sim::Detail::resetIBus()
+{
+  for (uint8_t i = 0; i < NUM_IBUS_CHANNELS; i++)
+  {
+    staged[i] = 0;
+  }
+}
+
+void Sim::setChannel(uint8_t channel, uint16_t value)
+{
+  if (channel < NUM_IBUS_CHANNELS)
+  {
+    staged[channel] = value;
+  }
+}
+
+void Sim::encodeFrame(uint8_t frame[IBUS_FRAME_LENGTH])
+{
+  uint8_t length = 0;
+  frame[length++] = FRAME_LENGTH;
+  frame[length++] = COMMAND_SERVO;
+  for (uint8_t i = 0; i < NUM_IBUS_CHANNELS; i++)
+  {
+    frame[length++] = uint8_t(staged[i]);
+    frame[length++] = uint8_t(staged[i] >> 8);
+  }
+
+  uint16_t checksum = 0xFFFF;
+  for (uint8_t i = 0; i < length; i++)
+  {
+    checksum -= frame[i];
+  }
+  frame[length++] = uint8_t(checksum);
+  frame[length++] = uint8_t(checksum >> 8);
+}
+
+void Sim::deliverFrame()
+{
+  uint8_t frame[IBUS_FRAME_LENGTH];
+  encodeFrame(frame);
+  uartReceive(SERVO_UART, frame, IBUS_FRAME_LENGTH);
+}
@@ -0,0 +1,187 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "sim.h"
+#include "simDetail.h"
+
+namespace
+{
+  constexpr uint8_t ACCEL_ADDRESS = 0x19;
+  constexpr uint8_t MAG_ADDRESS = 0x1E;
+
+  /* Counts per gauss at +-1.3 gauss, z is less sensitive */
+  constexpr int32_t MAG_XY_GAIN = 1100;
+  constexpr int32_t MAG_Z_GAIN = 980;
+
+  int16_t clampCounts(int32_t counts)
+  {
+    return counts > 2047 ? 2047 : (counts < -2048 ? -2048 : counts);
+  }
+
+  /* LSM303DLHC accelerometer: auto-increments only when the sub-address has bit 7 set */
+  class Accelerometer : public Sim::I2cDevice
+  {
+    public:
+      void reset()
+      {
+        memset(registers, 0, sizeof(registers));
+        registers[0x20] = 0x07; // Powered down
+        pointer = 0;
+        increment = false;
+      }
+
+      void receive(const uint8_t* data, uint8_t size) override
+      {
+        if (size == 0)
+        {
+          return;
+        }
+        pointer = data[0] & 0x7F;
+        increment = data[0] & 0x80;
+        for (uint8_t i = 1; i < size; i++)
+        {
+          registers[pointer] = data[i];
+          advance();
+        }
+      }
+
+      uint8_t request(uint8_t* data, uint8_t size) override
+      {
+        // Samples only appear once an output data rate is set
+        bool running = registers[0x20] & 0xF0;
+        for (uint8_t i = 0; i < 3; i++)
+        {
+          uint16_t counts = running ? uint16_t(clampCounts(mg[i]) * 16) : 0;
+          registers[0x28 + 2 * i] = uint8_t(counts);
+          registers[0x29 + 2 * i] = uint8_t(counts >> 8);
+        }
+        for (uint8_t i = 0; i < size; i++)
+        {
+          data[i] = registers[pointer];
+          advance();
+        }
+        return size;
+      }
+
+      int16_t mg[3];
+
+    private:
+      void advance()
+      {
+        if (increment)
+        {
+          pointer = (pointer + 1) & 0x7F;
+        }
+      }
+
+      uint8_t registers[128];
+      uint8_t pointer;
+      bool increment;
+  };
+
+  /* LSM303DLHC magnetometer: always auto-increments, outputs big endian x, z, y */
+  class Magnetometer : public Sim::I2cDevice
+  {
+    public:
+      void reset()
+      {
+        memset(registers, 0, sizeof(registers));
+        registers[0x02] = 0x03; // Sleeping
+        pointer = 0;
+      }
+
+      void receive(const uint8_t* data, uint8_t size) override
+      {
+        if (size == 0)
+        {
+          return;
+        }
+        pointer = data[0];
+        for (uint8_t i = 1; i < size; i++)
+        {
+          registers[pointer] = data[i];
+          advance();
+        }
+      }
+
+      uint8_t request(uint8_t* data, uint8_t size) override
+      {
+        if ((registers[0x02] & 0x03) == 0)
+        {
+          store(0x03, milligauss[0] * MAG_XY_GAIN / 1000);
+          store(0x05, milligauss[2] * MAG_Z_GAIN / 1000);
+          store(0x07, milligauss[1] * MAG_XY_GAIN / 1000);
+        }
+        for (uint8_t i = 0; i < size; i++)
+        {
+          data[i] = registers[pointer];
+          advance();
+        }
+        return size;
+      }
+
+      int16_t milligauss[3];
+
+    private:
+      void store(uint8_t reg, int32_t counts)
+      {
+        uint16_t value = clampCounts(counts);
+        registers[reg] = uint8_t(value >> 8);
+        registers[reg + 1] = uint8_t(value);
+      }
+
+      /* The output registers wrap back to OUT_X_H_M */
+      void advance()
+      {
+        pointer = pointer == 0x08 ? 0x03 : (pointer + 1) & 0x0F;
+      }
+
+      uint8_t registers[16];
+      uint8_t pointer;
+  };
+
+  Accelerometer accelerometer;
+  Magnetometer magnetometer;
+}
+
+void Sim::Detail::resetImu()
+{
+  accelerometer.reset();
+  magnetometer.reset();
+  // Level and facing north with a mid-latitude field
+  setImu(0, 0, 1000, 200, 0, -450);
+  connectImu(true);
+}
+
+void Sim::setImu(int16_t ax, int16_t ay, int16_t az, int16_t mx, int16_t my, int16_t mz)
+{
+  accelerometer.mg[0] = ax;
+  accelerometer.mg[1] = ay;
+  accelerometer.mg[2] = az;
+  magnetometer.milligauss[0] = mx;
+  magnetometer.milligauss[1] = my;
+  magnetometer.milligauss[2] = mz;
+}
+
+void Sim::connectImu(bool connected)
+{
+  attachI2c(ACCEL_ADDRESS, connected ? &accelerometer : nullptr);
+  attachI2c(MAG_ADDRESS, connected ? &magnetometer : nullptr);
+}
@@ -0,0 +1,195 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "sim.h"
+#include "simDetail.h"
+
+namespace
+{
+  constexpr uint8_t MS5837_ADDRESS = 0x76;
+
+  /* The calibration and conversions in the MS5837-30BA datasheet's worked example */
+  constexpr uint16_t EXAMPLE_PROM[7] = { 0, 34982, 36352, 20328, 22354, 26646, 26146 };
+  constexpr uint32_t EXAMPLE_D1 = 4958179;
+  constexpr uint32_t EXAMPLE_D2 = 6815414;
+
+  /* Datasheet typical conversion times, OSR 256 to 8192 */
+  constexpr uint32_t CONVERSION_US[6] = { 560, 1100, 2170, 4320, 8610, 17200 };
+
+  /* MS5837 command set: reset, PROM read, conversions and the ADC readout */
+  class Ms5837 : public Sim::I2cDevice
+  {
+    public:
+      void reset()
+      {
+        memcpy(prom, EXAMPLE_PROM, sizeof(prom));
+        prom[0] = crc() << 12;
+        d1 = EXAMPLE_D1;
+        d2 = EXAMPLE_D2;
+        reading = PROM;
+        pointer = 0;
+        done = 0;
+        result = 0;
+        converting = false;
+        conversions = 0;
+      }
+
+      void receive(const uint8_t* data, uint8_t size) override
+      {
+        if (size == 0)
+        {
+          return;
+        }
+        uint8_t command = data[0];
+        if ((command & 0xF0) == 0xA0)
+        {
+          pointer = (command & 0x0F) / 2;
+          reading = PROM;
+        }
+        else if (command == 0x00)
+        {
+          reading = ADC_RESULT;
+        }
+        else if (command == 0x1E)
+        {
+          converting = false;
+          result = 0;
+        }
+        else if (((command & 0xF0) == 0x40 || (command & 0xF0) == 0x50) && (command & 0x0F) <= 0x0A && !converting)
+        {
+          // A command during a conversion is ignored, like the real part
+          converting = true;
+          result = (command & 0xF0) == 0x40 ? d1 : d2;
+          done = Sim::now() + CONVERSION_US[(command & 0x0F) / 2];
+          conversions++;
+        }
+      }
+
+      uint8_t request(uint8_t* data, uint8_t size) override
+      {
+        uint32_t value;
+        uint8_t length;
+        if (reading == PROM)
+        {
+          value = pointer < 7 ? prom[pointer] : 0;
+          length = 2;
+        }
+        else
+        {
+          // Reading before the conversion finishes, or without one, gives 0
+          value = converting && Sim::now() >= done ? result : 0;
+          converting = false;
+          result = 0;
+          length = 3;
+        }
+        for (uint8_t i = 0; i < size; i++)
+        {
+          data[i] = i < length ? value >> 8 * (length - 1 - i) : 0;
+        }
+        return size;
+      }
+
+      /* D1 that compensates to pascals at the current D2, per the datasheet's sums */
+      uint32_t pressureCounts(int32_t pascals) const
+      {
+        int64_t dT = int64_t(d2) - int64_t(prom[5]) * 256;
+        int64_t sens = int64_t(prom[1]) * 32768 + int64_t(prom[3]) * dT / 256;
+        int64_t off = int64_t(prom[2]) * 65536 + int64_t(prom[4]) * dT / 128;
+        int64_t temp = 2000 + dT * prom[6] / 8388608;
+        if (temp < 2000)
+        {
+          off -= 3 * (temp - 2000) * (temp - 2000) / 2;
+          sens -= 5 * (temp - 2000) * (temp - 2000) / 8;
+        }
+        else
+        {
+          off -= (temp - 2000) * (temp - 2000) / 16;
+        }
+        int64_t tenths = (pascals + 5) / 10;
+        return uint32_t(((tenths * 8192 + off) * 2097152 + sens - 1) / sens);
+      }
+
+      uint16_t prom[7];
+      uint32_t d1;
+      uint32_t d2;
+      uint32_t conversions;
+
+    private:
+      enum Reading
+      {
+        PROM,
+        ADC_RESULT
+      };
+
+      /* CRC-4 exactly as the datasheet's listing, over 8 words with the CRC bits cleared */
+      uint16_t crc() const
+      {
+        uint16_t words[8];
+        memcpy(words, prom, sizeof(prom));
+        words[0] &= 0x0FFF;
+        words[7] = 0;
+        uint16_t remainder = 0;
+        for (uint8_t count = 0; count < 16; count++)
+        {
+          remainder ^= count % 2 == 1 ? words[count >> 1] & 0x00FF : words[count >> 1] >> 8;
+          for (uint8_t bit = 8; bit > 0; bit--)
+          {
+            remainder = remainder & 0x8000 ? (remainder << 1) ^ 0x3000 : remainder << 1;
+          }
+        }
+        return (remainder >> 12) & 0x000F;
+      }
+
+      Reading reading;
+      uint8_t pointer;
+      uint64_t done;
+      uint32_t result;
+      bool converting;
+  };
+
+  Ms5837 sensor;
+}
+
+void Sim::Detail::resetPressureSensor()
+{
+  sensor.reset();
+  attachI2c(MS5837_ADDRESS, &sensor);
+}
+
+void Sim::setPressureCounts(uint32_t d1, uint32_t d2)
+{
+  sensor.d1 = d1;
+  sensor.d2 = d2;
+}
+
+void Sim::setWaterPressure(int32_t pascals)
+{
+  sensor.d1 = sensor.pressureCounts(pascals);
+}
+
+void Sim::connectPressureSensor(bool connected)
+{
+  attachI2c(MS5837_ADDRESS, connected ? &sensor : nullptr);
+}
+
+uint32_t Sim::pressureConversions()
+{
+  return sensor.conversions;
+}
@@ -0,0 +1,181 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * sim.h - Controls for the simulated board behind the host shim.
+ *
+ * The sketch only ever sees the Arduino API. Benchmarks and tests use
+ * these functions to move the virtual clock, drive inputs and look at
+ * what the sketch did to its outputs.
+ */
+
+#ifndef SIM_h
+#define SIM_h
+
+#include <stdint.h>
+#include <vector>
+
+namespace Sim
+{
+  static constexpr uint8_t NUM_PINS = 70;
+  static constexpr uint8_t NUM_IBUS_CHANNELS = 14;
+  static constexpr uint8_t IBUS_FRAME_LENGTH = 32;
+  static constexpr uint8_t NUM_SERVO_CHANNELS = 16;
+
+  /* Puts the clock, pins and peripherals back to power-on state */
+  void reset();
+
+  /* Current virtual time in microseconds since reset */
+  uint64_t now();
+
+  /* Moves the virtual clock forward, finishing any ADC conversions that fall due */
+  void advanceMicros(uint32_t us);
+  void advanceMillis(uint32_t ms);
+
+  /* Pin state as last set by the sketch; levels come from the PORTx registers, so direct port writes count */
+  uint8_t pinMode(uint8_t pin);
+  uint8_t pinLevel(uint8_t pin);
+  int pwmLevel(uint8_t pin);
+
+  /* Values the sketch will see from digitalRead()/analogRead() */
+  void setPinInput(uint8_t pin, uint8_t level);
+  void setAnalog(uint8_t pin, int value);
+
+  /* Number of digitalWrite() calls since reset */
+  uint32_t digitalWrites();
+
+  /* Stages channel values for the next iBus servo frame */
+  void setChannel(uint8_t channel, uint16_t value);
+
+  /* Builds a valid iBus servo frame from the staged channels */
+  void encodeFrame(uint8_t frame[IBUS_FRAME_LENGTH]);
+
+  /* Sends the staged channels to USART2 as one frame, as the receiver would */
+  void deliverFrame();
+
+  /*
+   * Feeds bytes into a USART's receive interrupt, one call per byte.
+   * The clock is not advanced; do that between calls to model gaps.
+   */
+  void uartReceive(uint8_t uart, const uint8_t* data, uint8_t size);
+
+  /* Route transmitted bytes straight back into the receiver, as half-duplex wiring does */
+  void setUartEcho(uint8_t uart, bool enabled);
+
+  /* Bytes the sketch has written to a USART data register */
+  const std::vector<uint8_t>& uartTransmitted(uint8_t uart);
+  void clearUartTransmitted(uint8_t uart);
+
+  /*
+   * Runs interrupt-driven work the sketch has left pending: Timer0
+   * compare B one-shots and USART data-register-empty chains. The clock
+   * advances by the time each step would take on the wire.
+   */
+  void service();
+
+  /* Adds quadrature counts to the encoder attached to pinA */
+  void moveEncoder(uint8_t pinA, int32_t counts);
+
+  /* Whether the watchdog would have reset the chip since it was last reset */
+  bool watchdogExpired();
+
+  /* Watchdog period in microseconds, 0 while disabled */
+  uint32_t watchdogTimeout();
+
+  /* Rising edges on T5 (pin 47), counted by Timer5 if it is clocked from the pin */
+  void clockT5(uint32_t edges);
+
+  /* A device on the simulated I2C bus */
+  class I2cDevice
+  {
+    public:
+      virtual ~I2cDevice() {}
+
+      /* One write transaction, without the address byte */
+      virtual void receive(const uint8_t* data, uint8_t size) = 0;
+
+      /* Fills a read transaction, returns how many bytes it supplied */
+      virtual uint8_t request(uint8_t* data, uint8_t size) = 0;
+  };
+
+  /* Puts a device on the I2C bus; reset() takes them all off again */
+  void attachI2c(uint8_t address, I2cDevice* device);
+
+  /*
+   * Pulse width a PCA9685 channel is producing, from its LED_OFF count,
+   * the prescaler and the oscillator frequency. The oscillator is the
+   * board's 27 MHz unless Adafruit_PWMServoDriver was told otherwise.
+   */
+  uint16_t servoMicros(uint8_t channel);
+
+  /* Number of PCA9685 channel updates (LED_OFF_H writes) since reset */
+  uint32_t servoWrites();
+
+  /*
+   * Raw conversions the MS5837 at 0x76 returns. reset() loads the
+   * datasheet's worked example, 3999.8 mbar at about 19.8 C.
+   */
+  void setPressureCounts(uint32_t d1, uint32_t d2);
+
+  /* Sets the MS5837's raw pressure so it compensates to pascals at the current temperature */
+  void setWaterPressure(int32_t pascals);
+
+  /* Takes the MS5837 off the bus, so it stops acknowledging, or puts it back */
+  void connectPressureSensor(bool connected);
+
+  /* Conversions the MS5837 has started since reset */
+  uint32_t pressureConversions();
+
+  /*
+   * What the LSM303DLHC at 0x19 and 0x1E senses: acceleration in mg and
+   * the magnetic field in milligauss, on board axes x forward, y left and
+   * z up. reset() makes it level and facing magnetic north.
+   */
+  void setImu(int16_t ax, int16_t ay, int16_t az, int16_t mx, int16_t my, int16_t mz);
+
+  /* Takes the LSM303 off the bus, or puts it back */
+  void connectImu(bool connected);
+
+  /* Sets every EEPROM byte back to 0xFF, as a chip erase does */
+  void eraseEeprom();
+
+  /* The EEPROM's contents, for tests to read or damage directly */
+  uint8_t* eepromData();
+
+  /* Bytes actually written to the EEPROM since reset() */
+  uint32_t eepromWrites();
+
+  /* Static data reset() leaves at the bottom of the simulated SRAM */
+  static constexpr uint16_t DEFAULT_STATIC_RAM = 2048;
+
+  /*
+   * Moves the end of the static data, which is where __malloc_heap_start
+   * points. reset() zeroes the SRAM and leaves the stack empty.
+   */
+  void setStaticRam(uint16_t bytes);
+
+  /*
+   * Calls nest this deep: the bytes from RAMEND down are written, as
+   * pushes and frames would, and SP is left below them. Coming back up
+   * leaves what was written, as on the chip.
+   */
+  void setStackDepth(uint16_t bytes);
+}
+
+#endif
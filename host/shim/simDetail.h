@@ -0,0 +1,44 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * simDetail.h - Reset hooks shared between the shim translation units.
+ */
+
+#ifndef SIM_DETAIL_h
+#define SIM_DETAIL_h
+
+namespace Sim
+{
+  namespace Detail
+  {
+    void resetCore();
+    void resetSerial();
+    void resetRegisters();
+    void runAdc();
+    void resetIBus();
+    void resetEncoders();
+    void resetWire();
+    void resetServoDriver();
+    void resetPressureSensor();
+    void resetImu();
+  }
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * sketch.h - Sketch globals for host programs that link the .ino.
+ */
+
+#ifndef SKETCH_h
+#define SKETCH_h
+
+#include "motor.h"
+#include "fastHBridge.h"
+#include "servoBank.h"
+#include "input.h"
+#include "output.h"
+#include "scheduler.h"
+#include "analogSampler.h"
+#include "failsafe.h"
+#include "depthSensor.h"
+#include "compass.h"
+#include "deadReckoning.h"
+#include "depthHold.h"
+#include "recorder.h"
+#include "stackGauge.h"
+#include "calibration.h"
+#include "connections.h"
+
+void setup();
+void loop();
+void updateActuators(const Data::Input& input);
+
+extern Data::Input Rx;
+extern Data::Output Tx;
+extern Motor::HBridgePWMEnc engine;
+extern Motor::FastHBridge<WATER_PUMP_INPUT_1, WATER_PUMP_INPUT_2> waterPump;
+extern Actuator::ServoBank servos;
+extern Tasks::Scheduler scheduler;
+extern Analog::Sampler adc;
+extern uint8_t batterySlot;
+extern Safety::Failsafe failsafe;
+extern Sensor::DepthSensor depthSensor;
+extern Sensor::Compass compass;
+extern Navigation::DeadReckoning position;
+extern Ballast::DepthHold depthHold;
+extern Memory::StackGauge stackGauge;
+extern bool holding;
+extern Config::Calibration calibration;
+extern Config::CalibrationWriter calibrationWriter;
+extern bool calibrating;
+extern Recorder::FlightRecorder recorder;
+
+#endif
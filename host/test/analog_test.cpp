@@ -0,0 +1,162 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "analogSampler.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  /* 13 ADC clocks at F_CPU / 128 */
+  constexpr uint32_t CONVERSION_US = 104;
+
+  /* A whole block plus the conversion dropped after a channel switch */
+  constexpr uint32_t BLOCK_US = (Analog::BLOCK_SIZE + 1) * CONVERSION_US;
+}
+
+/* Conversions run while the loop does other things, and reading never waits */
+void testBackground()
+{
+  Sim::reset();
+  Sim::setAnalog(A1, 512);
+  Analog::Sampler sampler;
+  uint8_t slot = sampler.addChannel(A1);
+  CHECK_EQ(slot, 0);
+
+  sampler.begin();
+  CHECK_EQ(Sim::now(), 0);
+  CHECK(DIDR0 & _BV(1));
+  CHECK_EQ(sampler.read(slot), 0);
+
+  Sim::advanceMicros(BLOCK_US - 1);
+  CHECK_EQ(sampler.blocks(slot), 0);
+  Sim::advanceMicros(1);
+  CHECK_EQ(sampler.blocks(slot), 1);
+  uint64_t before = Sim::now();
+  CHECK_EQ(sampler.read(slot), 512 << Analog::OVERSAMPLE_BITS);
+  CHECK_EQ(Sim::now(), before);
+
+  // No channel switch with one channel, so later blocks drop nothing
+  Sim::advanceMicros(Analog::BLOCK_SIZE * CONVERSION_US);
+  CHECK_EQ(sampler.blocks(slot), 2);
+}
+
+/* Noise of an LSB between conversions averages out below one LSB */
+void testOversampling()
+{
+  Sim::reset();
+  Analog::Sampler sampler;
+  uint8_t slot = sampler.addChannel(A1);
+  sampler.begin();
+
+  for (uint16_t i = 0; i < 40 * Analog::BLOCK_SIZE; i++)
+  {
+    Sim::setAnalog(A1, i % 2 ? 501 : 500);
+    Sim::advanceMicros(CONVERSION_US);
+  }
+  CHECK_EQ(sampler.read(slot), 2002);
+}
+
+/* A step moves the output a quarter of the way per block */
+void testFilter()
+{
+  Sim::reset();
+  Sim::setAnalog(A1, 0);
+  Analog::Sampler sampler;
+  uint8_t slot = sampler.addChannel(A1);
+  sampler.begin();
+  Sim::advanceMicros(BLOCK_US);
+  CHECK_EQ(sampler.read(slot), 0);
+
+  Sim::setAnalog(A1, 1000);
+  Sim::advanceMicros(Analog::BLOCK_SIZE * CONVERSION_US);
+  CHECK_EQ(sampler.read(slot), 1000);
+  Sim::advanceMicros(Analog::BLOCK_SIZE * CONVERSION_US);
+  CHECK_EQ(sampler.read(slot), 1750);
+}
+
+/*
+ * The block count wraps after 256, about 0.43 s with one channel. The
+ * filter carries on through it rather than starting again from a raw
+ * block, and no conversion is dropped as if the channel were new.
+ */
+void testCountWraps()
+{
+  Sim::reset();
+  Sim::setAnalog(A1, 500);
+  Analog::Sampler sampler;
+  uint8_t slot = sampler.addChannel(A1);
+  sampler.begin();
+  Sim::advanceMicros(BLOCK_US);
+  CHECK_EQ(sampler.read(slot), 2000);
+
+  // Alternate blocks a little high and low; the filter keeps the output near the middle
+  uint16_t lowest = 0xFFFF;
+  uint16_t highest = 0;
+  for (uint16_t block = 1; block < 600; block++)
+  {
+    Sim::setAnalog(A1, block % 2 ? 540 : 500);
+    Sim::advanceMicros(Analog::BLOCK_SIZE * CONVERSION_US);
+    if (block > 20)
+    {
+      uint16_t value = sampler.read(slot);
+      lowest = value < lowest ? value : lowest;
+      highest = value > highest ? value : highest;
+    }
+  }
+  // Raw blocks are 160 apart; reseeding from one would jump most of that
+  CHECK(highest - lowest <= 30);
+  CHECK(sampler.blocks(slot) == uint8_t(600));
+}
+
+/* Several channels, including one behind MUX5, each keep their own value */
+void testChannels()
+{
+  Sim::reset();
+  Sim::setAnalog(A1, 100);
+  Sim::setAnalog(A3, 700);
+  Sim::setAnalog(A0 + 9, 300);
+  Analog::Sampler sampler;
+  uint8_t battery = sampler.addChannel(A1);
+  uint8_t other = sampler.addChannel(A3);
+  uint8_t high = sampler.addChannel(A0 + 9);
+  CHECK_EQ(sampler.addChannel(A4), 3);
+  CHECK_EQ(sampler.addChannel(A5), Analog::NO_SLOT);
+  sampler.begin();
+  CHECK(DIDR2 & _BV(1));
+
+  Sim::advanceMicros(10 * 4 * BLOCK_US);
+  CHECK_EQ(sampler.read(battery), 400);
+  CHECK_EQ(sampler.read(other), 2800);
+  CHECK_EQ(sampler.read(high), 1200);
+  CHECK(sampler.blocks(battery) >= 9);
+  CHECK(sampler.blocks(high) >= 9);
+}
+
+int main()
+{
+  testBackground();
+  testOversampling();
+  testFilter();
+  testCountWraps();
+  testChannels();
+  return CHECK_DONE();
+}
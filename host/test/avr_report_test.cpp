@@ -0,0 +1,154 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "check.h"
+#include "avrReport.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  /* simavr colours the UART lines and adds its own around them */
+  const char RUN[] =
+    "Loaded 9876 bytes at 0\n"
+    "\x1b[32mBENCH arduino_map 610 655 702 map\n\x1b[0m"
+    "\x1b[32mBENCH hbridge_forward 180 180 180 Motor::HBridge::forward+digitalWrite\n\x1b[0m"
+    "\x1b[32mBENCH fast_hbridge_forward 6 6 6 AvrBench::fastForward\n\x1b[0m"
+    "\x1b[32mBENCH_DONE 9\n\x1b[0m"
+    "simavr: sleeping with interrupts off, quitting gracefully\n";
+
+  const char SYMBOLS[] =
+    "00000100 00000002 b AvrBench::sink\n"
+    "00000a2c 0000004e T map(long, long, long, long, long)\n"
+    "00000b10 00000018 T Motor::HBridge::forward()\n"
+    "00000c00 00000090 T digitalWrite\n"
+    "00000c90 00000006 T AvrBench::fastForward(unsigned char)\n"
+    "00000d00 00000020 W Motor::FastHBridge<(unsigned char)22, (unsigned char)23>::forward()\n";
+
+  const char STACK[] =
+    "WMath.cpp:51:6:long int map(long int, long int, long int, long int, long int)\t16\tstatic\n"
+    "motor.cpp:22:6:virtual void Motor::HBridge::forward()\t4\tstatic\n"
+    "wiring_digital.c:138:6:digitalWrite\t8\tstatic\n"
+    "/home/me/avr_bench.cpp:91:8:void AvrBench::fastForward(uint8_t)\t0\tstatic\n";
+
+  const char SECTIONS[] =
+    "TelemetryProof.elf  :\n"
+    "section                     size      addr\n"
+    ".data                        612   8389120\n"
+    ".text                      27914         0\n"
+    ".bss                        2203   8389732\n"
+    ".noinit                        0   8391935\n"
+    ".comment                      17         0\n"
+    "Total                      30746\n";
+}
+
+/* Results come out of the noise around them and pick up their sizes */
+void testRun()
+{
+  std::vector<AvrReport::Result> results;
+  CHECK(AvrReport::parseRun(RUN, results));
+  CHECK_EQ(results.size(), 3);
+  CHECK(results[0].name == "arduino_map");
+  CHECK_EQ(results[0].min, 610);
+  CHECK_EQ(results[0].mean, 655);
+  CHECK_EQ(results[0].max, 702);
+  CHECK(results[1].symbols == "Motor::HBridge::forward+digitalWrite");
+
+  AvrReport::Sizes symbols = AvrReport::parseSymbols(SYMBOLS);
+  CHECK_EQ(symbols.count("AvrBench::sink"), 0);
+  CHECK_EQ(symbols["map"], 0x4e);
+  CHECK_EQ(symbols["Motor::FastHBridge<(unsigned char)22, (unsigned char)23>::forward"], 0x20);
+
+  AvrReport::Sizes stack = AvrReport::parseStack(STACK);
+  CHECK_EQ(stack["map"], 16);
+  CHECK_EQ(stack["Motor::HBridge::forward"], 4);
+  CHECK_EQ(stack["digitalWrite"], 8);
+  CHECK_EQ(stack.count("AvrBench::fastForward"), 1);
+
+  AvrReport::size(results, symbols, stack);
+  CHECK_EQ(results[1].flash, 0x18 + 0x90);
+  CHECK_EQ(results[1].stack, 4 + 8);
+  CHECK(results[1].missing.empty());
+
+  // A run cut short is reported as such
+  std::string partial(RUN, strstr(RUN, "\x1b[32mBENCH_DONE") - RUN);
+  CHECK(!AvrReport::parseRun(partial, results));
+  CHECK_EQ(results.size(), 3);
+}
+
+/* A baseline reads back what was written and the report shows the change */
+void testBaseline()
+{
+  std::vector<AvrReport::Result> results;
+  AvrReport::parseRun(RUN, results);
+  AvrReport::size(results, AvrReport::parseSymbols(SYMBOLS), AvrReport::parseStack(STACK));
+
+  std::vector<AvrReport::Result> baseline;
+  CHECK(AvrReport::parseBaseline(AvrReport::formatBaseline(results), baseline));
+  CHECK_EQ(baseline.size(), 3);
+  CHECK_EQ(baseline[2].mean, 6);
+  CHECK_EQ(baseline[1].flash, 0x18 + 0x90);
+  CHECK(!AvrReport::parseBaseline("arduino_map 1 2 three 4 5\n", baseline));
+
+  CHECK(AvrReport::parseBaseline("# old numbers\narduino_map 700 712 760 70 16\nhbridge_forward 180 180 180 168 12\n", baseline));
+  results[0].symbols = "map+nowhere";
+  AvrReport::size(results, AvrReport::parseSymbols(SYMBOLS), AvrReport::parseStack(STACK));
+  std::string report = AvrReport::formatReport(results, baseline);
+  CHECK(strstr(report.c_str(), "-57") != nullptr);
+  CHECK(strstr(report.c_str(), "78 (+8)") != nullptr);
+  CHECK(strstr(report.c_str(), "new") != nullptr);
+  CHECK(strstr(report.c_str(), "arduino_map: no symbol nowhere\n") != nullptr);
+
+  // Without a baseline nothing is compared, so nothing is called new
+  report = AvrReport::formatReport(results, std::vector<AvrReport::Result>());
+  CHECK(strstr(report.c_str(), "new") == nullptr);
+  CHECK(strstr(report.c_str(), "(+") == nullptr);
+}
+
+/* Static RAM adds up .data, .bss and .noinit, and the rest is left to the stack */
+void testMemory()
+{
+  AvrReport::Memory memory;
+  CHECK(AvrReport::parseSections(SECTIONS, memory));
+  CHECK_EQ(memory.data, 612);
+  CHECK_EQ(memory.bss, 2203);
+  CHECK_EQ(memory.noinit, 0);
+
+  std::string report = AvrReport::formatMemory(memory);
+  CHECK(strstr(report.c_str(), "= 2815 of 8192 bytes\n") != nullptr);
+  CHECK(strstr(report.c_str(), "left for the stack: 5377 bytes (65%)\n") != nullptr);
+
+  // Over budget shows as a negative margin rather than wrapping
+  memory.bss = 8000;
+  CHECK(strstr(AvrReport::formatMemory(memory).c_str(), "left for the stack: -420 bytes") != nullptr);
+
+  // Output without the static sections is not an image's
+  CHECK(!AvrReport::parseSections("section size addr\n.text 100 0\n", memory));
+  CHECK(!AvrReport::parseSections("", memory));
+}
+
+int main()
+{
+  testRun();
+  testBaseline();
+  testMemory();
+  return CHECK_DONE();
+}
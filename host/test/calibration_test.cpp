@@ -0,0 +1,335 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "sketch.h"
+#include <avr/eeprom.h>
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr Config::Calibration DEFAULTS = {
+    Config::CALIBRATION_VERSION, 0, 27000000,
+    { Data::NOMINAL_STICK, Data::NOMINAL_STICK, Data::NOMINAL_STICK }
+  };
+
+  /* A transmitter whose sticks fall short of the nominal range */
+  constexpr Data::StickRange RUDDER_TRAVEL = { 1100, 1480, 1900 };
+  constexpr Data::StickRange PLANE_TRAVEL = { 1050, 1520, 1950 };
+  constexpr Data::StickRange THROTTLE_TRAVEL = { 1120, 0, 1880 };
+
+  /* Polls until the save is done, returning how many polls it took */
+  uint32_t write(Config::CalibrationWriter& writer)
+  {
+    uint32_t polls = 1;
+    while (!writer.poll() && polls < 10000)
+    {
+      Sim::advanceMicros(500);
+      polls++;
+    }
+    return polls;
+  }
+
+  /* Run the sketch as loop() would be called, several times per step */
+  void run(uint32_t micros)
+  {
+    for (uint32_t at = 0; at < micros; at += 500)
+    {
+      for (uint8_t i = 0; i < 8; i++)
+      {
+        loop();
+      }
+      Sim::advanceMicros(500);
+    }
+  }
+
+  /* Send the staged channels as one frame and let the sketch take it in */
+  void frame()
+  {
+    Sim::deliverFrame();
+    run(7000);
+  }
+
+  /* Sticks at rest, throttle closed, every switch up */
+  void neutral()
+  {
+    for (uint8_t i = 0; i < Sim::NUM_IBUS_CHANNELS; i++)
+    {
+      Sim::setChannel(i, Data::MIN_RAW_INPUT);
+    }
+    Sim::setChannel(Data::RUDDER_INDEX, Data::MID_RAW_INPUT);
+    Sim::setChannel(Data::DIVE_PLANE_INDEX, Data::MID_RAW_INPUT);
+  }
+
+  void sticks(uint16_t rudder, uint16_t plane, uint16_t throttle)
+  {
+    Sim::setChannel(Data::RUDDER_INDEX, rudder);
+    Sim::setChannel(Data::DIVE_PLANE_INDEX, plane);
+    Sim::setChannel(Data::THROTTLE_INDEX, throttle);
+  }
+}
+
+/* The CRC covers every field, and matches the standard check value */
+void testChecksum()
+{
+  const uint8_t digits[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+  uint16_t crc = 0xFFFF;
+  for (uint8_t digit : digits)
+  {
+    crc = Config::crc16(crc, digit);
+  }
+  CHECK_EQ(crc, 0x29B1);
+
+  Config::Calibration record = DEFAULTS;
+  uint16_t base = Config::checksum(record);
+  record.oscillator++;
+  CHECK(Config::checksum(record) != base);
+  record = DEFAULTS;
+  record.sticks[Data::THROTTLE_STICK].high--;
+  CHECK(Config::checksum(record) != base);
+}
+
+/* A blank, damaged or old record gives the defaults; a saved one comes back */
+void testLoad()
+{
+  Sim::reset();
+  Sim::eraseEeprom();
+  Config::Calibration loaded;
+  CHECK(!Config::load(loaded, DEFAULTS));
+  CHECK_EQ(loaded.oscillator, DEFAULTS.oscillator);
+
+  Config::Calibration saved = DEFAULTS;
+  saved.oscillator = 26500000;
+  saved.sticks[Data::RUDDER_STICK] = RUDDER_TRAVEL;
+  Config::CalibrationWriter writer;
+  writer.save(saved);
+  write(writer);
+  CHECK(Config::load(loaded, DEFAULTS));
+  CHECK_EQ(loaded.oscillator, 26500000);
+  CHECK_EQ(loaded.sticks[Data::RUDDER_STICK].low, RUDDER_TRAVEL.low);
+  CHECK_EQ(loaded.sticks[Data::RUDDER_STICK].centre, RUDDER_TRAVEL.centre);
+  CHECK_EQ(loaded.sticks[Data::RUDDER_STICK].high, RUDDER_TRAVEL.high);
+
+  // Half a save, as if the power went
+  uint8_t* stored = Sim::eepromData() + Config::CALIBRATION_ADDRESS;
+  stored[offsetof(Config::Calibration, sticks)] ^= 0x01;
+  CHECK(!Config::load(loaded, DEFAULTS));
+  CHECK_EQ(loaded.oscillator, DEFAULTS.oscillator);
+  CHECK_EQ(loaded.sticks[Data::RUDDER_STICK].low, Data::MIN_RAW_INPUT);
+  stored[offsetof(Config::Calibration, sticks)] ^= 0x01;
+  CHECK(Config::load(loaded, DEFAULTS));
+
+  // A layout from another version is not trusted, even with a good CRC
+  stored[offsetof(Config::Calibration, version)]++;
+  CHECK(!Config::load(loaded, DEFAULTS));
+}
+
+/* Saving never waits on the EEPROM, and unchanged bytes are not rewritten */
+void testWriter()
+{
+  Sim::reset();
+  Sim::eraseEeprom();
+  Config::Calibration record = DEFAULTS;
+  Config::CalibrationWriter writer;
+  writer.save(record);
+  CHECK(writer.busy());
+
+  uint32_t polls = 0;
+  while (writer.busy())
+  {
+    uint32_t before = Sim::eepromWrites();
+    uint64_t at = Sim::now();
+    writer.poll();
+    CHECK(Sim::eepromWrites() - before <= 1);
+    CHECK_EQ(Sim::now(), at);
+    Sim::advanceMicros(1000);
+    polls++;
+  }
+  CHECK_EQ(Sim::eepromWrites(), sizeof(Config::Calibration));
+  CHECK(polls >= sizeof(Config::Calibration) * EEPROM_WRITE_TIME / 1000);
+
+  // Only the bytes of the one field that changed go again
+  record.oscillator += 1;
+  writer.save(record);
+  write(writer);
+  CHECK_EQ(Sim::eepromWrites(), sizeof(Config::Calibration) + 3);
+  writer.save(record);
+  write(writer);
+  CHECK_EQ(Sim::eepromWrites(), sizeof(Config::Calibration) + 3);
+}
+
+/* Ends are the furthest seen; only sprung sticks take their centre from where they were let go */
+void testCalibrator()
+{
+  Config::StickCalibrator calibrator(_BV(Data::RUDDER_STICK));
+  Data::StickRange sticks[Data::NUM_STICKS];
+  CHECK_EQ(calibrator.finish(sticks), 0);
+
+  calibrator.begin();
+  const uint16_t frames[][Data::NUM_STICKS] = {
+    { 1500, 1500, 1000 },
+    { 1100, 1200, 1400 },
+    { 1900, 1800, 1990 },
+    { 1470, 1300, 1010 },
+  };
+  for (const uint16_t* raw : frames)
+  {
+    calibrator.sample(raw);
+  }
+  CHECK_EQ(calibrator.finish(sticks), Data::NUM_STICKS);
+  CHECK_EQ(sticks[Data::RUDDER_STICK].low, 1100);
+  CHECK_EQ(sticks[Data::RUDDER_STICK].centre, 1470);
+  CHECK_EQ(sticks[Data::RUDDER_STICK].high, 1900);
+  CHECK_EQ(sticks[Data::DIVE_PLANE_STICK].centre, 1500);
+  CHECK_EQ(sticks[Data::THROTTLE_STICK].low, 1000);
+  CHECK_EQ(sticks[Data::THROTTLE_STICK].centre, 1495);
+  CHECK_EQ(sticks[Data::THROTTLE_STICK].high, 1990);
+
+  // The dive plane never went far enough up
+  calibrator.begin();
+  const uint16_t shy[][Data::NUM_STICKS] = {
+    { 1100, 1400, 1000 },
+    { 1900, 1550, 2000 },
+    { 1500, 1500, 1000 },
+  };
+  for (const uint16_t* raw : shy)
+  {
+    calibrator.sample(raw);
+  }
+  CHECK_EQ(calibrator.finish(sticks), Data::DIVE_PLANE_STICK);
+}
+
+/*
+ * The sketch is up and controllable straight away, flashing until it
+ * hears the transmitter. Switch D learns the sticks, the engine stays
+ * off meanwhile, and the ranges are there after the next power up.
+ */
+void testSketch()
+{
+  Sim::reset();
+  Sim::eraseEeprom();
+  setup();
+  CHECK(Sim::now() < 5000);
+  CHECK_EQ(calibration.oscillator, 27000000);
+
+  // Not armed yet, so the LED flashes
+  uint8_t changes = 0;
+  uint8_t level = Sim::pinLevel(HEARTBEAT_LED_PIN);
+  for (uint32_t at = 0; at < 600000; at += 10000)
+  {
+    run(10000);
+    changes += Sim::pinLevel(HEARTBEAT_LED_PIN) != level;
+    level = Sim::pinLevel(HEARTBEAT_LED_PIN);
+  }
+  CHECK(changes >= 6);
+
+  // The first frame drives the engine at once
+  neutral();
+  sticks(Data::MID_RAW_INPUT, Data::MID_RAW_INPUT, Data::MAX_RAW_INPUT);
+  frame();
+  CHECK_EQ(engine.getSpeed(), Motor::MAX_PWM_VALUE);
+
+  // Switch D only starts calibration with the throttle down; this one never quite closes
+  Sim::setChannel(Data::SWD_INDEX, Data::MAX_RAW_INPUT);
+  frame();
+  CHECK(!calibrating);
+  Sim::setChannel(Data::SWD_INDEX, Data::MIN_RAW_INPUT);
+  sticks(Data::MID_RAW_INPUT, Data::MID_RAW_INPUT, THROTTLE_TRAVEL.low);
+  frame();
+  CHECK(engine.getSpeed() > 0);
+  Sim::setChannel(Data::SWD_INDEX, Data::MAX_RAW_INPUT);
+  frame();
+  CHECK(calibrating);
+  CHECK_EQ(Sim::pinLevel(HEARTBEAT_LED_PIN), HIGH);
+
+  // Sweep every stick end to end; the engine and servos ignore them
+  sticks(RUDDER_TRAVEL.low, PLANE_TRAVEL.low, THROTTLE_TRAVEL.high);
+  frame();
+  CHECK_EQ(engine.getSpeed(), 0);
+  CHECK_EQ(servos.read(0), Data::MID_POINT);
+  sticks(RUDDER_TRAVEL.high, PLANE_TRAVEL.high, THROTTLE_TRAVEL.low);
+  frame();
+  sticks(RUDDER_TRAVEL.centre, PLANE_TRAVEL.centre, THROTTLE_TRAVEL.low);
+  frame();
+  CHECK_EQ(engine.getSpeed(), 0);
+
+  Sim::setChannel(Data::SWD_INDEX, Data::MIN_RAW_INPUT);
+  frame();
+  CHECK(!calibrating);
+  CHECK(calibrationWriter.busy());
+  run(300000);
+  CHECK(!calibrationWriter.busy());
+
+  // The new ranges are in use: the shorter throttle now reaches full power
+  sticks(RUDDER_TRAVEL.high, PLANE_TRAVEL.centre, THROTTLE_TRAVEL.high);
+  frame();
+  CHECK_EQ(engine.getSpeed(), Motor::MAX_PWM_VALUE);
+  CHECK_EQ(Rx.rudder, Data::MAX_RUDDER_ANGLE);
+  CHECK_EQ(Rx.divePlane, Data::DivePlaneMap::apply(Data::MID_RAW_INPUT));
+
+  // And survive a power cycle
+  Sim::reset();
+  setup();
+  CHECK_EQ(calibration.sticks[Data::RUDDER_STICK].low, RUDDER_TRAVEL.low);
+  CHECK_EQ(calibration.sticks[Data::RUDDER_STICK].centre, RUDDER_TRAVEL.centre);
+  CHECK_EQ(calibration.sticks[Data::DIVE_PLANE_STICK].high, PLANE_TRAVEL.high);
+  CHECK_EQ(calibration.sticks[Data::THROTTLE_STICK].centre, (THROTTLE_TRAVEL.low + THROTTLE_TRAVEL.high) / 2);
+  neutral();
+  sticks(RUDDER_TRAVEL.low, PLANE_TRAVEL.centre, Data::MIN_RAW_INPUT);
+  frame();
+  CHECK_EQ(Rx.rudder, Data::MIN_RUDDER_ANGLE);
+}
+
+/* Letting go of switch D without moving the sticks keeps the old ranges */
+void testRejected()
+{
+  Sim::reset();
+  Sim::eraseEeprom();
+  setup();
+  neutral();
+  frame();
+  Sim::setChannel(Data::SWD_INDEX, Data::MAX_RAW_INPUT);
+  frame();
+  CHECK(calibrating);
+  frame();
+  Sim::setChannel(Data::SWD_INDEX, Data::MIN_RAW_INPUT);
+  frame();
+  CHECK(!calibrating);
+  CHECK(!calibrationWriter.busy());
+  CHECK_EQ(Sim::eepromWrites(), 0);
+  CHECK_EQ(calibration.sticks[Data::RUDDER_STICK].low, Data::MIN_RAW_INPUT);
+
+  // Control comes straight back
+  sticks(Data::MID_RAW_INPUT, Data::MID_RAW_INPUT, Data::MAX_RAW_INPUT);
+  frame();
+  CHECK_EQ(engine.getSpeed(), Motor::MAX_PWM_VALUE);
+}
+
+int main()
+{
+  testChecksum();
+  testLoad();
+  testWriter();
+  testCalibrator();
+  testSketch();
+  testRejected();
+  return CHECK_DONE();
+}
@@ -0,0 +1,65 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * check.h - Minimal assertions for the host tests.
+ *
+ * Each test is a plain executable registered with ctest; a failed CHECK
+ * prints where it failed and makes CHECK_DONE() return non-zero.
+ */
+
+#ifndef CHECK_h
+#define CHECK_h
+
+#include <stdio.h>
+
+namespace Check
+{
+  extern int failures;
+}
+
+#define CHECK(cond) \
+  do \
+  { \
+    if (!(cond)) \
+    { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      Check::failures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(a, b) \
+  do \
+  { \
+    long long check_a = (long long)(a); \
+    long long check_b = (long long)(b); \
+    if (check_a != check_b) \
+    { \
+      printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, check_a, check_b); \
+      Check::failures++; \
+    } \
+  } while (0)
+
+/* Defines the failure counter; use once per test executable */
+#define CHECK_MAIN int Check::failures = 0
+
+#define CHECK_DONE() \
+  (printf("%s: %d failure(s)\n", __FILE__, Check::failures), Check::failures ? 1 : 0)
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <Wire.h>
+
+#include "check.h"
+#include "sim.h"
+#include "compass.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  /* Mid-latitude field: horizontal and downward parts in milligauss */
+  constexpr double FIELD_NORTH = 200;
+  constexpr double FIELD_DOWN = 450;
+
+  constexpr double DEGREES_PER_ANGLE = 360.0 / Sensor::FULL_TURN;
+
+  /* Smallest difference between two headings in degrees */
+  double headingError(double a, double b)
+  {
+    double error = fmod(a - b + 540.0, 360.0) - 180.0;
+    return fabs(error);
+  }
+
+  /* Body frame readings for a heading, pitch (bow up) and roll (starboard down), in degrees */
+  struct Pose
+  {
+    double accel[3];
+    double field[3];
+  };
+
+  Pose pose(double heading, double pitch, double roll)
+  {
+    // World axes north, west, up; body axes forward, left, up
+    double h = heading * M_PI / 180;
+    double p = pitch * M_PI / 180;
+    double r = roll * M_PI / 180;
+    double yaw[3][3] = { { cos(h), -sin(h), 0 }, { sin(h), cos(h), 0 }, { 0, 0, 1 } };
+    double tilt[3][3] = { { cos(p), 0, sin(p) }, { 0, 1, 0 }, { -sin(p), 0, cos(p) } };
+    double bank[3][3] = { { 1, 0, 0 }, { 0, cos(r), sin(r) }, { 0, -sin(r), cos(r) } };
+
+    // Rows are the body axes in the frame before; world to body is yaw, then pitch, then roll
+    double world[2][3] = { { 0, 0, 1000 }, { FIELD_NORTH, 0, -FIELD_DOWN } };
+    double body[2][3];
+    for (int v = 0; v < 2; v++)
+    {
+      double a[3];
+      double b[3];
+      for (int i = 0; i < 3; i++)
+      {
+        a[i] = yaw[i][0] * world[v][0] + yaw[i][1] * world[v][1] + yaw[i][2] * world[v][2];
+      }
+      for (int i = 0; i < 3; i++)
+      {
+        b[i] = tilt[i][0] * a[0] + tilt[i][1] * a[1] + tilt[i][2] * a[2];
+      }
+      for (int i = 0; i < 3; i++)
+      {
+        body[v][i] = bank[i][0] * b[0] + bank[i][1] * b[1] + bank[i][2] * b[2];
+      }
+    }
+
+    Pose result;
+    memcpy(result.accel, body[0], sizeof(result.accel));
+    memcpy(result.field, body[1], sizeof(result.field));
+    return result;
+  }
+
+  /* The same east and north construction in doubles */
+  double referenceHeading(const double a[3], const double m[3])
+  {
+    double east[3] = { m[1] * a[2] - m[2] * a[1], m[2] * a[0] - m[0] * a[2], m[0] * a[1] - m[1] * a[0] };
+    double north[3] = { a[1] * east[2] - a[2] * east[1], a[2] * east[0] - a[0] * east[2], a[0] * east[1] - a[1] * east[0] };
+    double degrees = atan2(east[0] / sqrt(east[0] * east[0] + east[1] * east[1] + east[2] * east[2]),
+      north[0] / sqrt(north[0] * north[0] + north[1] * north[1] + north[2] * north[2])) * 180 / M_PI;
+    return degrees < 0 ? degrees + 360 : degrees;
+  }
+
+  Sensor::Vector quantise(const double v[3], double scale)
+  {
+    Sensor::Vector q;
+    q.x = int16_t(lround(v[0] * scale));
+    q.y = int16_t(lround(v[1] * scale));
+    q.z = int16_t(lround(v[2] * scale));
+    return q;
+  }
+
+  void setPose(const Pose& p)
+  {
+    Sim::setImu(lround(p.accel[0]), lround(p.accel[1]), lround(p.accel[2]),
+      lround(p.field[0]), lround(p.field[1]), lround(p.field[2]));
+  }
+
+  /* Runs update() and fuse() the way the sketch task does */
+  void run(Sensor::Compass& compass, uint32_t calls)
+  {
+    for (uint32_t i = 0; i < calls; i++)
+    {
+      if (compass.update())
+      {
+        compass.fuse();
+      }
+      Sim::advanceMicros(10000);
+    }
+  }
+}
+
+/* The table atan2 tracks the library one all the way round and at any scale */
+void testAtan2()
+{
+  CHECK_EQ(Sensor::atan2Angle(0, 0), 0);
+  CHECK_EQ(Sensor::atan2Angle(0, 5), 0);
+  CHECK_EQ(Sensor::atan2Angle(5, 0), Sensor::FULL_TURN / 4);
+  CHECK_EQ(Sensor::atan2Angle(0, -5), Sensor::FULL_TURN / 2);
+  CHECK_EQ(Sensor::atan2Angle(-5, 0), 3 * Sensor::FULL_TURN / 4);
+
+  double worst = 0;
+  const double radii[] = { 100, 30000, 2e8 };
+  for (double radius : radii)
+  {
+    for (int tenth = 0; tenth < 3600; tenth++)
+    {
+      double angle = tenth * M_PI / 1800;
+      int32_t x = int32_t(lround(radius * cos(angle)));
+      int32_t y = int32_t(lround(radius * sin(angle)));
+      double expected = atan2(double(y), double(x)) * 180 / M_PI;
+      double error = headingError(Sensor::atan2Angle(y, x) * DEGREES_PER_ANGLE, expected);
+      worst = error > worst ? error : worst;
+    }
+  }
+  printf("atan2 worst error %.4f degrees\n", worst);
+  CHECK(worst < 0.02);
+}
+
+/* Fixed point heading against the floating point one and the true heading */
+void testTiltHeading()
+{
+  srand(18);
+  double worstReference = 0;
+  double worstTruth = 0;
+  for (int i = 0; i < 20000; i++)
+  {
+    double heading = 360.0 * rand() / RAND_MAX;
+    double pitch = 80.0 * rand() / RAND_MAX - 40;
+    double roll = 80.0 * rand() / RAND_MAX - 40;
+    Pose p = pose(heading, pitch, roll);
+
+    // What the parts report: 1 mg, and 1.1 counts per milligauss
+    Sensor::Vector accel = quantise(p.accel, 1);
+    Sensor::Vector mag = quantise(p.field, 1.1);
+    double fixed = Sensor::tiltHeading(accel, mag) * DEGREES_PER_ANGLE;
+    double reference = referenceHeading(p.accel, p.field);
+
+    double error = headingError(fixed, reference);
+    worstReference = error > worstReference ? error : worstReference;
+    error = headingError(reference, heading);
+    worstTruth = error > worstTruth ? error : worstTruth;
+  }
+  printf("tilt heading worst error %.3f degrees, reference %.6f\n", worstReference, worstTruth);
+  CHECK(worstTruth < 1e-6);
+  CHECK(worstReference < 0.5);
+}
+
+/* Readings alternate, and a heading comes out of every second update */
+void testDevice()
+{
+  Sim::reset();
+  Wire.begin();
+  Wire.setClock(400000);
+  Sensor::Compass compass;
+  CHECK(compass.begin());
+  CHECK(!compass.valid());
+
+  setPose(pose(30, 10, -5));
+  CHECK(!compass.update());
+  CHECK(compass.update());
+  compass.fuse();
+  CHECK(compass.valid());
+  CHECK(headingError(compass.degrees(), 30) <= 1);
+
+  // Each update is one short transaction
+  uint64_t start = Sim::now();
+  CHECK(!compass.update());
+  CHECK(Sim::now() - start < 250);
+
+  // A steady tilt does not move the heading
+  run(compass, 100);
+  CHECK(headingError(compass.degrees(), 30) <= 1);
+  CHECK_EQ(compass.errors(), 0);
+}
+
+/* The filter smooths steps and goes the short way through north */
+void testFilter()
+{
+  Sim::reset();
+  Wire.begin();
+  Sensor::Compass compass;
+  compass.begin();
+  setPose(pose(350, 0, 0));
+  run(compass, 20);
+  CHECK(headingError(compass.degrees(), 350) <= 1);
+
+  setPose(pose(10, 0, 0));
+  run(compass, 2);
+  CHECK(headingError(compass.degrees(), 355) <= 1);
+  run(compass, 60);
+  CHECK(headingError(compass.degrees(), 10) <= 1);
+}
+
+/* Hard iron offsets come off before the heading is worked out */
+void testCalibration()
+{
+  Sim::reset();
+  Wire.begin();
+  Sensor::Compass compass;
+  compass.begin();
+  Pose p = pose(120, 0, 0);
+  p.field[0] += 150;
+  p.field[1] -= 80;
+  setPose(p);
+  run(compass, 40);
+  CHECK(headingError(compass.degrees(), 120) > 10);
+
+  Sensor::Vector offset = { 165, -88, 0 };
+  compass.calibrate(offset);
+  run(compass, 40);
+  CHECK(headingError(compass.degrees(), 120) <= 1);
+}
+
+/* A missing part is counted, and the compass comes back when it does */
+void testFault()
+{
+  Sim::reset();
+  Wire.begin();
+  Sim::connectImu(false);
+  Sensor::Compass compass;
+  CHECK(!compass.begin());
+  CHECK_EQ(compass.errors(), 1);
+  run(compass, 4);
+  CHECK(!compass.valid());
+  CHECK_EQ(compass.errors(), 5);
+
+  Sim::connectImu(true);
+  run(compass, 4);
+  CHECK(compass.valid());
+  CHECK(headingError(compass.degrees(), 0) <= 1);
+
+  Sim::connectImu(false);
+  run(compass, 1);
+  CHECK(!compass.valid());
+}
+
+int main()
+{
+  testAtan2();
+  testTiltHeading();
+  testDevice();
+  testFilter();
+  testCalibration();
+  testFault();
+  return CHECK_DONE();
+}
@@ -0,0 +1,389 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "check.h"
+#include "harness.h"
+#include "sim.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  /* Mirrors the sketch's depth hold period, knob range and servo flush */
+  constexpr uint32_t PERIOD = 100000;
+  constexpr int32_t MAX_HOLD_DEPTH = 3000;
+  constexpr uint32_t SERVO_PERIOD = 1000;
+
+  /* The loop and the hull model both run at this step */
+  constexpr uint32_t STEP_US = 250;
+  constexpr double STEP = STEP_US / 1e6;
+
+  /* Surface pressure and fresh water, to match the sketch's density */
+  constexpr int32_t SURFACE_PRESSURE = 101325;
+  constexpr double PASCALS_PER_METRE = 997 * 9.80665;
+
+  /*
+   * A small hull, in SI units. It is neutral with NEUTRAL mL in the
+   * tank, the planes give PLANE_LIFT newtons at full deflection and
+   * 1 m/s, and vertical drag is quadratic with a little linear damping
+   * so it comes to rest.
+   */
+  constexpr double MASS = 4.0;
+  constexpr double TANK = 400;
+  constexpr double NEUTRAL = 200;
+  constexpr double PUMP_RATE = 15;
+  constexpr double VENT_RATE = 15;
+  constexpr double PLANE_LIFT = 4.0;
+  constexpr double MAX_SPEED = 0.6;
+  constexpr double QUADRATIC_DRAG = 25;
+  constexpr double LINEAR_DRAG = 2;
+
+  struct Hull
+  {
+    double depth; // m, positive down
+    double rate; // m/s
+    double tank; // mL
+  };
+
+  Hull hull;
+
+  /* What the hull does */
+  struct Result
+  {
+    double settling; // s to stay inside the tolerance
+    double overshoot; // mm past the target
+    double pumpDuty; // fraction of the time the pump ran
+    uint16_t switches; // tank changes by the controller
+  };
+
+  bool pumping()
+  {
+    return Sim::pinLevel(WATER_PUMP_INPUT_1) != Sim::pinLevel(WATER_PUMP_INPUT_2);
+  }
+
+  /* One step of the hull under whatever the sketch is driving */
+  void stepHull()
+  {
+    if (Sim::pinLevel(WATER_SOLENOID_PIN) == LOW)
+    {
+      hull.tank += (pumping() ? PUMP_RATE : -VENT_RATE) * STEP;
+      hull.tank = hull.tank < 0 ? 0 : hull.tank > TANK ? TANK : hull.tank;
+    }
+
+    double speed = MAX_SPEED * Sim::pwmLevel(ENGINE_PWM) / 255.0;
+    double deflection = (double(Sim::servoMicros(DIVE_PLANE)) - Data::MID_POINT) / (Data::MAX_DIVE_PLANE_ANGLE - Data::MID_POINT);
+    double force = (hull.tank - NEUTRAL) * 1e-3 * 9.80665
+      + PLANE_LIFT * speed * speed * deflection
+      - QUADRATIC_DRAG * hull.rate * fabs(hull.rate)
+      - LINEAR_DRAG * hull.rate;
+    hull.rate += force / MASS * STEP;
+    hull.depth += hull.rate * STEP;
+    if (hull.depth < 0)
+    {
+      hull.depth = 0;
+      hull.rate = hull.rate < 0 ? 0 : hull.rate;
+    }
+    Sim::setWaterPressure(SURFACE_PRESSURE + int32_t(hull.depth * PASCALS_PER_METRE));
+  }
+
+  void runFor(uint32_t us)
+  {
+    Harness::runSketchFor(us, STEP_US, stepHull);
+  }
+
+  /* Floating at the surface, switches set for manual control with the tank closed */
+  void startSketch(uint16_t throttle, double tank)
+  {
+    Harness::resetBoard();
+    hull = { 0, 0, tank };
+    Sim::setWaterPressure(SURFACE_PRESSURE);
+    Sim::setChannel(Data::THROTTLE_INDEX, throttle);
+    Sim::setChannel(Data::SWA_INDEX, 1000);
+    Sim::setChannel(Data::SWB_INDEX, 1000);
+    Sim::setChannel(Data::SWC_INDEX, 2000);
+    Sim::setChannel(Data::DIVE_PLANE_INDEX, 1500);
+    Sim::setChannel(Data::VRA_INDEX, 1500);
+    Harness::startSketch();
+    runFor(1000000);
+  }
+
+  /* Engages depth hold and runs it, measuring against the target knob A asks for */
+  Result holdFor(uint32_t seconds, double tolerance)
+  {
+    double target = Data::LinearMap<Data::MIN_RAW_INPUT, Data::MAX_RAW_INPUT, 0, MAX_HOLD_DEPTH>::apply(Rx.vrA) / 1000.0;
+    Sim::setChannel(Data::SWB_INDEX, 2000);
+    Result result = { 0, 0, 0, 0 };
+    uint32_t pumped = 0;
+    uint32_t start = micros();
+    uint32_t lastOutside = start;
+    uint32_t steps = seconds * (1000000 / STEP_US);
+    for (uint32_t step = 0; step < steps; step++)
+    {
+      runFor(STEP_US);
+      pumped += pumping();
+      double error = hull.depth - target;
+      if (fabs(error) > tolerance)
+      {
+        lastOutside = micros();
+      }
+      if (error * 1000 > result.overshoot)
+      {
+        result.overshoot = error * 1000;
+      }
+    }
+    result.settling = (lastOutside - start) / 1e6;
+    result.pumpDuty = pumped / double(steps);
+    result.switches = depthHold.changes();
+    return result;
+  }
+
+  void report(const char* name, const Result& result)
+  {
+    printf("%s: settled in %.1f s, overshoot %.0f mm, pump duty %.1f%%, %u tank changes, hull %.0f mm with %.0f mL\n",
+      name, result.settling, result.overshoot, result.pumpDuty * 100, result.switches, hull.depth * 1000, hull.tank);
+  }
+
+  Ballast::DepthGains gains()
+  {
+    return Ballast::DEFAULT_DEPTH_GAINS;
+  }
+}
+
+/* begin() takes over at the current depth with the tank closed and the planes level */
+void testBegin()
+{
+  Ballast::DepthHold hold(PERIOD);
+  hold.begin(0, 700);
+  hold.update(PERIOD, 700);
+  CHECK_EQ(hold.ballast(), Ballast::HOLD);
+  CHECK_EQ(hold.plane(), Data::MID_POINT);
+  CHECK_EQ(hold.rate(), 0);
+  CHECK_EQ(hold.changes(), 0);
+}
+
+/* Too shallow dives and fills, too deep rises and vents */
+void testDirection()
+{
+  Ballast::DepthHold hold(PERIOD);
+  hold.begin(0, 0);
+  hold.setTarget(1000);
+  hold.update(PERIOD, 0);
+  CHECK_EQ(hold.ballast(), Ballast::FILL);
+  CHECK_EQ(hold.plane(), Data::MAX_DIVE_PLANE_ANGLE);
+
+  hold.begin(0, 2000);
+  hold.setTarget(1000);
+  hold.update(PERIOD, 2000);
+  CHECK_EQ(hold.ballast(), Ballast::VENT);
+  CHECK_EQ(hold.plane(), Data::MIN_DIVE_PLANE_ANGLE);
+
+  // A small error is left to the planes, which only move part way
+  hold.begin(0, 1000);
+  hold.setTarget(1100);
+  hold.update(PERIOD, 1000);
+  CHECK_EQ(hold.plane(), Data::MID_POINT + (100 * gains().kp >> Ballast::GAIN_SHIFT));
+  CHECK_EQ(hold.ballast(), Ballast::HOLD);
+}
+
+/* Smallest depth error, with the sign of rate, that the tank aims to close faster than rate mm/s */
+int32_t errorBeyond(int32_t rate)
+{
+  int32_t step = rate < 0 ? -1 : 1;
+  int32_t error = 0;
+  while ((error * gains().approach >> Ballast::GAIN_SHIFT) * step <= rate * step)
+  {
+    error += step;
+  }
+  return error;
+}
+
+/* Held still, the tank starts outside band and only stops inside band / 2 */
+void testHysteresis()
+{
+  const int32_t fill = errorBeyond(gains().band);
+  const int32_t vent = errorBeyond(-gains().band);
+
+  // The tank only stops once the approach rate is under band / 2
+  const int32_t fillStop = errorBeyond(gains().band / 2 - 1);
+  const int32_t ventStop = errorBeyond(-gains().band / 2 + 1);
+  uint32_t now = 0;
+  Ballast::DepthHold hold(PERIOD);
+  hold.begin(now, 1000);
+
+  // Long enough for dwell to pass at each step
+  auto settleAt = [&](int32_t target)
+  {
+    hold.setTarget(target);
+    for (uint8_t i = 0; i < 40; i++)
+    {
+      now += PERIOD;
+      hold.update(now, 1000);
+    }
+  };
+
+  settleAt(999 + fill);
+  CHECK_EQ(hold.ballast(), Ballast::HOLD);
+  settleAt(1000 + fill);
+  CHECK_EQ(hold.ballast(), Ballast::FILL);
+
+  // Still filling between band / 2 and band
+  settleAt(1000 + fillStop);
+  CHECK_EQ(hold.ballast(), Ballast::FILL);
+  settleAt(999 + fillStop);
+  CHECK_EQ(hold.ballast(), Ballast::HOLD);
+
+  settleAt(1001 + vent);
+  CHECK_EQ(hold.ballast(), Ballast::HOLD);
+  settleAt(1000 + vent);
+  CHECK_EQ(hold.ballast(), Ballast::VENT);
+  settleAt(1000 + ventStop);
+  CHECK_EQ(hold.ballast(), Ballast::VENT);
+  settleAt(1001 + ventStop);
+  CHECK_EQ(hold.ballast(), Ballast::HOLD);
+  CHECK_EQ(hold.changes(), 4);
+}
+
+/* A reversal stops the pump at once but waits out dwell before starting the other way */
+void testDwell()
+{
+  Ballast::DepthHold hold(PERIOD);
+  hold.begin(0, 1000);
+  hold.setTarget(2000);
+  hold.update(PERIOD, 1000);
+  CHECK_EQ(hold.ballast(), Ballast::FILL);
+
+  uint32_t now = 2 * PERIOD;
+  hold.setTarget(0);
+  hold.update(now, 1000);
+  CHECK_EQ(hold.ballast(), Ballast::HOLD);
+  while (now + PERIOD - 2 * PERIOD < gains().dwell)
+  {
+    now += PERIOD;
+    hold.update(now, 1000);
+    CHECK_EQ(hold.ballast(), Ballast::HOLD);
+  }
+  now += PERIOD;
+  hold.update(now, 1000);
+  CHECK_EQ(hold.ballast(), Ballast::VENT);
+  CHECK_EQ(hold.changes(), 3);
+}
+
+/* Depth rate comes out in mm/s, and sinking fast vents and brakes before the target is reached */
+void testApproach()
+{
+  Ballast::DepthHold hold(PERIOD);
+  hold.begin(0, 0);
+  hold.setTarget(1000);
+  uint32_t now = 0;
+  int32_t depth = 0;
+  for (uint8_t i = 0; i < 40; i++)
+  {
+    now += PERIOD;
+    depth += 20;
+    hold.update(now, depth);
+  }
+  CHECK_EQ(hold.rate(), 200);
+  CHECK_EQ(depth, 800);
+  CHECK_EQ(hold.ballast(), Ballast::VENT);
+  CHECK_EQ(hold.plane(), Data::MIN_DIVE_PLANE_ANGLE);
+}
+
+/* Under way, the planes do most of the work and the pump runs little */
+void testHoldUnderWay()
+{
+  startSketch(1700, NEUTRAL - 20);
+  CHECK(depthSensor.valid());
+  CHECK(!holding);
+  CHECK_EQ(hull.depth, 0);
+
+  Result result = holdFor(120, 0.1);
+  report("under way", result);
+  CHECK(holding);
+  CHECK(result.settling < 30);
+  CHECK(result.overshoot < 100);
+  CHECK(result.pumpDuty < 0.05);
+  CHECK(result.switches <= 10);
+  CHECK(fabs(hull.depth - 1.5) < 0.1);
+}
+
+/* Stopped, only the tank can hold depth, and it must not chatter doing it */
+void testHoldStopped()
+{
+  startSketch(1000, NEUTRAL - 20);
+  CHECK_EQ(Sim::pwmLevel(ENGINE_PWM), 0);
+
+  Result result = holdFor(180, 0.15);
+  report("stopped", result);
+  CHECK(result.settling < 30);
+  CHECK(result.overshoot < 150);
+  CHECK(result.pumpDuty < 0.05);
+  CHECK(result.switches <= 30);
+  CHECK(fabs(hull.depth - 1.5) < 0.15);
+}
+
+/* Switch B up hands the tank and planes back to the sticks */
+void testHandBack()
+{
+  startSketch(1700, NEUTRAL - 20);
+  holdFor(20, 0.1);
+  CHECK(holding);
+
+  Sim::setChannel(Data::SWB_INDEX, 1000);
+  runFor(2 * PERIOD);
+  CHECK(!holding);
+  CHECK_EQ(Sim::pinLevel(WATER_SOLENOID_PIN), HIGH);
+  CHECK(!pumping());
+  runFor(2 * SERVO_PERIOD);
+  CHECK(abs(int32_t(Sim::servoMicros(DIVE_PLANE)) - int32_t(Data::MID_POINT)) <= 5);
+
+  // Manual tank control works again
+  Sim::setChannel(Data::SWC_INDEX, 1000);
+  runFor(2 * Harness::FRAME_US);
+  CHECK_EQ(Sim::pinLevel(WATER_SOLENOID_PIN), LOW);
+  CHECK(!pumping());
+}
+
+/* Losing the depth sensor drops out of depth hold */
+void testSensorLoss()
+{
+  startSketch(1700, NEUTRAL - 20);
+  holdFor(10, 0.1);
+  CHECK(holding);
+  Sim::connectPressureSensor(false);
+  runFor(2000000);
+  CHECK(!depthSensor.valid());
+  CHECK(!holding);
+  CHECK_EQ(Sim::pinLevel(WATER_SOLENOID_PIN), HIGH);
+}
+
+int main()
+{
+  testBegin();
+  testDirection();
+  testHysteresis();
+  testDwell();
+  testApproach();
+  testHoldUnderWay();
+  testHoldStopped();
+  testHandBack();
+  testSensorLoss();
+  return CHECK_DONE();
+}
@@ -0,0 +1,205 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <Wire.h>
+
+#include "check.h"
+#include "sim.h"
+#include "depthSensor.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint32_t PERIOD = 10000;
+
+  /* The datasheet's worked example, which the simulated sensor starts with */
+  constexpr uint16_t EXAMPLE_PROM[Sensor::PROM_WORDS] = { 0, 34982, 36352, 20328, 22354, 26646, 26146 };
+  constexpr int32_t EXAMPLE_PRESSURE = 399980;
+
+  /* Longest a single update() held the bus */
+  uint32_t longestUpdate = 0;
+
+  /* Runs update() at PERIOD for a number of periods, returns the readings it produced */
+  uint32_t tick(Sensor::DepthSensor& sensor, uint32_t periods)
+  {
+    uint32_t produced = 0;
+    for (uint32_t i = 0; i < periods; i++)
+    {
+      Sim::advanceMicros(PERIOD - micros() % PERIOD);
+      uint32_t start = micros();
+      produced += sensor.update(start);
+      if (micros() - start > longestUpdate)
+      {
+        longestUpdate = micros() - start;
+      }
+    }
+    return produced;
+  }
+
+  void startSensor(Sensor::DepthSensor& sensor)
+  {
+    Sim::reset();
+    Wire.begin();
+    Wire.setClock(400000);
+    longestUpdate = 0;
+    sensor.begin(micros());
+  }
+}
+
+/* Known raw values give the datasheet's answer */
+void testCompensation()
+{
+  Sensor::Reading reading = Sensor::compensate(EXAMPLE_PROM, 4958179, 6815414);
+  CHECK_EQ(reading.pressure, EXAMPLE_PRESSURE);
+  CHECK_EQ(reading.temperature, 1982);
+
+  // Warm water takes the other second order branch
+  reading = Sensor::compensate(EXAMPLE_PROM, 4958179, 7000000);
+  CHECK(reading.temperature > 2000);
+  CHECK(reading.pressure > 300000 && reading.pressure < 500000);
+}
+
+/* The CRC ignores its own bits and catches a changed coefficient */
+void testCrc()
+{
+  uint16_t prom[Sensor::PROM_WORDS];
+  memcpy(prom, EXAMPLE_PROM, sizeof(prom));
+  prom[0] = 0x0ABC;
+  uint8_t crc = Sensor::promCrc(prom);
+  prom[0] |= crc << 12;
+  CHECK_EQ(Sensor::promCrc(prom), crc);
+  prom[3] ^= 0x0100;
+  CHECK(Sensor::promCrc(prom) != crc);
+}
+
+/* A reading every other period, and no update ever waits on a conversion */
+void testSteadyReadings()
+{
+  Sensor::DepthSensor sensor;
+  startSensor(sensor);
+  CHECK(!sensor.valid());
+
+  // Reset wait, PROM and the first temperature conversion
+  CHECK_EQ(tick(sensor, 2), 0);
+  CHECK_EQ(tick(sensor, 1), 1);
+  CHECK(sensor.valid());
+  CHECK_EQ(sensor.pressure(), EXAMPLE_PRESSURE);
+  CHECK_EQ(sensor.temperature(), 1982);
+  CHECK_EQ(sensor.depth(), 0);
+
+  CHECK_EQ(tick(sensor, 100), 50);
+  CHECK_EQ(sensor.readings(), 51);
+  CHECK_EQ(sensor.errors(), 0);
+
+  // The PROM read is the longest step, seven short transactions
+  printf("longest update %u us\n", longestUpdate);
+  CHECK(longestUpdate < 1000);
+  longestUpdate = 0;
+  tick(sensor, 100);
+  CHECK(longestUpdate < 250);
+}
+
+/* Calling early does nothing, not even touch the bus */
+void testEarlyUpdate()
+{
+  Sensor::DepthSensor sensor;
+  startSensor(sensor);
+  tick(sensor, 3);
+  uint32_t transactions = Wire.transactions;
+  Sim::advanceMicros(Sensor::conversionTime(Sensor::OSR_4096) - 1);
+  CHECK(!sensor.update(micros() - micros() % PERIOD + Sensor::conversionTime(Sensor::OSR_4096) - 1));
+  CHECK_EQ(Wire.transactions, transactions);
+}
+
+/* Depth follows pressure from the surface reading at the density given */
+void testDepth()
+{
+  Sensor::DepthSensor sensor;
+  startSensor(sensor);
+  tick(sensor, 3);
+  int32_t surface = sensor.pressure();
+
+  Sim::setWaterPressure(surface + 2 * Sensor::pascalsPerMetre(Sensor::FRESH_WATER));
+  tick(sensor, 2);
+  CHECK(sensor.depth() >= 1998 && sensor.depth() <= 2002);
+
+  // Sea water is denser, so the same pressure is less depth
+  Sensor::DepthSensor sea(Sensor::OSR_4096, 1025);
+  startSensor(sea);
+  tick(sea, 3);
+  Sim::setWaterPressure(sea.pressure() + 2 * Sensor::pascalsPerMetre(Sensor::FRESH_WATER));
+  tick(sea, 2);
+  CHECK(sea.depth() > 1935 && sea.depth() < 1955);
+
+  sea.zero();
+  tick(sea, 2);
+  CHECK_EQ(sea.depth(), 0);
+}
+
+/* A lost sensor is counted, retried after a delay and picked up again */
+void testFaultAndRecovery()
+{
+  Sensor::DepthSensor sensor;
+  startSensor(sensor);
+  tick(sensor, 5);
+  CHECK(sensor.valid());
+
+  Sim::connectPressureSensor(false);
+  tick(sensor, 1);
+  CHECK(!sensor.valid());
+  CHECK_EQ(sensor.errors(), 1);
+
+  // Nothing is tried until the retry delay is up
+  Sim::connectPressureSensor(true);
+  uint32_t conversions = Sim::pressureConversions();
+  tick(sensor, Sensor::RETRY_DELAY / PERIOD - 1);
+  CHECK_EQ(Sim::pressureConversions(), conversions);
+  CHECK_EQ(tick(sensor, 5), 1);
+  CHECK(sensor.valid());
+  CHECK_EQ(sensor.errors(), 1);
+
+  // An empty conversion, as if read too soon, is a fault too
+  CHECK(!sensor.update(micros() + Sensor::conversionTime(Sensor::OSR_4096)));
+  CHECK_EQ(sensor.errors(), 2);
+}
+
+/* No sensor at all */
+void testAbsent()
+{
+  Sensor::DepthSensor sensor;
+  Sim::reset();
+  Sim::connectPressureSensor(false);
+  sensor.begin(micros());
+  CHECK_EQ(sensor.errors(), 1);
+  CHECK_EQ(tick(sensor, 100), 0);
+  CHECK(!sensor.valid());
+}
+
+int main()
+{
+  testCompensation();
+  testCrc();
+  testSteadyReadings();
+  testEarlyUpdate();
+  testDepth();
+  testFaultAndRecovery();
+  testAbsent();
+  return CHECK_DONE();
+}
@@ -0,0 +1,280 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <avr/wdt.h>
+
+#include "check.h"
+#include "harness.h"
+#include "sim.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  /* The step the loop is run at */
+  constexpr uint32_t STEP_US = 50;
+
+  constexpr Safety::Thresholds LIMITS = Safety::DEFAULT_THRESHOLDS;
+
+  void runFor(uint32_t us)
+  {
+    Harness::runSketchFor(us, STEP_US);
+  }
+
+  /* Full throttle forward with the dive planes hard down */
+  void startSketch()
+  {
+    Harness::resetBoard();
+    Sim::setChannel(Data::THROTTLE_INDEX, 2000);
+    Sim::setChannel(Data::SWA_INDEX, 1000);
+    Sim::setChannel(Data::DIVE_PLANE_INDEX, 2000);
+    Sim::setChannel(Data::SWC_INDEX, 2000);
+    Harness::startSketch();
+  }
+
+  uint32_t longestTask()
+  {
+    uint32_t longest = 0;
+    for (uint8_t i = 0; i < scheduler.size(); i++)
+    {
+      if (scheduler.task(i).worst > longest)
+      {
+        longest = scheduler.task(i).worst;
+      }
+    }
+    return longest;
+  }
+
+  /* Within one PCA9685 count of the surface position; a count is about 5 us at 50 Hz */
+  bool planesSurfacing()
+  {
+    int32_t error = int32_t(Sim::servoMicros(DIVE_PLANE)) - int32_t(Data::MIN_DIVE_PLANE_ANGLE);
+    return error >= -5 && error <= 5;
+  }
+
+  bool safe()
+  {
+    return engine.getState() == Motor::Direction::COAST
+      && Sim::pinLevel(WATER_SOLENOID_PIN) == LOW
+      && Sim::pinLevel(WATER_PUMP_INPUT_1) == LOW
+      && Sim::pinLevel(WATER_PUMP_INPUT_2) == LOW
+      && planesSurfacing();
+  }
+}
+
+/* Signal loss trips only after the timeout and clears on the next frame */
+void testSignalLoss()
+{
+  Safety::Failsafe failsafe;
+  failsafe.begin(0);
+  failsafe.voltage(12000, 0);
+  CHECK_EQ(failsafe.check(LIMITS.signalTimeout), 0);
+
+  failsafe.frame(50000);
+  CHECK_EQ(failsafe.check(50000 + LIMITS.signalTimeout), 0);
+  CHECK_EQ(failsafe.check(50001 + LIMITS.signalTimeout), Safety::SIGNAL_LOST);
+  CHECK(failsafe.engaged());
+  CHECK_EQ(failsafe.since(), 50001 + LIMITS.signalTimeout);
+
+  // A later check keeps the original trip time
+  CHECK_EQ(failsafe.check(80000 + LIMITS.signalTimeout), Safety::SIGNAL_LOST);
+  CHECK_EQ(failsafe.since(), 50001 + LIMITS.signalTimeout);
+
+  failsafe.frame(90000 + LIMITS.signalTimeout);
+  CHECK_EQ(failsafe.check(90000 + LIMITS.signalTimeout), 0);
+  CHECK(!failsafe.engaged());
+}
+
+/* A sampler that stops producing values is a fault in its own right */
+void testVoltageStale()
+{
+  Safety::Failsafe failsafe;
+  failsafe.begin(0);
+  for (uint32_t now = 0; now <= LIMITS.voltageTimeout + 10000; now += 10000)
+  {
+    failsafe.frame(now);
+  }
+  CHECK_EQ(failsafe.check(LIMITS.voltageTimeout + 10000), Safety::VOLTAGE_STALE);
+  failsafe.voltage(12000, LIMITS.voltageTimeout + 10000);
+  CHECK_EQ(failsafe.check(LIMITS.voltageTimeout + 10000), 0);
+}
+
+/* Brief sag is ignored, a sustained one latches until past the margin */
+void testUndervoltage()
+{
+  Safety::Failsafe failsafe;
+  failsafe.begin(0);
+  uint32_t now = 0;
+
+  // Sag under load that recovers before undervoltageTime
+  failsafe.voltage(LIMITS.undervoltage - 500, now);
+  now += LIMITS.undervoltageTime / 2;
+  failsafe.frame(now);
+  failsafe.voltage(LIMITS.undervoltage + LIMITS.recoveryMargin, now);
+  CHECK_EQ(failsafe.check(now), 0);
+  now += LIMITS.undervoltageTime;
+  failsafe.frame(now);
+  failsafe.voltage(LIMITS.undervoltage + LIMITS.recoveryMargin, now);
+  CHECK_EQ(failsafe.check(now), 0);
+
+  // Sustained
+  uint32_t low = now;
+  failsafe.voltage(LIMITS.undervoltage - 1, now);
+  now += LIMITS.undervoltageTime - 1;
+  failsafe.frame(now);
+  failsafe.voltage(LIMITS.undervoltage - 1, now);
+  CHECK_EQ(failsafe.check(now), 0);
+  now = low + LIMITS.undervoltageTime;
+  failsafe.frame(now);
+  CHECK_EQ(failsafe.check(now), Safety::UNDERVOLTAGE);
+
+  // Recovery alone never clears it, however far the battery comes back
+  failsafe.voltage(LIMITS.undervoltage + 2000, now);
+  now += 10 * LIMITS.undervoltageTime;
+  failsafe.frame(now);
+  failsafe.voltage(LIMITS.undervoltage + 2000, now);
+  CHECK_EQ(failsafe.check(now), Safety::UNDERVOLTAGE);
+
+  // Re-arming needs the battery back above the threshold plus the margin
+  failsafe.voltage(LIMITS.undervoltage - 1, now);
+  failsafe.voltage(LIMITS.undervoltage + LIMITS.recoveryMargin - 1, now);
+  CHECK(!failsafe.rearm());
+  CHECK_EQ(failsafe.check(now), Safety::UNDERVOLTAGE);
+  failsafe.voltage(LIMITS.undervoltage + LIMITS.recoveryMargin, now);
+  CHECK(failsafe.rearm());
+  CHECK_EQ(failsafe.check(now), 0);
+}
+
+/*
+ * With the load off, a sagging pack bounces back past the margin. The
+ * boat must stay safe rather than cycle, until the pilot closes the
+ * throttle and flips switch A.
+ */
+void testUndervoltageLatched()
+{
+  startSketch();
+  runFor(50000);
+  CHECK_EQ(engine.getState(), Motor::Direction::FORWARD);
+
+  // Sags under full throttle, and bounces back once the engine stops
+  Sim::setAnalog(Data::BATTERY_PIN, 600);
+  runFor(LIMITS.undervoltageTime + 100000);
+  CHECK_EQ(failsafe.reasons(), Safety::UNDERVOLTAGE);
+  CHECK(safe());
+  Sim::setAnalog(Data::BATTERY_PIN, Harness::HEALTHY_BATTERY);
+  runFor(3 * LIMITS.undervoltageTime);
+  CHECK_EQ(failsafe.reasons(), Safety::UNDERVOLTAGE);
+  CHECK(safe());
+
+  // Switch A with the throttle open does nothing
+  Sim::setChannel(Data::SWA_INDEX, 2000);
+  runFor(100000);
+  CHECK(safe());
+  Sim::setChannel(Data::SWA_INDEX, 1000);
+  runFor(100000);
+  CHECK(safe());
+
+  // Closed, it re-arms and the sticks take over
+  Sim::setChannel(Data::THROTTLE_INDEX, 1000);
+  runFor(100000);
+  CHECK(safe());
+  Sim::setChannel(Data::SWA_INDEX, 2000);
+  runFor(100000);
+  CHECK(!failsafe.engaged());
+  CHECK_EQ(Sim::pinLevel(WATER_SOLENOID_PIN), HIGH);
+  CHECK(!planesSurfacing());
+  CHECK(!Harness::watchdogFired());
+}
+
+/* The sketch reaches the safe state within the bound after the last frame */
+void testReactionTime()
+{
+  startSketch();
+  runFor(300000);
+  CHECK_EQ(engine.getState(), Motor::Direction::FORWARD);
+  CHECK_EQ(Sim::pinLevel(WATER_SOLENOID_PIN), HIGH);
+  CHECK(!planesSurfacing());
+  CHECK(!failsafe.engaged());
+
+  Harness::setReceiving(false);
+  uint32_t lastFrame = Harness::lastFrame();
+  while (!safe() && micros() - lastFrame < 2 * LIMITS.signalTimeout)
+  {
+    runFor(STEP_US);
+  }
+  uint32_t reaction = micros() - lastFrame;
+  uint32_t bound = Safety::reactionBound(LIMITS.signalTimeout, longestTask());
+  printf("signal loss to safe state: %u us, bound %u us\n", reaction, bound);
+  CHECK(safe());
+  CHECK(reaction > LIMITS.signalTimeout);
+  CHECK(reaction <= bound);
+  CHECK_EQ(failsafe.reasons(), Safety::SIGNAL_LOST);
+
+  // Stays safe without frames, and the watchdog stays fed throughout
+  runFor(500000);
+  CHECK(safe());
+  CHECK(!Harness::watchdogFired());
+
+  // Control comes back with the first frame after the link does
+  Harness::setReceiving(true);
+  runFor(2 * Safety::CHECK_PERIOD);
+  CHECK(!failsafe.engaged());
+  CHECK_EQ(engine.getState(), Motor::Direction::FORWARD);
+  CHECK_EQ(Sim::pinLevel(WATER_SOLENOID_PIN), HIGH);
+}
+
+/* Frames arriving during the failsafe do not drive the actuators */
+void testFramesIgnoredWhileEngaged()
+{
+  startSketch();
+  runFor(50000);
+  Sim::setAnalog(Data::BATTERY_PIN, 600);
+  runFor(LIMITS.undervoltageTime + 100000);
+  CHECK_EQ(failsafe.reasons(), Safety::UNDERVOLTAGE);
+  CHECK(safe());
+
+  Sim::setChannel(Data::DIVE_PLANE_INDEX, 1800);
+  Sim::setChannel(Data::THROTTLE_INDEX, 1700);
+  runFor(100000);
+  CHECK(safe());
+  CHECK(!Harness::watchdogFired());
+}
+
+/* The watchdog expires if the loop stops running tasks */
+void testWatchdog()
+{
+  startSketch();
+  CHECK_EQ(Sim::watchdogTimeout(), 16000u << WDTO_120MS);
+  runFor(200000);
+  CHECK(!Harness::watchdogFired());
+  Sim::advanceMicros(Sim::watchdogTimeout());
+  CHECK(Sim::watchdogExpired());
+}
+
+int main()
+{
+  testSignalLoss();
+  testVoltageStale();
+  testUndervoltage();
+  testReactionTime();
+  testUndervoltageLatched();
+  testFramesIgnoredWhileEngaged();
+  testWatchdog();
+  return CHECK_DONE();
+}
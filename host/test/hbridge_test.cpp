@@ -0,0 +1,146 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "fastHBridge.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  /* Every pin's port and bit agree with the core's table behind digitalWrite() */
+  template<uint8_t PIN>
+  struct PinCheck
+  {
+    static void run()
+    {
+      Pins::write<PIN>(HIGH);
+      CHECK_EQ(Sim::pinLevel(PIN), HIGH);
+      for (uint8_t other = 0; other < NUM_DIGITAL_PINS; other++)
+      {
+        CHECK(other == PIN || Sim::pinLevel(other) == LOW);
+      }
+      Pins::write<PIN>(LOW);
+      CHECK_EQ(Sim::pinLevel(PIN), LOW);
+      PinCheck<PIN + 1>::run();
+    }
+  };
+
+  template<>
+  struct PinCheck<NUM_DIGITAL_PINS>
+  {
+    static void run()
+    {
+    }
+  };
+
+  /* Both bridges end up with the same pins and state after each call */
+  template<uint8_t INPUT1, uint8_t INPUT2>
+  void checkSameAsRuntime()
+  {
+    Sim::reset();
+    Motor::HBridge slow(INPUT1, INPUT2);
+    Motor::FastHBridge<INPUT1, INPUT2> fast;
+    void (Motor::HBridge::*slowCalls[])() = { &Motor::HBridge::forward, &Motor::HBridge::backward, &Motor::HBridge::stop, &Motor::HBridge::off };
+    void (Motor::FastHBridge<INPUT1, INPUT2>::*fastCalls[])() = {
+      &Motor::FastHBridge<INPUT1, INPUT2>::forward, &Motor::FastHBridge<INPUT1, INPUT2>::backward,
+      &Motor::FastHBridge<INPUT1, INPUT2>::stop, &Motor::FastHBridge<INPUT1, INPUT2>::off };
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      (slow.*slowCalls[i])();
+      uint8_t level1 = Sim::pinLevel(INPUT1);
+      uint8_t level2 = Sim::pinLevel(INPUT2);
+      (fast.*fastCalls[(i + 1) % 4])();
+      uint32_t writes = Sim::digitalWrites();
+      (fast.*fastCalls[i])();
+      CHECK_EQ(Sim::pinLevel(INPUT1), level1);
+      CHECK_EQ(Sim::pinLevel(INPUT2), level2);
+      CHECK_EQ(fast.getState(), slow.getState());
+      CHECK_EQ(Sim::digitalWrites(), writes);
+    }
+  }
+}
+
+void testPinMap()
+{
+  Sim::reset();
+  PinCheck<0>::run();
+}
+
+/* Same port (A), split ports (A and B) and a port outside sbi/cbi reach (H) */
+void testMatchesRuntime()
+{
+  checkSameAsRuntime<24, 25>();
+  checkSameAsRuntime<22, 53>();
+  checkSameAsRuntime<16, 17>();
+}
+
+/* A two pin write leaves the rest of the port and the interrupt flag alone */
+void testPortSharing()
+{
+  Sim::reset();
+  Motor::FastHBridge<24, 25> bridge;
+  digitalWrite(29, HIGH);
+  digitalWrite(22, HIGH);
+  bridge.forward();
+  bridge.backward();
+  CHECK_EQ(Sim::pinLevel(29), HIGH);
+  CHECK_EQ(Sim::pinLevel(22), HIGH);
+  CHECK_EQ(PORTA, 0x01 | 0x08 | 0x80);
+  CHECK(SREG & _BV(SREG_I));
+
+  cli();
+  bridge.off();
+  CHECK(!(SREG & _BV(SREG_I)));
+  sei();
+}
+
+/* The PWM variant follows HBridgePWM, coast and stop included */
+void testPwm()
+{
+  Sim::reset();
+  Motor::FastHBridgePWM<22, 23, 11> motor;
+  CHECK_EQ(motor.getState(), Motor::COAST);
+  CHECK_EQ(Sim::pinMode(11), OUTPUT);
+
+  motor.set(Motor::FORWARD, 100);
+  CHECK_EQ(motor.getState(), Motor::FORWARD);
+  CHECK_EQ(motor.getSpeed(), 100);
+  CHECK_EQ(Sim::pwmLevel(11), 100);
+  CHECK_EQ(Sim::pinLevel(22), HIGH);
+  CHECK_EQ(Sim::pinLevel(23), LOW);
+
+  motor.stop();
+  CHECK_EQ(motor.getSpeed(), Motor::MAX_PWM_VALUE);
+  CHECK_EQ(Sim::pinLevel(23), HIGH);
+  motor.off();
+  CHECK_EQ(motor.getSpeed(), 0);
+  CHECK_EQ(Sim::pinLevel(22), LOW);
+}
+
+int main()
+{
+  testPinMap();
+  testMatchesRuntime();
+  testPortSharing();
+  testPwm();
+  return CHECK_DONE();
+}
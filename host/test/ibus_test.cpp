@@ -0,0 +1,275 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "ibus.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint8_t SERVO_UART = 2;
+  constexpr uint8_t SENSOR_UART = 3;
+
+  void poll(uint8_t command)
+  {
+    uint8_t message[4] = { 0x04, command, 0, 0 };
+    uint16_t checksum = 0xFFFF - 0x04 - command;
+    message[2] = uint8_t(checksum);
+    message[3] = uint8_t(checksum >> 8);
+    Sim::uartReceive(SENSOR_UART, message, sizeof(message));
+  }
+
+  /* Reply after the turnaround, as the receiver would see it */
+  std::vector<uint8_t> reply()
+  {
+    Sim::service();
+    std::vector<uint8_t> sent = Sim::uartTransmitted(SENSOR_UART);
+    Sim::clearUartTransmitted(SENSOR_UART);
+    return sent;
+  }
+
+  bool checksumOk(const std::vector<uint8_t>& message)
+  {
+    if (message.size() < 4 || message[0] != message.size())
+    {
+      return false;
+    }
+    uint16_t checksum = 0xFFFF;
+    for (size_t i = 0; i + 2 < message.size(); i++)
+    {
+      checksum -= message[i];
+    }
+    return checksum == uint16_t(message[message.size() - 2] | message[message.size() - 1] << 8);
+  }
+}
+
+/* A valid frame is published whole and bumps the sequence */
+void testReceiverFrame()
+{
+  Sim::reset();
+  IBus::Receiver receiver;
+  receiver.begin();
+
+  for (uint8_t i = 0; i < IBus::NUM_CHANNELS; i++)
+  {
+    Sim::setChannel(i, 1000 + i * 10);
+  }
+  Sim::advanceMillis(10);
+  Sim::deliverFrame();
+
+  CHECK_EQ(receiver.sequence(), 1);
+  CHECK_EQ(receiver.errors(), 0);
+  for (uint8_t i = 0; i < IBus::NUM_CHANNELS; i++)
+  {
+    CHECK_EQ(receiver.channels()[i], 1000 + i * 10);
+  }
+
+  // Back to back frames need no gap between them
+  Sim::setChannel(0, 2000);
+  Sim::deliverFrame();
+  Sim::deliverFrame();
+  CHECK_EQ(receiver.sequence(), 3);
+  CHECK_EQ(receiver.channels()[0], 2000);
+}
+
+/* A corrupt frame is dropped and the previous one stays readable */
+void testReceiverBadChecksum()
+{
+  Sim::reset();
+  IBus::Receiver receiver;
+  receiver.begin();
+
+  Sim::setChannel(0, 1500);
+  Sim::advanceMillis(10);
+  Sim::deliverFrame();
+
+  uint8_t frame[Sim::IBUS_FRAME_LENGTH];
+  Sim::setChannel(0, 1800);
+  Sim::encodeFrame(frame);
+  frame[5] ^= 0x01;
+  Sim::uartReceive(SERVO_UART, frame, sizeof(frame));
+
+  CHECK_EQ(receiver.sequence(), 1);
+  CHECK_EQ(receiver.errors(), 1);
+  CHECK_EQ(receiver.channels()[0], 1500);
+
+  // Nothing is accepted until the line goes quiet, then parsing resumes
+  Sim::deliverFrame();
+  CHECK_EQ(receiver.sequence(), 1);
+  Sim::advanceMicros(IBus::FRAME_GAP);
+  Sim::deliverFrame();
+  CHECK_EQ(receiver.sequence(), 2);
+  CHECK_EQ(receiver.channels()[0], 1800);
+}
+
+/* Joining mid-frame resynchronises on the next gap */
+void testReceiverResync()
+{
+  Sim::reset();
+  IBus::Receiver receiver;
+  receiver.begin();
+
+  uint8_t frame[Sim::IBUS_FRAME_LENGTH];
+  Sim::setChannel(3, 1234);
+  Sim::encodeFrame(frame);
+
+  Sim::advanceMillis(10);
+  Sim::uartReceive(SERVO_UART, frame + 7, sizeof(frame) - 7);
+  CHECK_EQ(receiver.sequence(), 0);
+
+  Sim::advanceMillis(4);
+  Sim::uartReceive(SERVO_UART, frame, sizeof(frame));
+  CHECK_EQ(receiver.sequence(), 1);
+  CHECK_EQ(receiver.channels()[3], 1234);
+}
+
+/* Discover, type and value polls each get a well formed reply */
+void testTelemetryReplies()
+{
+  Sim::reset();
+  IBus::Telemetry telemetry;
+  telemetry.begin();
+
+  CHECK_EQ(telemetry.addSensor(IBus::SENSOR_RPM), 1);
+  CHECK_EQ(telemetry.addSensor(IBus::SENSOR_PRESSURE, 4), 2);
+  CHECK(telemetry.setMeasurement(1, 1234));
+  CHECK(telemetry.setMeasurement(2, 101300));
+
+  Sim::advanceMillis(10);
+  poll(IBus::COMMAND_DISCOVER | 1);
+  std::vector<uint8_t> sent = reply();
+  CHECK_EQ(sent.size(), 4);
+  CHECK_EQ(sent[1], IBus::COMMAND_DISCOVER | 1);
+  CHECK(checksumOk(sent));
+
+  Sim::advanceMillis(10);
+  poll(IBus::COMMAND_TYPE | 2);
+  sent = reply();
+  CHECK_EQ(sent.size(), 6);
+  CHECK_EQ(sent[2], IBus::SENSOR_PRESSURE);
+  CHECK_EQ(sent[3], 4);
+  CHECK(checksumOk(sent));
+
+  Sim::advanceMillis(10);
+  poll(IBus::COMMAND_VALUE | 1);
+  sent = reply();
+  CHECK_EQ(sent.size(), 6);
+  CHECK_EQ(sent[2] | sent[3] << 8, 1234);
+  CHECK(checksumOk(sent));
+
+  Sim::advanceMillis(10);
+  poll(IBus::COMMAND_VALUE | 2);
+  sent = reply();
+  CHECK_EQ(sent.size(), 8);
+  CHECK_EQ(int32_t(sent[2] | sent[3] << 8 | sent[4] << 16 | uint32_t(sent[5]) << 24), 101300);
+  CHECK(checksumOk(sent));
+
+  // Unknown sensors and corrupt polls get no reply
+  Sim::advanceMillis(10);
+  poll(IBus::COMMAND_VALUE | 3);
+  CHECK_EQ(reply().size(), 0);
+  uint8_t corrupt[4] = { 0x04, IBus::COMMAND_VALUE | 1, 0x00, 0x00 };
+  Sim::advanceMillis(10);
+  Sim::uartReceive(SENSOR_UART, corrupt, sizeof(corrupt));
+  CHECK_EQ(reply().size(), 0);
+  CHECK_EQ(telemetry.polls(), 4);
+}
+
+/* Our own reply echoed back on the shared wire is never taken for a poll */
+void testTelemetryEcho()
+{
+  Sim::reset();
+  Sim::setUartEcho(SENSOR_UART, true);
+  IBus::Telemetry telemetry;
+  telemetry.begin();
+  telemetry.addSensor(IBus::SENSOR_RPM);
+
+  Sim::advanceMillis(10);
+  poll(IBus::COMMAND_DISCOVER | 1);
+  CHECK_EQ(reply().size(), 4);
+  CHECK_EQ(telemetry.polls(), 1);
+
+  // The next poll follows the echo closely and must still be answered
+  Sim::advanceMicros(500);
+  poll(IBus::COMMAND_VALUE | 1);
+  CHECK_EQ(reply().size(), 6);
+  CHECK_EQ(telemetry.polls(), 2);
+}
+
+/* A value can not be replaced in the buffer that is on the wire */
+void testTelemetryBusyBuffer()
+{
+  Sim::reset();
+  IBus::Telemetry telemetry;
+  telemetry.begin();
+  telemetry.addSensor(IBus::SENSOR_RPM);
+  telemetry.setMeasurement(1, 10);
+
+  Sim::advanceMillis(10);
+  poll(IBus::COMMAND_VALUE | 1);
+
+  // Reply to 10 is pending; swapping in 20 is fine, 30 would overwrite the pending reply
+  CHECK(telemetry.setMeasurement(1, 20));
+  CHECK(!telemetry.setMeasurement(1, 30));
+
+  std::vector<uint8_t> sent = reply();
+  CHECK_EQ(sent[2], 10);
+  CHECK(telemetry.setMeasurement(1, 30));
+
+  Sim::advanceMillis(10);
+  poll(IBus::COMMAND_VALUE | 1);
+  sent = reply();
+  CHECK_EQ(sent[2], 30);
+
+  // Nor once the reply is partly on the wire
+  for (uint8_t already = 1; already <= 2; already++)
+  {
+    Sim::advanceMillis(10);
+    poll(IBus::COMMAND_VALUE | 1);
+    CHECK(telemetry.setMeasurement(1, 40 + already));
+    sent.clear();
+    for (uint8_t i = 0; i < already; i++)
+    {
+      uint8_t data;
+      CHECK(telemetry.nextByte(data));
+      sent.push_back(data);
+    }
+    CHECK(!telemetry.setMeasurement(1, 50));
+
+    // The rest goes out from the data register empty interrupt, unchanged
+    std::vector<uint8_t> rest = reply();
+    sent.insert(sent.end(), rest.begin(), rest.end());
+    CHECK(checksumOk(sent));
+    CHECK_EQ(sent[2], already == 1 ? 30 : 41);
+    CHECK(telemetry.setMeasurement(1, 40 + already));
+  }
+}
+
+int main()
+{
+  testReceiverFrame();
+  testReceiverBadChecksum();
+  testReceiverResync();
+  testTelemetryReplies();
+  testTelemetryEcho();
+  testTelemetryBusyBuffer();
+  return CHECK_DONE();
+}
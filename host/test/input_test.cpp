@@ -0,0 +1,196 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "input.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  uint32_t calls = 0;
+  uint8_t lastThrottle = 0;
+
+  void onFrame(const Data::Input& input)
+  {
+    calls++;
+    lastThrottle = input.throttle;
+  }
+
+  /* Decode one frame with the staged channel values */
+  void deliver(Data::Input& input)
+  {
+    Sim::advanceMillis(7);
+    Sim::deliverFrame();
+    input.Read();
+  }
+}
+
+/* Polling without a new frame does no work and reports nothing new */
+void testFrameDriven()
+{
+  Sim::reset();
+  calls = 0;
+  Data::Input input;
+  input.Begin();
+  input.OnFrame(onFrame);
+
+  CHECK(!input.Read());
+  CHECK_EQ(input.frameCount(), 0);
+  CHECK_EQ(calls, 0);
+
+  Sim::setChannel(Data::THROTTLE_INDEX, Data::MAX_RAW_INPUT);
+  Sim::advanceMillis(7);
+  Sim::deliverFrame();
+  CHECK(input.Read());
+  CHECK_EQ(input.frameCount(), 1);
+  CHECK_EQ(input.frameTime(), 7);
+  CHECK_EQ(calls, 1);
+  CHECK_EQ(lastThrottle, Motor::MAX_PWM_VALUE);
+
+  Sim::advanceMillis(1);
+  CHECK(!input.Read());
+  CHECK(!input.Read());
+  CHECK_EQ(calls, 1);
+  CHECK_EQ(input.frameTime(), 7);
+}
+
+/* Frames overwritten before a poll are counted, the callback runs once */
+void testSkippedFrames()
+{
+  Sim::reset();
+  calls = 0;
+  Data::Input input;
+  input.Begin();
+  input.OnFrame(onFrame);
+
+  Sim::deliverFrame();
+  Sim::deliverFrame();
+  Sim::deliverFrame();
+  CHECK(input.Read());
+  CHECK_EQ(input.frameCount(), 3);
+  CHECK_EQ(input.framesSkipped(), 2);
+  CHECK_EQ(calls, 1);
+
+  // The receive counter is 8 bits wide; crossing its wrap must not lose frames
+  for (int i = 0; i < 300; i++)
+  {
+    Sim::deliverFrame();
+    input.Read();
+  }
+  CHECK_EQ(input.frameCount(), 303);
+  CHECK_EQ(input.framesSkipped(), 2);
+  CHECK_EQ(calls, 301);
+}
+
+/* Switches ignore jitter around their positions and only move past a band edge */
+void testSwitchHysteresis()
+{
+  Sim::reset();
+  Data::Input input;
+  input.Begin();
+
+  Sim::setChannel(Data::SWC_INDEX, 1499);
+  Sim::setChannel(Data::SWA_INDEX, 2001);
+  deliver(input);
+  CHECK(input.swC == Data::ThreeWaySwitchPos::MIDDLE);
+  CHECK(input.swA == Data::SwitchPos::DOWN);
+
+  // Near the upper band edge, but not past it plus the hysteresis
+  Sim::setChannel(Data::SWC_INDEX, 1700);
+  Sim::setChannel(Data::SWA_INDEX, 1480);
+  deliver(input);
+  CHECK(input.swC == Data::ThreeWaySwitchPos::MIDDLE);
+  CHECK(input.swA == Data::SwitchPos::DOWN);
+
+  Sim::setChannel(Data::SWC_INDEX, 1990);
+  Sim::setChannel(Data::SWA_INDEX, 1003);
+  deliver(input);
+  CHECK(input.swC == Data::ThreeWaySwitchPos::DOWN);
+  CHECK(input.swA == Data::SwitchPos::UP);
+
+  // Coming back down the same edge holds DOWN until well below it
+  Sim::setChannel(Data::SWC_INDEX, 1640);
+  deliver(input);
+  CHECK(input.swC == Data::ThreeWaySwitchPos::DOWN);
+  Sim::setChannel(Data::SWC_INDEX, 1010);
+  deliver(input);
+  CHECK(input.swC == Data::ThreeWaySwitchPos::UP);
+
+  // The previously ignored channels are decoded too
+  Sim::setChannel(Data::SWB_INDEX, 2000);
+  Sim::setChannel(Data::SWD_INDEX, 1998);
+  Sim::setChannel(Data::VRA_INDEX, 1234);
+  Sim::setChannel(Data::VRB_INDEX, 1777);
+  deliver(input);
+  CHECK(input.swB == Data::SwitchPos::DOWN);
+  CHECK(input.swD == Data::SwitchPos::DOWN);
+  CHECK_EQ(input.vrA, 1234);
+  CHECK_EQ(input.vrB, 1777);
+
+  // Knobs hold through jitter but reach the ends exactly
+  Sim::setChannel(Data::VRA_INDEX, 1237);
+  deliver(input);
+  CHECK_EQ(input.vrA, 1234);
+  Sim::setChannel(Data::VRA_INDEX, 2000);
+  deliver(input);
+  CHECK_EQ(input.vrA, 2000);
+}
+
+/* Only fields that really moved are flagged */
+void testChangeFlags()
+{
+  Sim::reset();
+  Data::Input input;
+  input.Begin();
+
+  Sim::setChannel(Data::RUDDER_INDEX, Data::MID_RAW_INPUT);
+  Sim::setChannel(Data::DIVE_PLANE_INDEX, Data::MID_RAW_INPUT);
+  Sim::setChannel(Data::THROTTLE_INDEX, Data::MIN_RAW_INPUT);
+  Sim::setChannel(Data::SWA_INDEX, Data::MIN_RAW_INPUT);
+  Sim::setChannel(Data::SWB_INDEX, Data::MIN_RAW_INPUT);
+  Sim::setChannel(Data::SWC_INDEX, Data::MIN_RAW_INPUT);
+  Sim::setChannel(Data::SWD_INDEX, Data::MIN_RAW_INPUT);
+  Sim::setChannel(Data::VRA_INDEX, Data::MIN_RAW_INPUT);
+  Sim::setChannel(Data::VRB_INDEX, Data::MIN_RAW_INPUT);
+  deliver(input);
+  CHECK_EQ(input.changes(), Data::RUDDER_CHANGED | Data::DIVE_PLANE_CHANGED);
+
+  deliver(input);
+  CHECK_EQ(input.changes(), 0);
+
+  Sim::setChannel(Data::SWC_INDEX, 1520);
+  Sim::setChannel(Data::VRB_INDEX, 1002);
+  deliver(input);
+  CHECK_EQ(input.changes(), Data::SWC_CHANGED);
+
+  Sim::setChannel(Data::THROTTLE_INDEX, Data::MAX_RAW_INPUT);
+  deliver(input);
+  CHECK_EQ(input.changes(), Data::THROTTLE_CHANGED);
+}
+
+int main()
+{
+  testFrameDriven();
+  testSkippedFrames();
+  testSwitchHysteresis();
+  testChangeFlags();
+  return CHECK_DONE();
+}
@@ -0,0 +1,111 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "input.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  /* Every raw value a stick can produce must convert exactly as map() did */
+  template <typename Map>
+  void checkAgainstMap(long outMin, long outMax)
+  {
+    uint32_t mismatches = 0;
+    for (uint16_t raw = Data::MIN_RAW_INPUT; raw <= Data::MAX_RAW_INPUT; raw++)
+    {
+      if (Map::apply(raw) != map(raw, Data::MIN_RAW_INPUT, Data::MAX_RAW_INPUT, outMin, outMax))
+      {
+        mismatches++;
+      }
+    }
+    CHECK_EQ(mismatches, 0);
+  }
+}
+
+/* The conversions Input::Read uses */
+void testStickMaps()
+{
+  checkAgainstMap<Data::RudderMap>(Data::MIN_RUDDER_ANGLE, Data::MAX_RUDDER_ANGLE);
+  checkAgainstMap<Data::DivePlaneMap>(Data::MIN_DIVE_PLANE_ANGLE, Data::MAX_DIVE_PLANE_ANGLE);
+  checkAgainstMap<Data::ThrottleMap>(Motor::MIN_PWM_VALUE, Motor::MAX_PWM_VALUE);
+}
+
+/* Ranges with awkward ratios and a signed output */
+void testOtherRanges()
+{
+  checkAgainstMap<Data::LinearMap<1000, 2000, -15, 15>>(-15, 15);
+  checkAgainstMap<Data::LinearMap<1000, 2000, 0, 999>>(0, 999);
+  checkAgainstMap<Data::LinearMap<1000, 2000, 800, 2200>>(800, 2200);
+  checkAgainstMap<Data::LinearMap<1000, 2000, 7, 7>>(7, 7);
+}
+
+/* Out of range input is held at the ends instead of extrapolated */
+void testClamp()
+{
+  CHECK_EQ(Data::ThrottleMap::apply(0), 0);
+  CHECK_EQ(Data::ThrottleMap::apply(988), 0);
+  CHECK_EQ(Data::ThrottleMap::apply(2012), 255);
+  CHECK_EQ(Data::ThrottleMap::apply(0xFFFF), 255);
+  CHECK_EQ(Data::RudderMap::apply(900), Data::MIN_RUDDER_ANGLE);
+}
+
+/* An uncalibrated stick passes straight through */
+void testNominalStick()
+{
+  Data::StickScale scale;
+  for (uint16_t raw = Data::MIN_RAW_INPUT; raw <= Data::MAX_RAW_INPUT; raw++)
+  {
+    CHECK_EQ(scale.apply(raw), raw);
+  }
+  CHECK_EQ(scale.apply(0), Data::MIN_RAW_INPUT);
+  CHECK_EQ(scale.apply(0xFFFF), Data::MAX_RAW_INPUT);
+}
+
+/* A short, off-centre stick still reaches both ends and rests in the middle */
+void testCalibratedStick()
+{
+  Data::StickScale scale;
+  scale.set(Data::StickRange{ 1100, 1450, 1900 });
+  CHECK_EQ(scale.apply(1100), Data::MIN_RAW_INPUT);
+  CHECK_EQ(scale.apply(1450), Data::MID_RAW_INPUT);
+  CHECK_EQ(scale.apply(1900), Data::MAX_RAW_INPUT);
+  CHECK_EQ(scale.apply(1000), Data::MIN_RAW_INPUT);
+  CHECK_EQ(scale.apply(2000), Data::MAX_RAW_INPUT);
+
+  // Each side is linear on its own scale, to within a count
+  CHECK(abs(int(scale.apply(1275)) - 1250) <= 1);
+  CHECK(abs(int(scale.apply(1675)) - 1750) <= 1);
+  for (uint16_t raw = 1100; raw < 1900; raw++)
+  {
+    CHECK(scale.apply(raw) <= scale.apply(raw + 1));
+  }
+}
+
+int main()
+{
+  testStickMaps();
+  testOtherRanges();
+  testClamp();
+  testNominalStick();
+  testCalibratedStick();
+  return CHECK_DONE();
+}
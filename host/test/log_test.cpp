@@ -0,0 +1,148 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define DEBUG_TRACE
+
+#include "check.h"
+#include "sim.h"
+#include "debug.h"
+#include "logDecoder.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  std::vector<uint8_t> sent()
+  {
+    return std::vector<uint8_t>(Serial.output.begin(), Serial.output.end());
+  }
+
+  std::string decoded(size_t& skipped)
+  {
+    return LogDecoder::decode(sent(), skipped);
+  }
+}
+
+/* Records come back as the text they stand for */
+void testRoundTrip()
+{
+  Sim::reset();
+  Log::clear();
+
+  Sim::advanceMicros(1500000);
+  LOG_INFO(Log::STARTING);
+  Sim::advanceMicros(250);
+  LOG_TRACE(Log::RX_CHANNEL, 3, 1500);
+  LOG_ERROR(Log::PWM_TOO_HIGH, -7);
+  CHECK_EQ(Log::pending(), 10 + 18 + 14);
+  CHECK_EQ(Serial.output.size(), 0);
+
+  CHECK_EQ(Log::drain(Serial), 42);
+  CHECK_EQ(Log::pending(), 0);
+
+  size_t skipped = 0;
+  CHECK(decoded(skipped) ==
+    "  1.500000 INFO  Starting\n"
+    "  1.500250 TRACE Read channel 3 : 1500\n"
+    "  1.500250 ERROR PWM value -7 exceeds maximum, clamping to MAX_PWM_VALUE\n");
+  CHECK_EQ(skipped, 0);
+}
+
+/* Draining never sends more than the UART can take right now */
+void testDrainDoesNotBlock()
+{
+  Sim::reset();
+  Log::clear();
+
+  LOG_INFO(Log::TELEMETRY, 101300, 90, 120, 40);
+  LOG_INFO(Log::TELEMETRY_VOLTS, 960);
+  Serial.txFree = 5;
+  CHECK_EQ(Log::drain(Serial), 5);
+  Serial.txFree = 0;
+  CHECK_EQ(Log::drain(Serial), 0);
+  Serial.txFree = 63;
+  CHECK_EQ(Log::drain(Serial), 26 + 14 - 5);
+
+  size_t skipped = 0;
+  CHECK(decoded(skipped) ==
+    "  0.000000 INFO  Telemetry pressure 101300, heading 90, rpm 120, speed 40\n"
+    "  0.000000 INFO  Telemetry volts 960\n");
+}
+
+/* A full ring drops whole records, counts them, and says so once there is room */
+void testOverflow()
+{
+  Sim::reset();
+  Log::clear();
+
+  // 18 byte records, 14 fit in 255 bytes
+  for (int i = 0; i < 20; i++)
+  {
+    LOG_TRACE(Log::RX_CHANNEL, i, 1000 + i);
+  }
+  CHECK_EQ(Log::dropped(), 6);
+  CHECK_EQ(Log::pending(), 14 * 18);
+
+  Log::drain(Serial);
+  Log::drain(Serial);
+  Log::drain(Serial);
+  Log::drain(Serial);
+  Log::drain(Serial);
+  CHECK_EQ(Log::pending(), 0);
+
+  size_t skipped = 0;
+  std::string text = decoded(skipped);
+  CHECK(text.find("Read channel 13 : 1013\n") != std::string::npos);
+  CHECK(text.find("Read channel 14") == std::string::npos);
+  CHECK(text.find("WARN  Dropped 6 log records\n") != std::string::npos);
+  CHECK_EQ(skipped, 0);
+}
+
+/* Line noise and cut off records are skipped without losing the good ones */
+void testResync()
+{
+  Sim::reset();
+  Log::clear();
+
+  LOG_INFO(Log::STARTING);
+  LOG_INFO(Log::HEADING_ADDRESS, 5);
+  Log::drain(Serial);
+
+  std::vector<uint8_t> data = sent();
+  const uint8_t prefix[] = { 0x00, Log::FRAME_SYNC, 0x13 };
+  std::vector<uint8_t> noisy(prefix, prefix + sizeof(prefix));
+  noisy.reserve(sizeof(prefix) + data.size() + 2);
+  noisy.insert(noisy.end(), data.begin(), data.end());
+  noisy[noisy.size() - 6] ^= 0x40;
+  noisy.push_back(Log::FRAME_SYNC);
+  noisy.push_back(Log::RECORD_LOG);
+
+  size_t skipped = 0;
+  CHECK(LogDecoder::decode(noisy, skipped) == "  0.000000 INFO  Starting\n");
+  CHECK_EQ(skipped, 3 + 14 + 2);
+}
+
+int main()
+{
+  testRoundTrip();
+  testDrainDoesNotBlock();
+  testOverflow();
+  testResync();
+  return CHECK_DONE();
+}
@@ -0,0 +1,186 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "deadReckoning.h"
+#include "compass.h"
+#include "dataUtils.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint32_t TICK = 10000;
+
+  /* Binary angle for degrees */
+  uint16_t angle(double degrees)
+  {
+    return uint16_t(lround(degrees * Sensor::FULL_TURN / 360.0));
+  }
+
+  /* Runs a leg at a steady speed and heading, returns the time it ended */
+  uint32_t leg(Navigation::DeadReckoning& nav, uint32_t now, uint32_t duration, uint32_t tick, int32_t speed, uint16_t heading)
+  {
+    for (uint32_t t = 0; t < duration; t += tick)
+    {
+      now += tick;
+      nav.update(now, speed, heading, 0);
+    }
+    return now;
+  }
+}
+
+/* The table sine is within a couple of table counts everywhere */
+void testSine()
+{
+  double worst = 0;
+  for (uint32_t a = 0; a < Sensor::FULL_TURN; a += 7)
+  {
+    double expected = sin(a * 2 * M_PI / Sensor::FULL_TURN);
+    double error = fabs(Navigation::sine(a) / 16384.0 - expected);
+    worst = error > worst ? error : worst;
+    error = fabs(Navigation::cosine(a) / 16384.0 - cos(a * 2 * M_PI / Sensor::FULL_TURN));
+    worst = error > worst ? error : worst;
+  }
+  printf("sine worst error %.6f\n", worst);
+  CHECK(worst < 0.0002);
+  CHECK_EQ(Navigation::sine(angle(90)), 16384);
+  CHECK_EQ(Navigation::sine(angle(270)), -16384);
+  CHECK_EQ(Navigation::cosine(0), 16384);
+}
+
+/* The integer root is the floor of the true one, either side of each square and at the top of the range */
+void testIsqrt()
+{
+  CHECK_EQ(Data::isqrt(0), 0);
+  CHECK_EQ(Data::isqrt(1), 1);
+  for (uint32_t root = 2; root < 65536; root += 97)
+  {
+    CHECK_EQ(Data::isqrt(root * root - 1), root - 1);
+    CHECK_EQ(Data::isqrt(root * root), root);
+  }
+  CHECK_EQ(Data::isqrt(65535u * 65535u), 65535);
+  CHECK_EQ(Data::isqrt(UINT32_MAX), 65535);
+}
+
+/* A straight run north, and the way home is back south */
+void testStraightRun()
+{
+  Navigation::DeadReckoning nav;
+  nav.begin(1000);
+  leg(nav, 1000, 10000000, TICK, 1000, 0);
+  CHECK_EQ(nav.north(), 10000);
+  CHECK_EQ(nav.east(), 0);
+  CHECK_EQ(nav.distanceHome(), 10000);
+  CHECK_EQ(nav.bearingHome(), angle(180));
+
+  // Astern on the same heading comes back
+  leg(nav, 10001000, 4000000, TICK, -1000, 0);
+  CHECK_EQ(nav.north(), 6000);
+}
+
+/* Creeping speeds and odd tick lengths still add up exactly */
+void testSlowSpeed()
+{
+  Navigation::DeadReckoning nav;
+  nav.begin(0);
+  leg(nav, 0, 100002000, 7001, 1, angle(90));
+  CHECK(abs(nav.east() - 100) <= 1);
+  CHECK_EQ(nav.north(), 0);
+}
+
+/* A square comes back to where it started */
+void testSquare()
+{
+  Navigation::DeadReckoning nav;
+  uint32_t now = 0;
+  nav.begin(now);
+  const double headings[] = { 90, 180, 270, 0 };
+  for (double heading : headings)
+  {
+    now = leg(nav, now, 5000000, TICK, 2000, angle(heading));
+    if (heading == 90)
+    {
+      CHECK_EQ(nav.bearingHome(), angle(270));
+    }
+  }
+  CHECK(nav.distanceHome() <= 5);
+}
+
+/* An update after a long gap does not overflow */
+void testLateUpdate()
+{
+  Navigation::DeadReckoning nav;
+  nav.begin(0);
+  nav.update(2000000, 8000, angle(45), 1500);
+  CHECK(abs(nav.north() - 11314) <= 2);
+  CHECK(abs(nav.east() - 11314) <= 2);
+  CHECK_EQ(nav.depth(), 1500);
+  CHECK(abs(int32_t(nav.distanceHome()) - 16000) <= 2);
+}
+
+/* A wandering track against the same integration in doubles */
+void testAgainstReference()
+{
+  srand(19);
+  Navigation::DeadReckoning nav;
+  nav.begin(0);
+  double north = 0;
+  double east = 0;
+  uint32_t now = 0;
+  double heading = 0;
+  int32_t speed = 1500;
+  double run = 0;
+  for (int i = 0; i < 60000; i++)
+  {
+    heading = fmod(heading + 2.0 * rand() / RAND_MAX - 1 + 360, 360);
+    speed = constrain(speed + rand() % 41 - 20, 0, 5000);
+    uint16_t binary = angle(heading);
+    double radians = binary * 2 * M_PI / Sensor::FULL_TURN;
+    uint32_t tick = TICK + rand() % 500;
+    now += tick;
+    nav.update(now, speed, binary, 0);
+    north += speed * cos(radians) * tick / 1e6;
+    east += speed * sin(radians) * tick / 1e6;
+    run += speed * double(tick) / 1e6;
+  }
+
+  double error = hypot(nav.north() - north, nav.east() - east);
+  printf("after %.0f m, %.1f mm from the reference\n", run / 1000, error);
+  CHECK(error < run * 0.0005);
+  CHECK(fabs(nav.distanceHome() - hypot(north, east)) < run * 0.0005 + 2);
+  double bearing = atan2(-east, -north) * 180 / M_PI;
+  double expected = bearing < 0 ? bearing + 360 : bearing;
+  CHECK(fabs(nav.bearingHome() * 360.0 / Sensor::FULL_TURN - expected) < 0.5);
+}
+
+int main()
+{
+  testSine();
+  testIsqrt();
+  testStraightRun();
+  testSlowSpeed();
+  testSquare();
+  testLateUpdate();
+  testAgainstReference();
+  return CHECK_DONE();
+}
@@ -0,0 +1,166 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define PROFILE_ENABLED
+
+#include "check.h"
+#include "sim.h"
+#include "profile.h"
+#include "logDecoder.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  void timedStage(uint32_t cost)
+  {
+    PROFILE_SCOPE(SERVO_WRITE);
+    Sim::advanceMicros(cost);
+  }
+}
+
+/* Bins are powers of two with everything long piling into the last */
+void testBins()
+{
+  CHECK_EQ(Profile::bin(0), 0);
+  CHECK_EQ(Profile::bin(1), 1);
+  CHECK_EQ(Profile::bin(2), 2);
+  CHECK_EQ(Profile::bin(3), 2);
+  CHECK_EQ(Profile::bin(4), 3);
+  CHECK_EQ(Profile::bin(4095), 12);
+  CHECK_EQ(Profile::bin(4096), 13);
+  CHECK_EQ(Profile::bin(UINT32_MAX), Profile::HISTOGRAM_BINS - 1);
+}
+
+/* Scoped timers and explicit records both land in the stage summary */
+void testStats()
+{
+  Sim::reset();
+  Profile::clear();
+
+  timedStage(40);
+  timedStage(100);
+  timedStage(10);
+  PROFILE_RECORD(SERVO_WRITE, 6000);
+
+  const Profile::Stats& stats = Profile::stats(Profile::SERVO_WRITE);
+  CHECK_EQ(stats.count, 4);
+  CHECK_EQ(stats.total, 6150);
+  CHECK_EQ(stats.min, 10);
+  CHECK_EQ(stats.max, 6000);
+  CHECK_EQ(stats.histogram[Profile::bin(10)], 1);
+  CHECK_EQ(stats.histogram[Profile::bin(40)], 1);
+  CHECK_EQ(stats.histogram[Profile::bin(100)], 1);
+  CHECK_EQ(stats.histogram[Profile::HISTOGRAM_BINS - 1], 1);
+  CHECK_EQ(Profile::stats(Profile::LOOP).count, 0);
+
+  // The worst case over a window is reported once then starts over
+  CHECK_EQ(PROFILE_WORST(SERVO_WRITE), 6000);
+  CHECK_EQ(PROFILE_WORST(SERVO_WRITE), 0);
+  timedStage(25);
+  CHECK_EQ(PROFILE_WORST(SERVO_WRITE), 25);
+  CHECK_EQ(stats.max, 6000);
+}
+
+/* A dump larger than the log ring goes out over several drains and decodes */
+void testDump()
+{
+  Sim::reset();
+  Profile::clear();
+  Log::clear();
+
+  PROFILE_RECORD(LOOP, 12);
+  PROFILE_RECORD(LOOP, 20);
+  PROFILE_RECORD(LOOP, 700);
+
+  uint8_t calls = 1;
+  while (!PROFILE_DUMP())
+  {
+    Log::drain(Serial);
+    calls++;
+  }
+  while (Log::pending())
+  {
+    Log::drain(Serial);
+  }
+  CHECK(calls > 1);
+  CHECK_EQ(Log::dropped(), 0);
+
+  size_t skipped = 0;
+  std::vector<uint8_t> capture(Serial.output.begin(), Serial.output.end());
+  std::string text = LogDecoder::decode(capture, skipped);
+  CHECK_EQ(skipped, 0);
+  CHECK(text.find("PROFILE loop(): 3 runs, min 12, mean 244, max 700 us, histogram <1:0 <2:0") == 0);
+  CHECK(text.find(" <16:1 <32:1 ") != std::string::npos);
+  CHECK(text.find(" <1024:1 ") != std::string::npos);
+  CHECK(text.find("PROFILE control tick lateness: 0 runs") != std::string::npos);
+
+  // The next dump starts over from the first stage
+  Serial.output.clear();
+  PROFILE_DUMP();
+  Log::drain(Serial);
+  Log::clear();
+  capture.assign(Serial.output.begin(), Serial.output.end());
+  CHECK(LogDecoder::decode(capture, skipped).find("PROFILE loop(): 3 runs") == 0);
+}
+
+/*
+ * A loop() that averages 2 ms totals more than 32 bits of microseconds
+ * in under an hour and a half; the total and the mean must not wrap
+ */
+void testLongRun()
+{
+  Sim::reset();
+  Profile::clear();
+  Log::clear();
+  Serial.output.clear();
+
+  constexpr uint32_t RUNS = 2400000;
+  for (uint32_t i = 0; i < RUNS; i++)
+  {
+    PROFILE_RECORD(LOOP, i % 2 ? 1500 : 2500);
+  }
+  const Profile::Stats& stats = Profile::stats(Profile::LOOP);
+  CHECK_EQ(stats.count, RUNS);
+  CHECK(stats.total == uint64_t(RUNS) * 2000);
+  CHECK(stats.total > UINT32_MAX);
+
+  while (!PROFILE_DUMP())
+  {
+    Log::drain(Serial);
+  }
+  while (Log::pending())
+  {
+    Log::drain(Serial);
+  }
+  size_t skipped = 0;
+  std::vector<uint8_t> capture(Serial.output.begin(), Serial.output.end());
+  std::string text = LogDecoder::decode(capture, skipped);
+  CHECK_EQ(skipped, 0);
+  CHECK(text.find("PROFILE loop(): 2400000 runs, min 1500, mean 2000, max 2500 us") == 0);
+}
+
+int main()
+{
+  testBins();
+  testStats();
+  testDump();
+  testLongRun();
+  return CHECK_DONE();
+}
@@ -0,0 +1,319 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "check.h"
+#include "harness.h"
+#include "sim.h"
+#include "logDecoder.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint32_t STEP_US = 50;
+  constexpr uint32_t RECORD_PERIOD = 20000;
+
+  /* Keeps whatever it is given, taking at most room bytes per flush */
+  class BufferSink : public Recorder::Sink
+  {
+    public:
+      uint16_t room() override
+      {
+        return space;
+      }
+
+      void write(const uint8_t* data, uint16_t size) override
+      {
+        CHECK(size <= space);
+        bytes.insert(bytes.end(), data, data + size);
+        writes++;
+      }
+
+      uint16_t space = 64;
+      uint32_t writes = 0;
+      std::vector<uint8_t> bytes;
+  };
+
+  Recorder::Snapshot sample(uint32_t time)
+  {
+    Recorder::Snapshot s;
+    s.time = time;
+    s.throttle = 128;
+    s.rudder = 1500;
+    s.divePlane = 1480;
+    s.switches = Recorder::SWA_DOWN | 2 << Recorder::SWC_SHIFT;
+    s.vrA = 1000;
+    s.vrB = 2000;
+    s.outputs = Motor::FORWARD | Ballast::HOLD << Recorder::BALLAST_SHIFT;
+    s.enginePwm = 200;
+    s.rudderServo = 1510;
+    s.planeServo = 1400;
+    s.rpm = 2400;
+    s.pressure = 111325;
+    s.heading = 65000;
+    s.battery = 12100;
+    return s;
+  }
+
+  bool same(const Recorder::Snapshot& a, const Recorder::Snapshot& b)
+  {
+    return a.time == b.time && a.throttle == b.throttle && a.rudder == b.rudder && a.divePlane == b.divePlane
+      && a.switches == b.switches && a.vrA == b.vrA && a.vrB == b.vrB && a.outputs == b.outputs
+      && a.enginePwm == b.enginePwm && a.rudderServo == b.rudderServo && a.planeServo == b.planeServo
+      && a.rpm == b.rpm && a.pressure == b.pressure && a.heading == b.heading && a.battery == b.battery;
+  }
+
+  /* Snapshots rebuilt from a capture */
+  std::vector<Recorder::Snapshot> replay(const std::vector<uint8_t>& bytes, size_t& skipped)
+  {
+    std::vector<Recorder::Snapshot> out;
+    LogDecoder::FlightDecoder decoder;
+    LogDecoder::Frame frame;
+    size_t pos = 0;
+    size_t before = 0;
+    skipped = 0;
+    while (LogDecoder::nextFrame(bytes.data(), bytes.size(), pos, frame, skipped))
+    {
+      if (!decoder.format(frame, skipped != before).empty())
+      {
+        out.push_back(decoder.snapshot());
+      }
+      before = skipped;
+    }
+    return out;
+  }
+
+  size_t rows(const std::string& csv)
+  {
+    size_t lines = 0;
+    for (char c : csv)
+    {
+      lines += c == '\n';
+    }
+    return lines;
+  }
+}
+
+/* Both encodings come back to the snapshot they were made from */
+void testRoundTrip()
+{
+  Recorder::Snapshot first = sample(1000000);
+  Recorder::Snapshot second = sample(1020000);
+  second.rudder += 40;
+  second.divePlane -= 100;
+  second.rpm -= 128;
+  second.pressure += 30000;
+  second.heading = 300; // Wrapped past north
+  second.battery -= 20;
+  second.switches = Recorder::SWB_DOWN;
+
+  uint8_t key[Recorder::KEY_LENGTH];
+  uint8_t delta[Recorder::DELTA_LENGTH];
+  Recorder::encodeKey(first, key);
+  CHECK(Recorder::encodeDelta(first, second, delta));
+
+  Recorder::Snapshot decoded;
+  CHECK(Recorder::decodeKey(key, sizeof(key), decoded));
+  CHECK(same(decoded, first));
+  CHECK(Recorder::applyDelta(delta, sizeof(delta), decoded));
+  CHECK(same(decoded, second));
+
+  CHECK(!Recorder::decodeKey(key, sizeof(key) - 1, decoded));
+  CHECK(!Recorder::applyDelta(delta, sizeof(delta) + 1, decoded));
+}
+
+/* Anything that moves too far for its delta field needs a keyframe */
+void testDeltaLimits()
+{
+  uint8_t delta[Recorder::DELTA_LENGTH];
+  Recorder::Snapshot before = sample(0);
+  Recorder::Snapshot after = before;
+
+  after.rudder = before.rudder + 127;
+  CHECK(Recorder::encodeDelta(before, after, delta));
+  after.rudder = before.rudder + 128;
+  CHECK(!Recorder::encodeDelta(before, after, delta));
+  after.rudder = before.rudder - 128;
+  CHECK(Recorder::encodeDelta(before, after, delta));
+
+  after = before;
+  after.pressure = before.pressure - 32769;
+  CHECK(!Recorder::encodeDelta(before, after, delta));
+
+  after = before;
+  after.time = before.time + 65536;
+  CHECK(!Recorder::encodeDelta(before, after, delta));
+  after.time = before.time + 65535;
+  CHECK(Recorder::encodeDelta(before, after, delta));
+
+  // Whole bytes go in as they are, so any change fits
+  after.throttle = 0;
+  after.outputs = 0xFF;
+  CHECK(Recorder::encodeDelta(before, after, delta));
+}
+
+/* A keyframe starts the stream, after every KEYFRAME_INTERVAL records and after a big move */
+void testKeyframes()
+{
+  BufferSink sink;
+  Recorder::FlightRecorder recorder(sink);
+  for (uint32_t i = 0; i < 2 * Recorder::KEYFRAME_INTERVAL; i++)
+  {
+    Recorder::Snapshot s = sample(i * RECORD_PERIOD);
+    s.planeServo += i % 3;
+    CHECK(recorder.record(s));
+    recorder.flush();
+  }
+  CHECK_EQ(recorder.records(), 2 * Recorder::KEYFRAME_INTERVAL);
+  CHECK_EQ(recorder.keyframes(), 2);
+  CHECK_EQ(sink.bytes.size(), 2 * (34 + (Recorder::KEYFRAME_INTERVAL - 1) * 22));
+  CHECK_EQ(sink.bytes[1], Recorder::RECORD_KEYFRAME);
+  CHECK_EQ(sink.bytes[34 + 1], Recorder::RECORD_DELTA);
+
+  Recorder::Snapshot jump = sample(2 * Recorder::KEYFRAME_INTERVAL * RECORD_PERIOD);
+  jump.rudder = 1900;
+  recorder.record(jump);
+  CHECK_EQ(recorder.keyframes(), 3);
+
+  size_t skipped = 0;
+  recorder.flush();
+  std::vector<Recorder::Snapshot> out = replay(sink.bytes, skipped);
+  CHECK_EQ(skipped, 0);
+  CHECK_EQ(out.size(), 2 * Recorder::KEYFRAME_INTERVAL + 1);
+  CHECK(same(out.back(), jump));
+}
+
+/* A full ring drops records rather than wait, and the one after a drop stands alone */
+void testFullRing()
+{
+  BufferSink sink;
+  sink.space = 0;
+  Recorder::FlightRecorder recorder(sink);
+  uint32_t i = 0;
+  while (recorder.record(sample(i * RECORD_PERIOD)))
+  {
+    i++;
+  }
+  CHECK_EQ(recorder.dropped(), 1);
+  CHECK(recorder.pending() <= Recorder::RING_SIZE - 1);
+  CHECK(recorder.pending() > Recorder::RING_SIZE - 1 - 34);
+  CHECK_EQ(recorder.flush(), 0);
+
+  // Room comes back a little at a time, and the ring wraps while it drains
+  uint16_t keys = recorder.keyframes();
+  sink.space = 40;
+  recorder.flush();
+  CHECK(recorder.record(sample(++i * RECORD_PERIOD)));
+  CHECK_EQ(recorder.keyframes(), keys + 1);
+  for (int n = 0; n < 20; n++)
+  {
+    recorder.flush();
+    recorder.record(sample(++i * RECORD_PERIOD));
+  }
+  sink.space = Recorder::RING_SIZE;
+  recorder.flush();
+  CHECK_EQ(recorder.pending(), 0);
+
+  size_t skipped = 0;
+  std::vector<Recorder::Snapshot> out = replay(sink.bytes, skipped);
+  CHECK_EQ(skipped, 0);
+  CHECK_EQ(out.size(), recorder.records());
+  CHECK(same(out.back(), sample(i * RECORD_PERIOD)));
+}
+
+/* Damage in the capture costs the records up to the next keyframe, no more */
+void testDecoderResync()
+{
+  BufferSink sink;
+  sink.space = 1024;
+  Recorder::FlightRecorder recorder(sink);
+  for (uint32_t i = 0; i < 2 * Recorder::KEYFRAME_INTERVAL; i++)
+  {
+    Recorder::Snapshot s = sample(i * RECORD_PERIOD);
+    s.rpm += i;
+    recorder.record(s);
+    recorder.flush();
+  }
+
+  // Hit the tenth record, a delta
+  std::vector<uint8_t> damaged = sink.bytes;
+  damaged[34 + 8 * 22 + 5] ^= 0x40;
+  size_t skipped = 0;
+  std::vector<Recorder::Snapshot> out = replay(damaged, skipped);
+  CHECK_EQ(skipped, 22);
+  CHECK_EQ(out.size(), 9 + Recorder::KEYFRAME_INTERVAL);
+  CHECK_EQ(out[9].time, Recorder::KEYFRAME_INTERVAL * RECORD_PERIOD);
+  CHECK_EQ(out.back().rpm, 2400 + 2 * Recorder::KEYFRAME_INTERVAL - 1);
+
+  std::string csv = LogDecoder::decodeFlight(damaged, skipped);
+  CHECK_EQ(rows(csv), 1 + 9 + Recorder::KEYFRAME_INTERVAL);
+  CHECK(csv.compare(0, strlen(LogDecoder::FLIGHT_COLUMNS), LogDecoder::FLIGHT_COLUMNS) == 0);
+  CHECK(csv.find("\n0.000000,128,1500,1480,1,0,2,0,1000,2000,2,0,0,0,200,1510,1400,2400,111325,357.06,12100\n") != std::string::npos);
+}
+
+/* The sketch records at RECORD_PERIOD on Serial1 at the documented rate */
+void testSketchRecording()
+{
+  Harness::resetBoard();
+  Sim::setChannel(Data::THROTTLE_INDEX, 1600);
+  Sim::setChannel(Data::SWA_INDEX, 1000);
+  Sim::setChannel(Data::SWC_INDEX, 2000);
+  Sim::setChannel(Data::DIVE_PLANE_INDEX, 1500);
+  Harness::startSketch();
+  CHECK_EQ(Serial1.baud, 115200u);
+
+  uint32_t start = micros();
+  Harness::runSketchFor(10000000, STEP_US);
+  uint32_t elapsed = micros() - start;
+
+  std::vector<uint8_t> bytes(Serial1.output.begin(), Serial1.output.end());
+  double perSecond = bytes.size() * 1e6 / elapsed;
+  printf("flight recorder: %u records, %u keyframes, %u dropped, %.0f bytes/s\n",
+    recorder.records(), recorder.keyframes(), recorder.dropped(), perSecond);
+  CHECK_EQ(recorder.dropped(), 0);
+  CHECK(recorder.records() >= elapsed / RECORD_PERIOD - 1);
+  CHECK(recorder.records() <= elapsed / RECORD_PERIOD + 1);
+  CHECK(perSecond < 1200);
+
+  size_t skipped = 0;
+  std::vector<Recorder::Snapshot> out = replay(bytes, skipped);
+  CHECK_EQ(skipped, 0);
+  CHECK(out.size() + 2 >= recorder.records());
+  const Recorder::Snapshot& last = out.back();
+  CHECK_EQ(last.outputs & Recorder::ENGINE_MASK, engine.getState());
+  CHECK_EQ(engine.getState(), Motor::FORWARD);
+  CHECK_EQ((last.outputs >> Recorder::BALLAST_SHIFT) & 0x03, Ballast::HOLD);
+  CHECK_EQ(last.enginePwm, engine.getSpeed());
+  CHECK_EQ(last.planeServo, Rx.divePlane);
+  CHECK(last.battery > 11500 && last.battery < 12500);
+  CHECK(last.pressure > 90000);
+}
+
+int main()
+{
+  testRoundTrip();
+  testDeltaLimits();
+  testKeyframes();
+  testFullRing();
+  testDecoderResync();
+  testSketchRecording();
+  return CHECK_DONE();
+}
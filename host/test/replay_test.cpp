@@ -0,0 +1,220 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstring>
+
+#include "check.h"
+#include "sim.h"
+#include "sketch.h"
+#include "ibusReplay.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint32_t FRAME_US = 7000;
+
+  /* Surface position of the planes in the sketch */
+  constexpr uint16_t DIVE_PLANE_SURFACE = Data::MIN_DIVE_PLANE_ANGLE;
+
+  /* Frames from..to with the staged channels */
+  void frames(Replay::Capture& capture, uint32_t from, uint32_t to)
+  {
+    for (uint32_t at = from; at < to; at += FRAME_US)
+    {
+      Replay::addFrame(capture, at);
+    }
+  }
+
+  /*
+   * A short session: throttle up forward, fill and hold the tank, a
+   * burst of line noise, reverse, then the link drops for 300 ms
+   */
+  Replay::Capture session()
+  {
+    Sim::reset();
+    Sim::setChannel(Data::RUDDER_INDEX, 1500);
+    Sim::setChannel(Data::DIVE_PLANE_INDEX, 1500);
+    Sim::setChannel(Data::THROTTLE_INDEX, 1000);
+    Sim::setChannel(Data::SWA_INDEX, 1000);
+    Sim::setChannel(Data::SWC_INDEX, 2000);
+
+    Replay::Capture capture;
+    frames(capture, 0, 500000);
+    for (uint32_t at = 500000; at < 1000000; at += FRAME_US)
+    {
+      Sim::setChannel(Data::THROTTLE_INDEX, 1000 + (at - 500000) * 600 / 500000);
+      Replay::addFrame(capture, at);
+    }
+    frames(capture, 1000000, 1200000);
+    Sim::setChannel(Data::SWC_INDEX, 1500);
+    frames(capture, 1200000, 1600000);
+    Sim::setChannel(Data::SWC_INDEX, 2000);
+    frames(capture, 1600000, 1800000);
+
+    // Noise between frames, then the next frame as normal
+    capture.bursts.push_back(Replay::Burst{ 1803500, { 0x20, 0x40, 0x13, 0x77, 0xFE } });
+    frames(capture, 1807000, 2000000);
+    Sim::setChannel(Data::SWA_INDEX, 2000);
+    frames(capture, 2000000, 2500000);
+    frames(capture, 2800000, 3200000);
+    return capture;
+  }
+
+  /* First trace line at or after a time, or the last one */
+  std::string at(const std::vector<std::string>& trace, uint32_t time)
+  {
+    for (const std::string& line : trace)
+    {
+      if (strtoul(line.c_str(), nullptr, 10) >= time)
+      {
+        return line;
+      }
+    }
+    return trace.empty() ? std::string() : trace.back();
+  }
+
+  /* The line in effect at a time: the last one at or before it */
+  std::string state(const std::vector<std::string>& trace, uint32_t time)
+  {
+    std::string current;
+    for (const std::string& line : trace)
+    {
+      if (strtoul(line.c_str(), nullptr, 10) > time)
+      {
+        break;
+      }
+      current = line;
+    }
+    return current;
+  }
+
+  bool has(const std::string& line, const char* text)
+  {
+    return line.find(text) != std::string::npos;
+  }
+
+  /* Number after name= in a trace line */
+  long field(const std::string& line, const char* name)
+  {
+    size_t found = line.find(std::string(" ") + name + "=");
+    return found == std::string::npos ? -1 : strtol(line.c_str() + found + strlen(name) + 2, nullptr, 10);
+  }
+
+  /* Servo pulses come back a timer tick or two off what was written */
+  bool near(long micros, long expected)
+  {
+    return micros >= expected - 5 && micros <= expected + 5;
+  }
+}
+
+/* A capture survives the file format, long bursts included */
+void testFormat()
+{
+  Replay::Capture capture;
+  capture.bursts.push_back(Replay::Burst{ 10, { 1, 2, 3 } });
+  capture.bursts.push_back(Replay::Burst{ 5000, std::vector<uint8_t>(300, 0x55) });
+
+  Replay::Capture back;
+  CHECK(Replay::parse(Replay::serialize(capture), back));
+  CHECK_EQ(back.baud, Replay::DEFAULT_BAUD);
+  CHECK_EQ(back.bursts.size(), 3);
+  CHECK_EQ(back.bursts[0].at, 10);
+  CHECK(back.bursts[0].bytes == capture.bursts[0].bytes);
+  CHECK_EQ(back.bursts[1].bytes.size(), 255);
+  CHECK_EQ(back.bursts[2].bytes.size(), 45);
+  CHECK_EQ(back.bursts[2].at, 5000 + 255 * 87);
+  CHECK_EQ(back.duration(), capture.duration());
+
+  std::vector<uint8_t> data = Replay::serialize(capture);
+  data.pop_back();
+  CHECK(!Replay::parse(data, back));
+  data = Replay::serialize(capture);
+  data[0] = 'X';
+  CHECK(!Replay::parse(data, back));
+  data = Replay::serialize(capture);
+  data[7] = Replay::FORMAT_VERSION + 1;
+  CHECK(!Replay::parse(data, back));
+}
+
+/* The same capture gives the same trace, run after run */
+void testDeterministic()
+{
+  Replay::Capture capture = session();
+  std::vector<std::string> first;
+  std::vector<std::string> second;
+  CHECK(Replay::run(capture, first));
+  CHECK(Replay::run(capture, second));
+  CHECK(!first.empty());
+  CHECK(Replay::diff(first, second).empty());
+
+  // And a trace that moved is reported where it moved
+  second[2] = "changed";
+  std::string differences = Replay::diff(first, second);
+  CHECK(has(differences, "line 3\n- "));
+  CHECK(has(differences, "\n+ changed\n"));
+}
+
+/* The trace shows what the session asked for, including the failsafe and the recovery */
+void testSession()
+{
+  Replay::Capture capture = session();
+  auto started = std::chrono::steady_clock::now();
+  std::vector<std::string> trace;
+  CHECK(Replay::run(capture, trace));
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  printf("replayed %.1f s in %.3f s, %zu trace lines\n", capture.duration() / 1e6, seconds, trace.size());
+  CHECK(seconds < capture.duration() / 1e6);
+
+  CHECK(has(state(trace, 400000), "engine=coast pwm=0 "));
+  CHECK(has(state(trace, 400000), "solenoid=1 pump=off"));
+  CHECK(has(state(trace, 1100000), "engine=forward pwm=151 "));
+  CHECK(has(state(trace, 1500000), "solenoid=0 pump=forward"));
+  CHECK(has(state(trace, 1900000), "solenoid=1 pump=off"));
+  CHECK(has(state(trace, 2400000), "engine=backward pwm=151 "));
+
+  // The noise burst changed nothing
+  CHECK(state(trace, 1800000) == state(trace, 1990000));
+
+  // Safe within the failsafe's bound of the last frame before the gap
+  uint32_t lastFrame = capture.bursts[0].at;
+  for (const Replay::Burst& burst : capture.bursts)
+  {
+    lastFrame = burst.at < 2500000 ? burst.at : lastFrame;
+  }
+  std::string dropped = at(trace, lastFrame + Safety::DEFAULT_THRESHOLDS.signalTimeout);
+  CHECK(has(dropped, "engine=coast"));
+  CHECK(has(dropped, "solenoid=0 pump=off"));
+  CHECK(near(field(dropped, "plane"), DIVE_PLANE_SURFACE));
+  CHECK(strtoul(dropped.c_str(), nullptr, 10) <= lastFrame + Safety::reactionBound(Safety::DEFAULT_THRESHOLDS.signalTimeout, 1000));
+  CHECK(has(state(trace, 2790000), "engine=coast"));
+
+  // Control comes back with the link
+  CHECK(has(state(trace, 3000000), "engine=backward pwm=151 "));
+  CHECK(has(state(trace, 3000000), "solenoid=1"));
+}
+
+int main()
+{
+  testFormat();
+  testDeterministic();
+  testSession();
+  return CHECK_DONE();
+}
@@ -0,0 +1,233 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "motor.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint8_t ENCODER_PIN_A = 2;
+  constexpr uint8_t ENCODER_PIN_B = 3;
+  constexpr uint8_t DIRECTION_PIN = 48;
+
+  /* Encoder counts for a steady speed, carrying the fractions between samples */
+  struct Shaft
+  {
+    int32_t count;
+    int32_t remainder;
+
+    /* Advance by one sample period at rpm, returns the new count */
+    int32_t turn(int32_t rpm)
+    {
+      // counts = rpm * PPR * period / 1 minute
+      int64_t scaled = int64_t(rpm) * Motor::PULSES_PER_REVOLUTION * Motor::RPM_SAMPLE_PERIOD + remainder;
+      count += int32_t(scaled / Motor::MINUTE_US);
+      remainder = int32_t(scaled % Motor::MINUTE_US);
+      return count;
+    }
+  };
+
+  /* Run the estimator at a steady speed for a while */
+  void spin(Motor::RpmEstimator& estimator, Shaft& shaft, uint32_t& now, int32_t rpm, uint32_t samples)
+  {
+    for (uint32_t i = 0; i < samples; i++)
+    {
+      now += Motor::RPM_SAMPLE_PERIOD;
+      estimator.sample(shaft.turn(rpm), now);
+    }
+  }
+}
+
+/* Counting over each sample at speed, in both directions */
+void testCounting()
+{
+  Motor::RpmEstimator estimator;
+  Shaft shaft = { 0, 0 };
+  uint32_t now = 0;
+  estimator.begin(0, now);
+
+  spin(estimator, shaft, now, 120, 50);
+  CHECK_EQ(estimator.getRpm(), 120);
+  CHECK_EQ(estimator.getDirection(), 1);
+
+  spin(estimator, shaft, now, -45, 50);
+  CHECK_EQ(estimator.getSignedRpm(), -45);
+  CHECK_EQ(estimator.getRpm(), 45);
+  CHECK_EQ(estimator.getDirection(), -1);
+}
+
+/* Below MIN_COUNTS per sample the estimate spans edges and stays accurate */
+void testSlow()
+{
+  Motor::RpmEstimator estimator;
+  Shaft shaft = { 0, 0 };
+  uint32_t now = 0;
+  estimator.begin(0, now);
+
+  // 1.4 counts per sample
+  spin(estimator, shaft, now, 1, 300);
+  CHECK_EQ(estimator.getRpm(), 1);
+
+  spin(estimator, shaft, now, 3, 100);
+  CHECK_EQ(estimator.getRpm(), 3);
+  spin(estimator, shaft, now, 7, 100);
+  CHECK_EQ(estimator.getRpm(), 7);
+}
+
+/* With no edges for STALL_TIME the estimate drops straight to zero */
+void testStall()
+{
+  Motor::RpmEstimator estimator;
+  Shaft shaft = { 0, 0 };
+  uint32_t now = 0;
+  estimator.begin(0, now);
+
+  spin(estimator, shaft, now, 60, 30);
+  CHECK_EQ(estimator.getRpm(), 60);
+
+  uint32_t stopped = now;
+  while (now - stopped < Motor::STALL_TIME - Motor::RPM_SAMPLE_PERIOD)
+  {
+    now += Motor::RPM_SAMPLE_PERIOD;
+    estimator.sample(shaft.count, now);
+  }
+  CHECK_EQ(estimator.getRpm(), 60);
+  now += Motor::RPM_SAMPLE_PERIOD;
+  estimator.sample(shaft.count, now);
+  CHECK_EQ(estimator.getRpm(), 0);
+  CHECK_EQ(estimator.getDirection(), 0);
+}
+
+/* Neither the count nor micros() wrapping upsets the estimate */
+void testWrap()
+{
+  Motor::RpmEstimator estimator;
+  Shaft shaft = { INT32_MAX - 1000, 0 };
+  uint32_t now = UINT32_MAX - 100000;
+  estimator.begin(shaft.count, now);
+
+  for (uint32_t i = 0; i < 50; i++)
+  {
+    now += Motor::RPM_SAMPLE_PERIOD;
+    // Step through unsigned like a 32 bit counter would
+    shaft.count = int32_t(uint32_t(shaft.count) + 140);
+    estimator.sample(shaft.count, now);
+  }
+  CHECK(shaft.count < 0);
+  CHECK_EQ(estimator.getRpm(), 100);
+}
+
+/* The motor's rpm follows the encoder from read() alone, with no set() */
+void testMotorFresh()
+{
+  Sim::reset();
+  Motor::QuadratureCounter encoder(ENCODER_PIN_A, ENCODER_PIN_B);
+  Motor::HBridgePWMEnc motor(22, 23, 11, encoder);
+  motor.begin();
+  motor.set(Motor::FORWARD, 200);
+
+  for (uint32_t i = 0; i < 50; i++)
+  {
+    Sim::advanceMicros(Motor::RPM_SAMPLE_PERIOD);
+    Sim::moveEncoder(ENCODER_PIN_A, 280);
+    motor.read();
+  }
+  CHECK_EQ(motor.getRpm(), 200);
+  CHECK_EQ(motor.getDirection(), 1);
+
+  for (uint32_t i = 0; i < 50; i++)
+  {
+    Sim::advanceMicros(Motor::RPM_SAMPLE_PERIOD);
+    Sim::moveEncoder(ENCODER_PIN_A, 70);
+    motor.read();
+  }
+  CHECK_EQ(motor.getRpm(), 50);
+}
+
+/* Timer5 counts whole cycles on T5 and survives its 16 bit wrap */
+void testTimer5Counter()
+{
+  Sim::reset();
+  Motor::Timer5Counter counter(DIRECTION_PIN);
+
+  // Nothing counts until begin() hands the timer the T5 clock
+  Sim::clockT5(10);
+  counter.begin();
+  CHECK_EQ(counter.read(), 0);
+
+  Sim::clockT5(1000);
+  CHECK_EQ(counter.read(), 1000 * Motor::COUNTS_PER_CYCLE);
+
+  // Cross the 16 bit wrap several times, reading often enough
+  int32_t expected = 1000 * Motor::COUNTS_PER_CYCLE;
+  for (uint32_t i = 0; i < 10; i++)
+  {
+    Sim::clockT5(60000);
+    expected += 60000 * Motor::COUNTS_PER_CYCLE;
+    CHECK_EQ(counter.read(), expected);
+  }
+
+  Sim::setPinInput(DIRECTION_PIN, HIGH);
+  Sim::clockT5(500);
+  CHECK_EQ(counter.read(), expected - 500 * Motor::COUNTS_PER_CYCLE);
+}
+
+/* The hardware counter gives the same rpm as the quadrature one */
+void testMotorTimer5()
+{
+  Sim::reset();
+  Motor::Timer5Counter counter(DIRECTION_PIN);
+  Motor::HBridgePWMEnc motor(22, 23, 11, counter);
+  motor.begin();
+
+  // 3000 rpm is 4200 counts, 1050 cycles, per 10 ms sample
+  for (uint32_t i = 0; i < 50; i++)
+  {
+    Sim::advanceMicros(Motor::RPM_SAMPLE_PERIOD);
+    Sim::clockT5(1050);
+    motor.read();
+  }
+  CHECK_EQ(motor.getRpm(), 3000);
+  CHECK_EQ(motor.getDirection(), 1);
+
+  Sim::setPinInput(DIRECTION_PIN, HIGH);
+  for (uint32_t i = 0; i < 50; i++)
+  {
+    Sim::advanceMicros(Motor::RPM_SAMPLE_PERIOD);
+    Sim::clockT5(1050);
+    motor.read();
+  }
+  CHECK_EQ(motor.getRpm(), 3000);
+  CHECK_EQ(motor.getDirection(), -1);
+}
+
+int main()
+{
+  testCounting();
+  testSlow();
+  testStall();
+  testWrap();
+  testMotorFresh();
+  testTimer5Counter();
+  testMotorTimer5();
+  return CHECK_DONE();
+}
@@ -0,0 +1,179 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "scheduler.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  uint32_t fastRuns = 0;
+  uint32_t slowRuns = 0;
+  /* How long the next run of slow() blocks for */
+  uint32_t slowCost = 0;
+  uint32_t order = 0;
+  uint32_t fastOrder = 0;
+  uint32_t slowOrder = 0;
+
+  void fast()
+  {
+    fastRuns++;
+    fastOrder = ++order;
+  }
+
+  void slow()
+  {
+    slowRuns++;
+    slowOrder = ++order;
+    Sim::advanceMicros(slowCost);
+    slowCost = 0;
+  }
+
+  void resetCounters()
+  {
+    fastRuns = slowRuns = 0;
+    order = fastOrder = slowOrder = 0;
+  }
+
+  /* Drains every task that is due right now */
+  void runAll(Tasks::Scheduler& scheduler)
+  {
+    while (scheduler.run())
+    {
+    }
+  }
+}
+
+/* Releases stay on the original grid even when each start is a bit late */
+void testNoDrift()
+{
+  Sim::reset();
+  resetCounters();
+  Tasks::Task tasks[] = { TASK(fast, 1000, 0) };
+  Tasks::Scheduler scheduler(tasks, 1);
+  scheduler.begin(micros());
+
+  for (uint32_t i = 0; i < 1000; i++)
+  {
+    Sim::advanceMicros(1300);
+    runAll(scheduler);
+  }
+
+  // 1.3 s of time at 1 kHz, each release late by a varying amount
+  CHECK_EQ(tasks[0].release % 1000, 0);
+  CHECK(fastRuns >= 1000);
+  CHECK(fastRuns <= 1301);
+}
+
+/* Higher priority (lower number) wins when both are due */
+void testPriority()
+{
+  Sim::reset();
+  resetCounters();
+  Tasks::Task tasks[] = { TASK(slow, 1000, 1), TASK(fast, 1000, 0) };
+  Tasks::Scheduler scheduler(tasks, 2);
+  scheduler.begin(micros());
+
+  CHECK(scheduler.run());
+  CHECK(scheduler.run());
+  CHECK(!scheduler.run());
+  CHECK_EQ(fastOrder, 1);
+  CHECK_EQ(slowOrder, 2);
+}
+
+/* A task that blocks for several periods counts the releases it skipped */
+void testMissesAndOverruns()
+{
+  Sim::reset();
+  resetCounters();
+  Tasks::Task tasks[] = { TASK(fast, 1000, 0), TASK(slow, 10000, 1) };
+  Tasks::Scheduler scheduler(tasks, 2);
+  scheduler.begin(micros());
+
+  slowCost = 3500;
+  CHECK(scheduler.run());
+  CHECK(scheduler.run());
+  CHECK_EQ(fastRuns, 1);
+  CHECK_EQ(slowRuns, 1);
+  CHECK_EQ(tasks[1].worst, 3500);
+  CHECK_EQ(tasks[1].overruns, 0);
+
+  // fast was blocked from t=1000 to t=3500, so releases at 1000..3000 were missed
+  CHECK(scheduler.run());
+  CHECK_EQ(fastRuns, 2);
+  CHECK_EQ(tasks[0].misses, 2);
+  CHECK_EQ(tasks[0].release, 4000);
+
+  slowCost = 12000;
+  Sim::advanceMicros(10000 - micros());
+  runAll(scheduler);
+  CHECK_EQ(tasks[1].overruns, 1);
+  CHECK_EQ(scheduler.totalOverruns(), 1);
+  CHECK(scheduler.totalMisses() > 2);
+}
+
+/* Lateness is measured from the latest release, not the first one missed */
+void testLateness()
+{
+  Sim::reset();
+  resetCounters();
+  Tasks::Task tasks[] = { TASK(fast, 1000, 0) };
+  Tasks::Scheduler scheduler(tasks, 1);
+  scheduler.begin(micros());
+
+  CHECK(scheduler.run());
+  CHECK_EQ(scheduler.lateness(), 0);
+  Sim::advanceMicros(1030);
+  CHECK(scheduler.run());
+  CHECK_EQ(scheduler.lateness(), 30);
+  Sim::advanceMicros(2500);
+  CHECK(scheduler.run());
+  CHECK_EQ(scheduler.lateness(), 530);
+}
+
+/* Nothing runs early and the deadline test survives the micros() wrap */
+void testWrap()
+{
+  Sim::reset();
+  resetCounters();
+  Sim::advanceMicros(UINT32_MAX - 500);
+  Tasks::Task tasks[] = { TASK(fast, 1000, 0) };
+  Tasks::Scheduler scheduler(tasks, 1);
+  scheduler.begin(micros());
+
+  CHECK(scheduler.run());
+  CHECK(!scheduler.run());
+  Sim::advanceMicros(999);
+  CHECK(!scheduler.run());
+  Sim::advanceMicros(1);
+  CHECK(scheduler.run());
+  CHECK_EQ(tasks[0].misses, 0);
+}
+
+int main()
+{
+  testNoDrift();
+  testPriority();
+  testMissesAndOverruns();
+  testLateness();
+  testWrap();
+  return CHECK_DONE();
+}
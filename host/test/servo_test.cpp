@@ -0,0 +1,167 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <Adafruit_PWMServoDriver.h>
+
+#include "check.h"
+#include "sim.h"
+#include "servoBank.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint32_t OSCILLATOR = 27000000;
+  constexpr uint16_t FREQUENCY = 50;
+
+  /* Same bring-up as the sketch */
+  void start(Actuator::ServoBank& servos)
+  {
+    Sim::reset();
+    Wire.begin();
+    servos.begin(OSCILLATOR, FREQUENCY);
+  }
+
+  /* One count is about 4.9 us at 50 Hz */
+  bool near(uint16_t actual, uint16_t expected)
+  {
+    return actual + 5 >= expected && actual <= expected + 5;
+  }
+}
+
+/* Two channels go out as one short transaction at 400 kHz */
+void testBurst()
+{
+  Actuator::ServoBank servos;
+  start(servos);
+  CHECK_EQ(Wire.clockHz, Actuator::I2C_FAST);
+
+  servos.write(0, 1500);
+  servos.write(1, 1200);
+  CHECK(servos.pending());
+  uint32_t transactions = Wire.transactions;
+  uint32_t bytes = Wire.bytesWritten;
+  uint64_t start = Sim::now();
+  CHECK_EQ(servos.flush(micros()), 2);
+
+  CHECK_EQ(Wire.transactions - transactions, 1);
+  CHECK_EQ(Wire.bytesWritten - bytes, 10);
+  CHECK_EQ(servos.busBytes(), 10);
+  CHECK(Sim::now() - start <= 250);
+  CHECK(near(Sim::servoMicros(0), 1500));
+  CHECK(near(Sim::servoMicros(1), 1200));
+  CHECK_EQ(Sim::servoWrites(), 2);
+  CHECK(!servos.pending());
+  CHECK_EQ(servos.flush(micros()), 0);
+  CHECK_EQ(Wire.transactions - transactions, 1);
+}
+
+/* The driver's own path costs four transactions and far longer for the same update */
+void testDriverCost()
+{
+  Actuator::ServoBank servos;
+  start(servos);
+  Wire.setClock(100000);
+  Adafruit_PWMServoDriver pwm;
+  pwm.setOscillatorFrequency(OSCILLATOR);
+
+  uint32_t transactions = Wire.transactions;
+  uint64_t start = Sim::now();
+  pwm.writeMicroseconds(0, 1500);
+  pwm.writeMicroseconds(1, 1200);
+  CHECK_EQ(Wire.transactions - transactions, 6);
+  CHECK(Sim::now() - start > 1500);
+  CHECK(near(Sim::servoMicros(0), 1500));
+}
+
+/* Small moves are dropped and fast ones held back to the minimum interval */
+void testDeadbandAndRate()
+{
+  Actuator::ServoBank servos;
+  start(servos);
+  servos.configure(0, 4, 20000);
+
+  servos.write(0, 1500);
+  CHECK_EQ(servos.flush(micros()), 1);
+  servos.write(0, 1503);
+  CHECK(!servos.pending());
+
+  servos.write(0, 1600);
+  CHECK(servos.pending());
+  Sim::advanceMicros(10000);
+  CHECK_EQ(servos.flush(micros()), 0);
+  CHECK(near(Sim::servoMicros(0), 1500));
+
+  // The newest width is what goes out once the interval is up
+  servos.write(0, 1650);
+  Sim::advanceMicros(10000);
+  CHECK_EQ(servos.flush(micros()), 1);
+  CHECK(near(Sim::servoMicros(0), 1650));
+
+  // Coming back inside the deadband cancels a held update
+  servos.write(0, 1700);
+  servos.write(0, 1652);
+  CHECK(!servos.pending());
+}
+
+/* A channel between two due ones is sent again unchanged */
+void testGap()
+{
+  Actuator::ServoBank servos;
+  start(servos);
+  servos.write(0, 1000);
+  servos.write(1, 1500);
+  servos.write(2, 2000);
+  servos.flush(micros());
+
+  servos.write(0, 1100);
+  servos.write(2, 1900);
+  uint32_t bytes = servos.busBytes();
+  CHECK_EQ(servos.flush(micros()), 2);
+  CHECK_EQ(servos.busBytes() - bytes, 14);
+  CHECK(near(Sim::servoMicros(0), 1100));
+  CHECK(near(Sim::servoMicros(1), 1500));
+  CHECK(near(Sim::servoMicros(2), 1900));
+}
+
+/* Bytes per second cover the last whole window */
+void testBusRate()
+{
+  Actuator::ServoBank servos;
+  start(servos);
+  servos.configure(0, 0, 20000);
+
+  for (uint16_t i = 0; i < 60; i++)
+  {
+    servos.write(0, i % 2 ? 1000 : 2000);
+    servos.flush(micros());
+    Sim::advanceMicros(20000);
+  }
+  CHECK_EQ(servos.busRate(), 50 * 6);
+}
+
+int main()
+{
+  testBurst();
+  testDriverCost();
+  testDeadbandAndRate();
+  testGap();
+  testBusRate();
+  return CHECK_DONE();
+}
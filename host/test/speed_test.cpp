@@ -0,0 +1,191 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "motor.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint8_t ENCODER_PIN_A = 2;
+  constexpr uint8_t ENCODER_PIN_B = 3;
+  constexpr uint8_t PWM_PIN = 11;
+
+  /*
+   * First order DC motor with a propeller: speed settles towards what
+   * the duty, battery and load allow, with a dead band below which the
+   * shaft does not turn.
+   */
+  struct MotorModel
+  {
+    double rpm = 0;
+    double counts = 0;
+    double voltage = 1.0; // Fraction of a full battery
+    double load = 0; // rpm lost to drag
+    double timeConstant = 0.08; // Seconds
+
+    static constexpr double DEAD_BAND = 10;
+    static constexpr double RPM_PER_DUTY = 300.0 / (255 - DEAD_BAND);
+
+    /* Advance by 1 ms under the duty and direction the sketch is driving */
+    void step(int duty, bool backward)
+    {
+      double drive = duty > DEAD_BAND ? (duty - DEAD_BAND) * RPM_PER_DUTY * voltage : 0;
+      double settle = drive > load ? drive - load : 0;
+      if (backward)
+      {
+        settle = -settle;
+      }
+      rpm += (settle - rpm) * 0.001 / timeConstant;
+
+      double before = counts;
+      counts += rpm * Motor::PULSES_PER_REVOLUTION / 60.0 * 0.001;
+      Sim::moveEncoder(ENCODER_PIN_A, int32_t(counts) - int32_t(before));
+      Sim::advanceMicros(1000);
+    }
+  };
+
+  /* Run motor and control loop together, returns the peak rpm seen */
+  double run(Motor::HBridgePWMEnc& motor, MotorModel& model, uint32_t ms, uint8_t* largestStep = nullptr)
+  {
+    double peak = 0;
+    uint8_t lastDuty = Sim::pwmLevel(PWM_PIN);
+    for (uint32_t i = 0; i < ms; i++)
+    {
+      model.step(Sim::pwmLevel(PWM_PIN), motor.getState() == Motor::BACKWARD);
+      if ((i + 1) % (Motor::RPM_SAMPLE_PERIOD / 1000) == 0)
+      {
+        motor.read();
+        uint8_t duty = Sim::pwmLevel(PWM_PIN);
+        uint8_t step = duty > lastDuty ? duty - lastDuty : lastDuty - duty;
+        if (largestStep && step > *largestStep)
+        {
+          *largestStep = step;
+        }
+        lastDuty = duty;
+      }
+      peak = model.rpm > peak ? model.rpm : peak;
+    }
+    return peak;
+  }
+
+  bool near(double value, double expected, double tolerance)
+  {
+    return value >= expected - tolerance && value <= expected + tolerance;
+  }
+}
+
+/* A step in target settles quickly, without much overshoot, inside the slew limit */
+void testStep()
+{
+  Sim::reset();
+  MotorModel model;
+  Motor::QuadratureCounter encoder(ENCODER_PIN_A, ENCODER_PIN_B);
+  Motor::HBridgePWMEnc motor(22, 23, PWM_PIN, encoder);
+  motor.begin();
+
+  motor.setTargetRpm(Motor::FORWARD, 150);
+  CHECK(motor.isClosedLoop());
+  uint8_t largestStep = 0;
+  double peak = run(motor, model, 1500, &largestStep);
+  CHECK(near(model.rpm, 150, 3));
+  CHECK(peak < 165);
+  CHECK(largestStep <= Motor::DEFAULT_SPEED_GAINS.slew);
+  CHECK(near(motor.getRpm(), 150, 3));
+}
+
+/* Battery sag and drag that pull open loop speed down are made up for */
+void testHoldsUnderLoad()
+{
+  Sim::reset();
+  MotorModel model;
+  Motor::QuadratureCounter encoder(ENCODER_PIN_A, ENCODER_PIN_B);
+  Motor::HBridgePWMEnc motor(22, 23, PWM_PIN, encoder);
+  motor.begin();
+
+  motor.setTargetRpm(Motor::FORWARD, 150);
+  run(motor, model, 1500);
+  uint8_t duty = Sim::pwmLevel(PWM_PIN);
+
+  model.voltage = 0.8;
+  model.load = 20;
+  run(motor, model, 2000);
+  CHECK(near(model.rpm, 150, 3));
+  CHECK(Sim::pwmLevel(PWM_PIN) > duty);
+
+  // The same disturbance open loop, for comparison
+  motor.set(Motor::FORWARD, duty);
+  CHECK(!motor.isClosedLoop());
+  run(motor, model, 2000);
+  CHECK(model.rpm < 120);
+  CHECK_EQ(Sim::pwmLevel(PWM_PIN), duty);
+}
+
+/* Asking for more than the motor can give does not wind the integral up */
+void testAntiWindup()
+{
+  Sim::reset();
+  MotorModel model;
+  Motor::QuadratureCounter encoder(ENCODER_PIN_A, ENCODER_PIN_B);
+  Motor::HBridgePWMEnc motor(22, 23, PWM_PIN, encoder);
+  motor.begin();
+
+  model.voltage = 0.7;
+  motor.setTargetRpm(Motor::FORWARD, 300);
+  run(motor, model, 3000);
+  CHECK_EQ(Sim::pwmLevel(PWM_PIN), 255);
+
+  motor.setTargetRpm(Motor::FORWARD, 100);
+  run(motor, model, 1000);
+  CHECK(near(model.rpm, 100, 3));
+}
+
+/* Reversing drops the duty and brings the shaft round to the new direction */
+void testReverse()
+{
+  Sim::reset();
+  MotorModel model;
+  Motor::QuadratureCounter encoder(ENCODER_PIN_A, ENCODER_PIN_B);
+  Motor::HBridgePWMEnc motor(22, 23, PWM_PIN, encoder);
+  motor.begin();
+
+  motor.setTargetRpm(Motor::FORWARD, 120);
+  run(motor, model, 1500);
+  motor.setTargetRpm(Motor::BACKWARD, 120);
+  CHECK_EQ(Sim::pwmLevel(PWM_PIN), 0);
+  run(motor, model, 2500);
+  CHECK(near(model.rpm, -120, 3));
+  CHECK_EQ(motor.getDirection(), -1);
+
+  motor.setTargetRpm(Motor::COAST, 120);
+  CHECK(!motor.isClosedLoop());
+  CHECK_EQ(motor.getTargetRpm(), 0);
+  CHECK_EQ(Sim::pwmLevel(PWM_PIN), 0);
+}
+
+int main()
+{
+  testStep();
+  testHoldsUnderLoad();
+  testAntiWindup();
+  testReverse();
+  return CHECK_DONE();
+}
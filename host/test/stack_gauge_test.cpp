@@ -0,0 +1,119 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "sketch.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  /* Polls until a pass reports, returning how many it took, 0 if none did */
+  uint16_t pass(Memory::StackGauge& gauge)
+  {
+    for (uint16_t polls = 1; polls < 1000; polls++)
+    {
+      if (gauge.poll())
+      {
+        return polls;
+      }
+    }
+    return 0;
+  }
+}
+
+/* Static data, peak and margin add up to the whole of SRAM */
+void testFigures()
+{
+  Sim::reset();
+  Sim::setStaticRam(3000);
+  Sim::setStackDepth(200);
+  Memory::StackGauge gauge;
+  gauge.begin();
+
+  uint16_t polls = pass(gauge);
+  CHECK(polls > 0);
+  CHECK(polls <= (Sim::RAM_SIZE - 3000 - 200) / Memory::SCAN_STEP + 1);
+  CHECK_EQ(gauge.staticBytes(), 3000);
+  CHECK_EQ(gauge.stackPeak(), 200);
+  CHECK_EQ(gauge.margin(), Sim::RAM_SIZE - 3000 - 200);
+
+  // Nothing new, nothing to report
+  CHECK_EQ(pass(gauge), 0);
+}
+
+/* A deep call that has since returned still counts */
+void testHighWaterMark()
+{
+  Sim::reset();
+  Sim::setStackDepth(100);
+  Memory::StackGauge gauge;
+  gauge.begin();
+  pass(gauge);
+
+  Sim::setStackDepth(700);
+  Sim::setStackDepth(100);
+  CHECK(pass(gauge) > 0);
+  CHECK_EQ(gauge.stackPeak(), 700);
+  CHECK_EQ(gauge.margin(), Sim::RAM_SIZE - Sim::DEFAULT_STATIC_RAM - 700);
+}
+
+/* The scan stops at the stack pointer rather than reading live frames */
+void testLiveFrames()
+{
+  Sim::reset();
+  Memory::StackGauge gauge;
+  gauge.begin();
+
+  // A live frame that happens to hold PAINT is not counted as free
+  Sim::setStackDepth(64);
+  Sim::sram[Sim::RAM_SIZE - 1] = Memory::PAINT;
+  CHECK(pass(gauge) > 0);
+  CHECK_EQ(gauge.stackPeak(), 64);
+}
+
+/* The sketch paints in setup() and reports through its task */
+void testSketch()
+{
+  Sim::reset();
+  Sim::setStaticRam(2500);
+  setup();
+  Sim::setStackDepth(300);
+  for (uint32_t step = 0; step < 2000; step++)
+  {
+    for (uint8_t i = 0; i < 8; i++)
+    {
+      loop();
+    }
+    Sim::advanceMicros(500);
+  }
+  CHECK_EQ(stackGauge.staticBytes(), 2500);
+  CHECK_EQ(stackGauge.stackPeak(), 300);
+  CHECK_EQ(stackGauge.margin(), Sim::RAM_SIZE - 2500 - 300);
+}
+
+int main()
+{
+  testFigures();
+  testHighWaterMark();
+  testLiveFrames();
+  testSketch();
+  return CHECK_DONE();
+}
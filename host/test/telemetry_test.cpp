@@ -0,0 +1,145 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "sim.h"
+#include "output.h"
+
+CHECK_MAIN;
+
+namespace
+{
+  constexpr uint8_t SENSOR_UART = 3;
+
+  void poll(uint8_t command)
+  {
+    uint8_t message[4] = { 0x04, command, 0, 0 };
+    uint16_t checksum = 0xFFFF - 0x04 - command;
+    message[2] = uint8_t(checksum);
+    message[3] = uint8_t(checksum >> 8);
+    Sim::advanceMillis(10);
+    Sim::uartReceive(SENSOR_UART, message, sizeof(message));
+  }
+
+  std::vector<uint8_t> reply()
+  {
+    Sim::service();
+    std::vector<uint8_t> sent = Sim::uartTransmitted(SENSOR_UART);
+    Sim::clearUartTransmitted(SENSOR_UART);
+    return sent;
+  }
+
+  /* Value the receiver gets back for a sensor, registered in table order */
+  int32_t polled(Data::SensorId sensor)
+  {
+    poll(IBus::COMMAND_VALUE | (sensor + 1));
+    std::vector<uint8_t> sent = reply();
+    int32_t value = sent[2] | sent[3] << 8;
+    if (sent.size() == 8)
+    {
+      value |= int32_t(sent[4]) << 16 | int32_t(sent[5]) << 24;
+    }
+    return value;
+  }
+}
+
+/* Every table entry is registered with its type and width, in order */
+void testRegistry()
+{
+  Sim::reset();
+  Data::Output output;
+  output.Begin();
+
+  const uint8_t types[] = { 0x7E, 0x02, 0x41, 0x03, 0x08, 0x7C, 0x7D, 0x83, 0x14, 0x0A };
+  CHECK_EQ(sizeof(types), Data::NUM_SENSORS);
+  for (uint8_t i = 0; i < Data::NUM_SENSORS; i++)
+  {
+    poll(IBus::COMMAND_TYPE | (i + 1));
+    std::vector<uint8_t> sent = reply();
+    CHECK_EQ(sent.size(), 6);
+    CHECK_EQ(sent[2], types[i]);
+    CHECK_EQ(sent[3], i == Data::PRESSURE_SENSOR || i == Data::DEPTH_SENSOR ? 4 : 2);
+  }
+}
+
+/* Sources are scaled into the units the transmitter shows */
+void testScaling()
+{
+  Sim::reset();
+  Data::Output output;
+  output.Begin();
+
+  output.Set(Data::SPEED_SENSOR, 1000); // 1 m/s is 3.6 km/h
+  output.Set(Data::VOLTAGE_SENSOR, 12345);
+  output.Set(Data::PRESSURE_SENSOR, 101325);
+  output.Set(Data::RPM_SENSOR, 70000);
+  output.Set(Data::HEADING_SENSOR, -5);
+  output.Set(Data::DEPTH_SENSOR, -1234); // 1.234 m down
+
+  CHECK_EQ(polled(Data::SPEED_SENSOR), 360);
+  CHECK_EQ(polled(Data::VOLTAGE_SENSOR), 1235);
+  CHECK_EQ(polled(Data::PRESSURE_SENSOR), 101325);
+  CHECK_EQ(polled(Data::RPM_SENSOR), UINT16_MAX);
+  CHECK_EQ(polled(Data::HEADING_SENSOR), 0);
+  CHECK_EQ(polled(Data::DEPTH_SENSOR), -123);
+  CHECK_EQ(output.Reported(Data::SPEED_SENSOR), 360);
+}
+
+/* Unchanged values are left alone and a busy reply is retried on the next Set() */
+void testChangeOnly()
+{
+  Sim::reset();
+  Data::Output output;
+  output.Begin();
+  output.Set(Data::RPM_SENSOR, 100);
+
+  // Reply to this poll is queued from the live buffer but not yet sent
+  poll(IBus::COMMAND_VALUE | (Data::RPM_SENSOR + 1));
+  output.Set(Data::RPM_SENSOR, 100);
+  output.Set(Data::RPM_SENSOR, 200);
+  CHECK_EQ(output.Reported(Data::RPM_SENSOR), 200);
+  output.Set(Data::RPM_SENSOR, 300);
+  CHECK_EQ(output.Reported(Data::RPM_SENSOR), 200);
+
+  std::vector<uint8_t> sent = reply();
+  CHECK_EQ(sent[2] | sent[3] << 8, 100);
+  output.Set(Data::RPM_SENSOR, 300);
+  CHECK_EQ(output.Reported(Data::RPM_SENSOR), 300);
+  CHECK_EQ(polled(Data::RPM_SENSOR), 300);
+}
+
+/* Loop stats land in their two slots */
+void testLoopStats()
+{
+  Sim::reset();
+  Data::Output output;
+  output.Begin();
+  output.SetLoopStats(1234, 100000);
+  CHECK_EQ(polled(Data::LOOP_TIME_SENSOR), 1234);
+  CHECK_EQ(polled(Data::OVERRUNS_SENSOR), UINT16_MAX);
+}
+
+int main()
+{
+  testRegistry();
+  testScaling();
+  testChangeOnly();
+  testLoopStats();
+  return CHECK_DONE();
+}
@@ -0,0 +1,385 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avrReport.h"
+
+namespace
+{
+  const char BENCH[] = "BENCH ";
+  const char DONE[] = "BENCH_DONE";
+
+  std::vector<std::string> lines(const std::string& text)
+  {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start < text.size())
+    {
+      size_t end = text.find('\n', start);
+      end = end == std::string::npos ? text.size() : end;
+      out.push_back(text.substr(start, end - start));
+      start = end + 1;
+    }
+    return out;
+  }
+
+  /* Whitespace separated words, stopping at a terminal escape code */
+  std::vector<std::string> words(const std::string& line)
+  {
+    std::vector<std::string> out;
+    std::string word;
+    for (char c : line)
+    {
+      if (c == '\x1b')
+      {
+        break;
+      }
+      if (c == ' ' || c == '\t' || c == '\r')
+      {
+        if (!word.empty())
+        {
+          out.push_back(word);
+          word.clear();
+        }
+      }
+      else
+      {
+        word += c;
+      }
+    }
+    if (!word.empty())
+    {
+      out.push_back(word);
+    }
+    return out;
+  }
+
+  /* The rest of a line after its first count words */
+  std::string afterWords(const std::string& line, uint8_t count)
+  {
+    size_t at = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+      at = line.find_first_not_of(' ', at);
+      at = line.find(' ', at);
+      if (at == std::string::npos)
+      {
+        return std::string();
+      }
+    }
+    size_t start = line.find_first_not_of(' ', at);
+    return start == std::string::npos ? std::string() : line.substr(start);
+  }
+
+  bool number(const std::string& text, uint32_t& value, int base = 10)
+  {
+    char* end;
+    value = strtoul(text.c_str(), &end, base);
+    return !text.empty() && *end == '\0';
+  }
+
+  /*
+   * A function's name from its signature, without return type or
+   * arguments: "virtual void Motor::HBridge::forward()" gives
+   * "Motor::HBridge::forward". Spaces inside template arguments stay.
+   */
+  std::string functionName(const std::string& signature)
+  {
+    size_t end = 0;
+    int depth = 0;
+    while (end < signature.size() && !(signature[end] == '(' && depth == 0))
+    {
+      depth += signature[end] == '<' ? 1 : signature[end] == '>' ? -1 : 0;
+      end++;
+    }
+    size_t start = end;
+    while (start > 0)
+    {
+      char c = signature[start - 1];
+      depth += c == '>' ? 1 : c == '<' ? -1 : 0;
+      if (c == ' ' && depth == 0)
+      {
+        break;
+      }
+      start--;
+    }
+    return signature.substr(start, end - start);
+  }
+
+  void keepLargest(AvrReport::Sizes& sizes, const std::string& name, uint32_t size)
+  {
+    AvrReport::Sizes::iterator found = sizes.find(name);
+    if (found == sizes.end() || found->second < size)
+    {
+      sizes[name] = size;
+    }
+  }
+
+  std::string signedChange(int32_t change)
+  {
+    char text[16];
+    if (change == 0)
+    {
+      return "=";
+    }
+    snprintf(text, sizeof(text), "%+ld", (long)change);
+    return text;
+  }
+}
+
+bool AvrReport::parseRun(const std::string& output, std::vector<Result>& results)
+{
+  results.clear();
+  bool done = false;
+  for (const std::string& line : lines(output))
+  {
+    if (line.find(DONE) != std::string::npos)
+    {
+      done = true;
+      continue;
+    }
+    size_t found = line.find(BENCH);
+    if (found == std::string::npos)
+    {
+      continue;
+    }
+    std::vector<std::string> fields = words(line.substr(found + strlen(BENCH)));
+    Result result = Result();
+    if (fields.size() != 5 || !number(fields[1], result.min) || !number(fields[2], result.mean) || !number(fields[3], result.max))
+    {
+      continue;
+    }
+    result.name = fields[0];
+    result.symbols = fields[4];
+    results.push_back(result);
+  }
+  return done;
+}
+
+AvrReport::Sizes AvrReport::parseSymbols(const std::string& nm)
+{
+  // address size type name, where name runs to the end of the line
+  Sizes sizes;
+  for (const std::string& line : lines(nm))
+  {
+    std::vector<std::string> fields = words(line);
+    uint32_t size;
+    if (fields.size() < 4 || fields[2].size() != 1 || !number(fields[1], size, 16))
+    {
+      continue;
+    }
+    char type = fields[2][0];
+    if (type != 'T' && type != 't' && type != 'W' && type != 'w')
+    {
+      continue;
+    }
+    keepLargest(sizes, functionName(afterWords(line, 3)), size);
+  }
+  return sizes;
+}
+
+AvrReport::Sizes AvrReport::parseStack(const std::string& su)
+{
+  // file:line:column:signature <tab> bytes <tab> static|dynamic|bounded
+  Sizes sizes;
+  for (const std::string& line : lines(su))
+  {
+    size_t tab = line.find('\t');
+    if (tab == std::string::npos)
+    {
+      continue;
+    }
+    std::string location = line.substr(0, tab);
+    size_t signature = std::string::npos;
+    uint8_t numbers = 0;
+    for (size_t i = 0; i < location.size() && signature == std::string::npos; i++)
+    {
+      if (location[i] != ':')
+      {
+        continue;
+      }
+      size_t digits = i + 1;
+      while (digits < location.size() && location[digits] >= '0' && location[digits] <= '9')
+      {
+        digits++;
+      }
+      bool isNumber = digits > i + 1 && digits < location.size() && location[digits] == ':';
+      numbers = isNumber ? numbers + 1 : 0;
+      if (numbers == 2)
+      {
+        signature = digits + 1;
+      }
+      else if (isNumber)
+      {
+        i = digits - 1;
+      }
+    }
+    uint32_t bytes = strtoul(line.c_str() + tab + 1, nullptr, 10);
+    if (signature != std::string::npos)
+    {
+      keepLargest(sizes, functionName(location.substr(signature)), bytes);
+    }
+  }
+  return sizes;
+}
+
+void AvrReport::size(std::vector<Result>& results, const Sizes& symbols, const Sizes& stack)
+{
+  for (Result& result : results)
+  {
+    result.flash = 0;
+    result.stack = 0;
+    result.missing.clear();
+    size_t start = 0;
+    while (start <= result.symbols.size())
+    {
+      size_t end = result.symbols.find('+', start);
+      end = end == std::string::npos ? result.symbols.size() : end;
+      std::string name = result.symbols.substr(start, end - start);
+      Sizes::const_iterator code = symbols.find(name);
+      Sizes::const_iterator frame = stack.find(name);
+      if (code == symbols.end())
+      {
+        result.missing.push_back(name);
+      }
+      else
+      {
+        result.flash += code->second;
+      }
+      result.stack += frame == stack.end() ? 0 : frame->second;
+      start = end + 1;
+    }
+  }
+}
+
+bool AvrReport::parseBaseline(const std::string& text, std::vector<Result>& baseline)
+{
+  baseline.clear();
+  for (const std::string& line : lines(text))
+  {
+    std::vector<std::string> fields = words(line.substr(0, line.find('#')));
+    if (fields.empty())
+    {
+      continue;
+    }
+    Result result = Result();
+    if (fields.size() != 6 || !number(fields[1], result.min) || !number(fields[2], result.mean) || !number(fields[3], result.max)
+      || !number(fields[4], result.flash) || !number(fields[5], result.stack))
+    {
+      return false;
+    }
+    result.name = fields[0];
+    baseline.push_back(result);
+  }
+  return true;
+}
+
+std::string AvrReport::formatBaseline(const std::vector<Result>& results)
+{
+  std::string text = "# avr_bench on the ATmega2560 at 16 MHz: name min mean max (cycles) flash stack (bytes)\n";
+  char line[128];
+  for (const Result& result : results)
+  {
+    snprintf(line, sizeof(line), "%s %lu %lu %lu %lu %lu\n", result.name.c_str(), (unsigned long)result.min,
+      (unsigned long)result.mean, (unsigned long)result.max, (unsigned long)result.flash, (unsigned long)result.stack);
+    text += line;
+  }
+  return text;
+}
+
+std::string AvrReport::formatReport(const std::vector<Result>& results, const std::vector<Result>& baseline)
+{
+  char line[160];
+  snprintf(line, sizeof(line), "%-22s %7s %7s %7s %8s %12s %10s\n", "benchmark", "min", "mean", "max", "change", "flash", "stack");
+  std::string text = line;
+  std::string notes;
+  for (const Result& result : results)
+  {
+    const Result* before = nullptr;
+    for (const Result& old : baseline)
+    {
+      before = old.name == result.name ? &old : before;
+    }
+    std::string change = baseline.empty() ? "-" : "new";
+    std::string flash = std::to_string(result.flash);
+    std::string stack = std::to_string(result.stack);
+    if (before)
+    {
+      change = signedChange(int32_t(result.mean - before->mean));
+      flash += " (" + signedChange(int32_t(result.flash - before->flash)) + ")";
+      stack += " (" + signedChange(int32_t(result.stack - before->stack)) + ")";
+    }
+    snprintf(line, sizeof(line), "%-22s %7lu %7lu %7lu %8s %12s %10s\n", result.name.c_str(), (unsigned long)result.min,
+      (unsigned long)result.mean, (unsigned long)result.max, change.c_str(), flash.c_str(), stack.c_str());
+    text += line;
+    for (const std::string& name : result.missing)
+    {
+      notes += result.name + ": no symbol " + name + "\n";
+    }
+  }
+  return text + notes;
+}
+
+bool AvrReport::parseSections(const std::string& size, Memory& memory)
+{
+  // section size address, after a line naming the file and the column headings
+  memory = Memory();
+  bool data = false;
+  bool bss = false;
+  for (const std::string& line : lines(size))
+  {
+    std::vector<std::string> fields = words(line);
+    uint32_t bytes;
+    if (fields.size() != 3 || !number(fields[1], bytes))
+    {
+      continue;
+    }
+    if (fields[0] == ".data")
+    {
+      memory.data = bytes;
+      data = true;
+    }
+    else if (fields[0] == ".bss")
+    {
+      memory.bss = bytes;
+      bss = true;
+    }
+    else if (fields[0] == ".noinit")
+    {
+      memory.noinit = bytes;
+    }
+  }
+  return data && bss;
+}
+
+std::string AvrReport::formatMemory(const Memory& memory, uint32_t ram)
+{
+  char text[256];
+  uint32_t used = memory.data + memory.bss + memory.noinit;
+  int32_t left = int32_t(ram - used);
+  snprintf(text, sizeof(text),
+    "static RAM: .data %lu + .bss %lu + .noinit %lu = %lu of %lu bytes\n"
+    "left for the stack: %ld bytes (%ld%%)\n",
+    (unsigned long)memory.data, (unsigned long)memory.bss, (unsigned long)memory.noinit,
+    (unsigned long)used, (unsigned long)ram, (long)left, (long)(left * 100 / int32_t(ram)));
+  return text;
+}
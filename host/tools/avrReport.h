@@ -0,0 +1,130 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * avrReport.h - Reads avr_bench results and shows them against a baseline.
+ *
+ * avr_bench runs on a simulated Mega and prints one line per benchmark,
+ *   BENCH name min mean max symbols
+ * in cycles, then BENCH_DONE once all have run. Flash comes from avr-nm
+ * -C --print-size and stack from the .su files -fstack-usage writes.
+ * Each benchmark's flash and stack are those of the functions in its
+ * symbols, added up. When they call each other that stack total is the
+ * deepest the call goes.
+ *
+ * A baseline is the same numbers saved as text, one benchmark a line,
+ *   name min mean max flash stack
+ * with # starting a comment.
+ *
+ * The sketch's static RAM comes from avr-size -A on its image: .data,
+ * .bss and .noinit sit at the bottom of SRAM and the rest is left to
+ * the stack, which StackGauge measures at run time.
+ */
+
+#ifndef avrReport_h
+#define avrReport_h
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace AvrReport
+{
+  /* One benchmark, cycles at 16 MHz and sizes in bytes */
+  struct Result
+  {
+    std::string name;
+    uint32_t min;
+    uint32_t mean;
+    uint32_t max;
+    uint32_t flash;
+    uint32_t stack;
+    /* Functions to size it by, joined with '+' */
+    std::string symbols;
+    /* Functions in symbols that were not found */
+    std::vector<std::string> missing;
+  };
+
+  /* Static data of an image in bytes, by section */
+  struct Memory
+  {
+    uint32_t data;
+    uint32_t bss;
+    uint32_t noinit;
+  };
+
+  /* SRAM on the ATmega2560 */
+  static constexpr uint32_t MEGA_RAM = 8192;
+
+  /* Function name without its arguments, to size in bytes */
+  typedef std::map<std::string, uint32_t> Sizes;
+
+  /*
+   * Pull the BENCH lines out of the simulator's output
+   * @param output Everything the simulator printed
+   * @param results Benchmarks in the order they ran
+   * @return false if the run stopped before BENCH_DONE
+   */
+  bool parseRun(const std::string& output, std::vector<Result>& results);
+
+  /*
+   * Code size of each function
+   * @param nm Output of avr-nm -C --print-size
+   */
+  Sizes parseSymbols(const std::string& nm);
+
+  /*
+   * Stack frame of each function
+   * @param su .su files from -fstack-usage, one after the other
+   */
+  Sizes parseStack(const std::string& su);
+
+  /*
+   * Fill in flash and stack for each result from its symbols
+   */
+  void size(std::vector<Result>& results, const Sizes& symbols, const Sizes& stack);
+
+  /*
+   * Read a baseline
+   * @return false if a line does not parse
+   */
+  bool parseBaseline(const std::string& text, std::vector<Result>& baseline);
+
+  std::string formatBaseline(const std::vector<Result>& results);
+
+  /*
+   * Results as a table, with the change in mean cycles, flash and
+   * stack against the baseline for those it has. With no baseline at
+   * all the change column is left blank rather than calling every
+   * benchmark new.
+   */
+  std::string formatReport(const std::vector<Result>& results, const std::vector<Result>& baseline);
+
+  /*
+   * Static data from avr-size -A
+   * @return false if there is no .data or no .bss section
+   */
+  bool parseSections(const std::string& size, Memory& memory);
+
+  /* Static data by section, and what it leaves of ram for the stack */
+  std::string formatMemory(const Memory& memory, uint32_t ram = MEGA_RAM);
+}
+
+#endif
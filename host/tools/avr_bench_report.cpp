@@ -0,0 +1,127 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * avr_bench_report - Cycles, flash and stack of the hot paths on the Mega.
+ *
+ * Reads what the avr_bench target collects from a simavr run of
+ * host/avr/avr_bench.cpp and prints it as a table, with the change
+ * against the baseline for each benchmark it has. Without a baseline it
+ * says so and shows no change. Exits 1 if the run is incomplete or a
+ * result file cannot be read.
+ *
+ * usage: avr_bench_report [--update] baseline run.out symbols.txt [stack.su]
+ *
+ * --update writes the results as the new baseline, after a change whose
+ * cost has been looked at and accepted.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "avrReport.h"
+
+namespace
+{
+  bool readFile(const char* path, std::string& text)
+  {
+    FILE* in = fopen(path, "r");
+    if (!in)
+    {
+      return false;
+    }
+    text.clear();
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    {
+      text.append(buffer, read);
+    }
+    fclose(in);
+    return true;
+  }
+
+  bool writeFile(const char* path, const std::string& text)
+  {
+    FILE* out = fopen(path, "w");
+    if (!out)
+    {
+      return false;
+    }
+    bool written = fwrite(text.data(), 1, text.size(), out) == text.size();
+    return fclose(out) == 0 && written;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  int first = 1;
+  bool update = argc > 1 && strcmp(argv[1], "--update") == 0;
+  first += update ? 1 : 0;
+  if (argc - first < 3 || argc - first > 4)
+  {
+    fprintf(stderr, "usage: avr_bench_report [--update] baseline run.out symbols.txt [stack.su]\n");
+    return 2;
+  }
+  const char* baselinePath = argv[first];
+
+  std::string run;
+  std::string symbols;
+  std::string stack;
+  for (int i = first + 1; i < argc; i++)
+  {
+    if (!readFile(argv[i], i == first + 1 ? run : i == first + 2 ? symbols : stack))
+    {
+      perror(argv[i]);
+      return 1;
+    }
+  }
+
+  std::vector<AvrReport::Result> results;
+  bool complete = AvrReport::parseRun(run, results);
+  if (!complete || results.empty())
+  {
+    fprintf(stderr, "%s: run did not finish, %zu benchmark(s) reported\n", argv[first + 1], results.size());
+    return 1;
+  }
+  AvrReport::size(results, AvrReport::parseSymbols(symbols), AvrReport::parseStack(stack));
+
+  std::vector<AvrReport::Result> baseline;
+  std::string saved;
+  if (!update)
+  {
+    if (!readFile(baselinePath, saved))
+    {
+      printf("%s: no baseline, build avr_bench_baseline once to save this run as one\n", baselinePath);
+    }
+    else if (!AvrReport::parseBaseline(saved, baseline))
+    {
+      fprintf(stderr, "%s: not a baseline\n", baselinePath);
+      return 1;
+    }
+  }
+  printf("%s", AvrReport::formatReport(results, baseline).c_str());
+
+  if (update && !writeFile(baselinePath, AvrReport::formatBaseline(results)))
+  {
+    perror(baselinePath);
+    return 1;
+  }
+  return 0;
+}
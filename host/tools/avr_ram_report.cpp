@@ -0,0 +1,67 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * avr_ram_report - Static RAM of the sketch on the Mega.
+ *
+ * Reads avr-size -A of the sketch's image, as the avr_ram target
+ * collects it, and prints the .data, .bss and .noinit bytes and what
+ * they leave of the 8 KB for the stack. The stack's actual peak only
+ * shows at run time, in the checkMemory task's log. Exits 1 if the file
+ * cannot be read or is not avr-size output.
+ *
+ * usage: avr_ram_report size.txt
+ */
+
+#include <stdio.h>
+
+#include "avrReport.h"
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: avr_ram_report size.txt\n");
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "r");
+  if (!in)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  std::string text;
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+  {
+    text.append(buffer, read);
+  }
+  fclose(in);
+
+  AvrReport::Memory memory;
+  if (!AvrReport::parseSections(text, memory))
+  {
+    fprintf(stderr, "%s: no .data and .bss sections\n", argv[1]);
+    return 1;
+  }
+  printf("%s", AvrReport::formatMemory(memory).c_str());
+  return 0;
+}
@@ -0,0 +1,294 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ibusReplay.h"
+#include "sim.h"
+#include "sketch.h"
+
+namespace
+{
+  const char MAGIC[] = "IBUSCAP";
+  constexpr size_t MAGIC_LENGTH = sizeof(MAGIC) - 1;
+  constexpr size_t HEADER_LENGTH = MAGIC_LENGTH + 1 + 4;
+
+  /* The receiver's servo output is wired to USART2 */
+  constexpr uint8_t SERVO_UART = 2;
+
+  const char* const DIRECTIONS[] = { "coast", "stop", "forward", "backward" };
+
+  void putLong(std::vector<uint8_t>& out, uint32_t value)
+  {
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      out.push_back(uint8_t(value >> (8 * i)));
+    }
+  }
+
+  uint32_t getLong(const uint8_t* in)
+  {
+    return uint32_t(in[0]) | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16 | uint32_t(in[3]) << 24;
+  }
+
+  /* Time one byte takes on the wire, 8N1 */
+  uint32_t byteTime(uint32_t baud)
+  {
+    return (10 * 1000000 + baud / 2) / baud;
+  }
+
+  const char* pumpState()
+  {
+    uint8_t in1 = Sim::pinLevel(WATER_PUMP_INPUT_1);
+    uint8_t in2 = Sim::pinLevel(WATER_PUMP_INPUT_2);
+    return in1 == in2 ? "off" : in1 ? "forward" : "backward";
+  }
+
+  /* Everything the sketch drives, as one line without the time */
+  std::string outputs()
+  {
+    char line[128];
+    uint8_t direction = engine.getState();
+    snprintf(line, sizeof(line), "engine=%s pwm=%d rudder=%u plane=%u solenoid=%u pump=%s",
+      direction < 4 ? DIRECTIONS[direction] : "?", Sim::pwmLevel(ENGINE_PWM),
+      Sim::servoMicros(RUDDER), Sim::servoMicros(DIVE_PLANE),
+      Sim::pinLevel(WATER_SOLENOID_PIN), pumpState());
+    return line;
+  }
+}
+
+uint32_t Replay::Capture::duration() const
+{
+  if (bursts.empty())
+  {
+    return 0;
+  }
+  const Burst& last = bursts.back();
+  return last.at + uint32_t(last.bytes.size()) * byteTime(baud);
+}
+
+std::vector<uint8_t> Replay::serialize(const Capture& capture)
+{
+  std::vector<uint8_t> out(MAGIC, MAGIC + MAGIC_LENGTH);
+  out.push_back(FORMAT_VERSION);
+  putLong(out, capture.baud);
+  for (const Burst& burst : capture.bursts)
+  {
+    // Longer bursts are split, the pieces timed as if back to back
+    for (size_t done = 0; done < burst.bytes.size(); done += 255)
+    {
+      size_t length = burst.bytes.size() - done < 255 ? burst.bytes.size() - done : 255;
+      putLong(out, burst.at + uint32_t(done) * byteTime(capture.baud));
+      out.push_back(uint8_t(length));
+      out.insert(out.end(), burst.bytes.begin() + done, burst.bytes.begin() + done + length);
+    }
+  }
+  return out;
+}
+
+bool Replay::parse(const std::vector<uint8_t>& data, Capture& capture)
+{
+  if (data.size() < HEADER_LENGTH || memcmp(data.data(), MAGIC, MAGIC_LENGTH) != 0 || data[MAGIC_LENGTH] != FORMAT_VERSION)
+  {
+    return false;
+  }
+  capture.baud = getLong(&data[MAGIC_LENGTH + 1]);
+  capture.bursts.clear();
+  if (capture.baud == 0)
+  {
+    return false;
+  }
+
+  size_t pos = HEADER_LENGTH;
+  while (pos < data.size())
+  {
+    if (pos + 5 > data.size() || pos + 5 + data[pos + 4] > data.size())
+    {
+      return false;
+    }
+    Burst burst;
+    burst.at = getLong(&data[pos]);
+    burst.bytes.assign(data.begin() + pos + 5, data.begin() + pos + 5 + data[pos + 4]);
+    capture.bursts.push_back(burst);
+    pos += 5 + data[pos + 4];
+  }
+  return true;
+}
+
+bool Replay::load(const std::string& path, Capture& capture)
+{
+  FILE* in = fopen(path.c_str(), "rb");
+  if (!in)
+  {
+    return false;
+  }
+  std::vector<uint8_t> data;
+  int c;
+  while ((c = fgetc(in)) != EOF)
+  {
+    data.push_back(uint8_t(c));
+  }
+  fclose(in);
+  return parse(data, capture);
+}
+
+bool Replay::save(const std::string& path, const Capture& capture)
+{
+  FILE* out = fopen(path.c_str(), "wb");
+  if (!out)
+  {
+    return false;
+  }
+  std::vector<uint8_t> data = serialize(capture);
+  bool written = fwrite(data.data(), 1, data.size(), out) == data.size();
+  return fclose(out) == 0 && written;
+}
+
+void Replay::addFrame(Capture& capture, uint32_t at)
+{
+  uint8_t frame[Sim::IBUS_FRAME_LENGTH];
+  Sim::encodeFrame(frame);
+  capture.bursts.push_back(Burst{ at, std::vector<uint8_t>(frame, frame + sizeof(frame)) });
+}
+
+namespace
+{
+  /* The replay itself, in whichever process is running it */
+  std::vector<std::string> replay(const Replay::Capture& capture, const Replay::Options& options)
+  {
+    Sim::reset();
+    Sim::setAnalog(Data::BATTERY_PIN, options.battery);
+    setup();
+
+    std::vector<std::string> trace;
+    std::string last;
+    uint32_t start = micros();
+    uint32_t perByte = byteTime(capture.baud);
+    uint32_t end = capture.duration() + options.tail;
+    size_t burst = 0;
+    size_t next = 0;
+    // Bytes are due by the sketch's own clock, which also moves while it runs
+    for (uint32_t now = 0; now <= end; now = micros() - start)
+    {
+      // Every byte due by now goes in, a byte time apart
+      while (burst < capture.bursts.size() && capture.bursts[burst].at + next * perByte <= now)
+      {
+        Sim::uartReceive(SERVO_UART, &capture.bursts[burst].bytes[next], 1);
+        if (++next == capture.bursts[burst].bytes.size())
+        {
+          burst++;
+          next = 0;
+        }
+      }
+
+      for (uint8_t i = 0; i < options.loops; i++)
+      {
+        loop();
+      }
+
+      std::string state = outputs();
+      if (state != last)
+      {
+        char time[16];
+        snprintf(time, sizeof(time), "%10lu ", (unsigned long)now);
+        trace.push_back(time + state);
+        last = state;
+      }
+      Sim::advanceMicros(options.step);
+    }
+    return trace;
+  }
+}
+
+bool Replay::run(const Capture& capture, std::vector<std::string>& trace, const Options& options)
+{
+  trace.clear();
+  int pipeEnds[2];
+  if (pipe(pipeEnds) != 0)
+  {
+    return false;
+  }
+
+  pid_t child = fork();
+  if (child < 0)
+  {
+    close(pipeEnds[0]);
+    close(pipeEnds[1]);
+    return false;
+  }
+  if (child == 0)
+  {
+    close(pipeEnds[0]);
+    FILE* out = fdopen(pipeEnds[1], "w");
+    if (!out)
+    {
+      _exit(1);
+    }
+    for (const std::string& line : replay(capture, options))
+    {
+      fprintf(out, "%s\n", line.c_str());
+    }
+    _exit(fclose(out) == 0 ? 0 : 1);
+  }
+
+  close(pipeEnds[1]);
+  FILE* in = fdopen(pipeEnds[0], "r");
+  if (in)
+  {
+    char line[256];
+    while (fgets(line, sizeof(line), in))
+    {
+      trace.push_back(std::string(line, strcspn(line, "\n")));
+    }
+    fclose(in);
+  }
+  else
+  {
+    close(pipeEnds[0]);
+  }
+
+  // A child that crashed part way leaves a trace that is only a prefix
+  int status;
+  if (waitpid(child, &status, 0) != child)
+  {
+    return false;
+  }
+  return in && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+std::string Replay::diff(const std::vector<std::string>& expected, const std::vector<std::string>& actual, size_t limit)
+{
+  std::string text;
+  size_t shown = 0;
+  size_t lines = expected.size() > actual.size() ? expected.size() : actual.size();
+  for (size_t i = 0; i < lines && shown < limit; i++)
+  {
+    const std::string& want = i < expected.size() ? expected[i] : std::string("(end)");
+    const std::string& got = i < actual.size() ? actual[i] : std::string("(end)");
+    if (want != got)
+    {
+      text += "line " + std::to_string(i + 1) + "\n- " + want + "\n+ " + got + "\n";
+      shown++;
+    }
+  }
+  return text;
+}
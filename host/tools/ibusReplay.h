@@ -0,0 +1,114 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ibusReplay.h - Captured iBus streams played back through the sketch.
+ *
+ * A capture is what came out of the receiver's servo port, as bursts of
+ * bytes with the time the first byte of each arrived. Bytes in a burst
+ * followed each other at the line rate. On disk it is
+ *   "IBUSCAP", version (1), baud rate (4)
+ * then any number of bursts
+ *   time in us since the capture started (4), length (1), bytes
+ * all little endian.
+ *
+ * Replaying resets the simulated board, runs setup() and then loop() on
+ * the virtual clock while the bytes go into USART2 at their times. Each
+ * replay runs in a child process, so the sketch's globals start from
+ * their initial values as they would after a reset, whatever ran
+ * before; one that does not exit cleanly fails the replay, as its
+ * trace may stop short. What the sketch does to the engine, servos and
+ * ballast comes back as a trace, one line each time any of it changes,
+ * which can be diffed against a golden trace from an earlier run.
+ */
+
+#ifndef ibusReplay_h
+#define ibusReplay_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "harness.h"
+
+namespace Replay
+{
+  static constexpr uint8_t FORMAT_VERSION = 1;
+  static constexpr uint32_t DEFAULT_BAUD = 115200;
+
+  /* Bytes that arrived back to back */
+  struct Burst
+  {
+    uint32_t at;
+    std::vector<uint8_t> bytes;
+  };
+
+  struct Capture
+  {
+    uint32_t baud = DEFAULT_BAUD;
+    std::vector<Burst> bursts;
+
+    /* Time the last byte ends */
+    uint32_t duration() const;
+  };
+
+  /* File contents for a capture */
+  std::vector<uint8_t> serialize(const Capture& capture);
+
+  /*
+   * Read a capture back
+   * @return false if the header is wrong or a burst is cut off
+   */
+  bool parse(const std::vector<uint8_t>& data, Capture& capture);
+
+  bool load(const std::string& path, Capture& capture);
+  bool save(const std::string& path, const Capture& capture);
+
+  /* Append one frame of the channels staged with Sim::setChannel() */
+  void addFrame(Capture& capture, uint32_t at);
+
+  struct Options
+  {
+    /* Loop steps: the clock moves this far, then loop() runs loops times */
+    uint32_t step = 50;
+    uint8_t loops = 8;
+
+    /* Keep running this long after the last byte */
+    uint32_t tail = 500000;
+
+    /* Raw ADC reading for the battery */
+    int battery = Harness::HEALTHY_BATTERY;
+  };
+
+  /*
+   * The actuator trace, one line per change
+   * @return false if the replay could not be started or its process did not exit cleanly
+   */
+  bool run(const Capture& capture, std::vector<std::string>& trace, const Options& options = Options());
+
+  /*
+   * Lines that differ between two traces, with line numbers
+   * @param limit Stop after this many
+   * @return Empty if they match
+   */
+  std::string diff(const std::vector<std::string>& expected, const std::vector<std::string>& actual, size_t limit = 10);
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ibus_capture - Records a receiver's iBus servo output for ibus_replay.
+ *
+ * Wire the receiver's servo port to a USB serial adapter's RX (and
+ * ground), then
+ *
+ * usage: ibus_capture /dev/ttyUSB0 session.ibus
+ *
+ * and stop it with Ctrl-C. Bytes are grouped into bursts by when they
+ * came out of the adapter, so burst times are only as good as its
+ * latency, typically a millisecond. The 3 ms gaps between iBus frames
+ * are what the sketch resynchronises on, so they survive that.
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ibusReplay.h"
+
+namespace
+{
+  volatile sig_atomic_t stopping = 0;
+
+  void stop(int)
+  {
+    stopping = 1;
+  }
+
+  uint64_t nowMicros()
+  {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 3)
+  {
+    fprintf(stderr, "usage: ibus_capture <serial device> <capture.ibus>\n");
+    return 2;
+  }
+
+  int port = open(argv[1], O_RDONLY | O_NOCTTY);
+  if (port < 0)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  termios settings;
+  tcgetattr(port, &settings);
+  cfmakeraw(&settings);
+  cfsetispeed(&settings, B115200);
+  settings.c_cc[VMIN] = 1;
+  settings.c_cc[VTIME] = 0;
+  tcsetattr(port, TCSANOW, &settings);
+  tcflush(port, TCIFLUSH);
+
+  signal(SIGINT, stop);
+  Replay::Capture capture;
+  uint64_t start = nowMicros();
+  uint8_t buffer[255];
+  while (!stopping)
+  {
+    ssize_t got = read(port, buffer, sizeof(buffer));
+    if (got <= 0)
+    {
+      continue;
+    }
+    // read() returns once the bytes are in, so the burst started a line time per byte earlier
+    uint64_t arrived = nowMicros() - start;
+    uint64_t lineTime = uint64_t(got) * 10 * 1000000 / capture.baud;
+    uint32_t at = uint32_t(arrived > lineTime ? arrived - lineTime : 0);
+    capture.bursts.push_back(Replay::Burst{ at, std::vector<uint8_t>(buffer, buffer + got) });
+  }
+  close(port);
+
+  if (!Replay::save(argv[2], capture))
+  {
+    perror(argv[2]);
+    return 1;
+  }
+  fprintf(stderr, "%zu bursts, %.1f s\n", capture.bursts.size(), capture.duration() / 1e6);
+  return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ibus_replay - Replays iBus captures through the sketch and checks the result.
+ *
+ * Each capture is played through setup() and loop() on the virtual
+ * clock, and the actuator trace is compared with the golden trace kept
+ * next to it, name.ibus against name.trace. Differences are printed and
+ * the exit status is 1 if any capture did not match.
+ *
+ * usage: ibus_replay [--update] [--print] capture.ibus...
+ *
+ * --update writes the golden traces instead of checking them, after a
+ * change that is meant to alter what the sketch does. --print writes
+ * each trace to standard output.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "ibusReplay.h"
+
+namespace
+{
+  std::string tracePath(const std::string& capture)
+  {
+    size_t dot = capture.rfind('.');
+    size_t slash = capture.rfind('/');
+    bool extension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    return (extension ? capture.substr(0, dot) : capture) + ".trace";
+  }
+
+  bool readLines(const std::string& path, std::vector<std::string>& lines)
+  {
+    FILE* in = fopen(path.c_str(), "r");
+    if (!in)
+    {
+      return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), in))
+    {
+      lines.push_back(std::string(line, strcspn(line, "\n")));
+    }
+    fclose(in);
+    return true;
+  }
+
+  bool writeLines(const std::string& path, const std::vector<std::string>& lines)
+  {
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out)
+    {
+      return false;
+    }
+    for (const std::string& line : lines)
+    {
+      fprintf(out, "%s\n", line.c_str());
+    }
+    return fclose(out) == 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  bool update = false;
+  bool print = false;
+  int failed = 0;
+  int captures = 0;
+  double replayed = 0;
+  auto started = std::chrono::steady_clock::now();
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--update") == 0)
+    {
+      update = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--print") == 0)
+    {
+      print = true;
+      continue;
+    }
+
+    Replay::Capture capture;
+    if (!Replay::load(argv[i], capture))
+    {
+      fprintf(stderr, "%s: not a readable capture\n", argv[i]);
+      failed++;
+      continue;
+    }
+    captures++;
+
+    Replay::Options options;
+    std::vector<std::string> trace;
+    if (!Replay::run(capture, trace, options))
+    {
+      fprintf(stderr, "%s: replay did not finish\n", argv[i]);
+      failed++;
+      continue;
+    }
+    replayed += (capture.duration() + options.tail) / 1e6;
+    if (print)
+    {
+      for (const std::string& line : trace)
+      {
+        printf("%s\n", line.c_str());
+      }
+    }
+
+    std::string golden = tracePath(argv[i]);
+    if (update)
+    {
+      if (!writeLines(golden, trace))
+      {
+        perror(golden.c_str());
+        failed++;
+      }
+      continue;
+    }
+
+    std::vector<std::string> expected;
+    if (!readLines(golden, expected))
+    {
+      fprintf(stderr, "%s: no golden trace %s, run with --update to make one\n", argv[i], golden.c_str());
+      failed++;
+      continue;
+    }
+    std::string differences = Replay::diff(expected, trace);
+    if (!differences.empty())
+    {
+      fprintf(stderr, "%s: does not match %s\n%s", argv[i], golden.c_str(), differences.c_str());
+      failed++;
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  fprintf(stderr, "%d capture(s), %.1f s of input replayed in %.2f s, %d failed\n", captures, replayed, seconds, failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "logDecoder.h"
+#include "log.h"
+#include "profile.h"
+#include "compass.h"
+
+namespace
+{
+  #define LOG_MESSAGE_TEXT(id, text) text,
+  const char* const MESSAGES[] = { LOG_MESSAGES(LOG_MESSAGE_TEXT) };
+  #undef LOG_MESSAGE_TEXT
+
+  const char* const LEVELS[] = { "TRACE", "INFO", "WARN", "ERROR" };
+
+  #define PROFILE_STAGE_NAME(id, name) name,
+  const char* const STAGES[] = { PROFILE_STAGES(PROFILE_STAGE_NAME) };
+  #undef PROFILE_STAGE_NAME
+
+  /* Stage, count, the 8 byte total, min, max and the histogram */
+  constexpr size_t PROFILE_LENGTH = 1 + 4 * 3 + 8 + 2 * Profile::HISTOGRAM_BINS;
+}
+
+bool LogDecoder::nextFrame(const uint8_t* data, size_t size, size_t& pos, Frame& frame, size_t& skipped)
+{
+  while (pos < size)
+  {
+    if (data[pos] != Log::FRAME_SYNC || pos + 3 > size)
+    {
+      pos++;
+      skipped++;
+      continue;
+    }
+
+    uint8_t type = data[pos + 1];
+    uint8_t length = data[pos + 2];
+    if (pos + length + Log::FRAME_OVERHEAD > size)
+    {
+      // Either cut off at the end of the capture or not a frame at all
+      pos++;
+      skipped++;
+      continue;
+    }
+
+    uint8_t crc = Log::crc8(Log::crc8(0, type), length);
+    for (uint8_t i = 0; i < length; i++)
+    {
+      crc = Log::crc8(crc, data[pos + 3 + i]);
+    }
+    if (crc != data[pos + 3 + length])
+    {
+      pos++;
+      skipped++;
+      continue;
+    }
+
+    frame.type = type;
+    frame.payload.assign(data + pos + 3, data + pos + 3 + length);
+    pos += length + Log::FRAME_OVERHEAD;
+    return true;
+  }
+  return false;
+}
+
+int32_t LogDecoder::readLong(const std::vector<uint8_t>& payload, size_t offset)
+{
+  return int32_t(uint32_t(payload[offset]) | uint32_t(payload[offset + 1]) << 8 | uint32_t(payload[offset + 2]) << 16 | uint32_t(payload[offset + 3]) << 24);
+}
+
+std::string LogDecoder::formatLog(const Frame& frame)
+{
+  const std::vector<uint8_t>& payload = frame.payload;
+  if (frame.type != Log::RECORD_LOG || payload.size() < Log::LOG_HEADER || (payload.size() - Log::LOG_HEADER) % 4)
+  {
+    return std::string();
+  }
+
+  uint8_t id = payload[0];
+  uint8_t level = payload[1];
+  uint32_t micros = uint32_t(readLong(payload, 2));
+  size_t count = (payload.size() - Log::LOG_HEADER) / 4;
+
+  char prefix[48];
+  snprintf(prefix, sizeof(prefix), "%10.6f %-5s ", micros / 1e6, level < 4 ? LEVELS[level] : "?");
+  std::string line(prefix);
+
+  if (id >= Log::NUM_MESSAGES)
+  {
+    char unknown[32];
+    snprintf(unknown, sizeof(unknown), "message %u", unsigned(id));
+    line += unknown;
+    for (size_t i = 0; i < count; i++)
+    {
+      line += " " + std::to_string(readLong(payload, Log::LOG_HEADER + 4 * i));
+    }
+    return line;
+  }
+
+  // Substitute each %d with the next number, leaving any extra %d as is
+  size_t next = 0;
+  for (const char* text = MESSAGES[id]; *text; text++)
+  {
+    if (text[0] == '%' && text[1] == 'd' && next < count)
+    {
+      line += std::to_string(readLong(payload, Log::LOG_HEADER + 4 * next++));
+      text++;
+    }
+    else
+    {
+      line += *text;
+    }
+  }
+  return line;
+}
+
+std::string LogDecoder::formatProfile(const Frame& frame)
+{
+  const std::vector<uint8_t>& payload = frame.payload;
+  if (frame.type != Profile::RECORD_PROFILE || payload.size() != PROFILE_LENGTH || payload[0] >= Profile::NUM_STAGES)
+  {
+    return std::string();
+  }
+
+  uint32_t count = uint32_t(readLong(payload, 1));
+  uint64_t total = uint32_t(readLong(payload, 5)) | uint64_t(uint32_t(readLong(payload, 9))) << 32;
+  uint32_t min = uint32_t(readLong(payload, 13));
+  uint32_t max = uint32_t(readLong(payload, 17));
+
+  char text[160];
+  snprintf(text, sizeof(text), "PROFILE %s: %u runs, min %u, mean %u, max %u us, histogram",
+    STAGES[payload[0]], count, min, count ? uint32_t(total / count) : 0, max);
+  std::string line(text);
+
+  // Bin n holds times below 2^n us, the last everything from 2^(n-1) up
+  for (uint8_t i = 0; i < Profile::HISTOGRAM_BINS; i++)
+  {
+    unsigned hits = payload[21 + 2 * i] | payload[22 + 2 * i] << 8;
+    if (i + 1 < Profile::HISTOGRAM_BINS)
+    {
+      snprintf(text, sizeof(text), " <%u:%u", 1u << i, hits);
+    }
+    else
+    {
+      snprintf(text, sizeof(text), " >=%u:%u", 1u << (i - 1), hits);
+    }
+    line += text;
+  }
+  return line;
+}
+
+const char* const LogDecoder::FLIGHT_COLUMNS =
+  "time_s,throttle,rudder_us,dive_plane_us,swA,swB,swC,swD,vrA,vrB,"
+  "engine,ballast,failsafe,holding,engine_pwm,rudder_servo_us,plane_servo_us,"
+  "rpm,pressure_pa,heading_deg,battery_mv";
+
+LogDecoder::FlightDecoder::FlightDecoder()
+  : synced(false), current(), orphaned(0)
+{
+}
+
+std::string LogDecoder::FlightDecoder::format(const Frame& frame, bool gap)
+{
+  const uint8_t* payload = frame.payload.data();
+  uint8_t length = uint8_t(frame.payload.size());
+  synced = synced && !gap;
+  if (frame.type == Recorder::RECORD_KEYFRAME)
+  {
+    synced = Recorder::decodeKey(payload, length, current);
+  }
+  else if (frame.type == Recorder::RECORD_DELTA)
+  {
+    if (!synced)
+    {
+      orphaned++;
+      return std::string();
+    }
+    synced = Recorder::applyDelta(payload, length, current);
+  }
+  else
+  {
+    return std::string();
+  }
+  if (!synced)
+  {
+    return std::string();
+  }
+
+  const Recorder::Snapshot& s = current;
+  char row[256];
+  snprintf(row, sizeof(row), "%.6f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%d,%d,%.2f,%u",
+    s.time / 1e6, s.throttle, s.rudder, s.divePlane,
+    (s.switches & Recorder::SWA_DOWN) != 0, (s.switches & Recorder::SWB_DOWN) != 0,
+    (s.switches >> Recorder::SWC_SHIFT) & 0x03, (s.switches & Recorder::SWD_DOWN) != 0,
+    s.vrA, s.vrB,
+    s.outputs & Recorder::ENGINE_MASK, (s.outputs >> Recorder::BALLAST_SHIFT) & 0x03,
+    (s.outputs & Recorder::FAILSAFE_ENGAGED) != 0, (s.outputs & Recorder::DEPTH_HOLDING) != 0,
+    s.enginePwm, s.rudderServo, s.planeServo,
+    s.rpm, s.pressure, s.heading * 360.0 / Sensor::FULL_TURN, s.battery);
+  return row;
+}
+
+const Recorder::Snapshot& LogDecoder::FlightDecoder::snapshot() const
+{
+  return current;
+}
+
+size_t LogDecoder::FlightDecoder::orphans() const
+{
+  return orphaned;
+}
+
+std::string LogDecoder::decodeFlight(const std::vector<uint8_t>& data, size_t& skipped)
+{
+  std::string text = std::string(FLIGHT_COLUMNS) + "\n";
+  FlightDecoder decoder;
+  size_t pos = 0;
+  Frame frame;
+  skipped = 0;
+  size_t before = 0;
+  while (nextFrame(data.data(), data.size(), pos, frame, skipped))
+  {
+    std::string row = decoder.format(frame, skipped != before);
+    before = skipped;
+    if (!row.empty())
+    {
+      text += row + "\n";
+    }
+  }
+  return text;
+}
+
+std::string LogDecoder::decode(const std::vector<uint8_t>& data, size_t& skipped)
+{
+  std::string text;
+  size_t pos = 0;
+  Frame frame;
+  skipped = 0;
+  while (nextFrame(data.data(), data.size(), pos, frame, skipped))
+  {
+    std::string line = frame.type == Profile::RECORD_PROFILE ? formatProfile(frame) : formatLog(frame);
+    if (!line.empty())
+    {
+      text += line + "\n";
+    }
+  }
+  return text;
+}
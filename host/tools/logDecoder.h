@@ -0,0 +1,117 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * logDecoder.h - Turns the sketch's framed binary records back into text.
+ */
+
+#ifndef logDecoder_h
+#define logDecoder_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "recorder.h"
+
+namespace LogDecoder
+{
+  /* One record pulled out of a stream */
+  struct Frame
+  {
+    uint8_t type;
+    std::vector<uint8_t> payload;
+  };
+
+  /*
+   * Find the next intact frame at or after pos. Damaged or cut off
+   * frames are skipped a byte at a time until the stream lines up again.
+   * @param data Captured bytes
+   * @param size Bytes in data
+   * @param pos Where to start looking, moved past the frame returned
+   * @param frame Filled in when one is found
+   * @param skipped Incremented for every byte that was not part of a good frame
+   * @return false once no more complete frames remain
+   */
+  bool nextFrame(const uint8_t* data, size_t size, size_t& pos, Frame& frame, size_t& skipped);
+
+  /* Little endian 32 bit value at offset in payload */
+  int32_t readLong(const std::vector<uint8_t>& payload, size_t offset);
+
+  /*
+   * Text for one log record: time in seconds, level and message
+   * @return Empty if the frame is not a well formed log record
+   */
+  std::string formatLog(const Frame& frame);
+
+  /*
+   * Text for one stage summary from Profile::dump()
+   * @return Empty if the frame is not a well formed profile record
+   */
+  std::string formatProfile(const Frame& frame);
+
+  /*
+   * Decode a whole capture, one line per log or profile record
+   * @param skipped Set to the number of bytes that could not be decoded
+   */
+  std::string decode(const std::vector<uint8_t>& data, size_t& skipped);
+
+  /* Header row naming the columns FlightDecoder writes */
+  extern const char* const FLIGHT_COLUMNS;
+
+  /*
+   * FlightDecoder class - Rebuilds recorder snapshots as CSV rows.
+   *
+   * Deltas only mean something on top of the snapshot before them, so
+   * after a damaged stretch of capture nothing comes out until the next
+   * keyframe.
+   */
+  class FlightDecoder
+  {
+    public:
+      FlightDecoder();
+
+      /*
+       * CSV row for one recorder frame
+       * @param gap Whether bytes were lost since the last frame
+       * @return Empty for other frames, or while waiting for a keyframe
+       */
+      std::string format(const Frame& frame, bool gap);
+
+      /* Latest snapshot rebuilt */
+      const Recorder::Snapshot& snapshot() const;
+
+      /* Deltas thrown away because there was no keyframe to apply them to */
+      size_t orphans() const;
+
+    private:
+      bool synced;
+      Recorder::Snapshot current;
+      size_t orphaned;
+  };
+
+  /*
+   * Decode a whole recorder capture to CSV, header first
+   * @param skipped Set to the number of bytes that could not be decoded
+   */
+  std::string decodeFlight(const std::vector<uint8_t>& data, size_t& skipped);
+}
+
+#endif
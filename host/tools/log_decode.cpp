@@ -0,0 +1,59 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * log_decode - Prints a binary log captured from the sketch's serial port.
+ *
+ * Capture the port raw, for example with
+ *   stty -F /dev/ttyACM0 115200 raw && cat /dev/ttyACM0 > capture.bin
+ * then decode it with
+ *
+ * usage: log_decode [capture.bin]
+ *
+ * Reads standard input when no file is given.
+ */
+
+#include <stdio.h>
+
+#include "logDecoder.h"
+
+int main(int argc, char** argv)
+{
+  FILE* in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+  if (!in)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+
+  std::vector<uint8_t> data;
+  int c;
+  while ((c = fgetc(in)) != EOF)
+  {
+    data.push_back(uint8_t(c));
+  }
+
+  size_t skipped = 0;
+  fputs(LogDecoder::decode(data, skipped).c_str(), stdout);
+  if (skipped)
+  {
+    fprintf(stderr, "%zu bytes could not be decoded\n", skipped);
+  }
+  return 0;
+}
@@ -17,54 +17,150 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-/*
- * Download IBusBM library here
- * https://github.com/bmellink/IBusBM
- *
- * Click "<> Code" -> Download zip
- * Add to sketch in Arduino ide
- * Sketch -> Include Library -> Add .zip library
- */
-
 /*
  * Uncomment one of these to enable debug logging to
  * the serial monitor. INFO is the least verbose to
  * TRACE should positivly overwhelm you with logging.
+ * The log is binary, decode it with host/tools/log_decode.
  */
 // #define DEBUG_TRACE
 // #define DEBUG_WARN
 // #define DEBUG_ERROR
 // #define DEBUG_INFO
 
-#include <IBusBM.h>
+/*
+ * Uncomment to count the engine encoder in Timer5 instead of with
+ * pin change interrupts. Needed above a few thousand rpm; see
+ * Motor::Timer5Counter for the extra wiring it takes.
+ */
+// #define ENGINE_HARDWARE_COUNTER
+
+/*
+ * Uncomment to have the throttle set a target rpm that the engine
+ * holds against load and battery sag, rather than a raw duty.
+ */
+// #define ENGINE_SPEED_CONTROL
+
+/*
+ * Uncomment to time loop() and its stages. The worst loop time goes
+ * out as a telemetry sensor; with DEBUG_INFO on as well, sending 'p'
+ * on the serial port logs every stage's summary and histogram.
+ */
+// #define PROFILE_ENABLED
+
+#include <avr/wdt.h>
 #include <Wire.h>
-#include <Adafruit_PWMServoDriver.h>
 
 #include "motor.h"
+#include "fastHBridge.h"
+#include "servoBank.h"
 #include "input.h"
+#include "analogSampler.h"
+#include "depthSensor.h"
+#include "compass.h"
+#include "deadReckoning.h"
+#include "depthHold.h"
+#include "recorder.h"
 #include "output.h"
 #include "debug.h"
-#include "Servo.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "failsafe.h"
+#include "stackGauge.h"
+#include "calibration.h"
+#include "connections.h"
 
 /*
- * Version number
+ * Version number, kept in flash
  */
-const String VERSION = "0.0.3";
-constexpr uint32_t READ_DELAY = 100;
+const char VERSION[] PROGMEM = "0.0.3";
 constexpr uint32_t BAUD_RATE = 115200;
-
-constexpr uint8_t WATER_SOLENOID_PIN = 27;
-constexpr uint8_t ENGINE_INPUT_1 = 22;
-constexpr uint8_t ENGINE_INPUT_2 = 23;
-constexpr uint8_t ENGINE_PWM = 11;
-constexpr uint8_t ENGINE_ENCODER_TRIGGER_1 = 2;
-constexpr uint8_t ENGINE_ENCODER_TRIGGER_2 = 3;
-
-constexpr uint8_t WATER_PUMP_INPUT_1 = 24;
-constexpr uint8_t WATER_PUMP_INPUT_2 = 25;
-
-constexpr uint8_t RUDDER = 0;
-constexpr uint8_t DIVE_PLANE = 1;
+constexpr uint32_t RECORDER_BAUD_RATE = 115200;
+
+/* Task periods in microseconds */
+constexpr uint32_t FAILSAFE_PERIOD = Safety::CHECK_PERIOD;
+constexpr uint32_t RX_PERIOD = 1000; // Several polls per 7 ms iBus frame
+constexpr uint32_t SERVO_PERIOD = RX_PERIOD;
+constexpr uint32_t ENCODER_PERIOD = Motor::RPM_SAMPLE_PERIOD;
+constexpr uint32_t DEPTH_PERIOD = 10000; // A reading every other period
+constexpr uint32_t COMPASS_PERIOD = 10000; // Accelerometer and magnetometer in turn, 50 Hz headings
+constexpr uint32_t NAVIGATION_PERIOD = 10000;
+constexpr uint32_t DEPTH_HOLD_PERIOD = 100000;
+constexpr uint32_t RECORD_PERIOD = 20000;
+constexpr uint32_t TELEMETRY_PERIOD = 100000;
+constexpr uint32_t INDICATOR_PERIOD = 50000;
+constexpr uint32_t MEMORY_PERIOD = 10000; // A full pass over the free RAM every half second or so
+constexpr uint32_t CALIBRATION_PERIOD = 5000; // One EEPROM byte takes 3.4 ms
+constexpr uint32_t PROFILE_REPORT_PERIOD = 50000;
+
+/* LED flashes in milliseconds: on for 100 of every 150 until armed, then toggling every 250 */
+constexpr uint16_t ARMING_FLASH_PERIOD = 150;
+constexpr uint16_t ARMING_FLASH_ON = 100;
+constexpr uint16_t HEARTBEAT_HALF_PERIOD = 250;
+
+/* Resets the board if the failsafe task stops running for this long */
+constexpr uint8_t WATCHDOG_TIMEOUT = WDTO_120MS;
+
+/* Throttle to target rpm for ENGINE_SPEED_CONTROL */
+typedef Data::LinearMap<Motor::MIN_PWM_VALUE, Motor::MAX_PWM_VALUE, 0, Motor::DEFAULT_MAX_RPM> ThrottleRpmMap;
+
+/* Dive plane position that brings the boat up; flip if the linkage is reversed */
+constexpr uint16_t DIVE_PLANE_SURFACE = Data::MIN_DIVE_PLANE_ANGLE;
+
+constexpr uint16_t SERVO_FREQUENCY = 50;
+constexpr uint16_t SERVO_DEADBAND = 4; // Microseconds, under one PCA9685 count at 50 Hz
+constexpr uint32_t SERVO_MIN_INTERVAL = 1000000 / SERVO_FREQUENCY; // Servos only see one pulse per period anyway
+
+/* Used until the sticks are calibrated; the oscillator is this board's PCA9685, as measured */
+constexpr Config::Calibration DEFAULT_CALIBRATION = {
+  Config::CALIBRATION_VERSION,
+  0, // crc, stamped when saved
+  27000000,
+  { Data::NOMINAL_STICK, Data::NOMINAL_STICK, Data::NOMINAL_STICK }
+};
+
+/* Highest throttle that counts as closed for the switch gestures; an uncalibrated throttle may not reach 0 */
+constexpr uint8_t LOW_THROTTLE = Motor::MAX_PWM_VALUE / 4;
+
+/* Loaded from EEPROM at boot; switch D down with the throttle low learns new stick ranges */
+Config::Calibration calibration;
+Config::CalibrationWriter calibrationWriter;
+Config::StickCalibrator stickCalibrator(_BV(Data::RUDDER_STICK) | _BV(Data::DIVE_PLANE_STICK));
+bool calibrating = false;
+
+/* Converts the battery voltage in the background */
+Analog::Sampler adc;
+uint8_t batterySlot;
+
+/* Depth sensor, it must be at least DEPTH_PERIOD for a conversion */
+constexpr Sensor::Oversampling DEPTH_OVERSAMPLING = Sensor::OSR_4096;
+static_assert(Sensor::conversionTime(DEPTH_OVERSAMPLING) <= DEPTH_PERIOD, "Depth conversions outlast the task period");
+Sensor::DepthSensor depthSensor(DEPTH_OVERSAMPLING, Sensor::FRESH_WATER);
+uint16_t depthErrors = 0;
+
+/* Heading from the LSM303 */
+Sensor::Compass compass;
+bool compassAnswering = false;
+
+/* Position relative to where the boat was switched on */
+Navigation::DeadReckoning position;
+
+/* Depth hold, engaged with switch B down; knob A sets the depth */
+constexpr int32_t MAX_HOLD_DEPTH = 3000;
+typedef Data::LinearMap<Data::MIN_RAW_INPUT, Data::MAX_RAW_INPUT, 0, MAX_HOLD_DEPTH> HoldDepthMap;
+Ballast::DepthHold depthHold(DEPTH_HOLD_PERIOD);
+bool holding = false;
+
+/* What the tank was last told, for the recorder */
+Ballast::Action ballastAction = Ballast::VENT;
+
+/* Flight recorder on Serial1, the one UART left, to a PC or an OpenLog */
+Recorder::SerialSink recorderPort(Serial1);
+Recorder::FlightRecorder recorder(recorderPort);
+
+/* Watches for signal loss and a flat battery */
+Safety::Failsafe failsafe;
+uint8_t lastBatteryBlock = 0;
 
 /* Rx data received from controller */
 Data::Input Rx;
@@ -72,122 +168,533 @@ Data::Input Rx;
 /* Tx data we are sending to controller */
 Data::Output Tx;
 
+/* Counts the main screw encoder */
+#ifdef ENGINE_HARDWARE_COUNTER
+Motor::Timer5Counter engineEncoder(ENGINE_ENCODER_DIRECTION);
+#else
+Motor::QuadratureCounter engineEncoder(ENGINE_ENCODER_TRIGGER_1, ENGINE_ENCODER_TRIGGER_2);
+#endif
+
 /* The main screw */
-Motor::HBridgePWMEnc engine(ENGINE_INPUT_1, ENGINE_INPUT_2, ENGINE_PWM, ENGINE_ENCODER_TRIGGER_1, ENGINE_ENCODER_TRIGGER_2);
+Motor::HBridgePWMEnc engine(ENGINE_INPUT_1, ENGINE_INPUT_2, ENGINE_PWM, engineEncoder);
 
-Motor::HBridge waterPump(WATER_PUMP_INPUT_1, WATER_PUMP_INPUT_2);
+/* Both inputs on port A, so every direction change is one port write */
+Motor::FastHBridge<WATER_PUMP_INPUT_1, WATER_PUMP_INPUT_2> waterPump;
 
-/* Rudder for steering */
-Servo rudder;
+/* Rudder and dive plane, sent to the PCA9685 a burst at a time */
+Actuator::ServoBank servos;
 
-/* Diveplane for changing depth */
-Servo divePlane;
+uint8_t ledLevel = LOW;
 
-Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
+/* High water mark of the stack, against what the static data leaves */
+Memory::StackGauge stackGauge;
 
-/* Stores previous values of rudder/diveplane so we aren't rewriting same value to servo over and over */
-int32_t oldRudder = Data::MID_POINT;
-int32_t oldDivePlane = Data::MID_POINT;
-Data::ThreeWaySwitchPos oldswC = Data::ThreeWaySwitchPos::UP;
-int32_t oldThrottle = Data::MIN_RAW_INPUT;
-Data::SwitchPos oldswA = Data::SwitchPos::UP;
+/* Runs the tasks below, declared with the task table */
+extern Tasks::Scheduler scheduler;
 
-/* Used for timing with no delay */
-uint32_t previousMillis = 0;
+/* Decode the latest frame from the receiver, if there is a new one */
+void readRx()
+{
+  PROFILE_SCOPE(RX_READ);
+  Rx.Read();
+}
 
-uint8_t nextLedState = LOW;
+/* Drive the solenoid and pump for a ballast action */
+void setBallast(Ballast::Action action)
+{
+  ballastAction = action;
+  switch (action)
+  {
+    case Ballast::VENT:
+      digitalWrite(WATER_SOLENOID_PIN, LOW);
+      waterPump.off();
+      break;
+    case Ballast::FILL:
+      digitalWrite(WATER_SOLENOID_PIN, LOW);
+      waterPump.forward();
+      break;
+    case Ballast::HOLD:
+      digitalWrite(WATER_SOLENOID_PIN, HIGH);
+      waterPump.off();
+      break;
+  }
+}
 
-void setup()
+/*
+ * Push stick and switch positions out to the motors and servos
+ * @param changes Data::*_CHANGED bits of what to update
+ */
+void applyActuators(const Data::Input& input, uint16_t changes)
 {
-  DEBUG_BEGIN(BAUD_RATE);
-  // Serial.begin(BAUD_RATE);
-  pwm.begin();
-  pwm.setOscillatorFrequency(27000000);
-  pwm.setPWMFreq(50);
-  pwm.writeMicroseconds(RUDDER, oldRudder);
-  pwm.writeMicroseconds(DIVE_PLANE, oldDivePlane);
-  Rx.Begin();
-  Tx.Begin();
+  if (changes == 0)
+  {
+    return;
+  }
 
-  // Normally I'd write a small class to work water pump
-  // but it's literally an on off relay so meh
-  pinMode(WATER_SOLENOID_PIN, OUTPUT);
-  digitalWrite(WATER_SOLENOID_PIN, LOW);
+  if (changes & (Data::THROTTLE_CHANGED | Data::SWA_CHANGED))
+  {
+    PROFILE_SCOPE(ENGINE_SET);
+    Motor::Direction direction = input.swA == Data::SwitchPos::UP ? Motor::Direction::FORWARD : Motor::Direction::BACKWARD;
+#ifdef ENGINE_SPEED_CONTROL
+    engine.setTargetRpm(direction, ThrottleRpmMap::apply(input.throttle));
+#else
+    engine.set(direction, input.throttle);
+#endif
+  }
 
-  pinMode(8, OUTPUT);
-  digitalWrite(8, LOW);
+  // Only staged here, flushServos() sends them together
+  if (changes & Data::RUDDER_CHANGED)
+  {
+    servos.write(RUDDER, input.rudder);
+  }
 
-  DEBUG_PRINTLN_INFO("Starting");
-  uint32_t current = millis();
-  while (current < 5000)
+  if (changes & Data::DIVE_PLANE_CHANGED)
   {
-    digitalWrite(8, HIGH);
-    delay(100);
-    digitalWrite(8, LOW);
-    delay(50);
-    current = millis();
+    servos.write(DIVE_PLANE, input.divePlane);
+  }
+
+  if (changes & Data::SWC_CHANGED)
+  {
+    switch(input.swC)
+    {
+      case Data::ThreeWaySwitchPos::UP:
+        setBallast(Ballast::VENT);
+        break;
+      case Data::ThreeWaySwitchPos::MIDDLE:
+        setBallast(Ballast::FILL);
+        break;
+      case Data::ThreeWaySwitchPos::DOWN:
+        setBallast(Ballast::HOLD);
+        break;
+    }
   }
 }
 
-void loop() {
+/*
+ * Switch D going down with the throttle near closed asks for stick
+ * calibration, if nothing else has the boat. Not fully closed, as an
+ * uncalibrated throttle may not get there.
+ */
+bool calibrationWanted(const Data::Input& input)
+{
+  return (input.changes() & Data::SWD_CHANGED) && input.swD == Data::SwitchPos::DOWN && input.throttle <= LOW_THROTTLE
+    && !holding && !failsafe.engaged() && !calibrationWriter.busy();
+}
 
-  uint32_t current = millis();
-  bool takeAction = (current - previousMillis) > READ_DELAY;
+/* Learn the stick travel while switch D is down, and keep it once it comes back up */
+void calibrateSticks(const Data::Input& input)
+{
+  if (!calibrating)
+  {
+    calibrating = true;
+    stickCalibrator.begin();
+    engine.off();
+    servos.write(RUDDER, Data::MID_POINT);
+    servos.write(DIVE_PLANE, Data::MID_POINT);
+    LOG_INFO(Log::CALIBRATION_STARTED);
+  }
 
-  if (takeAction)
+  if (input.swD == Data::SwitchPos::DOWN)
   {
-    digitalWrite(8, nextLedState);
-    nextLedState = nextLedState == LOW ? HIGH : LOW;
-    previousMillis = current;
-    Rx.Read();
+    uint16_t raw[Data::NUM_STICKS];
+    raw[Data::RUDDER_STICK] = input.channel(Data::RUDDER_INDEX);
+    raw[Data::DIVE_PLANE_STICK] = input.channel(Data::DIVE_PLANE_INDEX);
+    raw[Data::THROTTLE_STICK] = input.channel(Data::THROTTLE_INDEX);
+    stickCalibrator.sample(raw);
+    return;
+  }
 
-    if (oldThrottle != Rx.throttle || oldswA != Rx.swA)
+  calibrating = false;
+  Data::StickRange sticks[Data::NUM_STICKS];
+  uint8_t unmoved = stickCalibrator.finish(sticks);
+  if (unmoved == Data::NUM_STICKS)
+  {
+    for (uint8_t i = 0; i < Data::NUM_STICKS; i++)
     {
-      oldThrottle = Rx.throttle;
-      oldswA = Rx.swA;
-      engine.set(Rx.swA == Data::SwitchPos::UP ? Motor::Direction::FORWARD : Motor::Direction::BACKWARD, Rx.throttle);
+      calibration.sticks[i] = sticks[i];
     }
+    Rx.calibrate(calibration.sticks);
+    calibrationWriter.save(calibration);
+    LOG_INFO(Log::CALIBRATION_SAVED, sticks[Data::RUDDER_STICK].high - sticks[Data::RUDDER_STICK].low,
+      sticks[Data::DIVE_PLANE_STICK].high - sticks[Data::DIVE_PLANE_STICK].low,
+      sticks[Data::THROTTLE_STICK].high - sticks[Data::THROTTLE_STICK].low);
+  }
+  else
+  {
+    LOG_WARN(Log::CALIBRATION_REJECTED, unmoved);
+  }
+
+  // The new ranges apply from the next frame; until then the sticks keep this one's positions
+  if (!failsafe.engaged())
+  {
+    applyActuators(input, Data::ALL_CHANGED);
+  }
+}
 
-    uint16_t rpm = engine.getRpm();
+/* Flipping switch A with the throttle closed asks to re-arm after a flat battery */
+bool rearmWanted(const Data::Input& input)
+{
+  return (failsafe.reasons() & Safety::UNDERVOLTAGE) && (input.changes() & Data::SWA_CHANGED) && input.throttle <= LOW_THROTTLE;
+}
 
-    if (Rx.rudder != oldRudder)
+/* Called once per receiver frame; the failsafe owns the actuators while engaged */
+void updateActuators(const Data::Input& input)
+{
+  failsafe.frame(micros());
+  if (rearmWanted(input))
+  {
+    // The next check clears the failsafe and takes up the sticks
+    if (failsafe.rearm())
     {
-      pwm.writeMicroseconds(RUDDER, Rx.rudder);
-      oldRudder = Rx.rudder;
+      LOG_WARN(Log::FAILSAFE_REARMED, Data::batteryMillivolts(adc.read(batterySlot)));
     }
-
-    if (Rx.divePlane != oldDivePlane)
+    else
     {
-      pwm.writeMicroseconds(DIVE_PLANE, Rx.divePlane);
-      oldDivePlane = Rx.divePlane;
+      LOG_WARN(Log::FAILSAFE_REARM_REFUSED, Data::batteryMillivolts(adc.read(batterySlot)));
     }
+  }
+  if (calibrating || calibrationWanted(input))
+  {
+    calibrateSticks(input);
+  }
+  else if (!failsafe.engaged())
+  {
+    // Depth hold has the tank and planes while it is on
+    uint16_t manual = holding ? ~(Data::SWC_CHANGED | Data::DIVE_PLANE_CHANGED) : Data::ALL_CHANGED;
+    applyActuators(input, input.changes() & manual);
+  }
+}
+
+/* Make the boat safe, most urgent first: stop driving, let the ballast out, head up */
+void enterSafeState()
+{
+  engine.off();
+  setBallast(Ballast::VENT);
+  servos.write(DIVE_PLANE, DIVE_PLANE_SURFACE);
+  servos.flush(micros());
+}
+
+/* Check for signal loss and undervoltage, and keep the watchdog fed */
+void checkFailsafe()
+{
+  uint32_t now = micros();
+  uint8_t block = adc.blocks(batterySlot);
+  if (block != lastBatteryBlock)
+  {
+    lastBatteryBlock = block;
+    failsafe.voltage(Data::batteryMillivolts(adc.read(batterySlot)), now);
+  }
 
-    if (Rx.swC != oldswC)
+  uint8_t before = failsafe.reasons();
+  uint8_t reasons = failsafe.check(now);
+  if (reasons != before)
+  {
+    if (reasons)
     {
-      oldswC = Rx.swC;
-      switch(Rx.swC)
+      LOG_WARN(Log::FAILSAFE_ENGAGED, reasons, Data::batteryMillivolts(adc.read(batterySlot)));
+      enterSafeState();
+    }
+    else
+    {
+      // Take up wherever the sticks are now, unless they are being calibrated
+      LOG_WARN(Log::FAILSAFE_CLEARED, (now - failsafe.since()) / 1000);
+      if (!calibrating)
       {
-        case Data::ThreeWaySwitchPos::UP:
-          // Let water out, solenoid open, pump off
-          digitalWrite(WATER_SOLENOID_PIN, LOW);
-          waterPump.off();
-          break;
-        case Data::ThreeWaySwitchPos::MIDDLE:
-          // Pull water in, solenoid open, pump on
-          digitalWrite(WATER_SOLENOID_PIN, LOW);
-          waterPump.forward();
-          break;
-        case Data::ThreeWaySwitchPos::DOWN:
-          // Hold water, solenoid closed, pump off
-          digitalWrite(WATER_SOLENOID_PIN, HIGH);
-          waterPump.off();
-          break;
+        applyActuators(Rx, Data::ALL_CHANGED);
       }
+    }
+  }
+
+  wdt_reset();
+}
+
+/* Send whatever servo positions are due in one I2C burst */
+void flushServos()
+{
+  if (servos.pending())
+  {
+    PROFILE_SCOPE(SERVO_WRITE);
+    servos.flush(micros());
+  }
+}
+
+/* Sample the engine encoder on a fixed period so the rpm stays fresh, and run speed control */
+void sampleEncoder()
+{
+  PROFILE_RECORD(CONTROL_JITTER, scheduler.lateness());
+  engine.read();
+}
 
+/* Collect the finished depth conversion and start the next */
+void readDepth()
+{
+  {
+    PROFILE_SCOPE(DEPTH_UPDATE);
+    depthSensor.update(micros());
+  }
+  if (depthSensor.errors() != depthErrors)
+  {
+    depthErrors = depthSensor.errors();
+    LOG_WARN(Log::DEPTH_SENSOR_FAULT, depthErrors);
+  }
+}
+
+/* Read the next half of the IMU and fuse a heading once both are in */
+void readCompass()
+{
+  if (compass.update())
+  {
+    PROFILE_SCOPE(HEADING_FUSE);
+    compass.fuse();
+  }
+  if (compassAnswering && !compass.valid())
+  {
+    LOG_WARN(Log::COMPASS_FAULT, compass.errors());
+  }
+  compassAnswering = compass.valid();
+}
+
+/* Move the position estimate on by one tick of the screw along the heading */
+void navigate()
+{
+  int32_t speed = Data::screwSpeed(engine.getRpm());
+  if (engine.getState() == Motor::Direction::BACKWARD)
+  {
+    speed = -speed;
+  }
+  position.update(micros(), speed, compass.heading(), depthSensor.depth());
+}
+
+/* Hold the depth knob A asks for while switch B is down */
+void holdDepth()
+{
+  bool wanted = Rx.swB == Data::SwitchPos::DOWN && depthSensor.valid() && !failsafe.engaged() && !calibrating;
+  if (!wanted)
+  {
+    if (holding)
+    {
+      holding = false;
+      // A target of 0 marks the hand back in the log
+      LOG_INFO(Log::DEPTH_HOLD, 0, depthSensor.depth());
+      // Back to the sticks, unless the failsafe has the boat
+      if (!failsafe.engaged())
+      {
+        applyActuators(Rx, Data::SWC_CHANGED | Data::DIVE_PLANE_CHANGED);
+      }
     }
+    return;
+  }
+
+  uint32_t now = micros();
+  if (!holding)
+  {
+    holding = true;
+    depthHold.begin(now, depthSensor.depth());
+    LOG_INFO(Log::DEPTH_HOLD, HoldDepthMap::apply(Rx.vrA), depthSensor.depth());
+  }
+  depthHold.setTarget(HoldDepthMap::apply(Rx.vrA));
+  depthHold.update(now, depthSensor.depth());
+  setBallast(depthHold.ballast());
+  servos.write(DIVE_PLANE, depthHold.plane());
+  LOG_TRACE(Log::DEPTH_HOLD, HoldDepthMap::apply(Rx.vrA), depthSensor.depth());
+}
+
+/* Snapshot the inputs, outputs and sensors and pass what the port can take on */
+void recordFlight()
+{
+  Recorder::Snapshot snapshot;
+  snapshot.time = micros();
+  snapshot.throttle = Rx.throttle;
+  snapshot.rudder = Rx.rudder;
+  snapshot.divePlane = Rx.divePlane;
+  snapshot.switches = (Rx.swA == Data::SwitchPos::DOWN ? Recorder::SWA_DOWN : 0)
+    | (Rx.swB == Data::SwitchPos::DOWN ? Recorder::SWB_DOWN : 0)
+    | uint8_t(Rx.swC) << Recorder::SWC_SHIFT
+    | (Rx.swD == Data::SwitchPos::DOWN ? Recorder::SWD_DOWN : 0);
+  snapshot.vrA = Rx.vrA;
+  snapshot.vrB = Rx.vrB;
+  snapshot.outputs = engine.getState()
+    | ballastAction << Recorder::BALLAST_SHIFT
+    | (failsafe.engaged() ? Recorder::FAILSAFE_ENGAGED : 0)
+    | (holding ? Recorder::DEPTH_HOLDING : 0);
+  snapshot.enginePwm = engine.getSpeed();
+  snapshot.rudderServo = servos.read(RUDDER);
+  snapshot.planeServo = servos.read(DIVE_PLANE);
+  snapshot.rpm = engine.getRpm();
+  snapshot.pressure = depthSensor.pressure();
+  snapshot.heading = compass.heading();
+  snapshot.battery = Data::batteryMillivolts(adc.read(batterySlot));
+  recorder.record(snapshot);
+  recorder.flush();
+}
+
+/* Hand the latest sensor values to the telemetry port */
+void sendTelemetry()
+{
+  {
+    PROFILE_SCOPE(TELEMETRY);
+    Tx.SetSensors(engine.getRpm(), adc.read(batterySlot), depthSensor.pressure(), depthSensor.depth(), compass.degrees());
+  }
+  LOG_INFO(Log::DEPTH, depthSensor.depth(), depthSensor.pressure(), depthSensor.temperature());
+  Tx.SetNavigation(position.distanceHome(), Sensor::angleDegrees(position.bearingHome()));
+  Tx.SetLoopStats(PROFILE_WORST(LOOP), scheduler.totalOverruns() + scheduler.totalMisses());
+  LOG_INFO(Log::SERVO_BUS, servos.busRate());
+}
+
+/*
+ * Show the boat's state on the LED: quick flashes until it is armed,
+ * that is has heard the transmitter and is out of failsafe, then a slow
+ * blink so we can see the loop is alive. Solid while calibrating.
+ */
+void indicate()
+{
+  uint32_t now = millis();
+  uint8_t level;
+  if (calibrating)
+  {
+    level = HIGH;
+  }
+  else if (Rx.frameCount() == 0 || failsafe.engaged())
+  {
+    level = now % ARMING_FLASH_PERIOD < ARMING_FLASH_ON ? HIGH : LOW;
+  }
+  else
+  {
+    level = (now / HEARTBEAT_HALF_PERIOD) & 1 ? HIGH : LOW;
+  }
 
+  if (level != ledLevel)
+  {
+    digitalWrite(HEARTBEAT_LED_PIN, level);
+    ledLevel = level;
+  }
+}
+
+/* Log the RAM figures each time the stack reaches a new depth */
+void checkMemory()
+{
+  if (stackGauge.poll())
+  {
+    LOG_INFO(Log::MEMORY, stackGauge.staticBytes(), stackGauge.stackPeak(), stackGauge.margin());
+  }
+}
+
+/* Put the next byte of a calibration save in EEPROM, if it is free */
+void writeCalibration()
+{
+  if (calibrationWriter.poll())
+  {
+    LOG_INFO(Log::CALIBRATION_STORED);
+  }
+}
+
+#ifdef PROFILE_ENABLED
+/* Log the stage timings, a few at a time as the log has room, once asked over serial */
+void reportProfile()
+{
+  static bool reporting = false;
+  if (!reporting && Serial.available() && Serial.read() == 'p')
+  {
+    reporting = true;
+  }
+  if (reporting)
+  {
+    reporting = !PROFILE_DUMP();
+  }
+}
+#endif
+
+/* Everything loop() does, most urgent first */
+Tasks::Task tasks[] = {
+  TASK(checkFailsafe, FAILSAFE_PERIOD, 0),
+  TASK(readRx, RX_PERIOD, 1),
+  TASK(flushServos, SERVO_PERIOD, 2),
+  TASK(sampleEncoder, ENCODER_PERIOD, 3),
+  TASK(readDepth, DEPTH_PERIOD, 4),
+  TASK(readCompass, COMPASS_PERIOD, 5),
+  TASK(navigate, NAVIGATION_PERIOD, 6),
+  TASK(holdDepth, DEPTH_HOLD_PERIOD, 7),
+  TASK(recordFlight, RECORD_PERIOD, 8),
+  TASK(sendTelemetry, TELEMETRY_PERIOD, 9),
+  TASK(indicate, INDICATOR_PERIOD, 10),
+  TASK(checkMemory, MEMORY_PERIOD, 11),
+  TASK(writeCalibration, CALIBRATION_PERIOD, 12),
+#ifdef PROFILE_ENABLED
+  TASK(reportProfile, PROFILE_REPORT_PERIOD, 13),
+#endif
+};
+
+Tasks::Scheduler scheduler(tasks, sizeof(tasks) / sizeof(tasks[0]));
+
+void setup()
+{
+  stackGauge.begin();
+
+  // A watchdog reset leaves the watchdog running, so stop it before anything slow
+  uint8_t resetCause = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
 
-    Tx.SetSensors(Rx, rpm);
-    digitalWrite(8, LOW);
+  DEBUG_BEGIN(BAUD_RATE);
+  Serial1.begin(RECORDER_BAUD_RATE);
+  // Serial.begin(BAUD_RATE);
+
+  // A fixed size read, so it takes as long whatever is stored
+  bool calibrated = Config::load(calibration, DEFAULT_CALIBRATION);
+
+  Wire.begin();
+  servos.begin(calibration.oscillator, SERVO_FREQUENCY);
+  servos.configure(RUDDER, SERVO_DEADBAND, SERVO_MIN_INTERVAL);
+  servos.configure(DIVE_PLANE, SERVO_DEADBAND, SERVO_MIN_INTERVAL);
+  servos.write(RUDDER, Data::MID_POINT);
+  servos.write(DIVE_PLANE, Data::MID_POINT);
+  servos.flush(micros());
+  depthSensor.begin(micros());
+  compass.begin();
+  engine.begin();
+  Rx.Begin();
+  Rx.calibrate(calibration.sticks);
+  Rx.OnFrame(updateActuators);
+  Tx.Begin();
+  batterySlot = adc.addChannel(Data::BATTERY_PIN);
+  adc.begin();
+
+  // Normally I'd write a small class to work water pump
+  // but it's literally an on off relay so meh
+  pinMode(WATER_SOLENOID_PIN, OUTPUT);
+  digitalWrite(WATER_SOLENOID_PIN, LOW);
+
+  pinMode(HEARTBEAT_LED_PIN, OUTPUT);
+  digitalWrite(HEARTBEAT_LED_PIN, LOW);
+
+  LOG_INFO(Log::STARTING);
+  if (resetCause & _BV(WDRF))
+  {
+    LOG_WARN(Log::WATCHDOG_RESET);
+  }
+  if (!calibrated)
+  {
+    LOG_WARN(Log::CALIBRATION_DEFAULTS);
+  }
+
+  // No start-up delay: the depth sensor reads its PROM once its reset time is up,
+  // and the LED shows the boat is not armed until the transmitter is heard
+  position.begin(micros());
+  failsafe.begin(micros());
+  wdt_enable(WATCHDOG_TIMEOUT);
+  scheduler.begin(micros());
+}
+
+void loop()
+{
+  // Logging only gets the time no task wants, and only loops that did work are timed
+  PROFILE_START(loopStart);
+  if (scheduler.run())
+  {
+    PROFILE_STOP(LOOP, loopStart);
+  }
+  else
+  {
+    DEBUG_DRAIN();
   }
 }
@@ -0,0 +1,136 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "analogSampler.h"
+
+namespace
+{
+  /* Sampler the ADC interrupt feeds, set by begin() */
+  Analog::Sampler* adcSampler = nullptr;
+}
+
+Analog::Sampler::Sampler()
+  : channels(), count(0), current(0), samples(0), settling(false), sum(0), filtered(), produced(), seeded(0)
+{
+}
+
+uint8_t Analog::Sampler::addChannel(uint8_t pin)
+{
+  if (count >= MAX_CHANNELS)
+  {
+    return NO_SLOT;
+  }
+  channels[count] = pin >= A0 ? pin - A0 : pin;
+  return count++;
+}
+
+void Analog::Sampler::begin()
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  // Digital input buffers only add noise and current on analog pins
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (channels[i] < 8)
+    {
+      DIDR0 |= _BV(channels[i]);
+    }
+    else
+    {
+      DIDR2 |= _BV(channels[i] - 8);
+    }
+  }
+
+  adcSampler = this;
+  ADCSRA = _BV(ADEN) | _BV(ADIE) | PRESCALER_BITS;
+  current = 0;
+  samples = 0;
+  sum = 0;
+  seeded = 0;
+  start(0);
+}
+
+void Analog::Sampler::convert()
+{
+  uint16_t result = ADC;
+  if (settling)
+  {
+    settling = false;
+    ADCSRA |= _BV(ADSC);
+    return;
+  }
+
+  sum += result;
+  if (++samples < BLOCK_SIZE)
+  {
+    ADCSRA |= _BV(ADSC);
+    return;
+  }
+
+  // Decimate, then low pass; the first block seeds the filter, not a wrapped count
+  uint16_t value = (sum >> OVERSAMPLE_BITS) << FILTER_SHIFT;
+  uint16_t old = filtered[current];
+  filtered[current] = seeded & _BV(current) ? old + (int16_t(value - old) >> FILTER_SHIFT) : value;
+  seeded |= _BV(current);
+  produced[current]++;
+  sum = 0;
+  samples = 0;
+
+  start(current + 1 < count ? current + 1 : 0);
+}
+
+uint16_t Analog::Sampler::read(uint8_t slot) const
+{
+  if (slot >= count)
+  {
+    return 0;
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t value = filtered[slot];
+  SREG = oldSREG;
+  return value >> FILTER_SHIFT;
+}
+
+uint8_t Analog::Sampler::blocks(uint8_t slot) const
+{
+  return slot < count ? produced[slot] : 0;
+}
+
+void Analog::Sampler::start(uint8_t slot)
+{
+  settling = slot != current || !(seeded & _BV(slot));
+  current = slot;
+  uint8_t channel = channels[slot];
+  ADMUX = _BV(REFS0) | (channel & 0x07);
+  ADCSRB = (ADCSRB & ~_BV(MUX5)) | (channel & 0x08 ? _BV(MUX5) : 0);
+  ADCSRA |= _BV(ADSC);
+}
+
+ISR(ADC_vect)
+{
+  if (adcSampler)
+  {
+    adcSampler->convert();
+  }
+}
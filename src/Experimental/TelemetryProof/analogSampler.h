@@ -0,0 +1,128 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * AnalogSampler.h - Background ADC sampling with oversampling.
+ *
+ * analogRead() starts a conversion and spins for the 104 us it takes.
+ * Here the ADC complete interrupt stores each result and starts the
+ * next conversion itself, so the ADC runs back to back while loop()
+ * does other work. Each channel is converted 4^OVERSAMPLE_BITS times
+ * in a row and the sum decimated to 10 + OVERSAMPLE_BITS bits, which
+ * averages out noise and, with at least an LSB of it on the input,
+ * resolves below one LSB. Decimated values then go through a first
+ * order low pass.
+ *
+ * Once begin() has run the ADC belongs to the sampler; analogRead()
+ * would fight it for the multiplexer.
+ */
+
+#ifndef ANALOG_SAMPLER_h
+#define ANALOG_SAMPLER_h
+
+#include "Arduino.h"
+
+namespace Analog
+{
+  /* Channels one sampler cycles through */
+  static constexpr uint8_t MAX_CHANNELS = 4;
+
+  /* Each value is the sum of 4^OVERSAMPLE_BITS conversions shifted right by OVERSAMPLE_BITS */
+  static constexpr uint8_t OVERSAMPLE_BITS = 2;
+  static constexpr uint8_t BLOCK_SIZE = 1 << (2 * OVERSAMPLE_BITS);
+
+  /* Resolution of read() */
+  static constexpr uint8_t RESULT_BITS = 10 + OVERSAMPLE_BITS;
+
+  /* Each decimated value moves the output 1/4 of the way */
+  static constexpr uint8_t FILTER_SHIFT = 2;
+
+  /* ADC clock of F_CPU / 128, 125 kHz, so 104 us a conversion */
+  static constexpr uint8_t PRESCALER_BITS = _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+
+  /* Returned by addChannel() when the table is full */
+  static constexpr uint8_t NO_SLOT = 0xFF;
+
+  /*
+   * Sampler class - Keeps a filtered, oversampled reading of a few
+   * analog pins up to date from the ADC interrupt.
+   *
+   * A channel gets a whole block of conversions before the multiplexer
+   * moves on, and the first conversion after a switch is thrown away
+   * while the sample and hold settles to the new source.
+   */
+  class Sampler
+  {
+    public:
+      /* Default Constructor */
+      Sampler();
+
+      /*
+       * Sample another pin. Call before begin().
+       * @param pin Analog pin, A0 to A15
+       * @return Slot to read() it back with, NO_SLOT if full
+       */
+      uint8_t addChannel(uint8_t pin);
+
+      /* Enable the ADC against AVcc and start converting */
+      void begin();
+
+      /* Take the finished conversion and start the next. Called from the ADC interrupt. */
+      void convert();
+
+      /*
+       * Latest filtered value, constant time and safe from the loop
+       * @param slot Slot from addChannel()
+       * @return 0 to 2^RESULT_BITS - 1, 0 until the first block is in
+       */
+      uint16_t read(uint8_t slot) const;
+
+      /* Decimated values produced for a slot, wraps */
+      uint8_t blocks(uint8_t slot) const;
+
+    private:
+      /* Point the multiplexer at a channel and start a conversion */
+      void start(uint8_t slot);
+
+      /* ADC channel of each slot, 0 to 15 */
+      uint8_t channels[MAX_CHANNELS];
+      uint8_t count;
+
+      /* Slot being converted and how far through its block */
+      uint8_t current;
+      uint8_t samples;
+
+      /* Set after a multiplexer switch, the next result is dropped */
+      bool settling;
+
+      /* Running sum of the block */
+      uint16_t sum;
+
+      /* Filtered values, RESULT_BITS with FILTER_SHIFT extra fraction bits */
+      volatile uint16_t filtered[MAX_CHANNELS];
+
+      /* Blocks per slot, free running for blocks() */
+      volatile uint8_t produced[MAX_CHANNELS];
+
+      /* Bit per slot whose filter has been seeded with a first block */
+      uint8_t seeded;
+  };
+}
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <avr/eeprom.h>
+
+#include "calibration.h"
+
+namespace
+{
+  uint16_t crcWord(uint16_t crc, uint16_t word)
+  {
+    return Config::crc16(Config::crc16(crc, uint8_t(word)), uint8_t(word >> 8));
+  }
+}
+
+uint16_t Config::crc16(uint16_t crc, uint8_t data)
+{
+  crc ^= uint16_t(data) << 8;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    crc = crc & 0x8000 ? uint16_t(crc << 1) ^ 0x1021 : uint16_t(crc << 1);
+  }
+  return crc;
+}
+
+uint16_t Config::checksum(const Calibration& calibration)
+{
+  uint16_t crc = crcWord(0xFFFF, uint16_t(calibration.oscillator));
+  crc = crcWord(crc, uint16_t(calibration.oscillator >> 16));
+  for (uint8_t i = 0; i < Data::NUM_STICKS; i++)
+  {
+    crc = crcWord(crc, calibration.sticks[i].low);
+    crc = crcWord(crc, calibration.sticks[i].centre);
+    crc = crcWord(crc, calibration.sticks[i].high);
+  }
+  return crc;
+}
+
+bool Config::plausible(const Data::StickRange& stick)
+{
+  return stick.centre >= stick.low + MIN_HALF_TRAVEL && stick.high >= stick.centre + MIN_HALF_TRAVEL;
+}
+
+bool Config::valid(const Calibration& calibration)
+{
+  if (calibration.version != CALIBRATION_VERSION || calibration.crc != checksum(calibration))
+  {
+    return false;
+  }
+  if (calibration.oscillator < MIN_OSCILLATOR || calibration.oscillator > MAX_OSCILLATOR)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < Data::NUM_STICKS; i++)
+  {
+    if (!plausible(calibration.sticks[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Config::load(Calibration& calibration, const Calibration& defaults, uint16_t address)
+{
+  eeprom_read_block(&calibration, reinterpret_cast<const void*>(address), sizeof(calibration));
+  if (valid(calibration))
+  {
+    return true;
+  }
+  calibration = defaults;
+  return false;
+}
+
+Config::CalibrationWriter::CalibrationWriter(uint16_t address)
+  : record(), address(address), next(0), writing(false)
+{
+}
+
+void Config::CalibrationWriter::save(const Calibration& calibration)
+{
+  record = calibration;
+  record.version = CALIBRATION_VERSION;
+  record.crc = checksum(record);
+  next = 0;
+  writing = true;
+}
+
+bool Config::CalibrationWriter::poll()
+{
+  if (!writing || !eeprom_is_ready())
+  {
+    return false;
+  }
+  // Unchanged bytes cost nothing, so carry on to the first one that needs a write
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+  uint8_t* stored = reinterpret_cast<uint8_t*>(address);
+  while (next < sizeof(record) && eeprom_read_byte(stored + next) == bytes[next])
+  {
+    next++;
+  }
+  if (next < sizeof(record))
+  {
+    eeprom_update_byte(stored + next, bytes[next]);
+    next++;
+  }
+  writing = next < sizeof(record);
+  return !writing;
+}
+
+bool Config::CalibrationWriter::busy() const
+{
+  return writing;
+}
+
+Config::StickCalibrator::StickCalibrator(uint8_t sprung)
+  : seen(), sprung(sprung), sampled(false)
+{
+}
+
+void Config::StickCalibrator::begin()
+{
+  sampled = false;
+}
+
+void Config::StickCalibrator::sample(const uint16_t raw[Data::NUM_STICKS])
+{
+  for (uint8_t i = 0; i < Data::NUM_STICKS; i++)
+  {
+    Data::StickRange& stick = seen[i];
+    if (!sampled)
+    {
+      stick.low = stick.high = raw[i];
+    }
+    stick.low = raw[i] < stick.low ? raw[i] : stick.low;
+    stick.high = raw[i] > stick.high ? raw[i] : stick.high;
+    stick.centre = raw[i];
+  }
+  sampled = true;
+}
+
+uint8_t Config::StickCalibrator::finish(Data::StickRange sticks[Data::NUM_STICKS]) const
+{
+  if (!sampled)
+  {
+    return 0;
+  }
+  uint8_t first = Data::NUM_STICKS;
+  for (uint8_t i = Data::NUM_STICKS; i-- > 0;)
+  {
+    sticks[i] = seen[i];
+    if (!(sprung & _BV(i)))
+    {
+      sticks[i].centre = (seen[i].low + seen[i].high) / 2;
+    }
+    if (!plausible(sticks[i]))
+    {
+      first = i;
+    }
+  }
+  return first;
+}
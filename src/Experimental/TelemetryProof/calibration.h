@@ -0,0 +1,181 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Calibration.h - Per-boat settings kept in EEPROM across power cycles.
+ *
+ * The record is a fixed size and sits at a fixed address, so loading it
+ * at boot is one block read and a CRC over a few dozen bytes. It starts
+ * with a layout version and a CRC-16 of the fields after it; a record
+ * from another version, a blank EEPROM or one damaged by losing power
+ * half way through a save is ignored and the defaults used instead.
+ *
+ * An EEPROM byte takes 3.4 ms to write, so a save would hold the loop
+ * up for the best part of the watchdog period. CalibrationWriter writes
+ * one byte per poll() instead, and only when the last has finished.
+ */
+
+#ifndef CALIBRATION_h
+#define CALIBRATION_h
+
+#include "Arduino.h"
+#include "dataUtils.h"
+
+namespace Config
+{
+  /* Bump whenever Calibration changes, so an old record is never read as the new layout */
+  static constexpr uint16_t CALIBRATION_VERSION = 1;
+
+  /* Where the record starts in EEPROM */
+  static constexpr uint16_t CALIBRATION_ADDRESS = 0;
+
+  /* Least raw travel either side of a stick's centre worth believing */
+  static constexpr uint16_t MIN_HALF_TRAVEL = 150;
+
+  /* The PCA9685's oscillator is nominally 25 MHz; anything outside this is not a measurement */
+  static constexpr uint32_t MIN_OSCILLATOR = 20000000;
+  static constexpr uint32_t MAX_OSCILLATOR = 30000000;
+
+  /* The record as it is stored */
+  struct Calibration
+  {
+    /* CALIBRATION_VERSION when it was written */
+    uint16_t version;
+
+    /* checksum() of everything below */
+    uint16_t crc;
+
+    /* Measured PCA9685 oscillator in Hz */
+    uint32_t oscillator;
+
+    /* Raw travel of each stick, indexed by Data::*_STICK */
+    Data::StickRange sticks[Data::NUM_STICKS];
+  };
+
+  /*
+   * Step a CRC-16/CCITT (polynomial 0x1021) over one byte
+   * @param crc CRC so far, 0xFFFF to start
+   * @param data Next byte
+   * @return Updated CRC
+   */
+  uint16_t crc16(uint16_t crc, uint8_t data);
+
+  /* CRC-16 of the fields after crc, low byte first, whatever the compiler's layout */
+  uint16_t checksum(const Calibration& calibration);
+
+  /* Whether a stick's centre is far enough inside its travel */
+  bool plausible(const Data::StickRange& stick);
+
+  /* Whether a record is this version, passes its CRC and holds usable values */
+  bool valid(const Calibration& calibration);
+
+  /*
+   * Read the record from EEPROM
+   * @param calibration Filled with the record, or the defaults if it is not valid()
+   * @param defaults Used when nothing usable is stored
+   * @param address Where the record starts
+   * @return true if the stored record was used
+   */
+  bool load(Calibration& calibration, const Calibration& defaults, uint16_t address = CALIBRATION_ADDRESS);
+
+  /*
+   * CalibrationWriter class - Saves a record to EEPROM a byte at a time
+   * without ever waiting on the EEPROM.
+   *
+   * Only bytes that differ from what is stored are written, so saving an
+   * unchanged record costs no EEPROM wear.
+   */
+  class CalibrationWriter
+  {
+    public:
+      /* @param address Where the record starts */
+      CalibrationWriter(uint16_t address = CALIBRATION_ADDRESS);
+
+      /*
+       * Stamp a copy with the version and CRC and start writing it,
+       * dropping any save still in progress
+       * @param calibration Record to save
+       */
+      void save(const Calibration& calibration);
+
+      /*
+       * Write the next byte, if the EEPROM has finished the last one
+       * @return true once the last byte of a save has been handed over
+       */
+      bool poll();
+
+      /* true while a save still has bytes to write */
+      bool busy() const;
+
+    private:
+      /* The stamped copy being written */
+      Calibration record;
+
+      uint16_t address;
+
+      /* Next byte of record to write */
+      uint8_t next;
+
+      bool writing;
+  };
+
+  /*
+   * StickCalibrator class - Learns the raw travel of each stick while
+   * the pilot moves them all to both ends and lets go.
+   *
+   * The ends are the furthest values seen. A sprung stick's centre is
+   * where it was last seen, which is at rest once it has been let go;
+   * the centre of any other, like the throttle, is the middle of its
+   * travel.
+   */
+  class StickCalibrator
+  {
+    public:
+      /* @param sprung Bit per Data::*_STICK that springs back to its centre */
+      StickCalibrator(uint8_t sprung);
+
+      /* Forget everything seen so far */
+      void begin();
+
+      /*
+       * Take in one frame
+       * @param raw Raw channel value of each stick, indexed by Data::*_STICK
+       */
+      void sample(const uint16_t raw[Data::NUM_STICKS]);
+
+      /*
+       * Work out the ranges seen since begin()
+       * @param sticks Filled with each stick's range
+       * @return Data::NUM_STICKS if every range is plausible(), otherwise
+       * the first stick that was not moved far enough
+       */
+      uint8_t finish(Data::StickRange sticks[Data::NUM_STICKS]) const;
+
+    private:
+      /* Furthest each way and latest value of each stick */
+      Data::StickRange seen[Data::NUM_STICKS];
+
+      uint8_t sprung;
+
+      /* A frame has been taken since begin() */
+      bool sampled;
+  };
+}
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "compass.h"
+#include "dataUtils.h"
+
+namespace
+{
+  /* LSM303DLHC registers and settings */
+  constexpr uint8_t CTRL_REG1_A = 0x20;
+  constexpr uint8_t CTRL_REG4_A = 0x23;
+  constexpr uint8_t OUT_X_L_A = 0x28;
+  constexpr uint8_t AUTO_INCREMENT_A = 0x80;
+  constexpr uint8_t ACCEL_100HZ_XYZ = 0x57;
+  constexpr uint8_t ACCEL_BDU_HR_2G = 0x88;
+
+  constexpr uint8_t CRA_REG_M = 0x00;
+  constexpr uint8_t CRB_REG_M = 0x01;
+  constexpr uint8_t MR_REG_M = 0x02;
+  constexpr uint8_t OUT_X_H_M = 0x03;
+  constexpr uint8_t MAG_75HZ = 0x18;
+  constexpr uint8_t MAG_1_3_GAUSS = 0x20;
+  constexpr uint8_t MAG_CONTINUOUS = 0x00;
+
+  /* At +-1.3 gauss z gives 980 counts per gauss to x and y's 1100; this is 1100 / 980 in Q10 */
+  constexpr int32_t MAG_Z_SCALE = 1149;
+
+  /* atan(i / 32) as a binary angle, 45 degrees is 8192 */
+  constexpr uint8_t ATAN_STEPS = 32;
+  const uint16_t ATAN_TABLE[ATAN_STEPS + 1] PROGMEM = {
+    0, 326, 651, 975, 1297, 1617, 1933, 2246,
+    2555, 2860, 3159, 3453, 3742, 4025, 4302, 4572,
+    4836, 5094, 5344, 5589, 5826, 6058, 6282, 6500,
+    6712, 6917, 7117, 7310, 7498, 7679, 7856, 8026,
+    8192
+  };
+
+  /* Bits of the Q16 ratio below a table step */
+  constexpr uint8_t STEP_BITS = 11;
+}
+
+uint16_t Sensor::atan2Angle(int32_t y, int32_t x)
+{
+  uint32_t ax = x < 0 ? 0 - uint32_t(x) : uint32_t(x);
+  uint32_t ay = y < 0 ? 0 - uint32_t(y) : uint32_t(y);
+  if ((ax | ay) == 0)
+  {
+    return 0;
+  }
+
+  // Small enough that the Q16 ratio fits 32 bits
+  while ((ax | ay) >> 16)
+  {
+    ax >>= 1;
+    ay >>= 1;
+  }
+
+  // First octant from the table, then mirrored out to the right one
+  bool steep = ay > ax;
+  uint32_t ratio = steep ? (ax << 16) / ay : (ay << 16) / ax;
+  uint8_t index = ratio >> STEP_BITS;
+  uint16_t angle = pgm_read_word(&ATAN_TABLE[index]);
+  if (index < ATAN_STEPS)
+  {
+    uint16_t next = pgm_read_word(&ATAN_TABLE[index + 1]);
+    angle += (uint32_t(next - angle) * (ratio & ((1 << STEP_BITS) - 1))) >> STEP_BITS;
+  }
+
+  if (steep)
+  {
+    angle = FULL_TURN / 4 - angle;
+  }
+  if (x < 0)
+  {
+    angle = FULL_TURN / 2 - angle;
+  }
+  if (y < 0)
+  {
+    angle = FULL_TURN - angle;
+  }
+  return angle;
+}
+
+uint16_t Sensor::tiltHeading(const Vector& accel, const Vector& mag)
+{
+  // East x component, and east's y and z for north; scaled down so north fits 32 bits
+  int32_t eastX = (int32_t(mag.y) * accel.z - int32_t(mag.z) * accel.y) >> 8;
+  int32_t eastY = (int32_t(mag.z) * accel.x - int32_t(mag.x) * accel.z) >> 8;
+  int32_t eastZ = (int32_t(mag.x) * accel.y - int32_t(mag.y) * accel.x) >> 8;
+  int32_t northX = int32_t(accel.y) * eastZ - int32_t(accel.z) * eastY;
+
+  // North is |accel| times longer than east
+  uint32_t gravity = Data::isqrt(int32_t(accel.x) * accel.x + int32_t(accel.y) * accel.y + int32_t(accel.z) * accel.z);
+  return atan2Angle(eastX * int32_t(gravity), northX);
+}
+
+uint16_t Sensor::angleDegrees(uint16_t angle)
+{
+  uint16_t degrees = (uint32_t(angle) * 360 + FULL_TURN / 2) >> 16;
+  return degrees == 360 ? 0 : degrees;
+}
+
+Sensor::Compass::Compass(TwoWire& wire)
+  : wire(wire), magTurn(false), configured(false), haveAccel(false), started(false),
+    healthy(false), filtered(0), faults(0)
+{
+  accel[0] = accel[1] = accel[2] = 0;
+  mag.x = mag.y = mag.z = 0;
+  offset.x = offset.y = offset.z = 0;
+}
+
+bool Sensor::Compass::begin()
+{
+  configured = writeRegister(LSM303_ACCEL_ADDRESS, CTRL_REG1_A, ACCEL_100HZ_XYZ)
+    && writeRegister(LSM303_ACCEL_ADDRESS, CTRL_REG4_A, ACCEL_BDU_HR_2G)
+    && writeRegister(LSM303_MAG_ADDRESS, CRA_REG_M, MAG_75HZ)
+    && writeRegister(LSM303_MAG_ADDRESS, CRB_REG_M, MAG_1_3_GAUSS)
+    && writeRegister(LSM303_MAG_ADDRESS, MR_REG_M, MAG_CONTINUOUS);
+  if (!configured)
+  {
+    faults++;
+  }
+  return configured;
+}
+
+bool Sensor::Compass::update()
+{
+  if (!configured && !begin())
+  {
+    healthy = false;
+    return false;
+  }
+
+  if (!(magTurn ? readMag() : readAccel()))
+  {
+    faults++;
+    healthy = false;
+    return false;
+  }
+
+  bool ready = magTurn && haveAccel;
+  magTurn = !magTurn;
+  return ready;
+}
+
+void Sensor::Compass::fuse()
+{
+  Vector smoothed;
+  smoothed.x = accel[0] >> HEADING_FILTER_SHIFT;
+  smoothed.y = accel[1] >> HEADING_FILTER_SHIFT;
+  smoothed.z = accel[2] >> HEADING_FILTER_SHIFT;
+
+  Vector field;
+  field.x = mag.x - offset.x;
+  field.y = mag.y - offset.y;
+  field.z = mag.z - offset.z;
+
+  uint16_t measured = tiltHeading(smoothed, field);
+  if (!started)
+  {
+    filtered = uint32_t(measured) << 16;
+    started = true;
+  }
+  else
+  {
+    // The difference as a signed binary angle is the short way round
+    int16_t error = int16_t(measured - uint16_t(filtered >> 16));
+    filtered += uint32_t(int32_t(error) * (int32_t(1) << (16 - HEADING_FILTER_SHIFT)));
+  }
+  healthy = true;
+}
+
+void Sensor::Compass::calibrate(const Vector& hardIron)
+{
+  offset = hardIron;
+}
+
+uint16_t Sensor::Compass::heading() const
+{
+  return filtered >> 16;
+}
+
+uint16_t Sensor::Compass::degrees() const
+{
+  return angleDegrees(heading());
+}
+
+bool Sensor::Compass::valid() const
+{
+  return started && healthy;
+}
+
+uint16_t Sensor::Compass::errors() const
+{
+  return faults;
+}
+
+bool Sensor::Compass::writeRegister(uint8_t address, uint8_t reg, uint8_t value)
+{
+  wire.beginTransmission(address);
+  wire.write(reg);
+  wire.write(value);
+  return wire.endTransmission() == 0;
+}
+
+bool Sensor::Compass::readBlock(uint8_t address, uint8_t reg, uint8_t data[6])
+{
+  wire.beginTransmission(address);
+  wire.write(reg);
+  if (wire.endTransmission() != 0 || wire.requestFrom(address, uint8_t(6)) != 6)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < 6; i++)
+  {
+    data[i] = wire.read();
+  }
+  return true;
+}
+
+bool Sensor::Compass::readAccel()
+{
+  uint8_t data[6];
+  if (!readBlock(LSM303_ACCEL_ADDRESS, OUT_X_L_A | AUTO_INCREMENT_A, data))
+  {
+    return false;
+  }
+
+  // Little endian and left justified; 12 bits at 1 mg in high resolution mode
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    int32_t sample = int16_t(uint16_t(data[2 * i + 1]) << 8 | data[2 * i]) >> 4;
+    if (haveAccel)
+    {
+      accel[i] += sample - (accel[i] >> HEADING_FILTER_SHIFT);
+    }
+    else
+    {
+      accel[i] = sample * (1 << HEADING_FILTER_SHIFT);
+    }
+  }
+  haveAccel = true;
+  return true;
+}
+
+bool Sensor::Compass::readMag()
+{
+  uint8_t data[6];
+  if (!readBlock(LSM303_MAG_ADDRESS, OUT_X_H_M, data))
+  {
+    return false;
+  }
+
+  // Big endian, in the order x, z, y
+  mag.x = int16_t(uint16_t(data[0]) << 8 | data[1]);
+  mag.z = (int32_t(int16_t(uint16_t(data[2]) << 8 | data[3])) * MAG_Z_SCALE) >> 10;
+  mag.y = int16_t(uint16_t(data[4]) << 8 | data[5]);
+  return true;
+}
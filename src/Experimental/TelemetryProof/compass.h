@@ -0,0 +1,161 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compass.h - Tilt-compensated heading from an LSM303DLHC.
+ */
+
+#ifndef COMPASS_h
+#define COMPASS_h
+
+#include "Arduino.h"
+#include <Wire.h>
+
+namespace Sensor
+{
+  /* The LSM303DLHC is two devices on the bus */
+  static constexpr uint8_t LSM303_ACCEL_ADDRESS = 0x19;
+  static constexpr uint8_t LSM303_MAG_ADDRESS = 0x1E;
+
+  /* Angles are binary: a full turn is 65536, so they wrap for free */
+  static constexpr uint32_t FULL_TURN = 65536;
+
+  /* Each filter step takes 1 / 2^HEADING_FILTER_SHIFT of the new heading */
+  static constexpr uint8_t HEADING_FILTER_SHIFT = 2;
+
+  /*
+   * One reading per axis. Mount the board with x to the bow, y to port
+   * and z up, so a level board reads +1 g on z.
+   */
+  struct Vector
+  {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+  };
+
+  /*
+   * Angle of (x, y) from the x axis, from a 33 entry table with linear
+   * interpolation; good to about 0.01 degrees
+   * @return Binary angle, 0 for (0, 0)
+   */
+  uint16_t atan2Angle(int32_t y, int32_t x);
+
+  /*
+   * Heading of the x axis from north with any tilt taken out. East is
+   * mag x accel and north is accel x east, so only cross products, one
+   * square root and one atan2 are needed, all in integers.
+   * @param accel Accelerometer in mg
+   * @param mag Magnetometer in counts, hard iron already removed
+   * @return Binary angle, clockwise from magnetic north
+   */
+  uint16_t tiltHeading(const Vector& accel, const Vector& mag);
+
+  /* Binary angle to whole degrees, 0 to 359 */
+  uint16_t angleDegrees(uint16_t angle);
+
+  /*
+   * Compass class - Reads the accelerometer and magnetometer in turn and
+   * smooths the heading they give.
+   *
+   * Both parts free-run, so update() never waits: one call reads the
+   * accelerometer and the next the magnetometer, each a single short
+   * transaction. Once it has both, update() returns true and fuse() turns
+   * them into a heading. The LSM303 has no gyro, so the filter is the
+   * slow half of a complementary filter only: a first order low pass on
+   * the accelerometer and on the heading, the heading one taking the
+   * short way round through north.
+   */
+  class Compass
+  {
+    public:
+      /*
+       * @param wire Bus the LSM303 is on
+       */
+      Compass(TwoWire& wire = Wire);
+
+      /*
+       * Start both parts measuring: accelerometer at 100 Hz, +-2 g, high
+       * resolution; magnetometer at 75 Hz, +-1.3 gauss
+       * @return false if either did not answer; update() tries again
+       */
+      bool begin();
+
+      /*
+       * Read the next part
+       * @return true when a new accelerometer and magnetometer pair is ready for fuse()
+       */
+      bool update();
+
+      /* Update the heading from the latest pair */
+      void fuse();
+
+      /*
+       * Hard iron offsets, subtracted from every magnetometer reading
+       * @param offset Counts to remove on each axis
+       */
+      void calibrate(const Vector& offset);
+
+      /* Filtered heading as a binary angle */
+      uint16_t heading() const;
+
+      /* Filtered heading in degrees, 0 to 359 */
+      uint16_t degrees() const;
+
+      /* True once there is a heading and the last reads worked */
+      bool valid() const;
+
+      /* Failed reads and configurations since start */
+      uint16_t errors() const;
+
+    private:
+      /* Write one register */
+      bool writeRegister(uint8_t address, uint8_t reg, uint8_t value);
+
+      /* Read 6 output bytes starting at reg */
+      bool readBlock(uint8_t address, uint8_t reg, uint8_t data[6]);
+
+      bool readAccel();
+      bool readMag();
+
+      TwoWire& wire;
+
+      /* Next update() reads the magnetometer */
+      bool magTurn;
+
+      /* Chips set up, an accelerometer reading is in, fuse() has run, the last read worked */
+      bool configured;
+      bool haveAccel;
+      bool started;
+      bool healthy;
+
+      /* Accelerometer low pass, mg << HEADING_FILTER_SHIFT */
+      int32_t accel[3];
+
+      Vector mag;
+      Vector offset;
+
+      /* Heading, binary angle << 16 */
+      uint32_t filtered;
+
+      uint16_t faults;
+  };
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Connections.h - Where each part of the boat is wired on the Mega 2560,
+ * and which PCA9685 channel drives each servo. Host tests and tools
+ * include this too, so they look at the same pins the sketch drives.
+ */
+
+#ifndef CONNECTIONS_h
+#define CONNECTIONS_h
+
+#include "Arduino.h"
+
+constexpr uint8_t HEARTBEAT_LED_PIN = 8;
+
+constexpr uint8_t WATER_SOLENOID_PIN = 27;
+constexpr uint8_t ENGINE_INPUT_1 = 22;
+constexpr uint8_t ENGINE_INPUT_2 = 23;
+constexpr uint8_t ENGINE_PWM = 11;
+constexpr uint8_t ENGINE_ENCODER_TRIGGER_1 = 2;
+constexpr uint8_t ENGINE_ENCODER_TRIGGER_2 = 3;
+constexpr uint8_t ENGINE_ENCODER_DIRECTION = 48; // Latched direction, only for ENGINE_HARDWARE_COUNTER
+
+constexpr uint8_t WATER_PUMP_INPUT_1 = 24;
+constexpr uint8_t WATER_PUMP_INPUT_2 = 25;
+
+/* Servo channels on the PCA9685 */
+constexpr uint8_t RUDDER = 0;
+constexpr uint8_t DIVE_PLANE = 1;
+
+#endif
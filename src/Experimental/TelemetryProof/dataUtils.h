@@ -37,6 +37,26 @@ namespace Data
   static constexpr uint32_t MIN_DIVE_PLANE_ANGLE = (-15 / (double)DEGREES_OF_TRAVEL) * (MAX_MICROSECONDS - MIN_MICROSECONDS) + MID_POINT;
   static constexpr uint32_t MAX_DIVE_PLANE_ANGLE = (15 / (double)DEGREES_OF_TRAVEL) * (MAX_MICROSECONDS - MIN_MICROSECONDS) + MID_POINT;
 
+  /* Raw channel values a stick gives at either end of its travel and at rest */
+  struct StickRange
+  {
+    uint16_t low;
+    uint16_t centre;
+    uint16_t high;
+  };
+
+  /* Sticks with a calibrated range, in StickRange tables */
+  static constexpr uint8_t RUDDER_STICK = 0;
+  static constexpr uint8_t DIVE_PLANE_STICK = 1;
+  static constexpr uint8_t THROTTLE_STICK = 2;
+  static constexpr uint8_t NUM_STICKS = 3;
+
+  /* What the stick maps assume every stick gives */
+  static constexpr StickRange NOMINAL_STICK = { MIN_RAW_INPUT, MID_RAW_INPUT, MAX_RAW_INPUT };
+
+  /* Largest root with root * root <= value, bit by bit without a divide */
+  uint32_t isqrt(uint32_t value);
+
   /* Possible switch positions */
   enum class SwitchPos
   {
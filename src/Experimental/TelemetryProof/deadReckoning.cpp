@@ -0,0 +1,157 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "deadReckoning.h"
+#include "compass.h"
+#include "dataUtils.h"
+
+namespace
+{
+  /* sin(i * 90 / 64 degrees) << SINE_SHIFT */
+  constexpr uint8_t SINE_STEPS = 64;
+  const int16_t SINE_TABLE[SINE_STEPS + 1] PROGMEM = {
+    0, 402, 804, 1205, 1606, 2006, 2404, 2801,
+    3196, 3590, 3981, 4370, 4756, 5139, 5520, 5897,
+    6270, 6639, 7005, 7366, 7723, 8076, 8423, 8765,
+    9102, 9434, 9760, 10080, 10394, 10702, 11003, 11297,
+    11585, 11866, 12140, 12406, 12665, 12916, 13160, 13395,
+    13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978,
+    15137, 15286, 15426, 15557, 15679, 15791, 15893, 15986,
+    16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379,
+    16384
+  };
+
+  /* Binary angle bits below a table step */
+  constexpr uint8_t STEP_BITS = 8;
+
+  /*
+   * mm/s << (SINE_SHIFT - POSITION_SHIFT) times time steps, divided by this,
+   * is mm << POSITION_SHIFT
+   */
+  constexpr int32_t STEPS_PER_SECOND = 1000000 >> Navigation::TIME_SHIFT;
+
+  /* Time steps integrated at once; the product stays in 32 bits up to MAX_SPEED */
+  constexpr uint16_t MAX_STEPS = 512;
+
+  /* One axis of movement over up to MAX_STEPS */
+  int32_t advance(int32_t velocity, uint16_t steps, int32_t& remainder)
+  {
+    int32_t travelled = velocity * int32_t(steps) + remainder;
+    int32_t whole = travelled / STEPS_PER_SECOND;
+    remainder = travelled - whole * STEPS_PER_SECOND;
+    return whole;
+  }
+}
+
+int16_t Navigation::sine(uint16_t angle)
+{
+  // Fold into the first quadrant and put the sign back at the end
+  bool negative = angle >= 0x8000;
+  uint16_t quarter = angle & 0x7FFF;
+  if (quarter > 0x4000)
+  {
+    quarter = 0x8000 - quarter;
+  }
+
+  uint8_t index = quarter >> STEP_BITS;
+  int16_t value = pgm_read_word(&SINE_TABLE[index]);
+  if (index < SINE_STEPS)
+  {
+    int16_t next = pgm_read_word(&SINE_TABLE[index + 1]);
+    value += (int32_t(next - value) * (quarter & ((1 << STEP_BITS) - 1))) >> STEP_BITS;
+  }
+  return negative ? -value : value;
+}
+
+int16_t Navigation::cosine(uint16_t angle)
+{
+  return sine(angle + Sensor::FULL_TURN / 4);
+}
+
+Navigation::DeadReckoning::DeadReckoning()
+  : northPosition(0), eastPosition(0), northRemainder(0), eastRemainder(0), lastDepth(0), integrated(0)
+{
+}
+
+void Navigation::DeadReckoning::begin(uint32_t now)
+{
+  northPosition = eastPosition = 0;
+  northRemainder = eastRemainder = 0;
+  integrated = now;
+}
+
+void Navigation::DeadReckoning::update(uint32_t now, int32_t speed, uint16_t heading, int32_t depth)
+{
+  lastDepth = depth;
+
+  // Whole time steps only; the rest is carried into the next update
+  uint32_t steps = (now - integrated) >> TIME_SHIFT;
+  integrated += steps << TIME_SHIFT;
+
+  speed = constrain(speed, -MAX_SPEED, MAX_SPEED);
+  int32_t northSpeed = (speed * cosine(heading)) >> (SINE_SHIFT - POSITION_SHIFT);
+  int32_t eastSpeed = (speed * sine(heading)) >> (SINE_SHIFT - POSITION_SHIFT);
+
+  // A late update is integrated in pieces rather than overflowing
+  while (steps)
+  {
+    uint16_t chunk = steps < MAX_STEPS ? steps : MAX_STEPS;
+    northPosition += advance(northSpeed, chunk, northRemainder);
+    eastPosition += advance(eastSpeed, chunk, eastRemainder);
+    steps -= chunk;
+  }
+}
+
+int32_t Navigation::DeadReckoning::north() const
+{
+  return northPosition >> POSITION_SHIFT;
+}
+
+int32_t Navigation::DeadReckoning::east() const
+{
+  return eastPosition >> POSITION_SHIFT;
+}
+
+int32_t Navigation::DeadReckoning::depth() const
+{
+  return lastDepth;
+}
+
+uint32_t Navigation::DeadReckoning::distanceHome() const
+{
+  // Scale both down until their squares sum in 32 bits, then back up
+  uint32_t n = northPosition < 0 ? 0 - uint32_t(northPosition) : uint32_t(northPosition);
+  uint32_t e = eastPosition < 0 ? 0 - uint32_t(eastPosition) : uint32_t(eastPosition);
+  uint8_t shift = 0;
+  while ((n | e) >> 15)
+  {
+    n >>= 1;
+    e >>= 1;
+    shift++;
+  }
+
+  uint32_t root = Data::isqrt(n * n + e * e);
+
+  return shift >= POSITION_SHIFT ? root << (shift - POSITION_SHIFT) : root >> (POSITION_SHIFT - shift);
+}
+
+uint16_t Navigation::DeadReckoning::bearingHome() const
+{
+  return Sensor::atan2Angle(-int32_t(eastPosition), -int32_t(northPosition));
+}
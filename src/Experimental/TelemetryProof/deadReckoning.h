@@ -0,0 +1,117 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * DeadReckoning.h - Position from speed, heading and depth.
+ */
+
+#ifndef DEAD_RECKONING_h
+#define DEAD_RECKONING_h
+
+#include "Arduino.h"
+
+/* Holds the position estimate */
+namespace Navigation
+{
+  /* Position fraction bits; a 32 bit position reaches about 8 km from home */
+  static constexpr uint8_t POSITION_SHIFT = 8;
+
+  /* Time is integrated in steps of this many microseconds */
+  static constexpr uint8_t TIME_SHIFT = 6;
+
+  /* Fastest speed integrated, mm/s; anything faster is taken as this */
+  static constexpr int32_t MAX_SPEED = 16000;
+
+  /* Fraction bits of sine() */
+  static constexpr uint8_t SINE_SHIFT = 14;
+
+  /*
+   * Sine of a binary angle (65536 a turn) from a 65 entry quarter wave
+   * table with linear interpolation
+   * @return Sine << SINE_SHIFT
+   */
+  int16_t sine(uint16_t angle);
+
+  /* Cosine of a binary angle, << SINE_SHIFT */
+  int16_t cosine(uint16_t angle);
+
+  /*
+   * DeadReckoning class - Integrates the boat's track from where it was
+   * started.
+   *
+   * Each update() moves the position along the heading by speed times
+   * the time since the last one. Positions are millimetres north and
+   * east of home with POSITION_SHIFT fraction bits. The division by the
+   * time unit keeps its remainder for the next step, so slow speeds and
+   * short ticks add up exactly rather than rounding away. The speed is
+   * the screw's, so current and slip are not seen; treat the estimate as
+   * drifting a few percent of the distance run.
+   */
+  class DeadReckoning
+  {
+    public:
+      DeadReckoning();
+
+      /*
+       * Make here home
+       * @param now micros()
+       */
+      void begin(uint32_t now);
+
+      /*
+       * Move the position on to now
+       * @param now micros()
+       * @param speed Through the water in mm/s, negative going astern
+       * @param heading Binary angle clockwise from north
+       * @param depth Millimetres below the surface
+       */
+      void update(uint32_t now, int32_t speed, uint16_t heading, int32_t depth);
+
+      /* Millimetres north of home */
+      int32_t north() const;
+
+      /* Millimetres east of home */
+      int32_t east() const;
+
+      /* Millimetres below the surface, as last given */
+      int32_t depth() const;
+
+      /* Straight line distance to home across the surface in millimetres */
+      uint32_t distanceHome() const;
+
+      /* Binary angle clockwise from north that points home */
+      uint16_t bearingHome() const;
+
+    private:
+      /* Position, mm << POSITION_SHIFT */
+      int32_t northPosition;
+      int32_t eastPosition;
+
+      /* What the last steps' divisions left over */
+      int32_t northRemainder;
+      int32_t eastRemainder;
+
+      int32_t lastDepth;
+
+      /* micros() integrated up to, a whole number of time steps */
+      uint32_t integrated;
+  };
+}
+
+#endif
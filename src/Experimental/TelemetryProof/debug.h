@@ -17,44 +17,49 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+/*
+ * Debug.h - Logging macros, compiled in by level.
+ *
+ * Define one of DEBUG_TRACE, DEBUG_ERROR, DEBUG_WARN or DEBUG_INFO
+ * before including this. Each level also turns on the ones after it in
+ * that list. Messages go into the binary ring in log.h and reach the
+ * serial port through DEBUG_DRAIN; decode them with host/tools/log_decode.
+ */
+
 #ifndef DEBUG_h
 #define DEBUG_h
 
+#include "log.h"
+
 #if defined(DEBUG_TRACE)
-  #define DEBUG_PRINT_TRACE(x)    Serial.print(x)
-  #define DEBUG_PRINTLN_TRACE(x)  Serial.println(x)
+  #define LOG_TRACE(...)          Log::write(Log::LEVEL_TRACE, __VA_ARGS__)
   #define DEBUG_ERROR
 #else
-  #define DEBUG_PRINT_TRACE(x)
-  #define DEBUG_PRINTLN_TRACE(x)
+  #define LOG_TRACE(...)
 #endif
 
 #if defined(DEBUG_ERROR)
-  #define DEBUG_PRINT_ERROR(x)    Serial.print(x)
-  #define DEBUG_PRINTLN_ERROR(x)  Serial.println(x)
+  #define LOG_ERROR(...)          Log::write(Log::LEVEL_ERROR, __VA_ARGS__)
   #define DEBUG_WARN
 #else
-  #define DEBUG_PRINT_ERROR(x)
-  #define DEBUG_PRINTLN_ERROR(x)
+  #define LOG_ERROR(...)
 #endif
 
 #if defined(DEBUG_WARN)
-  #define DEBUG_PRINT_WARN(x)     Serial.print(x)
-  #define DEBUG_PRINTLN_WARN(x)   Serial.println(x)
+  #define LOG_WARN(...)           Log::write(Log::LEVEL_WARN, __VA_ARGS__)
   #define DEBUG_INFO
 #else
-  #define DEBUG_PRINT_WARN(x)
-  #define DEBUG_PRINTLN_WARN(x)
+  #define LOG_WARN(...)
 #endif
 
 #if defined(DEBUG_INFO)
   #define DEBUG_BEGIN(x)          Serial.begin(x)
-  #define DEBUG_PRINT_INFO(x)     Serial.print(x)
-  #define DEBUG_PRINTLN_INFO(x)   Serial.println(x)
+  #define DEBUG_DRAIN()           Log::drain(Serial)
+  #define LOG_INFO(...)           Log::write(Log::LEVEL_INFO, __VA_ARGS__)
 #else
   #define DEBUG_BEGIN(x)
-  #define DEBUG_PRINT_INFO(x)
-  #define DEBUG_PRINTLN_INFO(x)
+  #define DEBUG_DRAIN()
+  #define LOG_INFO(...)
 #endif
 
 #endif
@@ -0,0 +1,107 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "depthHold.h"
+
+Ballast::DepthHold::DepthHold(uint32_t period, const DepthGains& gains)
+  : gains(gains), ticksPerSecond(1000000 / period), target(0), lastDepth(0), filteredRate(0), filteredAccel(0),
+    action(HOLD), since(0), planeWidth(Data::MID_POINT), actionChanges(0)
+{
+}
+
+void Ballast::DepthHold::begin(uint32_t now, int32_t depth)
+{
+  target = lastDepth = depth;
+  filteredRate = 0;
+  filteredAccel = 0;
+  action = HOLD;
+  since = now - gains.dwell;
+  planeWidth = Data::MID_POINT;
+  actionChanges = 0;
+}
+
+void Ballast::DepthHold::setTarget(int32_t depth)
+{
+  target = depth;
+}
+
+void Ballast::DepthHold::update(uint32_t now, int32_t depth)
+{
+  int32_t measured = (depth - lastDepth) * ticksPerSecond;
+  lastDepth = depth;
+  int32_t lastSpeed = filteredRate >> RATE_FILTER_SHIFT;
+  filteredRate += measured - (filteredRate >> RATE_FILTER_SHIFT);
+  int32_t speed = filteredRate >> RATE_FILTER_SHIFT;
+  filteredAccel += (speed - lastSpeed) * ticksPerSecond - (filteredAccel >> RATE_FILTER_SHIFT);
+
+  // Positive error means too shallow, and the planes dive for it
+  int32_t error = target - depth;
+  int32_t push = (error * gains.kp - speed * gains.kd) >> GAIN_SHIFT;
+  planeWidth = constrain(int32_t(Data::MID_POINT) + push, int32_t(Data::MIN_DIVE_PLANE_ANGLE), int32_t(Data::MAX_DIVE_PLANE_ANGLE));
+
+  // The tank sets the rate, so it closes the error at a rate that tails off near the target
+  int32_t approach = constrain((error * gains.approach) >> GAIN_SHIFT, -int32_t(gains.maxRate), int32_t(gains.maxRate));
+  int32_t ahead = speed + (filteredAccel >> RATE_FILTER_SHIFT) * gains.lead / 1000;
+  int32_t slip = approach - ahead;
+  Action wanted = action;
+  if (slip > gains.band)
+  {
+    wanted = FILL;
+  }
+  else if (slip < -gains.band)
+  {
+    wanted = VENT;
+  }
+  else if (slip < gains.band / 2 && slip > -gains.band / 2)
+  {
+    wanted = HOLD;
+  }
+
+  // Stopping is always allowed; starting again waits out dwell from the last change
+  if (wanted != action && wanted != HOLD && now - since < gains.dwell)
+  {
+    wanted = HOLD;
+  }
+  if (wanted != action)
+  {
+    action = wanted;
+    since = now;
+    actionChanges++;
+  }
+}
+
+Ballast::Action Ballast::DepthHold::ballast() const
+{
+  return action;
+}
+
+uint16_t Ballast::DepthHold::plane() const
+{
+  return planeWidth;
+}
+
+int32_t Ballast::DepthHold::rate() const
+{
+  return filteredRate >> RATE_FILTER_SHIFT;
+}
+
+uint16_t Ballast::DepthHold::changes() const
+{
+  return actionChanges;
+}
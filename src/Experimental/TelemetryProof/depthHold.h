@@ -0,0 +1,153 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * DepthHold.h - Closed-loop depth from the ballast tank and dive planes.
+ */
+
+#ifndef DEPTH_HOLD_h
+#define DEPTH_HOLD_h
+
+#include "Arduino.h"
+#include "dataUtils.h"
+
+namespace Ballast
+{
+  /* What the tank is doing */
+  enum Action : uint8_t
+  {
+    HOLD, // Solenoid closed, pump off
+    FILL, // Solenoid open, pump pulling water in
+    VENT // Solenoid open, pump off, water running out
+  };
+
+  /* Gains are fixed point with this many fraction bits */
+  static constexpr uint8_t GAIN_SHIFT = 8;
+
+  /* Depth rate and acceleration low pass, each tick takes 1 / 2^RATE_FILTER_SHIFT of the new value */
+  static constexpr uint8_t RATE_FILTER_SHIFT = 2;
+
+  /*
+   * Controller tuning. kp is dive plane microseconds per mm of depth
+   * error and kd per mm/s of depth rate, both in 1/256. The tank chases
+   * a depth rate of approach mm/s per mm of error, in 1/256 and no more
+   * than maxRate, judged by the rate expected lead ms ahead: it starts
+   * once that is more than band mm/s off, stops inside band / 2, and
+   * never starts again sooner than dwell microseconds after a change.
+   */
+  struct DepthGains
+  {
+    int16_t kp;
+    int16_t kd;
+    int16_t approach;
+    int16_t maxRate;
+    int16_t band;
+    uint16_t lead;
+    uint32_t dwell;
+  };
+
+  static constexpr DepthGains DEFAULT_DEPTH_GAINS = {
+    96, // kp: full plane at about 340 mm out
+    640, // kd: full plane at about 50 mm/s
+    48, // approach: about a fifth of the error each second
+    100, // maxRate
+    40, // band
+    1500, // lead
+    3000000 // dwell
+  };
+
+  /*
+   * DepthHold class - Holds a target depth, run at a fixed period.
+   *
+   * The dive planes are the fast loop: a PD on depth error and rate,
+   * which only has authority while the boat is moving. The tank is the
+   * slow one and works at any speed. Its level sets how fast the boat
+   * sinks or rises, so it steers the depth rate towards one that closes
+   * the error, filling or venting while the rate is outside a band, with
+   * hysteresis and a minimum dwell so the pump is not cycled on every
+   * ripple in the reading. The hull takes seconds to answer the tank,
+   * so the rate is extrapolated by its acceleration first, which stops
+   * the pump before the rate arrives rather than after.
+   */
+  class DepthHold
+  {
+    public:
+      /*
+       * @param period Update period in microseconds
+       * @param gains Tuning for the hull
+       */
+      DepthHold(uint32_t period, const DepthGains& gains = DEFAULT_DEPTH_GAINS);
+
+      /*
+       * Take over from wherever the boat is
+       * @param now micros()
+       * @param depth Current depth in mm
+       */
+      void begin(uint32_t now, int32_t depth);
+
+      /*
+       * @param depth Depth to hold in mm
+       */
+      void setTarget(int32_t depth);
+
+      /*
+       * Run one tick
+       * @param now micros()
+       * @param depth Current depth in mm
+       */
+      void update(uint32_t now, int32_t depth);
+
+      /* What the tank should be doing */
+      Action ballast() const;
+
+      /* Dive plane pulse width in microseconds; larger dives */
+      uint16_t plane() const;
+
+      /* Filtered depth rate in mm/s, positive going down */
+      int32_t rate() const;
+
+      /* Times the tank has changed what it is doing since begin() */
+      uint16_t changes() const;
+
+    private:
+      const DepthGains gains;
+
+      /* Ticks per second, to turn a change per tick into mm/s */
+      const uint16_t ticksPerSecond;
+
+      int32_t target;
+      int32_t lastDepth;
+
+      /* mm/s << RATE_FILTER_SHIFT */
+      int32_t filteredRate;
+
+      /* mm/s/s << RATE_FILTER_SHIFT */
+      int32_t filteredAccel;
+
+      Action action;
+
+      /* micros() the tank last changed */
+      uint32_t since;
+
+      uint16_t planeWidth;
+      uint16_t actionChanges;
+  };
+}
+
+#endif
@@ -0,0 +1,266 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "depthSensor.h"
+
+namespace
+{
+  /* MS5837 commands */
+  constexpr uint8_t CMD_RESET = 0x1E;
+  constexpr uint8_t CMD_CONVERT_D1 = 0x40;
+  constexpr uint8_t CMD_CONVERT_D2 = 0x50;
+  constexpr uint8_t CMD_ADC_READ = 0x00;
+  constexpr uint8_t CMD_PROM_READ = 0xA0;
+}
+
+uint8_t Sensor::promCrc(const uint16_t prom[PROM_WORDS])
+{
+  // Eighth word is zero and the CRC's own bits are left out
+  uint16_t remainder = 0;
+  for (uint8_t i = 0; i < 2 * (PROM_WORDS + 1); i++)
+  {
+    uint16_t word = i / 2 < PROM_WORDS ? prom[i / 2] : 0;
+    if (i < 2)
+    {
+      word &= 0x0FFF;
+    }
+    remainder ^= i % 2 ? word & 0x00FF : word >> 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+      remainder = remainder & 0x8000 ? (remainder << 1) ^ 0x3000 : remainder << 1;
+    }
+  }
+  return (remainder >> 12) & 0x0F;
+}
+
+Sensor::Reading Sensor::compensate(const uint16_t prom[PROM_WORDS], uint32_t d1, uint32_t d2)
+{
+  // Divisions rather than shifts so negative terms round as the datasheet's do
+  int32_t dT = int32_t(d2) - (int32_t(prom[5]) << 8);
+  int64_t sens = (int64_t(prom[1]) << 15) + int64_t(prom[3]) * dT / 256;
+  int64_t off = (int64_t(prom[2]) << 16) + int64_t(prom[4]) * dT / 128;
+  int32_t temp = 2000 + int64_t(dT) * prom[6] / 8388608;
+
+  int64_t ti;
+  int64_t offi;
+  int64_t sensi;
+  int64_t warm = temp - 2000;
+  if (temp < 2000)
+  {
+    ti = 3 * int64_t(dT) * dT / 8589934592LL;
+    offi = 3 * warm * warm / 2;
+    sensi = 5 * warm * warm / 8;
+    if (temp < -1500)
+    {
+      int64_t cold = temp + 1500;
+      offi += 7 * cold * cold;
+      sensi += 4 * cold * cold;
+    }
+  }
+  else
+  {
+    ti = 2 * int64_t(dT) * dT / 137438953472LL;
+    offi = warm * warm / 16;
+    sensi = 0;
+  }
+
+  // 30BA results are in tenths of a millibar, which is 10 Pa
+  Reading reading;
+  reading.pressure = int32_t((int64_t(d1) * (sens - sensi) / 2097152 - (off - offi)) / 8192) * 10;
+  reading.temperature = int16_t(temp - ti);
+  return reading;
+}
+
+Sensor::DepthSensor::DepthSensor(Oversampling osr, uint16_t density, TwoWire& wire)
+  : wire(wire), osr(osr), perMetre(pascalsPerMetre(density)), state(IDLE), started(0),
+    d2(0), surface(0), zeroed(false), fresh(false), count(0), faults(0)
+{
+  latest.pressure = 0;
+  latest.temperature = 0;
+}
+
+void Sensor::DepthSensor::begin(uint32_t now)
+{
+  started = now;
+  state = command(CMD_RESET) ? RESETTING : FAULT;
+  if (state == FAULT)
+  {
+    faults++;
+  }
+}
+
+bool Sensor::DepthSensor::update(uint32_t now)
+{
+  switch (state)
+  {
+    case IDLE:
+      return false;
+
+    case FAULT:
+      if (now - started >= RETRY_DELAY)
+      {
+        begin(now);
+      }
+      return false;
+
+    case RESETTING:
+      if (now - started < RESET_TIME)
+      {
+        return false;
+      }
+      // Seven short reads, once per reset
+      if (!readProm() || !convert(CMD_CONVERT_D2, CONVERTING_TEMPERATURE, now))
+      {
+        fault(now);
+      }
+      return false;
+
+    case CONVERTING_TEMPERATURE:
+    {
+      uint32_t raw;
+      if (now - started < conversionTime(osr))
+      {
+        return false;
+      }
+      // An ADC read of 0 means the conversion never happened
+      if (!read(CMD_ADC_READ, 3, raw) || raw == 0 || !convert(CMD_CONVERT_D1, CONVERTING_PRESSURE, now))
+      {
+        fault(now);
+        return false;
+      }
+      d2 = raw;
+      return false;
+    }
+
+    case CONVERTING_PRESSURE:
+    {
+      uint32_t d1;
+      if (now - started < conversionTime(osr))
+      {
+        return false;
+      }
+      if (!read(CMD_ADC_READ, 3, d1) || d1 == 0 || !convert(CMD_CONVERT_D2, CONVERTING_TEMPERATURE, now))
+      {
+        fault(now);
+        return false;
+      }
+
+      latest = compensate(prom, d1, d2);
+      if (!zeroed)
+      {
+        surface = latest.pressure;
+        zeroed = true;
+      }
+      fresh = true;
+      count++;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Sensor::DepthSensor::valid() const
+{
+  return fresh;
+}
+
+int32_t Sensor::DepthSensor::pressure() const
+{
+  return latest.pressure;
+}
+
+int16_t Sensor::DepthSensor::temperature() const
+{
+  return latest.temperature;
+}
+
+int32_t Sensor::DepthSensor::depth() const
+{
+  // Fits 32 bits up to 200 m of water
+  return (latest.pressure - surface) * 1000 / perMetre;
+}
+
+void Sensor::DepthSensor::zero()
+{
+  zeroed = false;
+}
+
+uint32_t Sensor::DepthSensor::readings() const
+{
+  return count;
+}
+
+uint16_t Sensor::DepthSensor::errors() const
+{
+  return faults;
+}
+
+bool Sensor::DepthSensor::command(uint8_t code)
+{
+  wire.beginTransmission(MS5837_ADDRESS);
+  wire.write(code);
+  return wire.endTransmission() == 0;
+}
+
+bool Sensor::DepthSensor::read(uint8_t code, uint8_t length, uint32_t& value)
+{
+  if (!command(code) || wire.requestFrom(MS5837_ADDRESS, length) != length)
+  {
+    return false;
+  }
+  value = 0;
+  for (uint8_t i = 0; i < length; i++)
+  {
+    value = value << 8 | uint8_t(wire.read());
+  }
+  return true;
+}
+
+bool Sensor::DepthSensor::readProm()
+{
+  for (uint8_t i = 0; i < PROM_WORDS; i++)
+  {
+    uint32_t word;
+    if (!read(CMD_PROM_READ + 2 * i, 2, word))
+    {
+      return false;
+    }
+    prom[i] = word;
+  }
+  return promCrc(prom) == prom[0] >> 12;
+}
+
+bool Sensor::DepthSensor::convert(uint8_t base, State next, uint32_t now)
+{
+  if (!command(base + 2 * osr))
+  {
+    return false;
+  }
+  state = next;
+  started = now;
+  return true;
+}
+
+void Sensor::DepthSensor::fault(uint32_t now)
+{
+  state = FAULT;
+  started = now;
+  fresh = false;
+  faults++;
+}
@@ -0,0 +1,200 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * DepthSensor.h - Non-blocking MS5837-30BA pressure and depth driver.
+ */
+
+#ifndef DEPTH_SENSOR_h
+#define DEPTH_SENSOR_h
+
+#include "Arduino.h"
+#include <Wire.h>
+
+namespace Sensor
+{
+  /* Fixed I2C address of the MS5837 */
+  static constexpr uint8_t MS5837_ADDRESS = 0x76;
+
+  /* Coefficient words in the PROM; word 0 carries the CRC in its top 4 bits */
+  static constexpr uint8_t PROM_WORDS = 7;
+
+  /* Oversampling ratio, 256 << osr; each step halves the noise and doubles the wait */
+  enum Oversampling : uint8_t
+  {
+    OSR_256,
+    OSR_512,
+    OSR_1024,
+    OSR_2048,
+    OSR_4096,
+    OSR_8192
+  };
+
+  /* Longest a conversion takes in microseconds; the datasheet's 0.6 to 18.08 ms rounded up */
+  constexpr uint32_t conversionTime(Oversampling osr)
+  {
+    return uint32_t(600) << osr;
+  }
+
+  /* Time the PROM takes to reload after a reset command */
+  static constexpr uint32_t RESET_TIME = 3000;
+
+  /* Wait before starting again after the sensor stops answering */
+  static constexpr uint32_t RETRY_DELAY = 500000;
+
+  /* Fresh water; sea water is about 1025 */
+  static constexpr uint16_t FRESH_WATER = 997;
+
+  /* Pressure in pascals for each metre of water of a density in kg/m^3 */
+  constexpr uint16_t pascalsPerMetre(uint16_t density)
+  {
+    return (uint32_t(density) * 980665 + 50000) / 100000;
+  }
+
+  /* One compensated measurement */
+  struct Reading
+  {
+    /* Pascals */
+    int32_t pressure;
+
+    /* Hundredths of a degree C */
+    int16_t temperature;
+  };
+
+  /*
+   * CRC-4 of the PROM as the datasheet computes it
+   * @param prom Words 0 to 6, the CRC bits in word 0 are ignored
+   * @return Value to compare with prom[0] >> 12
+   */
+  uint8_t promCrc(const uint16_t prom[PROM_WORDS]);
+
+  /*
+   * Datasheet first and second order compensation of the raw conversions
+   * @param prom Calibration words
+   * @param d1 Raw pressure conversion
+   * @param d2 Raw temperature conversion
+   */
+  Reading compensate(const uint16_t prom[PROM_WORDS], uint32_t d1, uint32_t d2);
+
+  /*
+   * DepthSensor class - Reads an MS5837 without ever waiting on it.
+   *
+   * Each update() does at most one step: collect the conversion that
+   * has finished and start the next, alternating temperature and
+   * pressure. Called at a fixed period no shorter than the conversion
+   * time, it produces a reading every second call and never holds the
+   * loop for more than a couple of short bus transactions. A sensor that
+   * stops answering or returns an empty conversion is reset and read
+   * from the start again after RETRY_DELAY.
+   *
+   * Depth is taken from the first reading after begin() or zero(), so
+   * power up at the surface.
+   */
+  class DepthSensor
+  {
+    public:
+      /*
+       * @param osr Oversampling, the update period must be at least conversionTime(osr)
+       * @param density Water density in kg/m^3
+       * @param wire Bus the sensor is on
+       */
+      DepthSensor(Oversampling osr = OSR_4096, uint16_t density = FRESH_WATER, TwoWire& wire = Wire);
+
+      /*
+       * Reset the sensor; the PROM is read on a later update()
+       * @param now micros()
+       */
+      void begin(uint32_t now);
+
+      /*
+       * Move the state machine on if the current step is done
+       * @param now micros()
+       * @return true if a new reading came out of this call
+       */
+      bool update(uint32_t now);
+
+      /* True once there is a reading and the sensor is still answering */
+      bool valid() const;
+
+      /* Latest pressure in pascals */
+      int32_t pressure() const;
+
+      /* Latest temperature in hundredths of a degree C */
+      int16_t temperature() const;
+
+      /* Latest depth below the surface reading in millimetres */
+      int32_t depth() const;
+
+      /* Take the next reading as the surface */
+      void zero();
+
+      /* Readings produced since start */
+      uint32_t readings() const;
+
+      /* Faults since start: no answer, bad PROM or an empty conversion */
+      uint16_t errors() const;
+
+    private:
+      enum State : uint8_t
+      {
+        IDLE,
+        RESETTING,
+        CONVERTING_TEMPERATURE,
+        CONVERTING_PRESSURE,
+        FAULT
+      };
+
+      /* Send a one byte command, false if the sensor did not acknowledge */
+      bool command(uint8_t command);
+
+      /* Read n big-endian bytes after command, false on a short read */
+      bool read(uint8_t command, uint8_t length, uint32_t& value);
+
+      bool readProm();
+
+      /* Start a conversion and note when it will be done */
+      bool convert(uint8_t base, State next, uint32_t now);
+
+      void fault(uint32_t now);
+
+      TwoWire& wire;
+      const Oversampling osr;
+      const uint16_t perMetre;
+
+      State state;
+
+      /* micros() the current step started */
+      uint32_t started;
+
+      uint16_t prom[PROM_WORDS];
+
+      /* Latest raw temperature conversion */
+      uint32_t d2;
+
+      Reading latest;
+      int32_t surface;
+      bool zeroed;
+      bool fresh;
+
+      uint32_t count;
+      uint16_t faults;
+  };
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "failsafe.h"
+
+Safety::Failsafe::Failsafe(const Thresholds& thresholds)
+  : thresholds(thresholds), lastFrame(0), lastSample(0), millivolts(UINT16_MAX),
+    lowSince(0), low(false), latched(false), active(0), trippedAt(0)
+{
+}
+
+void Safety::Failsafe::begin(uint32_t now)
+{
+  lastFrame = lastSample = now;
+  low = false;
+  latched = false;
+  active = 0;
+}
+
+void Safety::Failsafe::frame(uint32_t now)
+{
+  lastFrame = now;
+}
+
+void Safety::Failsafe::voltage(uint16_t sample, uint32_t now)
+{
+  millivolts = sample;
+  lastSample = now;
+
+  if (!low && sample < thresholds.undervoltage)
+  {
+    low = true;
+    lowSince = now;
+  }
+  else if (low && sample >= thresholds.undervoltage + thresholds.recoveryMargin)
+  {
+    low = false;
+  }
+}
+
+uint8_t Safety::Failsafe::check(uint32_t now)
+{
+  uint8_t reasons = 0;
+  if (now - lastFrame > thresholds.signalTimeout)
+  {
+    reasons |= SIGNAL_LOST;
+  }
+  if (now - lastSample > thresholds.voltageTimeout)
+  {
+    reasons |= VOLTAGE_STALE;
+  }
+
+  // Once tripped, undervoltage holds however far the battery bounces back, until rearm()
+  if (low && now - lowSince >= thresholds.undervoltageTime)
+  {
+    latched = true;
+  }
+  if (latched)
+  {
+    reasons |= UNDERVOLTAGE;
+  }
+
+  if (reasons && !active)
+  {
+    trippedAt = now;
+  }
+  active = reasons;
+  return active;
+}
+
+bool Safety::Failsafe::rearm()
+{
+  if (!low)
+  {
+    latched = false;
+  }
+  return !latched;
+}
+
+uint8_t Safety::Failsafe::reasons() const
+{
+  return active;
+}
+
+bool Safety::Failsafe::engaged() const
+{
+  return active != 0;
+}
+
+uint32_t Safety::Failsafe::since() const
+{
+  return trippedAt;
+}
@@ -0,0 +1,164 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Failsafe.h - Signal loss and undervoltage detection.
+ */
+
+#ifndef FAILSAFE_h
+#define FAILSAFE_h
+
+#include "Arduino.h"
+
+namespace Safety
+{
+  /* Why the failsafe is engaged, most serious first */
+  static constexpr uint8_t SIGNAL_LOST = 1 << 0;
+  static constexpr uint8_t VOLTAGE_STALE = 1 << 1;
+  static constexpr uint8_t UNDERVOLTAGE = 1 << 2;
+
+  /* How often check() must run; part of the reaction time bound */
+  static constexpr uint32_t CHECK_PERIOD = 10000;
+
+  /*
+   * Limits, times in microseconds. Undervoltage has to last a while so
+   * sag under load does not trip it. Once tripped it stays latched until
+   * Failsafe::rearm(), which needs the battery back above the threshold
+   * plus a margin.
+   */
+  struct Thresholds
+  {
+    /* Longest gap between receiver frames, they normally come every 7 ms */
+    uint32_t signalTimeout;
+
+    /* Longest gap between voltage samples */
+    uint32_t voltageTimeout;
+
+    /* Battery level that counts as flat, in millivolts */
+    uint16_t undervoltage;
+
+    /* Re-arming needs undervoltage + recoveryMargin */
+    uint16_t recoveryMargin;
+
+    /* How long the battery must stay low before it trips */
+    uint32_t undervoltageTime;
+  };
+
+  /* 3S LiPo at 3.3 V a cell */
+  static constexpr Thresholds DEFAULT_THRESHOLDS = {
+    100000, // signalTimeout: 14 frames missed
+    500000, // voltageTimeout: the ADC produces a value every 2 ms
+    9900, // undervoltage
+    300, // recoveryMargin
+    2000000 // undervoltageTime
+  };
+
+  /*
+   * Worst case from the fault to check() reporting it: the timeout, one
+   * CHECK_PERIOD for check() to come round, and the longest task that
+   * may be running when it falls due.
+   * @param timeout The signalTimeout or voltageTimeout being bounded
+   * @param longestTask Longest run of any other task in microseconds
+   */
+  constexpr uint32_t reactionBound(uint32_t timeout, uint32_t longestTask)
+  {
+    return timeout + CHECK_PERIOD + longestTask;
+  }
+
+  /*
+   * Failsafe class - Decides when the boat has to be made safe.
+   *
+   * Frames and voltage samples are timestamped as they arrive and
+   * check(), run every CHECK_PERIOD, turns their age and the voltage
+   * into a set of reasons. The caller drives the safe state while any
+   * reason is set and holds off normal control until they all clear.
+   */
+  class Failsafe
+  {
+    public:
+      /*
+       * @param thresholds Limits to trip at
+       */
+      Failsafe(const Thresholds& thresholds = DEFAULT_THRESHOLDS);
+
+      /*
+       * Start the clocks; nothing trips for a timeout after this
+       * @param now micros()
+       */
+      void begin(uint32_t now);
+
+      /*
+       * A good receiver frame arrived
+       * @param now micros() at arrival
+       */
+      void frame(uint32_t now);
+
+      /*
+       * A new battery voltage sample
+       * @param millivolts Battery voltage
+       * @param now micros() of the sample
+       */
+      void voltage(uint16_t millivolts, uint32_t now);
+
+      /*
+       * Re-evaluate everything
+       * @param now micros()
+       * @return Reasons now set
+       */
+      uint8_t check(uint32_t now);
+
+      /*
+       * Release a latched undervoltage. A pack that has sagged bounces
+       * back once the load is off, so this is only called on the
+       * pilot's say-so, never by itself.
+       * @return true unless the battery is still below undervoltage + recoveryMargin
+       */
+      bool rearm();
+
+      /* Reasons set at the last check() */
+      uint8_t reasons() const;
+
+      /* True while any reason is set */
+      bool engaged() const;
+
+      /* micros() at which the current trip started */
+      uint32_t since() const;
+
+    private:
+      const Thresholds thresholds;
+
+      uint32_t lastFrame;
+      uint32_t lastSample;
+
+      /* Latest battery voltage */
+      uint16_t millivolts;
+
+      /* When the voltage first went below the threshold, and whether it is below */
+      uint32_t lowSince;
+      bool low;
+
+      /* Undervoltage has tripped since begin() or the last rearm() */
+      bool latched;
+
+      uint8_t active;
+      uint32_t trippedAt;
+  };
+}
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * FastHBridge.h - HBridge and HBridgePWM with the pins fixed at compile
+ * time.
+ *
+ * Same interface as the runtime-pin classes in motor.h, but nothing is
+ * virtual and the direction pins are written straight to their port,
+ * both in one write when they share a port. Set both input pins on one
+ * port (22-29 are all port A) to get that. forward() and the rest are
+ * then in/cli/in/andi/ori/out/out inline, where the runtime classes
+ * make a virtual call and two digitalWrite() calls. The runtime classes
+ * stay for pins only known at run time and for HBridgePWMEnc.
+ */
+
+#ifndef FAST_HBRIDGE_h
+#define FAST_HBRIDGE_h
+
+#include "motor.h"
+#include "pins.h"
+
+namespace Motor
+{
+  /*
+   * FastHBridge class - Controls basic motor direction without speed control.
+   */
+  template<uint8_t INPUT1, uint8_t INPUT2>
+  class FastHBridge
+  {
+    public:
+      FastHBridge()
+      {
+        pinMode(INPUT1, OUTPUT);
+        pinMode(INPUT2, OUTPUT);
+        off();
+      };
+
+      /* Set the motor to go forward */
+      void forward()
+      {
+        Pins::write<INPUT1, INPUT2>(HIGH, LOW);
+        state = FORWARD;
+      }
+
+      /* Set the motor to go backward */
+      void backward()
+      {
+        Pins::write<INPUT1, INPUT2>(LOW, HIGH);
+        state = BACKWARD;
+      }
+
+      /* Set the motors to hard stop */
+      void stop()
+      {
+        Pins::write<INPUT1, INPUT2>(HIGH, HIGH);
+        state = STOP;
+      }
+
+      /* Turn the motors off (coast) */
+      void off()
+      {
+        Pins::write<INPUT1, INPUT2>(LOW, LOW);
+        state = COAST;
+      }
+
+      /* Get current motor state */
+      Direction getState() const
+      {
+        return state;
+      }
+
+    private:
+      /* Current state of the motor */
+      Direction state;
+  };
+
+  /*
+   * FastHBridgePWM class - Controls motor direction and speed using PWM.
+   */
+  template<uint8_t INPUT1, uint8_t INPUT2, uint8_t PWM_PIN>
+  class FastHBridgePWM : public FastHBridge<INPUT1, INPUT2>
+  {
+    public:
+      FastHBridgePWM()
+        : pwmLevel(0)
+      {
+        pinMode(PWM_PIN, OUTPUT);
+      };
+
+      /*
+       * Set motor direction and speed.
+       * @param direction Direction to set the motor (FORWARD, BACKWARD, COAST, STOP)
+       * @param pwm PWM duty cycle (0-255)
+       */
+      void set(Direction direction, uint8_t pwm)
+      {
+        LOG_INFO(Log::MOTOR_SET, direction, pwm);
+        switch (direction)
+        {
+          case FORWARD:
+            this->forward();
+            break;
+          case BACKWARD:
+            this->backward();
+            break;
+          case COAST:
+            off();
+            break;
+          case STOP:
+            stop();
+            break;
+        }
+        setSpeed(pwm);
+      }
+
+      /*
+       * Set motor speed.
+       * @param pwm PWM duty cycle (0-255)
+       */
+      void setSpeed(uint8_t pwm)
+      {
+        analogWrite(PWM_PIN, pwm);
+        pwmLevel = pwm;
+      }
+
+      /* Set the motors to hard stop */
+      void stop()
+      {
+        FastHBridge<INPUT1, INPUT2>::stop();
+        setSpeed(MAX_PWM_VALUE);
+      }
+
+      /* Turn the motors off (coast) */
+      void off()
+      {
+        FastHBridge<INPUT1, INPUT2>::off();
+        setSpeed(MIN_PWM_VALUE);
+      }
+
+      /* Get the current duty cycle of the motor */
+      uint8_t getSpeed() const
+      {
+        return pwmLevel;
+      }
+
+    private:
+      /* Duty Cycle Motor is currently set to */
+      uint8_t pwmLevel;
+  };
+}
+
+#endif
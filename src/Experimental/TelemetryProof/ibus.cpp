@@ -0,0 +1,360 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "ibus.h"
+
+namespace
+{
+  /* Ports the interrupt vectors below hand bytes to */
+  IBus::Receiver* servoPort = nullptr;
+  IBus::Telemetry* sensorPort = nullptr;
+
+  /* Baud register value for BAUD_RATE in double speed mode, as HardwareSerial computes it */
+  constexpr uint16_t UBRR_VALUE = (F_CPU / 4 / IBus::BAUD_RATE - 1) / 2;
+
+  /* Reply checksum: 0xFFFF minus every byte before it, little endian */
+  uint8_t seal(uint8_t* reply, uint8_t length)
+  {
+    uint16_t checksum = 0xFFFF;
+    for (uint8_t i = 0; i < length; i++)
+    {
+      checksum -= reply[i];
+    }
+    reply[length++] = uint8_t(checksum);
+    reply[length++] = uint8_t(checksum >> 8);
+    return length;
+  }
+}
+
+IBus::Receiver::Receiver()
+  : front(0), published(0), badFrames(0), state(DISCARD), position(0), checksumLow(0), checksum(0), lastByte(0)
+{
+  for (uint8_t i = 0; i < NUM_CHANNELS; i++)
+  {
+    frames[0][i] = 0;
+    frames[1][i] = 0;
+  }
+}
+
+void IBus::Receiver::begin()
+{
+  servoPort = this;
+  // Treat the line as idle so a frame arriving right away is not lost
+  state = LENGTH;
+  lastByte = micros();
+  UBRR2 = UBRR_VALUE;
+  UCSR2A = _BV(U2X2);
+  UCSR2C = _BV(UCSZ21) | _BV(UCSZ20);
+  UCSR2B = _BV(RXEN2) | _BV(RXCIE2);
+}
+
+void IBus::Receiver::error()
+{
+  badFrames++;
+  state = DISCARD;
+}
+
+void IBus::Receiver::receive(uint8_t data)
+{
+  uint32_t now = micros();
+  if (now - lastByte >= FRAME_GAP)
+  {
+    state = LENGTH;
+  }
+  lastByte = now;
+
+  switch (state)
+  {
+    case LENGTH:
+      state = data == SERVO_FRAME_LENGTH ? COMMAND : DISCARD;
+      checksum = 0xFFFF - data;
+      break;
+    case COMMAND:
+      state = data == COMMAND_SERVO ? BODY : DISCARD;
+      checksum -= data;
+      position = 0;
+      break;
+    case BODY:
+      // Little endian on the wire and in memory, so bytes land in place
+      reinterpret_cast<uint8_t*>(frames[front ^ 1])[position++] = data;
+      checksum -= data;
+      if (position == NUM_CHANNELS * 2)
+      {
+        state = CHECKSUM_LOW;
+      }
+      break;
+    case CHECKSUM_LOW:
+      checksumLow = data;
+      state = CHECKSUM_HIGH;
+      break;
+    case CHECKSUM_HIGH:
+      if (checksum == uint16_t(data << 8 | checksumLow))
+      {
+        front ^= 1;
+        published++;
+        // The next frame may follow without a gap
+        state = LENGTH;
+      }
+      else
+      {
+        badFrames++;
+        state = DISCARD;
+      }
+      break;
+    case DISCARD:
+    default:
+      break;
+  }
+}
+
+IBus::Telemetry::Telemetry()
+  : count(0), state(DISCARD), command(0), checksumLow(0), checksum(0), lastByte(0), echo(0), transmit(nullptr), remaining(0), answered(0)
+{
+}
+
+void IBus::Telemetry::begin()
+{
+  sensorPort = this;
+  state = LENGTH;
+  lastByte = micros();
+  UBRR3 = UBRR_VALUE;
+  UCSR3A = _BV(U2X3);
+  UCSR3C = _BV(UCSZ31) | _BV(UCSZ30);
+  UCSR3B = _BV(RXEN3) | _BV(TXEN3) | _BV(RXCIE3);
+}
+
+uint8_t IBus::Telemetry::addSensor(uint8_t type, uint8_t length)
+{
+  if (count >= MAX_SENSORS)
+  {
+    return 0;
+  }
+
+  Sensor& sensor = sensors[count++];
+  sensor.type = type;
+  sensor.length = length == 4 ? 4 : 2;
+  sensor.live = 0;
+  setMeasurement(count, 0);
+  return count;
+}
+
+bool IBus::Telemetry::setMeasurement(uint8_t address, int32_t value)
+{
+  if (address == 0 || address > count)
+  {
+    return false;
+  }
+
+  Sensor& sensor = sensors[address - 1];
+  uint8_t spare = sensor.live ^ 1;
+  uint8_t* reply = sensor.reply[spare];
+
+  // The pointer is two bytes, so read it with interrupts held off
+  uint8_t oldSREG = SREG;
+  cli();
+  const uint8_t* sending = transmit;
+  bool busy = remaining && sending >= reply && sending <= reply + reply[0];
+  SREG = oldSREG;
+  if (busy)
+  {
+    // Still going out from an earlier swap, part sent or not, try again next time
+    return false;
+  }
+
+  reply[0] = 4 + sensor.length;
+  reply[1] = COMMAND_VALUE | address;
+  reply[2] = uint8_t(value);
+  reply[3] = uint8_t(value >> 8);
+  if (sensor.length == 4)
+  {
+    reply[4] = uint8_t(value >> 16);
+    reply[5] = uint8_t(value >> 24);
+  }
+  seal(reply, 2 + sensor.length);
+
+  sensor.live = spare;
+  return true;
+}
+
+void IBus::Telemetry::receive(uint8_t data)
+{
+  uint32_t now = micros();
+  if (now - lastByte >= FRAME_GAP)
+  {
+    state = LENGTH;
+    echo = 0;
+  }
+  lastByte = now;
+
+  if (echo)
+  {
+    echo--;
+    return;
+  }
+
+  switch (state)
+  {
+    case LENGTH:
+      // Our own replies are longer than a poll, so they can never be mistaken for one
+      state = data == POLL_LENGTH ? COMMAND : DISCARD;
+      checksum = 0xFFFF - data;
+      break;
+    case COMMAND:
+      command = data;
+      checksum -= data;
+      state = CHECKSUM_LOW;
+      break;
+    case CHECKSUM_LOW:
+      checksumLow = data;
+      state = CHECKSUM_HIGH;
+      break;
+    case CHECKSUM_HIGH:
+      if (checksum == uint16_t(data << 8 | checksumLow))
+      {
+        answer(command);
+      }
+      state = LENGTH;
+      break;
+    case BODY:
+    case DISCARD:
+    default:
+      break;
+  }
+}
+
+void IBus::Telemetry::answer(uint8_t command)
+{
+  uint8_t address = command & 0x0F;
+  if (address == 0 || address > count || remaining)
+  {
+    return;
+  }
+
+  Sensor& sensor = sensors[address - 1];
+  const uint8_t* reply = scratch;
+  uint8_t length;
+
+  switch (command & 0xF0)
+  {
+    case COMMAND_DISCOVER:
+      scratch[0] = POLL_LENGTH;
+      scratch[1] = command;
+      length = seal(scratch, 2);
+      break;
+    case COMMAND_TYPE:
+      scratch[0] = 6;
+      scratch[1] = command;
+      scratch[2] = sensor.type;
+      scratch[3] = sensor.length;
+      length = seal(scratch, 4);
+      break;
+    case COMMAND_VALUE:
+      reply = sensor.reply[sensor.live];
+      length = reply[0];
+      break;
+    default:
+      return;
+  }
+
+  answered++;
+  transmit = reply;
+  remaining = length;
+  echo = length;
+
+  // Give the receiver time to turn the line around, then start sending
+  OCR0B = TCNT0 + TURNAROUND_TICKS;
+  TIFR0 = _BV(OCF0B);
+  TIMSK0 |= _BV(OCIE0B);
+}
+
+void IBus::Telemetry::startReply()
+{
+  TIMSK0 &= ~_BV(OCIE0B);
+  UCSR3B |= _BV(UDRIE3);
+}
+
+bool IBus::Telemetry::nextByte(uint8_t& data)
+{
+  if (!remaining)
+  {
+    transmit = nullptr;
+    return false;
+  }
+
+  data = *transmit;
+  if (--remaining)
+  {
+    transmit = transmit + 1;
+  }
+  else
+  {
+    transmit = nullptr;
+  }
+  return true;
+}
+
+ISR(USART2_RX_vect)
+{
+  uint8_t status = UCSR2A;
+  uint8_t data = UDR2;
+  if (!servoPort)
+  {
+    return;
+  }
+  if (status & (_BV(FE2) | _BV(DOR2) | _BV(UPE2)))
+  {
+    servoPort->error();
+    return;
+  }
+  servoPort->receive(data);
+}
+
+ISR(USART3_RX_vect)
+{
+  uint8_t status = UCSR3A;
+  uint8_t data = UDR3;
+  if (sensorPort && !(status & (_BV(FE3) | _BV(DOR3) | _BV(UPE3))))
+  {
+    sensorPort->receive(data);
+  }
+}
+
+ISR(USART3_UDRE_vect)
+{
+  uint8_t data;
+  if (sensorPort && sensorPort->nextByte(data))
+  {
+    UDR3 = data;
+  }
+  else
+  {
+    UCSR3B &= ~_BV(UDRIE3);
+  }
+}
+
+ISR(TIMER0_COMPB_vect)
+{
+  if (sensorPort)
+  {
+    sensorPort->startReply();
+  }
+}
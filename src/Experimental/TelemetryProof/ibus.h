@@ -0,0 +1,280 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ibus.h - Interrupt-driven FlySky iBus servo and telemetry ports.
+ *
+ * Replaces the IBusBM library. Bytes are parsed straight from the USART
+ * receive interrupt instead of from a 1 kHz Timer0 poll, so the CPU only
+ * does iBus work when a byte actually arrives.
+ *
+ * Wiring (see Documentation/Wiring):
+ *   USART2 (RX2, pin 17) - receiver servo output, IBus::Receiver
+ *   USART3 (RX3/TX3, pins 15/14) - receiver sensor port, IBus::Telemetry
+ *
+ * Using these ports means Serial2 and Serial3 must not be used anywhere
+ * else in the sketch; their interrupt vectors are defined here.
+ */
+
+#ifndef IBUS_h
+#define IBUS_h
+
+#include "Arduino.h"
+
+/* Holds the iBus protocol handlers */
+namespace IBus
+{
+  static constexpr uint32_t BAUD_RATE = 115200;
+
+  /* Channels carried by one servo frame */
+  static constexpr uint8_t NUM_CHANNELS = 14;
+
+  /* Length byte of a servo frame: length, command, channels, checksum */
+  static constexpr uint8_t SERVO_FRAME_LENGTH = 4 + NUM_CHANNELS * 2;
+
+  /* Length byte of every sensor poll from the receiver */
+  static constexpr uint8_t POLL_LENGTH = 4;
+
+  static constexpr uint8_t COMMAND_SERVO = 0x40;
+  static constexpr uint8_t COMMAND_DISCOVER = 0x80;
+  static constexpr uint8_t COMMAND_TYPE = 0x90;
+  static constexpr uint8_t COMMAND_VALUE = 0xA0;
+
+  /* Silence that marks the start of a new message, frames come every ~7 ms */
+  static constexpr uint32_t FRAME_GAP = 3000;
+
+  /* Timer0 ticks (4 us each) to wait before answering a poll, ~100 us */
+  static constexpr uint8_t TURNAROUND_TICKS = 25;
+
+  /* Sensor slots; the FS-i6X shows at most this many */
+  static constexpr uint8_t MAX_SENSORS = 10;
+
+  /* Sensor types, see Documentation/Sensor_notes */
+  static constexpr uint8_t SENSOR_INTV = 0x00;
+  static constexpr uint8_t SENSOR_TEMP = 0x01;
+  static constexpr uint8_t SENSOR_RPM = 0x02;
+  static constexpr uint8_t SENSOR_EXTV = 0x03;
+  static constexpr uint8_t SENSOR_HEADING = 0x08;
+  static constexpr uint8_t SENSOR_COG = 0x0A;
+  static constexpr uint8_t SENSOR_GPS_DIST = 0x14;
+  static constexpr uint8_t SENSOR_PRESSURE = 0x41;
+  static constexpr uint8_t SENSOR_ALT = 0x83;
+  static constexpr uint8_t SENSOR_ODO1 = 0x7C;
+  static constexpr uint8_t SENSOR_ODO2 = 0x7D;
+  static constexpr uint8_t SENSOR_SPEED = 0x7E;
+
+  /* Stops the compiler moving buffer reads across a sequence() check */
+  inline void barrier()
+  {
+    __asm__ __volatile__("" ::: "memory");
+  }
+
+  /* Parser states, shared by both ports */
+  enum State : uint8_t
+  {
+    LENGTH,
+    COMMAND,
+    BODY,
+    CHECKSUM_LOW,
+    CHECKSUM_HIGH,
+    DISCARD
+  };
+
+  /*
+   * Receiver class - Decodes servo frames from the receiver on USART2.
+   *
+   * The interrupt writes channel bytes straight into the back half of a
+   * double buffer. Once a frame's checksum checks out the halves swap and
+   * the sequence number advances; a bad frame never becomes visible.
+   *
+   * Readers never disable interrupts. Read sequence(), read the channels
+   * in place through channels(), then check sequence() again: if it moved,
+   * a newer frame landed while reading and the read should be repeated.
+   */
+  class Receiver
+  {
+    public:
+      /* Default Constructor */
+      Receiver();
+
+      /* Configures USART2 for 115200 8N1 receive with interrupts */
+      void begin();
+
+      /*
+       * Parse one received byte. Called from the USART2 receive interrupt.
+       * @param data Byte from UDR2
+       */
+      void receive(uint8_t data);
+
+      /* Note a byte lost to a UART framing, overrun or parity error */
+      void error();
+
+      /* Advances by one for every valid frame */
+      uint8_t sequence() const
+      {
+        return published;
+      }
+
+      /* Channels of the latest valid frame, only stable while sequence() is unchanged */
+      const uint16_t* channels() const
+      {
+        return frames[front];
+      }
+
+      /* Frames dropped for a bad checksum or UART error */
+      uint16_t errors() const
+      {
+        return badFrames;
+      }
+
+    private:
+      /* Double buffered channel data, frames[front] is the published one */
+      uint16_t frames[2][NUM_CHANNELS];
+
+      /* Index of the published frame */
+      volatile uint8_t front;
+
+      /* Valid frames received, wraps */
+      volatile uint8_t published;
+
+      /* Frames dropped */
+      volatile uint16_t badFrames;
+
+      /* Parser state */
+      uint8_t state;
+
+      /* Next byte of the back buffer to write */
+      uint8_t position;
+
+      /* Low checksum byte as received */
+      uint8_t checksumLow;
+
+      /* Running checksum, 0xFFFF minus every byte so far */
+      uint16_t checksum;
+
+      /* micros() of the previous byte */
+      uint32_t lastByte;
+  };
+
+  /*
+   * Telemetry class - Answers sensor polls from the receiver on USART3.
+   *
+   * Each sensor's value reply is encoded ahead of time by setMeasurement(),
+   * into whichever of its two reply buffers is not live, then made live
+   * with a single byte write. A poll only has to point the transmitter
+   * at the live buffer, so the interrupt never formats or sums anything.
+   *
+   * The sensor line is half-duplex with TX tied to RX, so every byte sent
+   * comes straight back; that many received bytes are skipped after each
+   * reply.
+   */
+  class Telemetry
+  {
+    public:
+      /* Default Constructor */
+      Telemetry();
+
+      /* Configures USART3 for 115200 8N1 receive and transmit with interrupts */
+      void begin();
+
+      /*
+       * Add a sensor.
+       * @param type iBus sensor type
+       * @param length Bytes in the value, 2 or 4
+       * @return Address of the sensor, 0 if the table is full
+       */
+      uint8_t addSensor(uint8_t type, uint8_t length = 2);
+
+      /*
+       * Update the value reported for a sensor.
+       * @param address Address returned by addSensor()
+       * @param value Value in the sensor's native units
+       * @return false if the reply buffer was busy and nothing changed
+       */
+      bool setMeasurement(uint8_t address, int32_t value);
+
+      /*
+       * Parse one received byte. Called from the USART3 receive interrupt.
+       * @param data Byte from UDR3
+       */
+      void receive(uint8_t data);
+
+      /* Start transmitting a prepared reply. Called from the turnaround timer interrupt. */
+      void startReply();
+
+      /*
+       * Next reply byte to send. Called from the USART3 data register empty interrupt.
+       * @param data Set to the byte to send
+       * @return false once the reply is complete
+       */
+      bool nextByte(uint8_t& data);
+
+      /* Polls answered */
+      uint16_t polls() const
+      {
+        return answered;
+      }
+
+    private:
+      /* Largest reply: length, command, 4 value bytes, checksum */
+      static constexpr uint8_t MAX_REPLY = 8;
+
+      struct Sensor
+      {
+        /* iBus sensor type */
+        uint8_t type;
+
+        /* Value width in bytes, 2 or 4 */
+        uint8_t length;
+
+        /* Which reply buffer the interrupt may send */
+        volatile uint8_t live;
+
+        /* Complete value replies, checksum included */
+        uint8_t reply[2][MAX_REPLY];
+      };
+
+      /* Prepare a reply to a valid poll */
+      void answer(uint8_t command);
+
+      Sensor sensors[MAX_SENSORS];
+      uint8_t count;
+
+      /* Parser state */
+      uint8_t state;
+      uint8_t command;
+      uint8_t checksumLow;
+      uint16_t checksum;
+      uint32_t lastByte;
+
+      /* Received bytes still to be skipped as our own echo */
+      volatile uint8_t echo;
+
+      /* Reply being sent and bytes left in it */
+      const uint8_t* volatile transmit;
+      volatile uint8_t remaining;
+
+      /* Discover and type replies are built here, they are rare */
+      uint8_t scratch[MAX_REPLY];
+
+      volatile uint16_t answered;
+  };
+}
+
+#endif
@@ -20,81 +20,134 @@
 #include "input.h"
 
 Data::Input::Input()
-  : throttle(0), rudder(0), divePlane(0), swA(SwitchPos::UP), swB(SwitchPos::UP), swC(ThreeWaySwitchPos::UP), swD(SwitchPos::UP), vrA(MIN_RAW_INPUT), vrB(MIN_RAW_INPUT)
+  : throttle(0), rudder(0), divePlane(0), swA(SwitchPos::UP), swB(SwitchPos::UP), swC(ThreeWaySwitchPos::UP), swD(SwitchPos::UP), vrA(MIN_RAW_INPUT), vrB(MIN_RAW_INPUT),
+    lastReceived(0), frames(0), skipped(0), frameMillis(0), changed(0), callback(nullptr)
 {
   for (uint8_t i = 0; i < NUM_CHANNELS; i++)
   {
-    channelData[i] = MIN_RAW_INPUT;
+    channels[i] = MIN_RAW_INPUT;
   }
 };
 
-Data::Input::Begin()
+void Data::Input::Begin()
 {
-  ibus.begin(Serial2);
+  receiver.begin();
+  lastReceived = receiver.sequence();
 }
 
-Data::Input::Read()
+void Data::Input::OnFrame(FrameCallback callback)
 {
-  for (uint8_t i = 0; i < NUM_CHANNELS; i++)
+  this->callback = callback;
+}
+
+void Data::Input::calibrate(const StickRange sticks[NUM_STICKS])
+{
+  for (uint8_t i = 0; i < NUM_STICKS; i++)
+  {
+    this->sticks[i].set(sticks[i]);
+  }
+}
+
+uint16_t Data::Input::channel(uint8_t index) const
+{
+  return index < NUM_CHANNELS ? channels[index] : 0;
+}
+
+uint32_t Data::Input::frameCount() const
+{
+  return frames;
+}
+
+uint32_t Data::Input::framesSkipped() const
+{
+  return skipped;
+}
+
+uint32_t Data::Input::frameTime() const
+{
+  return frameMillis;
+}
+
+uint16_t Data::Input::changes() const
+{
+  return changed;
+}
+
+bool Data::Input::Read()
+{
+  // The receive interrupt bumps the sequence for every valid servo frame
+  uint8_t received = receiver.sequence();
+  if (received == lastReceived)
   {
-    channelData[i] = ibus.readChannel(i);
-    DEBUG_PRINT_TRACE("Read channel ");
-    DEBUG_PRINT_TRACE(i);
-    DEBUG_PRINT_TRACE(" : ");
-    DEBUG_PRINTLN_TRACE(channelData[i]);
+    return false;
   }
 
-  rudder = map(channelData[RUDDER_INDEX], MIN_RAW_INPUT, MAX_RAW_INPUT, MIN_RUDDER_ANGLE, MAX_RUDDER_ANGLE);
-  divePlane = map(channelData[DIVE_PLANE_INDEX], MIN_RAW_INPUT, MAX_RAW_INPUT, MIN_DIVE_PLANE_ANGLE, MAX_DIVE_PLANE_ANGLE);
-  throttle = map(channelData[THROTTLE_INDEX], MIN_RAW_INPUT, MAX_RAW_INPUT, Motor::MIN_PWM_VALUE, Motor::MAX_PWM_VALUE);
+  // Snapshot the channels we use, starting over if a newer frame lands meanwhile.
+  // Decoding depends on the previous state, so it must only run on a whole frame.
+  do
+  {
+    received = receiver.sequence();
+    IBus::barrier();
+    const uint16_t* latest = receiver.channels();
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++)
+    {
+      channels[i] = latest[i];
+    }
+    IBus::barrier();
+  } while (received != receiver.sequence());
+  Decode();
+
+  uint8_t arrived = received - lastReceived;
+  lastReceived = received;
+  frames += arrived;
+  skipped += arrived - 1;
+  frameMillis = millis();
 
-  switch (channelData[SWA_INDEX])
+  for (uint8_t i = 0; i < NUM_CHANNELS; i++)
   {
-    case MIN_RAW_INPUT:
-      swA = SwitchPos::UP;
-      break;
-    case MAX_RAW_INPUT:
-      swA = SwitchPos::DOWN;
-      break;
+    LOG_TRACE(Log::RX_CHANNEL, i, channels[i]);
   }
-  switch (channelData[SWC_INDEX]) 
+  LOG_TRACE(Log::RX_STICKS, received, rudder, divePlane, throttle);
+  LOG_TRACE(Log::RX_SWITCHES, uint8_t(swA), uint8_t(swB), uint8_t(swC), uint8_t(swD));
+  LOG_TRACE(Log::RX_KNOBS, vrA, vrB);
+
+  if (callback)
   {
-    case MIN_RAW_INPUT:
-      swC = ThreeWaySwitchPos::UP;
-      break;
-    case MID_RAW_INPUT:
-      swC = ThreeWaySwitchPos::MIDDLE;
-      break;
-    case MAX_RAW_INPUT:
-      swC = ThreeWaySwitchPos::DOWN;
+    callback(*this);
   }
 
-  DEBUG_PRINTLN_TRACE("Raw to Mapped data values");
-  DEBUG_PRINTLN_TRACE("-------------------------");
-  DEBUG_PRINTLN_TRACE("Object\t\t|\tRaw\t|\tMapped");
-
-  DEBUG_PRINT_TRACE("Rudder\t\t|\t");
-  DEBUG_PRINT_TRACE(channelData[RUDDER_INDEX]);
-  DEBUG_PRINT_TRACE("\t|\t");
-  DEBUG_PRINTLN_TRACE(rudder);
-
-  DEBUG_PRINT_TRACE("Dive Plane\t|\t");
-  DEBUG_PRINT_TRACE(channelData[DIVE_PLANE_INDEX]);
-  DEBUG_PRINT_TRACE("\t|\t");
-  DEBUG_PRINTLN_TRACE(divePlane);
-
-  DEBUG_PRINT_TRACE("Throttle\t|\t");
-  DEBUG_PRINT_TRACE(channelData[THROTTLE_INDEX]);
-  DEBUG_PRINT_TRACE("\t|\t");
-  DEBUG_PRINTLN_TRACE(throttle);
-
-  DEBUG_PRINT_TRACE("swA\t\t|\t");
-  DEBUG_PRINT_TRACE(channelData[SWA_INDEX]);
-  DEBUG_PRINT_TRACE("\t|\t");
-  DEBUG_PRINTLN_TRACE(int(swA));
-
-  DEBUG_PRINT_TRACE("swC\t\t|\t");
-  DEBUG_PRINT_TRACE(channelData[SWC_INDEX]);
-  DEBUG_PRINT_TRACE("\t|\t");
-  DEBUG_PRINTLN_TRACE(int(swC));
-};
\ No newline at end of file
+  return true;
+};
+
+void Data::Input::Decode()
+{
+  uint8_t newThrottle = ThrottleMap::apply(sticks[THROTTLE_STICK].apply(channels[THROTTLE_INDEX]));
+  uint32_t newRudder = RudderMap::apply(sticks[RUDDER_STICK].apply(channels[RUDDER_INDEX]));
+  uint32_t newDivePlane = DivePlaneMap::apply(sticks[DIVE_PLANE_STICK].apply(channels[DIVE_PLANE_INDEX]));
+  SwitchPos newSwA = decodeSwitch(channels[SWA_INDEX], swA);
+  SwitchPos newSwB = decodeSwitch(channels[SWB_INDEX], swB);
+  ThreeWaySwitchPos newSwC = decodeSwitch(channels[SWC_INDEX], swC);
+  SwitchPos newSwD = decodeSwitch(channels[SWD_INDEX], swD);
+  uint16_t newVrA = decodeKnob(channels[VRA_INDEX], vrA);
+  uint16_t newVrB = decodeKnob(channels[VRB_INDEX], vrB);
+
+  changed = (newThrottle != throttle ? THROTTLE_CHANGED : 0)
+    | (newRudder != rudder ? RUDDER_CHANGED : 0)
+    | (newDivePlane != divePlane ? DIVE_PLANE_CHANGED : 0)
+    | (newSwA != swA ? SWA_CHANGED : 0)
+    | (newSwB != swB ? SWB_CHANGED : 0)
+    | (newSwC != swC ? SWC_CHANGED : 0)
+    | (newSwD != swD ? SWD_CHANGED : 0)
+    | (newVrA != vrA ? VRA_CHANGED : 0)
+    | (newVrB != vrB ? VRB_CHANGED : 0);
+
+  throttle = newThrottle;
+  rudder = newRudder;
+  divePlane = newDivePlane;
+  swA = newSwA;
+  swB = newSwB;
+  swC = newSwC;
+  swD = newSwD;
+  vrA = newVrA;
+  vrB = newVrB;
+}
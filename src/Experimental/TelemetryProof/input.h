@@ -23,7 +23,9 @@
 #include "dataUtils.h"
 #include "debug.h"
 #include "Arduino.h"
-#include "IBusBM.h"
+#include "ibus.h"
+#include "linearMap.h"
+#include "switchDecoder.h"
 #include "motor.h"
 
 // #define DEBUG_TRACE
@@ -41,8 +43,30 @@ namespace Data
   static constexpr uint8_t SWC_INDEX = 6; 
   static constexpr uint8_t SWD_INDEX = 7; 
   static constexpr uint8_t VRA_INDEX = 9; 
-  static constexpr uint8_t VRB_INDEX = 10
-  ; 
+  static constexpr uint8_t VRB_INDEX = 10;
+
+  /* Bits in Input::changes(), one per decoded field */
+  static constexpr uint16_t THROTTLE_CHANGED = 1 << 0;
+  static constexpr uint16_t RUDDER_CHANGED = 1 << 1;
+  static constexpr uint16_t DIVE_PLANE_CHANGED = 1 << 2;
+  static constexpr uint16_t SWA_CHANGED = 1 << 3;
+  static constexpr uint16_t SWB_CHANGED = 1 << 4;
+  static constexpr uint16_t SWC_CHANGED = 1 << 5;
+  static constexpr uint16_t SWD_CHANGED = 1 << 6;
+  static constexpr uint16_t VRA_CHANGED = 1 << 7;
+  static constexpr uint16_t VRB_CHANGED = 1 << 8;
+  static constexpr uint16_t ALL_CHANGED = (1 << 9) - 1;
+
+  /* Stick conversions, resolved at compile time */
+  typedef LinearMap<MIN_RAW_INPUT, MAX_RAW_INPUT, MIN_RUDDER_ANGLE, MAX_RUDDER_ANGLE> RudderMap;
+  typedef LinearMap<MIN_RAW_INPUT, MAX_RAW_INPUT, MIN_DIVE_PLANE_ANGLE, MAX_DIVE_PLANE_ANGLE> DivePlaneMap;
+  typedef LinearMap<MIN_RAW_INPUT, MAX_RAW_INPUT, Motor::MIN_PWM_VALUE, Motor::MAX_PWM_VALUE> ThrottleMap;
+
+  class Input;
+
+  /* Called once for every new frame decoded by Input::Read() */
+  typedef void (*FrameCallback)(const Input& input);
+
   /* Transformed controller inpus */
   class Input
   {
@@ -51,10 +75,46 @@ namespace Data
       Input();
 
       /* Starts serial communication */
-      Begin();
-
-      /* Read data */
-      Read();
+      void Begin();
+
+      /*
+       * Decodes the latest frame if the receiver delivered one since the
+       * last call, then runs the frame callback. Does nothing otherwise,
+       * so it is cheap to poll faster than the frame rate.
+       * @return true if a new frame was decoded
+       */
+      bool Read();
+
+      /*
+       * Set the function to run after each new frame is decoded
+       * @param callback Function to call, nullptr to disable
+       */
+      void OnFrame(FrameCallback callback);
+
+      /*
+       * Stretch each stick's own travel onto the nominal range before
+       * it is mapped. Takes effect from the next frame.
+       * @param sticks Ranges indexed by *_STICK, each low < centre < high
+       */
+      void calibrate(const StickRange sticks[NUM_STICKS]);
+
+      /* Raw receiver value of a channel in the current frame, before calibration */
+      uint16_t channel(uint8_t index) const;
+
+      /* Number of frames received since Begin() */
+      uint32_t frameCount() const;
+
+      /* Frames that arrived but were replaced before Read() saw them */
+      uint32_t framesSkipped() const;
+
+      /* millis() when the current frame was picked up */
+      uint32_t frameTime() const;
+
+      /*
+       * Fields that changed with the current frame
+       * @return *_CHANGED bits, 0 if the frame repeated the last one
+       */
+      uint16_t changes() const;
 
       /* Throttle value, between 0 and 255 */
       uint8_t throttle;
@@ -85,13 +145,37 @@ namespace Data
 
       private:
         /* Number of channels to read from reciever */
-        static constexpr uint8_t NUM_CHANNELS = 10;
+        static constexpr uint8_t NUM_CHANNELS = 11;
+
+        /* Map the raw channel values onto the public fields and note which ones changed */
+        void Decode();
+
+        /* Raw values of the current frame */
+        uint16_t channels[NUM_CHANNELS];
+
+        /* Calibration for each *_STICK */
+        StickScale sticks[NUM_STICKS];
+
+        /* iBus servo port */
+        IBus::Receiver receiver;
+
+        /* Receiver sequence number of the current frame */
+        uint8_t lastReceived;
+
+        /* Frames received since Begin() */
+        uint32_t frames;
+
+        /* Frames that were overwritten before being decoded */
+        uint32_t skipped;
+
+        /* millis() when the current frame was picked up */
+        uint32_t frameMillis;
 
-        /* Raw sensor data */
-        uint16_t channelData[NUM_CHANNELS];
+        /* *_CHANGED bits for the current frame */
+        uint16_t changed;
 
-        /* iBus object */
-        IBusBM ibus;
+        /* Run after each decoded frame */
+        FrameCallback callback;
   }; 
 }
 
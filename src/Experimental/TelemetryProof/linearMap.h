@@ -0,0 +1,148 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * linearMap.h - Division free replacement for map() on fixed ranges.
+ */
+
+#ifndef LINEAR_MAP_h
+#define LINEAR_MAP_h
+
+#include "Arduino.h"
+#include "dataUtils.h"
+
+namespace Data
+{
+  /*
+   * Smallest shift for which a multiply-and-shift reproduces the floor
+   * of a division by span for every numerator 0..span: 2^shift > span^2.
+   */
+  constexpr uint8_t mapShift(uint32_t span, uint8_t shift = 0)
+  {
+    return (1ULL << shift) > uint64_t(span) * span ? shift : mapShift(span, shift + 1);
+  }
+
+  /* Scaled reciprocal, rounded up so truncation never falls one short */
+  constexpr uint32_t mapMultiplier(uint32_t range, uint32_t span)
+  {
+    return uint32_t((uint64_t(range) << mapShift(span)) / span + 1);
+  }
+
+  /*
+   * LinearMap class - map() from [IN_MIN, IN_MAX] to [OUT_MIN, OUT_MAX]
+   * with every constant worked out at compile time.
+   *
+   * For inputs inside the range the result is exactly what map() gives,
+   * but it costs one 32 bit multiply and a shift instead of a long
+   * division. Inputs outside the range are clamped to it first rather
+   * than extrapolated.
+   */
+  template <uint16_t IN_MIN, uint16_t IN_MAX, int32_t OUT_MIN, int32_t OUT_MAX>
+  class LinearMap
+  {
+    public:
+      static_assert(IN_MAX > IN_MIN, "Input range must be ascending");
+      static_assert(OUT_MAX >= OUT_MIN, "Output range must be ascending");
+
+      static constexpr uint32_t SPAN = IN_MAX - IN_MIN;
+      static constexpr uint32_t RANGE = uint32_t(OUT_MAX - OUT_MIN);
+      static constexpr uint8_t SHIFT = mapShift(SPAN);
+      static constexpr uint32_t MULTIPLIER = mapMultiplier(RANGE, SPAN);
+
+      static_assert(uint64_t(SPAN) * MULTIPLIER <= 0xFFFFFFFFULL, "Ranges too wide for a 32 bit product");
+
+      /*
+       * Convert a raw value
+       * @param raw Value in the input range
+       * @return The value scaled onto the output range
+       */
+      static inline int32_t apply(uint16_t raw)
+      {
+        uint16_t offset = raw <= IN_MIN ? 0 : (raw >= IN_MAX ? SPAN : raw - IN_MIN);
+        return OUT_MIN + int32_t((offset * MULTIPLIER) >> SHIFT);
+      }
+  };
+
+  /*
+   * StickScale class - Stretches one transmitter's stick onto the
+   * nominal MIN_RAW_INPUT to MAX_RAW_INPUT range the LinearMaps expect.
+   *
+   * Each side of the centre has its own scale, so a stick that rests off
+   * the middle of its travel still reads MID_RAW_INPUT at rest. The
+   * scales are worked out once by set(); apply() is a multiply and a
+   * shift. The nominal range passes through unchanged.
+   */
+  class StickScale
+  {
+    public:
+      /* Starts out on NOMINAL_STICK */
+      StickScale();
+
+      /*
+       * Work out the scales for a stick
+       * @param range Its raw ends and rest position, low < centre < high
+       */
+      void set(const StickRange& range);
+
+      /*
+       * Convert a raw value
+       * @param raw Channel value from the receiver
+       * @return The value on the nominal range, clamped to it
+       */
+      uint16_t apply(uint16_t raw) const;
+
+    private:
+      /* Half the nominal span, what each side is stretched to */
+      static constexpr uint16_t HALF_SPAN = MID_RAW_INPUT - MIN_RAW_INPUT;
+
+      StickRange range;
+
+      /* Nominal counts per raw count either side of the centre, in 1/65536 */
+      uint32_t lowScale;
+      uint32_t highScale;
+  };
+
+  inline StickScale::StickScale()
+  {
+    set(NOMINAL_STICK);
+  }
+
+  inline void StickScale::set(const StickRange& range)
+  {
+    this->range = range;
+    // Rounded up, so the ends of the travel reach the ends of the range
+    uint32_t below = range.centre - range.low;
+    uint32_t above = range.high - range.centre;
+    lowScale = ((uint32_t(HALF_SPAN) << 16) + below - 1) / below;
+    highScale = ((uint32_t(HALF_SPAN) << 16) + above - 1) / above;
+  }
+
+  inline uint16_t StickScale::apply(uint16_t raw) const
+  {
+    if (raw < range.centre)
+    {
+      uint16_t offset = raw <= range.low ? HALF_SPAN : uint16_t((uint32_t(range.centre - raw) * lowScale) >> 16);
+      return MID_RAW_INPUT - (offset < HALF_SPAN ? offset : HALF_SPAN);
+    }
+    uint16_t offset = raw >= range.high ? HALF_SPAN : uint16_t((uint32_t(raw - range.centre) * highScale) >> 16);
+    return MID_RAW_INPUT + (offset < HALF_SPAN ? offset : HALF_SPAN);
+  }
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "log.h"
+
+namespace
+{
+  uint8_t buffer[Log::BUFFER_SIZE];
+
+  /* Next byte to write and next byte to send, wrapping at 256 */
+  uint8_t head = 0;
+  uint8_t tail = 0;
+
+  /* Records dropped since start, and since that was last logged */
+  uint32_t droppedTotal = 0;
+  uint32_t droppedUnreported = 0;
+
+  /* Whether a record with this much payload fits. One slot stays empty so full and empty differ. */
+  bool fits(uint8_t length)
+  {
+    uint8_t used = head - tail;
+    return Log::BUFFER_SIZE - 1 - used >= uint16_t(length + Log::FRAME_OVERHEAD);
+  }
+
+  void put(uint8_t data)
+  {
+    buffer[head++] = data;
+  }
+
+  uint8_t* putLong(uint8_t* out, uint32_t value)
+  {
+    *out++ = uint8_t(value);
+    *out++ = uint8_t(value >> 8);
+    *out++ = uint8_t(value >> 16);
+    *out++ = uint8_t(value >> 24);
+    return out;
+  }
+}
+
+uint8_t Log::crc8(uint8_t crc, uint8_t data)
+{
+  crc ^= data;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    crc = crc & 0x80 ? uint8_t(crc << 1) ^ 0x07 : uint8_t(crc << 1);
+  }
+  return crc;
+}
+
+bool Log::frame(uint8_t type, const uint8_t* payload, uint8_t length)
+{
+  if (!fits(length))
+  {
+    droppedTotal++;
+    droppedUnreported++;
+    return false;
+  }
+
+  put(FRAME_SYNC);
+  put(type);
+  put(length);
+  uint8_t crc = crc8(crc8(0, type), length);
+  for (uint8_t i = 0; i < length; i++)
+  {
+    put(payload[i]);
+    crc = crc8(crc, payload[i]);
+  }
+  put(crc);
+  return true;
+}
+
+void Log::record(Level level, MessageId id, const int32_t* args, uint8_t count)
+{
+  uint8_t payload[MAX_PAYLOAD];
+  payload[0] = id;
+  payload[1] = level;
+  uint8_t* out = putLong(payload + 2, micros());
+  count = count < MAX_ARGS ? count : MAX_ARGS;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    out = putLong(out, args[i]);
+  }
+  frame(RECORD_LOG, payload, out - payload);
+}
+
+uint16_t Log::drain(HardwareSerial& port)
+{
+  // Report losses as soon as there is room for the report
+  if (droppedUnreported && fits(LOG_HEADER + 4))
+  {
+    int32_t lost = int32_t(droppedUnreported);
+    droppedUnreported = 0;
+    record(LEVEL_WARN, LOG_DROPPED, &lost, 1);
+  }
+
+  int room = port.availableForWrite();
+  uint16_t sent = 0;
+  while (room-- > 0 && tail != head)
+  {
+    port.write(buffer[tail++]);
+    sent++;
+  }
+  return sent;
+}
+
+uint16_t Log::pending()
+{
+  return uint8_t(head - tail);
+}
+
+uint16_t Log::room()
+{
+  uint16_t free = BUFFER_SIZE - 1 - uint8_t(head - tail);
+  return free > FRAME_OVERHEAD ? free - FRAME_OVERHEAD : 0;
+}
+
+uint32_t Log::dropped()
+{
+  return droppedTotal;
+}
+
+void Log::clear()
+{
+  head = tail = 0;
+  droppedTotal = droppedUnreported = 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Log.h - Binary logging into a RAM ring, drained when the loop is idle.
+ *
+ * Writing a record copies a few bytes and never waits on the UART. When
+ * the ring is full the record is dropped and counted, and the count is
+ * logged itself once there is room again. Use the LOG_* macros in
+ * debug.h rather than calling this directly, so disabled levels cost
+ * nothing.
+ *
+ * Every record is framed as
+ *   FRAME_SYNC, type, payload length, payload, CRC-8 of type to payload
+ * and a log record's payload is
+ *   message id, level, micros() (4 bytes), then each number (4 bytes),
+ * all little endian.
+ */
+
+#ifndef LOG_h
+#define LOG_h
+
+#include "Arduino.h"
+#include "logMessages.h"
+
+namespace Log
+{
+  static constexpr uint8_t FRAME_SYNC = 0xA5;
+  static constexpr uint8_t FRAME_OVERHEAD = 4; // Sync, type, length and CRC around the payload
+  static constexpr uint8_t RECORD_LOG = 0x01;
+  static constexpr uint8_t LOG_HEADER = 6; // Id, level and timestamp ahead of the numbers
+  static constexpr uint8_t MAX_ARGS = 4;
+  static constexpr uint8_t MAX_PAYLOAD = LOG_HEADER + 4 * MAX_ARGS;
+
+  /* Ring size, 256 so the indexes wrap on their own */
+  static constexpr uint16_t BUFFER_SIZE = 256;
+
+  enum Level : uint8_t
+  {
+    LEVEL_TRACE,
+    LEVEL_INFO,
+    LEVEL_WARN,
+    LEVEL_ERROR
+  };
+
+  #define LOG_MESSAGE_ID(id, text) id,
+  enum MessageId : uint8_t
+  {
+    LOG_MESSAGES(LOG_MESSAGE_ID)
+    NUM_MESSAGES
+  };
+  #undef LOG_MESSAGE_ID
+
+  /*
+   * Step a CRC-8 (polynomial 0x07) over one byte
+   * @param crc CRC so far, 0 to start
+   * @param data Next byte
+   * @return Updated CRC
+   */
+  uint8_t crc8(uint8_t crc, uint8_t data);
+
+  /*
+   * Append one framed record to the ring, or drop it whole
+   * @param type Record type
+   * @param payload Record body
+   * @param length Bytes in payload
+   * @return false if there was no room and the record was dropped
+   */
+  bool frame(uint8_t type, const uint8_t* payload, uint8_t length);
+
+  /*
+   * Log a message with up to MAX_ARGS numbers. Main loop context only,
+   * never from an interrupt.
+   */
+  void record(Level level, MessageId id, const int32_t* args, uint8_t count);
+
+  template <typename... Args>
+  inline void write(Level level, MessageId id, Args... args)
+  {
+    static_assert(sizeof...(args) <= MAX_ARGS, "Too many numbers for one log record");
+    const int32_t values[] = { int32_t(args)..., 0 };
+    record(level, id, values, sizeof...(args));
+  }
+
+  /*
+   * Send as much of the ring as the port can take without blocking
+   * @param port Where to send it
+   * @return Bytes sent
+   */
+  uint16_t drain(HardwareSerial& port);
+
+  /* Bytes waiting in the ring */
+  uint16_t pending();
+
+  /* Largest payload a frame() call could queue right now */
+  uint16_t room();
+
+  /* Records dropped since start */
+  uint32_t dropped();
+
+  /* Empty the ring and clear the counts */
+  void clear();
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * LogMessages.h - Every message the sketch can log.
+ *
+ * Records only carry the message id and its numbers; the text lives
+ * here, is never built into the sketch and is put back together by the
+ * host decoder. Append new messages at the end so ids in old captures
+ * keep their meaning. Each %d takes the next number from the record.
+ */
+
+#ifndef LOG_MESSAGES_h
+#define LOG_MESSAGES_h
+
+#define LOG_MESSAGES(MESSAGE) \
+  MESSAGE(LOG_DROPPED, "Dropped %d log records") \
+  MESSAGE(STARTING, "Starting") \
+  MESSAGE(RX_CHANNEL, "Read channel %d : %d") \
+  MESSAGE(RX_STICKS, "Frame %d mapped rudder %d, dive plane %d, throttle %d") \
+  MESSAGE(RX_SWITCHES, "Switches A %d, B %d, C %d, D %d") \
+  MESSAGE(RX_KNOBS, "Knobs A %d, B %d") \
+  MESSAGE(SENSOR_ADDRESSES, "Sensor addresses speed %d, rpm %d, pressure %d, voltage %d") \
+  MESSAGE(HEADING_ADDRESS, "Heading sensor address %d") \
+  MESSAGE(TELEMETRY, "Telemetry pressure %d, heading %d, rpm %d, speed %d") \
+  MESSAGE(TELEMETRY_VOLTS, "Telemetry volts %d") \
+  MESSAGE(MOTOR_SET, "Motor set direction %d, pwm %d") \
+  MESSAGE(PWM_TOO_HIGH, "PWM value %d exceeds maximum, clamping to MAX_PWM_VALUE") \
+  MESSAGE(PWM_TOO_LOW, "PWM value %d below minimum, clamping to MIN_PWM_VALUE") \
+  MESSAGE(SERVO_BUS, "Servo bus %d bytes/s") \
+  MESSAGE(FAILSAFE_ENGAGED, "Failsafe engaged, reasons %d, battery %d mV") \
+  MESSAGE(FAILSAFE_CLEARED, "Failsafe cleared after %d ms") \
+  MESSAGE(WATCHDOG_RESET, "Restarted by the watchdog") \
+  MESSAGE(DEPTH_SENSOR_FAULT, "Depth sensor fault %d, retrying") \
+  MESSAGE(DEPTH, "Depth %d mm, pressure %d Pa, water %d C x 100") \
+  MESSAGE(COMPASS_FAULT, "Compass not answering, %d errors") \
+  MESSAGE(DEPTH_HOLD, "Depth hold target %d mm, at %d mm") \
+  MESSAGE(MEMORY, "RAM static %d, stack peak %d, never used %d bytes") \
+  MESSAGE(CALIBRATION_DEFAULTS, "No calibration stored, using defaults") \
+  MESSAGE(CALIBRATION_STARTED, "Stick calibration started") \
+  MESSAGE(CALIBRATION_SAVED, "Sticks calibrated, travel rudder %d, dive plane %d, throttle %d") \
+  MESSAGE(CALIBRATION_REJECTED, "Stick calibration rejected, stick %d not moved far enough") \
+  MESSAGE(CALIBRATION_STORED, "Calibration written to EEPROM") \
+  MESSAGE(FAILSAFE_REARMED, "Re-armed after undervoltage, battery %d mV") \
+  MESSAGE(FAILSAFE_REARM_REFUSED, "Re-arm refused, battery still %d mV")
+
+#endif
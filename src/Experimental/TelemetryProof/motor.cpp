@@ -56,7 +56,7 @@ Motor::Direction Motor::HBridge::getState()
 
 void Motor::HBridgePWM::set(Direction direction, uint8_t pwm)
 {
-  DEBUG_PRINTLN_INFO("Set called");
+  LOG_INFO(Log::MOTOR_SET, direction, pwm);
   switch (direction) 
   {
     case FORWARD:
@@ -80,13 +80,13 @@ void Motor::HBridgePWM::setSpeed(uint8_t pwm)
 {
   if (pwm > MAX_PWM_VALUE)
   {
-    DEBUG_PRINTLN_ERROR("PWM value exceeds maximum, clamping to MAX_PWM_VALUE");
+    LOG_ERROR(Log::PWM_TOO_HIGH, pwm);
     pwm = MAX_PWM_VALUE;
   }
 
   if (pwm < MIN_PWM_VALUE)
   {
-    DEBUG_PRINTLN_WARN("PWM value below minimum, clamping to MIN_PWM_VALUE");
+    LOG_WARN(Log::PWM_TOO_LOW, pwm);
     pwm = MIN_PWM_VALUE;
   }
 
@@ -94,6 +94,11 @@ void Motor::HBridgePWM::setSpeed(uint8_t pwm)
   pwmLevel = pwm;
 }
 
+uint8_t Motor::HBridgePWM::getSpeed() const
+{
+  return pwmLevel;
+}
+
 void Motor::HBridgePWM::stop()
 {
   HBridge::stop();
@@ -107,47 +112,185 @@ void Motor::HBridgePWM::off()
 }
 
 
-void Motor::HBridgePWMEnc::read()
+Motor::RpmEstimator::RpmEstimator()
+  : anchorCount(0), anchorTime(0), lastCount(0), lastChange(0), filtered(0)
+{
+}
+
+void Motor::RpmEstimator::begin(int32_t count, uint32_t now)
+{
+  anchorCount = lastCount = count;
+  anchorTime = lastChange = now;
+  filtered = 0;
+}
+
+void Motor::RpmEstimator::sample(int32_t count, uint32_t now)
+{
+  if (count != lastCount)
+  {
+    lastCount = count;
+    lastChange = now;
+  }
+
+  // Differences through unsigned so a wrapping count stays well defined
+  int32_t moved = int32_t(uint32_t(lastCount) - uint32_t(anchorCount));
+  int32_t magnitude = moved < 0 ? -moved : moved;
+
+  if (magnitude >= MIN_COUNTS || (moved != 0 && now - anchorTime >= MAX_EDGE_WINDOW))
+  {
+    // Edge to edge, so the span holds exactly moved counts
+    uint32_t span = lastChange - anchorTime;
+    moved = constrain(moved, -MAX_COUNTS, MAX_COUNTS);
+    filter(moved * RPM_SCALE / int32_t(span));
+    anchorCount = lastCount;
+    anchorTime = lastChange;
+  }
+  else if (now - lastChange >= STALL_TIME)
+  {
+    filtered = 0;
+    anchorCount = lastCount;
+    anchorTime = now;
+  }
+}
+
+void Motor::RpmEstimator::filter(int32_t rawRpm)
+{
+  filtered += (rawRpm - filtered) / (1 << RPM_FILTER_SHIFT);
+}
+
+int32_t Motor::RpmEstimator::getSignedRpm() const
+{
+  // Round to the nearest whole rpm, symmetrically about zero
+  constexpr int32_t HALF = 1 << (RPM_FRACTION_BITS - 1);
+  return filtered < 0 ? -((HALF - filtered) >> RPM_FRACTION_BITS) : (filtered + HALF) >> RPM_FRACTION_BITS;
+}
+
+int32_t Motor::RpmEstimator::getRpm() const
+{
+  int32_t rpm = getSignedRpm();
+  return rpm < 0 ? -rpm : rpm;
+}
+
+int8_t Motor::RpmEstimator::getDirection() const
+{
+  int32_t rpm = getSignedRpm();
+  return rpm > 0 ? 1 : (rpm < 0 ? -1 : 0);
+}
+
+int32_t Motor::QuadratureCounter::read()
+{
+  return encoder.read();
+}
+
+void Motor::Timer5Counter::begin()
 {
-  uint32_t currentTime = millis();
-  uint32_t elapsedTime = currentTime - lastTime;
-  if (elapsedTime == 0)
+  pinMode(T5_PIN, INPUT);
+  pinMode(DIRECTION_PIN, INPUT);
+
+  // Normal mode, clocked from rising edges on T5, no interrupts
+  uint8_t oldSREG = SREG;
+  cli();
+  TIMSK5 = 0;
+  TCCR5A = 0;
+  TCCR5B = _BV(CS52) | _BV(CS51) | _BV(CS50);
+  lastTimer = TCNT5;
+  SREG = oldSREG;
+}
+
+int32_t Motor::Timer5Counter::read()
+{
+  // 16 bit reads go through the shared TEMP register, keep interrupts out of the middle
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t timer = TCNT5;
+  SREG = oldSREG;
+  uint16_t edges = timer - lastTimer;
+  lastTimer = timer;
+
+  int32_t counts = int32_t(edges) * COUNTS_PER_CYCLE;
+  count = int32_t(uint32_t(count) + uint32_t(digitalRead(DIRECTION_PIN) == HIGH ? -counts : counts));
+  return count;
+}
+
+void Motor::HBridgePWMEnc::begin()
+{
+  counter.begin();
+  estimator.begin(counter.read(), micros());
+}
+
+void Motor::HBridgePWMEnc::setTargetRpm(Direction direction, uint16_t rpm)
+{
+  if (direction != FORWARD && direction != BACKWARD)
   {
+    set(direction, MIN_PWM_VALUE);
     return;
   }
 
-  if (elapsedTime >= UPDATE_INTERVAL)
+  if (direction != state)
   {
-    int32_t pulses = this->encoder.readAndReset();
-    if (pulses < 0)
+    // Reversing starts from nothing rather than whatever the other way needed
+    if (direction == FORWARD)
     {
-      pulses = pulses * -1;
+      forward();
+    }
+    else
+    {
+      backward();
     }
-    rpm = (pulses / double(PULSES_PER_REVOLUTION)) * (MINUTE_MS / elapsedTime);
-    lastTime = currentTime;
+    HBridgePWM::setSpeed(MIN_PWM_VALUE);
+    controller.reset(MIN_PWM_VALUE);
   }
+  else if (!closedLoop)
+  {
+    controller.reset(getSpeed());
+  }
+
+  closedLoop = true;
+  targetRpm = rpm;
+}
+
+uint16_t Motor::HBridgePWMEnc::getTargetRpm() const
+{
+  return closedLoop ? targetRpm : 0;
+}
+
+bool Motor::HBridgePWMEnc::isClosedLoop() const
+{
+  return closedLoop;
 }
 
-void Motor::HBridgePWMEnc::set(Motor::Direction direction, uint8_t speed)
+void Motor::HBridgePWMEnc::set(Direction direction, uint8_t speed)
 {
+  closedLoop = false;
   HBridgePWM::set(direction, speed);
-  read();
 }
 
 void Motor::HBridgePWMEnc::setSpeed(uint8_t speed)
 {
+  closedLoop = false;
   HBridgePWM::setSpeed(speed);
-  read();
 }
 
 void Motor::HBridgePWMEnc::off()
 {
+  closedLoop = false;
   HBridgePWM::off();
-  read();
 }
 
 void Motor::HBridgePWMEnc::stop()
 {
+  closedLoop = false;
   HBridgePWM::stop();
-  rpm = 0;
-}
\ No newline at end of file
+}
+
+void Motor::HBridgePWMEnc::read()
+{
+  estimator.sample(counter.read(), micros());
+
+  if (closedLoop)
+  {
+    // The controller wants speed along the commanded direction
+    int32_t measured = estimator.getSignedRpm();
+    HBridgePWM::setSpeed(controller.update(targetRpm, state == BACKWARD ? -measured : measured));
+  }
+}
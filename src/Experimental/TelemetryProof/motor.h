@@ -32,16 +32,38 @@
 #include "Arduino.h"
 #include "Encoder.h"
 #include "debug.h"
+#include "speedController.h"
 
 /* Holds classes for controlling motors */
 namespace Motor
 {
   // Constants
-  static constexpr float MINUTE_MS = 60000.0f;
+  static constexpr uint32_t MINUTE_US = 60000000;
   static constexpr uint16_t MAX_PWM_VALUE = 255;
   static constexpr uint8_t MIN_PWM_VALUE = 0;
-  static constexpr uint32_t UPDATE_INTERVAL = 50;
-  static constexpr int16_t PULSES_PER_REVOLUTION = 8400;
+  static constexpr int16_t PULSES_PER_REVOLUTION = 8400; // Quadrature counts, four per encoder cycle
+  static constexpr uint8_t COUNTS_PER_CYCLE = 4;
+
+  // RPM estimation
+  static constexpr uint32_t RPM_SAMPLE_PERIOD = 10000; // Microseconds between encoder samples
+  static constexpr uint8_t RPM_FRACTION_BITS = 4; // Estimates are kept in 1/16 rpm
+  static constexpr int32_t RPM_SCALE = ((MINUTE_US << RPM_FRACTION_BITS) + PULSES_PER_REVOLUTION / 2) / PULSES_PER_REVOLUTION; // Counts per microsecond to 1/16 rpm
+  static constexpr int32_t MIN_COUNTS = 16; // Fewer counts than this in a sample times edges instead
+  static constexpr int32_t MAX_COUNTS = INT32_MAX / RPM_SCALE; // Most counts one estimate can hold without overflow
+  static constexpr uint32_t MAX_EDGE_WINDOW = 200000; // Longest a slow estimate waits for MIN_COUNTS
+  static constexpr uint32_t STALL_TIME = 250000; // No edge for this long means stopped
+  static constexpr uint8_t RPM_FILTER_SHIFT = 2; // Each estimate moves the output 1/4 of the way
+
+  // Speed control, tuned for the main screw
+  static constexpr uint16_t DEFAULT_MAX_RPM = 300; // Speed at full duty, unloaded, on a charged battery
+  static constexpr SpeedGains DEFAULT_SPEED_GAINS = {
+    128, // kp: half a duty step per rpm of error
+    16, // ki: 1/16 duty step per rpm of error per tick
+    0, // kd: the rpm filter is smooth enough without one
+    (MAX_DUTY << GAIN_SHIFT) / DEFAULT_MAX_RPM, // kff: duty for DEFAULT_MAX_RPM is full duty
+    0, // offset
+    8 // slew: full duty takes at least 0.32 s to reach
+  };
 
   // pins
   static constexpr uint8_t DEFAULT_INPUT_1_PIN = 22;
@@ -49,6 +71,7 @@ namespace Motor
   static constexpr uint8_t DEFAULT_PWM_PIN = 2;
   static constexpr uint8_t DEFAULT_ENCODER_SIGNAL_A_PIN = 21;
   static constexpr uint8_t DEFAULT_ENCODER_SIGNAL_B_PIN = 20;
+  static constexpr uint8_t T5_PIN = 47; // Timer5 external clock input, PL2
 
   /*
    * Possible motor states
@@ -171,20 +194,193 @@ namespace Motor
       uint16_t pwmLevel;
   };
 
+  /*
+   * RpmEstimator class - Turns encoder counts sampled on a fixed period
+   * into a filtered, signed rpm, without floating point.
+   *
+   * At speed each sample sees plenty of counts and rpm comes from counts
+   * over the sample period. When a sample sees fewer than MIN_COUNTS,
+   * the estimate instead spans whole edges: from the sample where the
+   * count first changed to the sample where it last changed, stretched
+   * until it holds MIN_COUNTS or MAX_EDGE_WINDOW passes. No edges for
+   * STALL_TIME reads as stopped.
+   */
+  class RpmEstimator
+  {
+    public:
+      /* Default constructor */
+      RpmEstimator();
+
+      /*
+       * Start estimating from a known position
+       * @param count Current encoder count
+       * @param now micros() at which count was read
+       */
+      void begin(int32_t count, uint32_t now);
+
+      /*
+       * Feed a new sample. Call every RPM_SAMPLE_PERIOD.
+       * @param count Encoder count, free running
+       * @param now micros() at which count was read
+       */
+      void sample(int32_t count, uint32_t now);
+
+      /* Filtered speed in rpm, regardless of direction */
+      int32_t getRpm() const;
+
+      /* Filtered speed in rpm, negative when counting down */
+      int32_t getSignedRpm() const;
+
+      /* 1 when counting up, -1 when counting down, 0 when stopped */
+      int8_t getDirection() const;
+
+    private:
+      /* Feed one raw estimate, in 1/16 rpm, through the filter */
+      void filter(int32_t rawRpm);
+
+      /* Count at the start of the current estimate */
+      int32_t anchorCount;
+
+      /* Sample time the anchor count was first seen */
+      uint32_t anchorTime;
+
+      /* Count at the last sample */
+      int32_t lastCount;
+
+      /* Sample time the count last changed */
+      uint32_t lastChange;
+
+      /* Filtered signed rpm in 1/16 rpm */
+      int32_t filtered;
+  };
+
+  /*
+   * PulseCounter class - Source of free running encoder counts, in
+   * quadrature counts so every backend reads on the same scale.
+   */
+  class PulseCounter
+  {
+    public:
+      /* Set up the hardware. Call from setup(), after the core has initialised its timers */
+      virtual void begin() {};
+
+      /* Count since begin(), wrapping through int32_t */
+      virtual int32_t read() = 0;
+  };
+
+  /*
+   * QuadratureCounter class - Counts every edge of both channels from
+   * pin change interrupts, using the Encoder library. Exact in both
+   * directions, but costs one interrupt per count, which limits it to
+   * a few thousand rpm at 8400 counts per revolution.
+   */
+  class QuadratureCounter : public PulseCounter
+  {
+    public:
+      /*
+       * @param signalA Interrupt capable pin for channel A
+       * @param signalB Interrupt capable pin for channel B
+       */
+      QuadratureCounter(uint8_t signalA, uint8_t signalB)
+        : encoder(signalA, signalB) {};
+
+      int32_t read() override;
+
+    private:
+      /* Does the counting */
+      Encoder encoder;
+  };
+
+  /*
+   * Timer5Counter class - Counts rising edges of channel A in Timer5,
+   * clocked from the T5 pin (47), so counting costs no interrupts at all.
+   *
+   * Only one edge per cycle is seen, so each is worth COUNTS_PER_CYCLE
+   * quadrature counts. The timer can not tell direction; that comes from
+   * a direction level read at every sample, which needs to be latched
+   * (channel B through a D flip-flop clocked by A, or a decoder chip's
+   * DIR output) since the raw B level says nothing between edges.
+   *
+   * Takes Timer5 from the core, so pins 44 to 46 lose analogWrite().
+   */
+  class Timer5Counter : public PulseCounter
+  {
+    public:
+      /*
+       * @param directionPin Pin that is HIGH while the shaft turns backward
+       */
+      Timer5Counter(uint8_t directionPin)
+        : DIRECTION_PIN(directionPin), lastTimer(0), count(0) {};
+
+      void begin() override;
+
+      /*
+       * Fold the timer into the running count. Must be called at least
+       * once every 65536 edges, which is 10 ms at 6.5 MHz.
+       */
+      int32_t read() override;
+
+    private:
+      /* Pin that gives the direction */
+      const uint8_t DIRECTION_PIN;
+
+      /* TCNT5 at the last read */
+      uint16_t lastTimer;
+
+      /* Running count in quadrature counts */
+      int32_t count;
+  };
+
+  /*
+   * HBridgePWMEnc class - HBridgePWM with an encoder on the shaft.
+   * Call read() every RPM_SAMPLE_PERIOD to keep the rpm fresh.
+   *
+   * set() and friends drive the duty directly as before. setTargetRpm()
+   * switches to closed loop, where every read() runs the speed
+   * controller and sets the duty itself, until the next set().
+   */
   class HBridgePWMEnc : public HBridgePWM
   {
     public:
-      HBridgePWMEnc() 
-        : HBridgePWMEnc(DEFAULT_INPUT_1_PIN, DEFAULT_INPUT_2_PIN, DEFAULT_PWM_PIN, DEFAULT_ENCODER_SIGNAL_A_PIN, DEFAULT_ENCODER_SIGNAL_B_PIN) {};
-      
-      HBridgePWMEnc(uint8_t input1, uint8_t input2, uint8_t pwmPin, uint8_t interrupt1, uint8_t interrupt2)
-        : HBridgePWM(input1, input2, pwmPin), encoder(interrupt1, interrupt2), rpm(0) {};
+      /* Parametized Constructor
+       * @param input1 Pin that helps to control direction of motor
+       * @param input2 Pin that helps to control direction of motor
+       * @param pwmPin Pin that controls speed of motor
+       * @param counter Encoder counting backend, QuadratureCounter or Timer5Counter
+       */
+      HBridgePWMEnc(uint8_t input1, uint8_t input2, uint8_t pwmPin, PulseCounter& counter, const SpeedGains& gains = DEFAULT_SPEED_GAINS)
+        : HBridgePWM(input1, input2, pwmPin), counter(counter), controller(gains), closedLoop(false), targetRpm(0) {};
 
-      int32_t getRpm()
+      /*
+       * Start the encoder counting. Call from setup().
+       */
+      void begin();
+
+      /* Filtered rpm, regardless of direction */
+      int32_t getRpm() const
+      {
+        return estimator.getRpm();
+      }
+
+      /* 1 forward, -1 backward, 0 stopped, as seen by the encoder */
+      int8_t getDirection() const
       {
-        return rpm;
+        return estimator.getDirection();
       }
 
+      /*
+       * Hold a speed instead of a duty.
+       * @param direction FORWARD or BACKWARD, anything else falls back to set()
+       * @param rpm Speed to hold
+       */
+      void setTargetRpm(Direction direction, uint16_t rpm);
+
+      /* Speed being held, 0 when not in closed loop */
+      uint16_t getTargetRpm() const;
+
+      /* True while setTargetRpm() is in charge of the duty */
+      bool isClosedLoop() const;
+
       void set(Direction direction, uint8_t speed) override;
 
       void setSpeed(uint8_t speed) override;
@@ -194,27 +390,35 @@ namespace Motor
       void stop() override;
 
       /*
-        * Reads encoder
-        */
+       * Samples the encoder, then updates the duty when in closed loop
+       */
       void read();
 
       private:
-        /* 
-        * Current rotations per minute
-        * Unused and inaccessible right now
-        */
-        volatile int32_t rpm;
+        /*
+         * Encoder for reading motor speed
+         */
+        PulseCounter& counter;
 
         /*
-         * Last time in milliseconds
-         * pulse count was checked
+         * Closed loop speed control
          */
-        uint32_t lastTime = millis();
+        SpeedController controller;
 
         /*
-         * Encoder for reading motor speed
+         * Whether read() drives the duty
+         */
+        bool closedLoop;
+
+        /*
+         * Speed to hold in closed loop
+         */
+        uint16_t targetRpm;
+
+        /*
+         * Turns encoder samples into rpm
          */
-        Encoder encoder;
+        RpmEstimator estimator;
   };
 }
 
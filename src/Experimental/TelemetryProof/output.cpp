@@ -20,71 +20,93 @@
 
 #include "output.h"
 
-namespace data
+namespace
 {
-  Data::Output::Begin()
+  #define TELEMETRY_SENSOR_SPEC(id, type, length, num, den) \
+    { type, length, Data::sensorMultiplier(num, den), uint8_t(den == 1 ? 0 : Data::SCALE_SHIFT) },
+  const Data::SensorSpec SPECS[Data::NUM_SENSORS] = { TELEMETRY_SENSORS(TELEMETRY_SENSOR_SPEC) };
+  #undef TELEMETRY_SENSOR_SPEC
+}
+
+int32_t Data::batteryMillivolts(uint16_t reading)
+{
+  return (int32_t(reading) * ADC_REFERENCE_MV * BATTERY_DIVIDER) >> Analog::RESULT_BITS;
+}
+
+int32_t Data::scaleSensor(const SensorSpec& spec, int32_t source)
+{
+  int32_t value = spec.multiplier * source;
+  if (spec.shift)
+  {
+    value = (value + (int32_t(1) << (spec.shift - 1))) >> spec.shift;
+  }
+
+  // Two byte values are unsigned on the transmitter, so pin rather than wrap
+  if (spec.length == 2)
+  {
+    value = constrain(value, int32_t(0), int32_t(UINT16_MAX));
+  }
+  return value;
+}
+
+void Data::Output::Begin()
+{
+  this->ibus.begin();
+  for (uint8_t i = 0; i < NUM_SENSORS; i++)
+  {
+    addresses[i] = ibus.addSensor(SPECS[i].type, SPECS[i].length);
+    encoded[i] = 0;
+  }
+
+  LOG_INFO(Log::SENSOR_ADDRESSES, addresses[SPEED_SENSOR], addresses[RPM_SENSOR], addresses[PRESSURE_SENSOR], addresses[VOLTAGE_SENSOR]);
+  LOG_INFO(Log::HEADING_ADDRESS, addresses[HEADING_SENSOR]);
+}
+
+void Data::Output::Set(SensorId sensor, int32_t source)
+{
+  int32_t value = scaleSensor(SPECS[sensor], source);
+  if (value == encoded[sensor])
   {
-    this->ibus.begin(Serial3);
-    this->speedSensor = ibus.addSensor(SPEED);
-    this->rpmSensor = ibus.addSensor(IBUSS_RPM);
-    this->presSensor = ibus.addSensor(PRESSURE, PRESSURE_SIZE);
-    this->voltageSensor = ibus.addSensor(IBUSS_EXTV);
-    this->headingSensor = ibus.addSensor(HEADING);
-
-    DEBUG_PRINT_INFO("Speed sensor index: ");
-    DEBUG_PRINTLN_INFO(this->speedSensor);
-    DEBUG_PRINT_INFO("RPM sensor index: ");
-    DEBUG_PRINTLN_INFO(this->rpmSensor);
-    DEBUG_PRINT_INFO("Pressure sensor index: ");
-    DEBUG_PRINTLN_INFO(this->presSensor);
-    DEBUG_PRINT_INFO("Voltage sensor index: ");
-    DEBUG_PRINTLN_INFO(this->voltageSensor);
-    DEBUG_PRINT_INFO("Heading sensor index: ");
-    DEBUG_PRINTLN_INFO(this->headingSensor);
+    return;
   }
 
-  Data::Output::SetSensors(const Data::Input& input, int16_t _rpm)
+  // A reply still going out keeps the old value, and the next Set() tries again
+  if (ibus.setMeasurement(addresses[sensor], value))
   {
-    rpm = _rpm;
-    switch (input.swC) 
-    {
-      case ThreeWaySwitchPos::UP:
-        pres += 1;
-        break;
-      case ThreeWaySwitchPos::DOWN:
-        pres -= 1;
-        break;
-    }
-
-    voltage = analogRead(A1);
-
-    if (++heading > 359)
-    {
-      heading = 0;
-    }
-
-    speed = _rpm / 3;
-
-    DEBUG_PRINTLN_INFO("Streaming Telemetry");
-    ibus.setSensorMeasurement(this->rpmSensor, this->rpm);
-    ibus.setSensorMeasurement(this->presSensor, this->pres);
-    ibus.setSensorMeasurement(this->voltageSensor, this->voltage);
-    ibus.setSensorMeasurement(this->headingSensor, this->heading);
-    ibus.setSensorMeasurement(this->speedSensor, this->speed);
-
-    DEBUG_PRINT_INFO("Pressure :\t");
-    DEBUG_PRINTLN_INFO(pres);
-
-    DEBUG_PRINT_INFO("Heading :\t");
-    DEBUG_PRINTLN_INFO(heading);
-
-    DEBUG_PRINT_INFO("RPM :\t\t");
-    DEBUG_PRINTLN_INFO(rpm);
-
-    DEBUG_PRINT_INFO("Speed :\t\t");
-    DEBUG_PRINTLN_INFO(speed);
-
-    DEBUG_PRINT_INFO("Volts :\t\t");
-    DEBUG_PRINTLN_INFO(voltage);
-  };
-}
\ No newline at end of file
+    encoded[sensor] = value;
+  }
+}
+
+int32_t Data::Output::Reported(SensorId sensor) const
+{
+  return encoded[sensor];
+}
+
+void Data::Output::SetSensors(int16_t rpm, uint16_t battery, int32_t pressure, int32_t depth, uint16_t heading)
+{
+  int32_t millivolts = batteryMillivolts(battery);
+
+  int32_t speed = screwSpeed(rpm);
+
+  Set(RPM_SENSOR, rpm);
+  Set(PRESSURE_SENSOR, pressure);
+  Set(DEPTH_SENSOR, -depth);
+  Set(VOLTAGE_SENSOR, millivolts);
+  Set(HEADING_SENSOR, heading);
+  Set(SPEED_SENSOR, speed);
+
+  LOG_INFO(Log::TELEMETRY, pressure, heading, rpm, encoded[SPEED_SENSOR]);
+  LOG_INFO(Log::TELEMETRY_VOLTS, encoded[VOLTAGE_SENSOR]);
+};
+
+void Data::Output::SetNavigation(uint32_t distance, uint16_t bearing)
+{
+  Set(HOME_SENSOR, (distance + 500) / 1000);
+  Set(BEARING_SENSOR, bearing);
+}
+
+void Data::Output::SetLoopStats(uint32_t worstLoop, uint32_t overruns)
+{
+  Set(LOOP_TIME_SENSOR, worstLoop < INT32_MAX ? worstLoop : INT32_MAX);
+  Set(OVERRUNS_SENSOR, overruns < INT32_MAX ? overruns : INT32_MAX);
+}
@@ -22,63 +22,158 @@
 
 #include "dataUtils.h"
 #include "Arduino.h"
-#include "IBusBM.h"
+#include "ibus.h"
 #include "motor.h"
 #include "debug.h"
 #include "input.h"
+#include "analogSampler.h"
 
 // #define DEBUG_TRACE
 // #define DEBUG_WARN
 // #define DEBUG_ERROR
 // #define DEBUG_INFO
 
+/*
+ * Every telemetry sensor, in address order: id, iBus type, value width
+ * in bytes, then the scale from the source's units to the sensor's as
+ * a fraction. Adding a sensor is one line here and a Set() call.
+ *
+ *   SPEED      mm/s to km/h x 100
+ *   RPM        rpm
+ *   PRESSURE   Pa, which is hPa x 100
+ *   VOLTAGE    mV to V x 100
+ *   HEADING    degrees
+ *   LOOP_TIME  microseconds, longest loop() since the last update
+ *   OVERRUNS   scheduler deadline misses and overruns since start
+ *   DEPTH      mm above the surface to m x 100, so negative under water
+ *   HOME       metres to the launch point
+ *   BEARING    degrees to degrees x 100, the way home
+ */
+#define TELEMETRY_SENSORS(SENSOR) \
+  SENSOR(SPEED, IBus::SENSOR_SPEED, 2, 36, 100) \
+  SENSOR(RPM, IBus::SENSOR_RPM, 2, 1, 1) \
+  SENSOR(PRESSURE, IBus::SENSOR_PRESSURE, 4, 1, 1) \
+  SENSOR(VOLTAGE, IBus::SENSOR_EXTV, 2, 1, 10) \
+  SENSOR(HEADING, IBus::SENSOR_HEADING, 2, 1, 1) \
+  SENSOR(LOOP_TIME, IBus::SENSOR_ODO1, 2, 1, 1) \
+  SENSOR(OVERRUNS, IBus::SENSOR_ODO2, 2, 1, 1) \
+  SENSOR(DEPTH, IBus::SENSOR_ALT, 4, 1, 10) \
+  SENSOR(HOME, IBus::SENSOR_GPS_DIST, 2, 1, 1) \
+  SENSOR(BEARING, IBus::SENSOR_COG, 2, 100, 1)
+
 /* Holds classes for working with Rx/Tx */
 namespace Data
 {
-  static constexpr uint8_t PRESSURE = 0x41;
-  static constexpr uint8_t PRESSURE_SIZE = 4;
-  static constexpr uint8_t HEADING = 0x08;
-  static constexpr uint8_t SPEED = 0x7E;
+  #define TELEMETRY_SENSOR_ID(id, type, length, num, den) id##_SENSOR,
+  enum SensorId : uint8_t
+  {
+    TELEMETRY_SENSORS(TELEMETRY_SENSOR_ID)
+    NUM_SENSORS
+  };
+  #undef TELEMETRY_SENSOR_ID
+
+  static_assert(NUM_SENSORS <= IBus::MAX_SENSORS, "More sensors than the receiver takes");
+
+  /* Battery voltage divider on A1, and the ADC reference it is read against */
+  static constexpr uint8_t BATTERY_PIN = A1;
+  static constexpr uint16_t ADC_REFERENCE_MV = 5000;
+  static constexpr uint8_t BATTERY_DIVIDER = 3;
+
+  /* Fraction bits of the scale factors that are not whole numbers */
+  static constexpr uint8_t SCALE_SHIFT = 16;
+
+  /*
+   * How a sensor's value gets from its source to the wire:
+   * value = (source * multiplier) >> shift, rounded. Whole number scales
+   * are exact with shift 0; source * multiplier must fit in 31 bits.
+   */
+  struct SensorSpec
+  {
+    uint8_t type;
+    uint8_t length;
+    int32_t multiplier;
+    uint8_t shift;
+  };
 
-  static constexpr int32_t SEA_LEVEL = 101300;
-  static constexpr int16_t INITIAL_VOLTAGE = 960;
-  static constexpr int16_t INITIAL_HEADING = 90;
-  static constexpr int16_t INITIAL_SPEED = 0;
+  /* Multiplier that applies num / den with the matching shift */
+  constexpr int32_t sensorMultiplier(int32_t num, int32_t den)
+  {
+    return den == 1 ? num : ((num << SCALE_SHIFT) + den / 2) / den;
+  }
+
+  /* Battery voltage in millivolts from an Analog::Sampler reading of BATTERY_PIN */
+  int32_t batteryMillivolts(uint16_t reading);
+
+  /* Source value in a sensor's units, pinned to what its width can carry */
+  int32_t scaleSensor(const SensorSpec& spec, int32_t source);
+
+
+  /* Distance the boat moves per screw revolution, for the speed estimate */
+  static constexpr uint16_t SCREW_PITCH_MM = 50;
+
+  /* Speed through the water in mm/s for a screw speed */
+  constexpr int32_t screwSpeed(int32_t rpm)
+  {
+    return rpm * SCREW_PITCH_MM / 60;
+  }
 
+  /*
+   * Output class - The sensors reported back over iBus telemetry.
+   *
+   * Sources hand values to Set() in their own units. A value is scaled
+   * and re-encoded into its reply buffer only when the scaled value
+   * changes, so steady sensors cost one multiply and a compare.
+   */
   class Output
   {
     public:
-      /* Constructor */
-      Output()
-        : rpm(0), pres(SEA_LEVEL), voltage(INITIAL_VOLTAGE), heading(INITIAL_HEADING), speed(INITIAL_SPEED) {};
+      /* Starts serial communication and registers the sensors */
+      void Begin();
+
+      /*
+       * Report a new value for a sensor
+       * @param sensor Which sensor
+       * @param source Value in the units TELEMETRY_SENSORS gives for its source
+       */
+      void Set(SensorId sensor, int32_t source);
+
+      /* Value a sensor is reporting right now, in the sensor's units */
+      int32_t Reported(SensorId sensor) const;
 
-      /* Starts serial communication */
-      Begin();
+      /*
+       * Updates sensor values
+       * @param rpm Engine speed
+       * @param battery Battery pin reading from Analog::Sampler, RESULT_BITS wide
+       * @param pressure Water pressure in pascals
+       * @param depth Millimetres below the surface
+       * @param heading Degrees from magnetic north
+       */
+      void SetSensors(int16_t rpm, uint16_t battery, int32_t pressure, int32_t depth, uint16_t heading);
 
-      /* updates sensor values */
-      SetSensors(const Data::Input& input, int16_t rpm);
+      /*
+       * Updates the loop health sensors
+       * @param worstLoop Longest loop() in microseconds since the last update
+       * @param overruns Scheduler deadline misses and overruns since start
+       */
+      void SetLoopStats(uint32_t worstLoop, uint32_t overruns);
+
+      /*
+       * Updates the way home
+       * @param distance Millimetres to the launch point
+       * @param bearing Degrees clockwise from north to steer for it
+       */
+      void SetNavigation(uint32_t distance, uint16_t bearing);
 
     private:
-      /* Fake sensor data */
-      int32_t pres;
-      int16_t rpm;
-      int16_t voltage;
-      int16_t heading;
-      int16_t speed;
-
-      /* 
-      * After adding sensors to iBus they get assigned indices
-      * These store these indices for use when updating the sensor
-      */
-      uint8_t rpmSensor;
-      uint8_t presSensor;
-      uint8_t voltageSensor;
-      uint8_t headingSensor;
-      uint8_t speedSensor;
-
-      /* The iBus object */
-      IBusBM ibus;
+      /* iBus address of each sensor, 0 if it did not fit */
+      uint8_t addresses[NUM_SENSORS];
+
+      /* Scaled value in each sensor's live reply */
+      int32_t encoded[NUM_SENSORS];
+
+      /* The iBus sensor port */
+      IBus::Telemetry ibus;
   };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,167 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Pins.h - Compile-time pin to port mapping for the Mega 2560, for
+ * writing outputs straight to their port register.
+ *
+ * digitalWrite() looks the port and bit up in flash, checks for a timer
+ * on the pin and masks interrupts on every call, several microseconds
+ * a time.
+ * With the pin known at compile time all of that folds away: a single
+ * bit on ports A to G is one sbi or cbi instruction (2 cycles), which
+ * the hardware makes atomic. Ports H to L sit outside the sbi/cbi range,
+ * so writes there are a read-modify-write with interrupts held off.
+ * Nothing here turns PWM off on the pin, so only use it on pins that
+ * are never given to analogWrite().
+ */
+
+#ifndef PINS_h
+#define PINS_h
+
+#include "Arduino.h"
+
+namespace Pins
+{
+  /* Digital ports in the order pins_arduino.h numbers them; there is no port I */
+  enum Port : uint8_t
+  {
+    PORT_A, PORT_B, PORT_C, PORT_D, PORT_E, PORT_F, PORT_G, PORT_H, PORT_J, PORT_K, PORT_L
+  };
+
+  #define PIN_ENTRY(port, bit) uint8_t((Pins::port << 3) | (bit))
+
+  /* Port and bit of every pin, port in the high bits, copied from the core's pins_arduino.h */
+  static constexpr uint8_t PIN_MAP[] = {
+    PIN_ENTRY(PORT_E, 0), PIN_ENTRY(PORT_E, 1), PIN_ENTRY(PORT_E, 4), PIN_ENTRY(PORT_E, 5), // 0-3
+    PIN_ENTRY(PORT_G, 5), PIN_ENTRY(PORT_E, 3), PIN_ENTRY(PORT_H, 3), PIN_ENTRY(PORT_H, 4), // 4-7
+    PIN_ENTRY(PORT_H, 5), PIN_ENTRY(PORT_H, 6), PIN_ENTRY(PORT_B, 4), PIN_ENTRY(PORT_B, 5), // 8-11
+    PIN_ENTRY(PORT_B, 6), PIN_ENTRY(PORT_B, 7), PIN_ENTRY(PORT_J, 1), PIN_ENTRY(PORT_J, 0), // 12-15
+    PIN_ENTRY(PORT_H, 1), PIN_ENTRY(PORT_H, 0), PIN_ENTRY(PORT_D, 3), PIN_ENTRY(PORT_D, 2), // 16-19
+    PIN_ENTRY(PORT_D, 1), PIN_ENTRY(PORT_D, 0), PIN_ENTRY(PORT_A, 0), PIN_ENTRY(PORT_A, 1), // 20-23
+    PIN_ENTRY(PORT_A, 2), PIN_ENTRY(PORT_A, 3), PIN_ENTRY(PORT_A, 4), PIN_ENTRY(PORT_A, 5), // 24-27
+    PIN_ENTRY(PORT_A, 6), PIN_ENTRY(PORT_A, 7), PIN_ENTRY(PORT_C, 7), PIN_ENTRY(PORT_C, 6), // 28-31
+    PIN_ENTRY(PORT_C, 5), PIN_ENTRY(PORT_C, 4), PIN_ENTRY(PORT_C, 3), PIN_ENTRY(PORT_C, 2), // 32-35
+    PIN_ENTRY(PORT_C, 1), PIN_ENTRY(PORT_C, 0), PIN_ENTRY(PORT_D, 7), PIN_ENTRY(PORT_G, 2), // 36-39
+    PIN_ENTRY(PORT_G, 1), PIN_ENTRY(PORT_G, 0), PIN_ENTRY(PORT_L, 7), PIN_ENTRY(PORT_L, 6), // 40-43
+    PIN_ENTRY(PORT_L, 5), PIN_ENTRY(PORT_L, 4), PIN_ENTRY(PORT_L, 3), PIN_ENTRY(PORT_L, 2), // 44-47
+    PIN_ENTRY(PORT_L, 1), PIN_ENTRY(PORT_L, 0), PIN_ENTRY(PORT_B, 3), PIN_ENTRY(PORT_B, 2), // 48-51
+    PIN_ENTRY(PORT_B, 1), PIN_ENTRY(PORT_B, 0), PIN_ENTRY(PORT_F, 0), PIN_ENTRY(PORT_F, 1), // 52-55
+    PIN_ENTRY(PORT_F, 2), PIN_ENTRY(PORT_F, 3), PIN_ENTRY(PORT_F, 4), PIN_ENTRY(PORT_F, 5), // 56-59
+    PIN_ENTRY(PORT_F, 6), PIN_ENTRY(PORT_F, 7), PIN_ENTRY(PORT_K, 0), PIN_ENTRY(PORT_K, 1), // 60-63
+    PIN_ENTRY(PORT_K, 2), PIN_ENTRY(PORT_K, 3), PIN_ENTRY(PORT_K, 4), PIN_ENTRY(PORT_K, 5), // 64-67
+    PIN_ENTRY(PORT_K, 6), PIN_ENTRY(PORT_K, 7) // 68-69
+  };
+
+  #undef PIN_ENTRY
+
+  static_assert(sizeof(PIN_MAP) == NUM_DIGITAL_PINS, "One entry per digital pin");
+
+  /* Port a pin is on */
+  constexpr uint8_t port(uint8_t pin)
+  {
+    return PIN_MAP[pin] >> 3;
+  }
+
+  /* Bit mask of a pin within its port */
+  constexpr uint8_t mask(uint8_t pin)
+  {
+    return uint8_t(1 << (PIN_MAP[pin] & 7));
+  }
+
+  /* Whether single bit writes to a port compile to sbi/cbi */
+  constexpr bool bitAddressable(uint8_t port)
+  {
+    return port <= PORT_G;
+  }
+
+  /* Output register of a port. Inlined with a constant port this is just the register */
+  inline volatile uint8_t& output(uint8_t port)
+  {
+    switch (port)
+    {
+      case PORT_A: return PORTA;
+      case PORT_B: return PORTB;
+      case PORT_C: return PORTC;
+      case PORT_D: return PORTD;
+      case PORT_E: return PORTE;
+      case PORT_F: return PORTF;
+      case PORT_G: return PORTG;
+      case PORT_H: return PORTH;
+      case PORT_J: return PORTJ;
+      case PORT_K: return PORTK;
+      default: return PORTL;
+    }
+  }
+
+  /*
+   * Set the pins in bits to the matching bits of levels, in one write to
+   * the port, so an ISR can neither see them half changed nor lose a
+   * change it made to other pins on the port in between.
+   */
+  template<uint8_t PORT>
+  inline void writePort(uint8_t bits, uint8_t levels)
+  {
+    volatile uint8_t& out = output(PORT);
+    if (bitAddressable(PORT) && (bits & (bits - 1)) == 0)
+    {
+      if (levels & bits)
+      {
+        out |= bits;
+      }
+      else
+      {
+        out &= ~bits;
+      }
+    }
+    else
+    {
+      uint8_t oldSREG = SREG;
+      cli();
+      out = (out & ~bits) | (levels & bits);
+      SREG = oldSREG;
+    }
+  }
+
+  /* Drive one pin */
+  template<uint8_t PIN>
+  inline void write(bool high)
+  {
+    static_assert(PIN < NUM_DIGITAL_PINS, "No such pin");
+    writePort<port(PIN)>(mask(PIN), high ? mask(PIN) : 0);
+  }
+
+  /* Drive two pins, in a single port write when they share a port */
+  template<uint8_t PIN1, uint8_t PIN2>
+  inline void write(bool high1, bool high2)
+  {
+    static_assert(PIN1 < NUM_DIGITAL_PINS && PIN2 < NUM_DIGITAL_PINS, "No such pin");
+    if (port(PIN1) == port(PIN2))
+    {
+      writePort<port(PIN1)>(mask(PIN1) | mask(PIN2), (high1 ? mask(PIN1) : 0) | (high2 ? mask(PIN2) : 0));
+    }
+    else
+    {
+      write<PIN1>(high1);
+      write<PIN2>(high2);
+    }
+  }
+}
+
+#endif
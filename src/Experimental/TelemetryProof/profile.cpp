@@ -0,0 +1,123 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "profile.h"
+
+namespace
+{
+  Profile::Stats stages[Profile::NUM_STAGES];
+
+  /* Next stage dump() will queue */
+  uint8_t dumpNext = 0;
+
+  /* Payload of one stage record */
+  constexpr uint8_t DUMP_LENGTH = 1 + 4 * 3 + 8 + 2 * Profile::HISTOGRAM_BINS;
+
+  uint8_t* putLong(uint8_t* out, uint32_t value)
+  {
+    *out++ = uint8_t(value);
+    *out++ = uint8_t(value >> 8);
+    *out++ = uint8_t(value >> 16);
+    *out++ = uint8_t(value >> 24);
+    return out;
+  }
+}
+
+uint8_t Profile::bin(uint32_t micros)
+{
+  uint8_t bin = 0;
+  while (micros && bin < HISTOGRAM_BINS - 1)
+  {
+    micros >>= 1;
+    bin++;
+  }
+  return bin;
+}
+
+void Profile::record(Stage stage, uint32_t micros)
+{
+  Stats& stats = stages[stage];
+  if (stats.count == 0 || micros < stats.min)
+  {
+    stats.min = micros;
+  }
+  if (micros > stats.max)
+  {
+    stats.max = micros;
+  }
+  if (micros > stats.windowMax)
+  {
+    stats.windowMax = micros;
+  }
+  stats.count++;
+  stats.total += micros;
+
+  uint16_t& count = stats.histogram[bin(micros)];
+  if (count != UINT16_MAX)
+  {
+    count++;
+  }
+}
+
+const Profile::Stats& Profile::stats(Stage stage)
+{
+  return stages[stage];
+}
+
+uint32_t Profile::takeWorst(Stage stage)
+{
+  uint32_t worst = stages[stage].windowMax;
+  stages[stage].windowMax = 0;
+  return worst;
+}
+
+bool Profile::dump()
+{
+  for (; dumpNext < NUM_STAGES; dumpNext++)
+  {
+    if (Log::room() < DUMP_LENGTH)
+    {
+      return false;
+    }
+
+    const Stats& stats = stages[dumpNext];
+    uint8_t payload[DUMP_LENGTH];
+    payload[0] = dumpNext;
+    uint8_t* out = putLong(payload + 1, stats.count);
+    out = putLong(out, uint32_t(stats.total));
+    out = putLong(out, uint32_t(stats.total >> 32));
+    out = putLong(out, stats.min);
+    out = putLong(out, stats.max);
+    for (uint8_t i = 0; i < HISTOGRAM_BINS; i++)
+    {
+      *out++ = uint8_t(stats.histogram[i]);
+      *out++ = uint8_t(stats.histogram[i] >> 8);
+    }
+    Log::frame(RECORD_PROFILE, payload, DUMP_LENGTH);
+  }
+
+  dumpNext = 0;
+  return true;
+}
+
+void Profile::clear()
+{
+  memset(stages, 0, sizeof(stages));
+  dumpNext = 0;
+}
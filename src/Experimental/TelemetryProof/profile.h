@@ -0,0 +1,141 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Profile.h - Stage timing with min/max/mean and log2 histograms.
+ *
+ * Define PROFILE_ENABLED before including this to switch the PROFILE_*
+ * macros on; without it they compile to nothing. Times are whole
+ * microseconds from micros(), so resolution is the core's 4 us.
+ */
+
+#ifndef PROFILE_h
+#define PROFILE_h
+
+#include "Arduino.h"
+#include "log.h"
+
+#define PROFILE_STAGES(STAGE) \
+  STAGE(LOOP, "loop()") \
+  STAGE(RX_READ, "Rx.Read()") \
+  STAGE(ENGINE_SET, "engine.set()") \
+  STAGE(SERVO_WRITE, "servos.flush()") \
+  STAGE(TELEMETRY, "Tx.SetSensors()") \
+  STAGE(DEPTH_UPDATE, "depthSensor.update()") \
+  STAGE(HEADING_FUSE, "compass.fuse()") \
+  STAGE(CONTROL_JITTER, "control tick lateness")
+
+namespace Profile
+{
+  #define PROFILE_STAGE_ID(id, name) id,
+  enum Stage : uint8_t
+  {
+    PROFILE_STAGES(PROFILE_STAGE_ID)
+    NUM_STAGES
+  };
+  #undef PROFILE_STAGE_ID
+
+  /* Bin 0 counts 0 us, bin n counts 2^(n-1) up to 2^n - 1 us, the last everything longer */
+  static constexpr uint8_t HISTOGRAM_BINS = 14;
+
+  /* Log record type for a stage summary, framed like any other log record */
+  static constexpr uint8_t RECORD_PROFILE = 0x02;
+
+  /* Timing of one stage since start */
+  struct Stats
+  {
+    uint32_t count;
+    uint64_t total; // 32 bits of loop() time would wrap in 71 minutes
+    uint32_t min;
+    uint32_t max;
+
+    /* Longest time since takeWorst() last asked */
+    uint32_t windowMax;
+
+    /* Saturating counts per bin */
+    uint16_t histogram[HISTOGRAM_BINS];
+  };
+
+  /*
+   * Add one measurement
+   * @param stage What was measured
+   * @param micros How long it took
+   */
+  void record(Stage stage, uint32_t micros);
+
+  /* Everything recorded for a stage */
+  const Stats& stats(Stage stage);
+
+  /* Histogram bin a duration falls in */
+  uint8_t bin(uint32_t micros);
+
+  /*
+   * Longest time for a stage since the last call, then start a new window
+   * @param stage Stage to ask about
+   */
+  uint32_t takeWorst(Stage stage);
+
+  /*
+   * Queue stage summaries on the log, to be drained like any other log
+   * record. All of them do not fit in the ring at once, so each call
+   * queues what fits and carries on from there next time. One record per
+   * stage: stage, then count (4 bytes), total (8), min and max (4 each),
+   * then the histogram (2 bytes per bin).
+   * @return true once every stage has been queued
+   */
+  bool dump();
+
+  /* Forget everything */
+  void clear();
+
+  /* Times from construction to the end of the enclosing scope */
+  class ScopedTimer
+  {
+    public:
+      ScopedTimer(Stage stage)
+        : stage(stage), start(micros()) {};
+
+      ~ScopedTimer()
+      {
+        record(stage, micros() - start);
+      }
+
+    private:
+      Stage stage;
+      uint32_t start;
+  };
+}
+
+#if defined(PROFILE_ENABLED)
+  #define PROFILE_SCOPE(stage)          Profile::ScopedTimer profileScope(Profile::stage)
+  #define PROFILE_START(name)           uint32_t name = micros()
+  #define PROFILE_STOP(stage, name)     Profile::record(Profile::stage, micros() - (name))
+  #define PROFILE_RECORD(stage, micros) Profile::record(Profile::stage, (micros))
+  #define PROFILE_WORST(stage)          Profile::takeWorst(Profile::stage)
+  #define PROFILE_DUMP()                Profile::dump()
+#else
+  #define PROFILE_SCOPE(stage)
+  #define PROFILE_START(name)
+  #define PROFILE_STOP(stage, name)
+  #define PROFILE_RECORD(stage, micros)
+  #define PROFILE_WORST(stage)          0
+  #define PROFILE_DUMP()                true
+#endif
+
+#endif
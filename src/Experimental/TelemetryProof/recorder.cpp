@@ -0,0 +1,286 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "recorder.h"
+
+namespace
+{
+  constexpr uint16_t RING_MASK = Recorder::RING_SIZE - 1;
+
+  uint8_t* putWord(uint8_t* out, uint16_t value)
+  {
+    *out++ = uint8_t(value);
+    *out++ = uint8_t(value >> 8);
+    return out;
+  }
+
+  uint8_t* putLong(uint8_t* out, uint32_t value)
+  {
+    return putWord(putWord(out, uint16_t(value)), uint16_t(value >> 16));
+  }
+
+  uint16_t getWord(const uint8_t*& in)
+  {
+    uint16_t value = in[0] | uint16_t(in[1]) << 8;
+    in += 2;
+    return value;
+  }
+
+  uint32_t getLong(const uint8_t*& in)
+  {
+    uint32_t low = getWord(in);
+    return low | uint32_t(getWord(in)) << 16;
+  }
+
+  /* Store a change as a signed byte; false if it does not fit */
+  bool putByteDelta(uint8_t*& out, int32_t change)
+  {
+    if (change < -128 || change > 127)
+    {
+      return false;
+    }
+    *out++ = uint8_t(int8_t(change));
+    return true;
+  }
+
+  bool putWordDelta(uint8_t*& out, int32_t change)
+  {
+    if (change < -32768 || change > 32767)
+    {
+      return false;
+    }
+    out = putWord(out, uint16_t(int16_t(change)));
+    return true;
+  }
+
+  int8_t getByteDelta(const uint8_t*& in)
+  {
+    return int8_t(*in++);
+  }
+
+  int16_t getWordDelta(const uint8_t*& in)
+  {
+    return int16_t(getWord(in));
+  }
+}
+
+void Recorder::encodeKey(const Snapshot& snapshot, uint8_t* out)
+{
+  out = putLong(out, snapshot.time);
+  *out++ = snapshot.throttle;
+  out = putWord(out, snapshot.rudder);
+  out = putWord(out, snapshot.divePlane);
+  *out++ = snapshot.switches;
+  out = putWord(out, snapshot.vrA);
+  out = putWord(out, snapshot.vrB);
+  *out++ = snapshot.outputs;
+  *out++ = snapshot.enginePwm;
+  out = putWord(out, snapshot.rudderServo);
+  out = putWord(out, snapshot.planeServo);
+  out = putWord(out, uint16_t(snapshot.rpm));
+  out = putLong(out, uint32_t(snapshot.pressure));
+  out = putWord(out, snapshot.heading);
+  putWord(out, snapshot.battery);
+}
+
+bool Recorder::encodeDelta(const Snapshot& previous, const Snapshot& snapshot, uint8_t* out)
+{
+  uint32_t elapsed = snapshot.time - previous.time;
+  if (elapsed > 0xFFFF)
+  {
+    return false;
+  }
+  out = putWord(out, uint16_t(elapsed));
+  *out++ = snapshot.throttle;
+  if (!putByteDelta(out, int32_t(snapshot.rudder) - previous.rudder)
+    || !putByteDelta(out, int32_t(snapshot.divePlane) - previous.divePlane))
+  {
+    return false;
+  }
+  *out++ = snapshot.switches;
+  if (!putByteDelta(out, int32_t(snapshot.vrA) - previous.vrA)
+    || !putByteDelta(out, int32_t(snapshot.vrB) - previous.vrB))
+  {
+    return false;
+  }
+  *out++ = snapshot.outputs;
+  *out++ = snapshot.enginePwm;
+  // The heading wraps, so its difference always fits a word
+  return putByteDelta(out, int32_t(snapshot.rudderServo) - previous.rudderServo)
+    && putByteDelta(out, int32_t(snapshot.planeServo) - previous.planeServo)
+    && putByteDelta(out, int32_t(snapshot.rpm) - previous.rpm)
+    && putWordDelta(out, snapshot.pressure - previous.pressure)
+    && putWordDelta(out, int16_t(uint16_t(snapshot.heading - previous.heading)))
+    && putByteDelta(out, int32_t(snapshot.battery) - previous.battery);
+}
+
+bool Recorder::decodeKey(const uint8_t* in, uint8_t length, Snapshot& snapshot)
+{
+  if (length != KEY_LENGTH)
+  {
+    return false;
+  }
+  snapshot.time = getLong(in);
+  snapshot.throttle = *in++;
+  snapshot.rudder = getWord(in);
+  snapshot.divePlane = getWord(in);
+  snapshot.switches = *in++;
+  snapshot.vrA = getWord(in);
+  snapshot.vrB = getWord(in);
+  snapshot.outputs = *in++;
+  snapshot.enginePwm = *in++;
+  snapshot.rudderServo = getWord(in);
+  snapshot.planeServo = getWord(in);
+  snapshot.rpm = int16_t(getWord(in));
+  snapshot.pressure = int32_t(getLong(in));
+  snapshot.heading = getWord(in);
+  snapshot.battery = getWord(in);
+  return true;
+}
+
+bool Recorder::applyDelta(const uint8_t* in, uint8_t length, Snapshot& snapshot)
+{
+  if (length != DELTA_LENGTH)
+  {
+    return false;
+  }
+  snapshot.time += getWord(in);
+  snapshot.throttle = *in++;
+  snapshot.rudder += getByteDelta(in);
+  snapshot.divePlane += getByteDelta(in);
+  snapshot.switches = *in++;
+  snapshot.vrA += getByteDelta(in);
+  snapshot.vrB += getByteDelta(in);
+  snapshot.outputs = *in++;
+  snapshot.enginePwm = *in++;
+  snapshot.rudderServo += getByteDelta(in);
+  snapshot.planeServo += getByteDelta(in);
+  snapshot.rpm += getByteDelta(in);
+  snapshot.pressure += getWordDelta(in);
+  snapshot.heading += getWordDelta(in);
+  snapshot.battery += getByteDelta(in);
+  return true;
+}
+
+Recorder::SerialSink::SerialSink(HardwareSerial& port)
+  : port(port)
+{
+}
+
+uint16_t Recorder::SerialSink::room()
+{
+  return port.availableForWrite();
+}
+
+void Recorder::SerialSink::write(const uint8_t* data, uint16_t size)
+{
+  port.write(data, size);
+}
+
+Recorder::FlightRecorder::FlightRecorder(Sink& sink)
+  : sink(sink), head(0), tail(0), last(), sinceKey(KEYFRAME_INTERVAL), recordCount(0), keyCount(0), dropCount(0)
+{
+}
+
+bool Recorder::FlightRecorder::record(const Snapshot& snapshot)
+{
+  uint8_t payload[KEY_LENGTH];
+  bool key = sinceKey >= KEYFRAME_INTERVAL - 1 || !encodeDelta(last, snapshot, payload);
+  if (key)
+  {
+    encodeKey(snapshot, payload);
+  }
+
+  if (!frame(key ? RECORD_KEYFRAME : RECORD_DELTA, payload, key ? KEY_LENGTH : DELTA_LENGTH))
+  {
+    // The decoder missed this one, so the next has to stand on its own
+    dropCount++;
+    sinceKey = KEYFRAME_INTERVAL;
+    return false;
+  }
+
+  last = snapshot;
+  sinceKey = key ? 0 : sinceKey + 1;
+  recordCount++;
+  keyCount += key;
+  return true;
+}
+
+bool Recorder::FlightRecorder::frame(uint8_t type, const uint8_t* payload, uint8_t length)
+{
+  if (RING_SIZE - 1 - pending() < uint16_t(length + Log::FRAME_OVERHEAD))
+  {
+    return false;
+  }
+
+  uint8_t header[] = { Log::FRAME_SYNC, type, length };
+  uint8_t crc = Log::crc8(Log::crc8(0, type), length);
+  for (uint8_t i = 0; i < sizeof(header); i++)
+  {
+    ring[head] = header[i];
+    head = (head + 1) & RING_MASK;
+  }
+  for (uint8_t i = 0; i < length; i++)
+  {
+    ring[head] = payload[i];
+    head = (head + 1) & RING_MASK;
+    crc = Log::crc8(crc, payload[i]);
+  }
+  ring[head] = crc;
+  head = (head + 1) & RING_MASK;
+  return true;
+}
+
+uint16_t Recorder::FlightRecorder::flush()
+{
+  uint16_t room = sink.room();
+  uint16_t sent = 0;
+
+  // At most two runs, up to the end of the ring and then from its start
+  while (room && head != tail)
+  {
+    uint16_t run = head > tail ? head - tail : RING_SIZE - tail;
+    run = run < room ? run : room;
+    sink.write(ring + tail, run);
+    tail = (tail + run) & RING_MASK;
+    room -= run;
+    sent += run;
+  }
+  return sent;
+}
+
+uint16_t Recorder::FlightRecorder::pending() const
+{
+  return (head - tail) & RING_MASK;
+}
+
+uint32_t Recorder::FlightRecorder::records() const
+{
+  return recordCount;
+}
+
+uint32_t Recorder::FlightRecorder::keyframes() const
+{
+  return keyCount;
+}
+
+uint32_t Recorder::FlightRecorder::dropped() const
+{
+  return dropCount;
+}
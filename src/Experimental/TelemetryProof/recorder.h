@@ -0,0 +1,208 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Recorder.h - Flight data recorder: binary snapshots of inputs, outputs and sensors.
+ *
+ * Each snapshot goes into a RAM ring as one frame in the same framing as
+ * the log (see log.h), so a capture can be split with the same decoder,
+ * and is sent on to a Sink as the sink has room. A snapshot is written as
+ * a keyframe with every field in full, or as a delta against the one
+ * before. Deltas have a fixed layout too: fields that change slowly are
+ * narrowed to a signed byte or word, small ones are repeated in full.
+ * When a field moves too far for its delta, after a dropped record, and
+ * every KEYFRAME_INTERVAL records regardless, a keyframe is written
+ * instead, so a decoder can start anywhere and recover from a gap.
+ *
+ * Keyframe payload, KEY_LENGTH bytes, little endian:
+ *   time (4), throttle (1), rudder (2), dive plane (2), switches (1),
+ *   knob A (2), knob B (2), outputs (1), engine PWM (1), rudder servo (2),
+ *   plane servo (2), rpm (2), pressure (4), heading (2), battery mV (2)
+ * Delta payload, DELTA_LENGTH bytes, the same order:
+ *   elapsed us (2), throttle (1), rudder (+1), dive plane (+1),
+ *   switches (1), knob A (+1), knob B (+1), outputs (1), engine PWM (1),
+ *   rudder servo (+1), plane servo (+1), rpm (+1), pressure (+2),
+ *   heading (+2, wrapping), battery mV (+1)
+ *
+ * Framed, a keyframe is 34 bytes and a delta 22. At RECORD_PERIOD in
+ * the sketch (50 Hz) with a keyframe a second that is 1112 bytes/s, or
+ * about 4 MB an hour, before any extra keyframes for sudden moves.
+ */
+
+#ifndef RECORDER_h
+#define RECORDER_h
+
+#include "Arduino.h"
+#include "log.h"
+
+namespace Recorder
+{
+  /* Frame types, alongside Log::RECORD_LOG and Profile::RECORD_PROFILE */
+  static constexpr uint8_t RECORD_KEYFRAME = 0x03;
+  static constexpr uint8_t RECORD_DELTA = 0x04;
+
+  static constexpr uint8_t KEY_LENGTH = 30;
+  static constexpr uint8_t DELTA_LENGTH = 18;
+
+  /* Records between forced keyframes */
+  static constexpr uint8_t KEYFRAME_INTERVAL = 50;
+
+  /* Ring size, a power of two so the indexes wrap with a mask */
+  static constexpr uint16_t RING_SIZE = 512;
+
+  /* Bits in Snapshot::switches */
+  static constexpr uint8_t SWA_DOWN = 1 << 0;
+  static constexpr uint8_t SWB_DOWN = 1 << 1;
+  static constexpr uint8_t SWC_SHIFT = 2; // Two bits, Data::ThreeWaySwitchPos
+  static constexpr uint8_t SWD_DOWN = 1 << 4;
+
+  /* Bits in Snapshot::outputs */
+  static constexpr uint8_t ENGINE_MASK = 0x03; // Motor::Direction
+  static constexpr uint8_t BALLAST_SHIFT = 2; // Two bits, Ballast::Action
+  static constexpr uint8_t FAILSAFE_ENGAGED = 1 << 4;
+  static constexpr uint8_t DEPTH_HOLDING = 1 << 5;
+
+  /* One moment of the boat */
+  struct Snapshot
+  {
+    uint32_t time; // micros()
+
+    /* Decoded receiver inputs, sticks in servo microseconds */
+    uint8_t throttle;
+    uint16_t rudder;
+    uint16_t divePlane;
+    uint8_t switches;
+    uint16_t vrA;
+    uint16_t vrB;
+
+    /* What the actuators were told */
+    uint8_t outputs;
+    uint8_t enginePwm;
+    uint16_t rudderServo;
+    uint16_t planeServo;
+
+    /* Sensors */
+    int16_t rpm;
+    int32_t pressure; // Pa
+    uint16_t heading; // FULL_TURN per turn
+    uint16_t battery; // mV
+  };
+
+  /*
+   * Write a keyframe payload
+   * @param out KEY_LENGTH bytes
+   */
+  void encodeKey(const Snapshot& snapshot, uint8_t* out);
+
+  /*
+   * Write a delta payload, if every change fits its field
+   * @param out DELTA_LENGTH bytes
+   * @return false if a keyframe is needed instead
+   */
+  bool encodeDelta(const Snapshot& previous, const Snapshot& snapshot, uint8_t* out);
+
+  /*
+   * Read a keyframe payload
+   * @return false if length is wrong
+   */
+  bool decodeKey(const uint8_t* in, uint8_t length, Snapshot& snapshot);
+
+  /*
+   * Apply a delta payload to the snapshot before it
+   * @return false if length is wrong
+   */
+  bool applyDelta(const uint8_t* in, uint8_t length, Snapshot& snapshot);
+
+  /* Where recorded bytes end up: a serial port, or an SD card logger */
+  class Sink
+  {
+    public:
+      /* Bytes write() can take now without blocking */
+      virtual uint16_t room() = 0;
+
+      /* Take size bytes, never more than room() said */
+      virtual void write(const uint8_t* data, uint16_t size) = 0;
+  };
+
+  /* A hardware UART, or anything on the other end of one such as an OpenLog */
+  class SerialSink : public Sink
+  {
+    public:
+      SerialSink(HardwareSerial& port);
+
+      uint16_t room() override;
+      void write(const uint8_t* data, uint16_t size) override;
+
+    private:
+      HardwareSerial& port;
+  };
+
+  /*
+   * FlightRecorder class - Queues snapshots and hands them to a sink.
+   *
+   * record() only copies into the ring and flush() only writes what the
+   * sink says it can take, so neither waits on the sink. A snapshot that
+   * does not fit is dropped and counted.
+   */
+  class FlightRecorder
+  {
+    public:
+      FlightRecorder(Sink& sink);
+
+      /* Queue a snapshot; false if the ring was full and it was dropped */
+      bool record(const Snapshot& snapshot);
+
+      /*
+       * Hand as much of the ring to the sink as it will take
+       * @return Bytes written
+       */
+      uint16_t flush();
+
+      /* Bytes waiting in the ring */
+      uint16_t pending() const;
+
+      /* Snapshots queued, keyframes among them, and snapshots dropped */
+      uint32_t records() const;
+      uint32_t keyframes() const;
+      uint32_t dropped() const;
+
+    private:
+      /* Frame a payload into the ring, or return false if it does not fit */
+      bool frame(uint8_t type, const uint8_t* payload, uint8_t length);
+
+      Sink& sink;
+      uint8_t ring[RING_SIZE];
+
+      /* Next byte to write and to send, masked by RING_SIZE - 1 */
+      uint16_t head;
+      uint16_t tail;
+
+      /* Last snapshot queued, which the next delta is taken against */
+      Snapshot last;
+
+      /* Deltas since the last keyframe; KEYFRAME_INTERVAL forces one */
+      uint8_t sinceKey;
+
+      uint32_t recordCount;
+      uint32_t keyCount;
+      uint32_t dropCount;
+  };
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "scheduler.h"
+
+void Tasks::Scheduler::begin(uint32_t now)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    tasks[i].release = now;
+  }
+}
+
+bool Tasks::Scheduler::run()
+{
+  uint32_t now = micros();
+  Task* next = nullptr;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    Task* task = &tasks[i];
+    // Signed difference keeps this correct across the micros() wrap
+    if (int32_t(now - task->release) < 0)
+    {
+      continue;
+    }
+    if (!next || task->priority < next->priority)
+    {
+      next = task;
+    }
+  }
+
+  if (!next)
+  {
+    return false;
+  }
+
+  uint32_t late = now - next->release;
+  next->release += next->period;
+  if (late >= next->period)
+  {
+    // Skip whole periods rather than running repeatedly to catch up
+    uint32_t skipped = late / next->period;
+    next->misses += skipped;
+    next->release += skipped * next->period;
+    late -= skipped * next->period;
+  }
+
+  lastLate = late;
+  next->run();
+
+  uint32_t took = micros() - now;
+  next->runs++;
+  if (took > next->worst)
+  {
+    next->worst = took;
+  }
+  if (took > next->period)
+  {
+    next->overruns++;
+  }
+
+  return true;
+}
+
+uint32_t Tasks::Scheduler::totalMisses() const
+{
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    total += tasks[i].misses;
+  }
+  return total;
+}
+
+uint32_t Tasks::Scheduler::totalOverruns() const
+{
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    total += tasks[i].overruns;
+  }
+  return total;
+}
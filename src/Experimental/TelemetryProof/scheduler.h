@@ -0,0 +1,138 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Scheduler.h - Fixed-rate cooperative task scheduler.
+ */
+
+#ifndef SCHEDULER_h
+#define SCHEDULER_h
+
+#include "Arduino.h"
+
+/* Holds the loop() task scheduler */
+namespace Tasks
+{
+  /* Function run each time a task is released */
+  typedef void (*Callback)();
+
+  /*
+   * A periodic task. Declare a table of these with TASK() and hand it to
+   * a Scheduler; everything after the first three fields is bookkeeping
+   * the scheduler fills in.
+   */
+  struct Task
+  {
+    /* Work to do each period */
+    Callback run;
+
+    /* Release period in microseconds */
+    uint32_t period;
+
+    /* Lower numbers run first when several tasks are due */
+    uint8_t priority;
+
+    /* micros() at which the task is next released */
+    uint32_t release;
+
+    /* Times the task has run */
+    uint32_t runs;
+
+    /* Longest single run in microseconds */
+    uint32_t worst;
+
+    /* Runs that took longer than the task's own period */
+    uint16_t overruns;
+
+    /* Releases that were not started before the next one was due */
+    uint16_t misses;
+  };
+
+  /* Static initialiser for a Task table entry */
+  #define TASK(run, period, priority) { (run), (period), (priority), 0, 0, 0, 0, 0 }
+
+  /*
+   * Scheduler class - Runs a static table of periodic tasks from loop().
+   *
+   * Releases are spaced exactly one period apart from the first, no matter
+   * how late a task actually starts, so rates do not drift. A task that
+   * falls more than a whole period behind skips the releases it missed
+   * instead of running back to back to catch up, and each skipped release
+   * is counted.
+   */
+  class Scheduler
+  {
+    public:
+      /* Parametized Constructor
+       * @param tasks Task table, owned by the caller
+       * @param count Number of entries in the table
+       */
+      Scheduler(Task* tasks, uint8_t count)
+        : tasks(tasks), count(count), lastLate(0) {};
+
+      /*
+       * Releases every task for the first time at now
+       * @param now Current time from micros()
+       */
+      void begin(uint32_t now);
+
+      /*
+       * Runs the highest priority task that is due, if any.
+       * Call this from loop() as often as possible.
+       * @return true if a task ran
+       */
+      bool run();
+
+      /* Number of tasks in the table */
+      uint8_t size() const
+      {
+        return count;
+      }
+
+      /* Task table entry, for reading its counters */
+      const Task& task(uint8_t index) const
+      {
+        return tasks[index];
+      }
+
+      /* How long after its release the task run last, or running now, started */
+      uint32_t lateness() const
+      {
+        return lastLate;
+      }
+
+      /* Deadline misses summed over all tasks */
+      uint32_t totalMisses() const;
+
+      /* Overruns summed over all tasks */
+      uint32_t totalOverruns() const;
+
+    private:
+      /* Task table */
+      Task* tasks;
+
+      /* Number of entries in the table */
+      uint8_t count;
+
+      /* Start delay of the last task run */
+      uint32_t lastLate;
+  };
+}
+
+#endif
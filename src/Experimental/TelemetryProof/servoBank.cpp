@@ -0,0 +1,168 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "servoBank.h"
+
+Actuator::ServoBank::ServoBank(TwoWire& wire, uint8_t address)
+  : wire(wire), address(address), tickScale(0), channels(), dirty(0),
+    totalBytes(0), windowStart(0), windowBytes(0), rate(0)
+{
+}
+
+void Actuator::ServoBank::begin(uint32_t oscillator, uint16_t frequency, uint32_t busClock)
+{
+  // Nearest whole prescaler, rounded as the Adafruit driver does it
+  uint32_t prescale = (oscillator + 2048UL * frequency) / (4096UL * frequency);
+  prescale = constrain(prescale, 4UL, 256UL);
+  tickScale = uint32_t((uint64_t(oscillator / prescale) << 16) / 1000000);
+  wire.setClock(busClock);
+
+  // The prescaler only takes a write while the oscillator is asleep
+  writeRegister(MODE1, MODE_SLEEP | MODE_AUTO_INCREMENT);
+  writeRegister(PRESCALE, uint8_t(prescale - 1));
+  writeRegister(MODE1, MODE_AUTO_INCREMENT);
+  delayMicroseconds(OSCILLATOR_STARTUP);
+  writeRegister(MODE1, MODE_RESTART | MODE_AUTO_INCREMENT);
+  windowStart = micros();
+}
+
+void Actuator::ServoBank::configure(uint8_t channel, uint16_t deadband, uint32_t minInterval)
+{
+  if (channel >= MAX_SERVOS)
+  {
+    return;
+  }
+  channels[channel].deadband = deadband;
+  channels[channel].minInterval = minInterval;
+  channels[channel].sentAt = micros() - minInterval;
+}
+
+void Actuator::ServoBank::write(uint8_t channel, uint16_t micros)
+{
+  if (channel >= MAX_SERVOS)
+  {
+    return;
+  }
+  Channel& servo = channels[channel];
+  servo.micros = micros;
+
+  uint16_t moved = micros > servo.sentMicros ? micros - servo.sentMicros : servo.sentMicros - micros;
+  if (moved > servo.deadband && toTicks(micros) != servo.sentTicks)
+  {
+    dirty |= 1 << channel;
+  }
+  else
+  {
+    dirty &= ~(1 << channel);
+  }
+}
+
+uint16_t Actuator::ServoBank::read(uint8_t channel) const
+{
+  return channel < MAX_SERVOS ? channels[channel].micros : 0;
+}
+
+bool Actuator::ServoBank::pending() const
+{
+  return dirty != 0;
+}
+
+uint8_t Actuator::ServoBank::flush(uint32_t now)
+{
+  if (now - windowStart >= BUS_RATE_WINDOW)
+  {
+    rate = windowBytes;
+    windowBytes = 0;
+    windowStart = now;
+  }
+
+  uint8_t due = 0;
+  for (uint8_t i = 0; i < MAX_SERVOS; i++)
+  {
+    if ((dirty & (1 << i)) && now - channels[i].sentAt >= channels[i].minInterval)
+    {
+      due |= 1 << i;
+    }
+  }
+  if (due == 0)
+  {
+    return 0;
+  }
+
+  uint8_t first = 0;
+  while (!(due & (1 << first)))
+  {
+    first++;
+  }
+  uint8_t last = MAX_SERVOS - 1;
+  while (!(due & (1 << last)))
+  {
+    last--;
+  }
+
+  // Channels in the gap that are not due go out again unchanged
+  uint8_t updated = 0;
+  wire.beginTransmission(address);
+  wire.write(uint8_t(LED0_ON_L + 4 * first));
+  for (uint8_t i = first; i <= last; i++)
+  {
+    Channel& servo = channels[i];
+    if (due & (1 << i))
+    {
+      servo.sentMicros = servo.micros;
+      servo.sentTicks = toTicks(servo.micros);
+      servo.sentAt = now;
+      updated++;
+    }
+    wire.write(0);
+    wire.write(0);
+    wire.write(uint8_t(servo.sentTicks));
+    wire.write(uint8_t(servo.sentTicks >> 8));
+  }
+  wire.endTransmission();
+  dirty &= ~due;
+
+  uint8_t bytes = 2 + 4 * (last - first + 1);
+  totalBytes += bytes;
+  windowBytes += bytes;
+  return updated;
+}
+
+uint32_t Actuator::ServoBank::busBytes() const
+{
+  return totalBytes;
+}
+
+uint16_t Actuator::ServoBank::busRate() const
+{
+  return rate;
+}
+
+uint16_t Actuator::ServoBank::toTicks(uint16_t micros) const
+{
+  return uint16_t((uint32_t(micros) * tickScale) >> 16);
+}
+
+void Actuator::ServoBank::writeRegister(uint8_t reg, uint8_t value)
+{
+  wire.beginTransmission(address);
+  wire.write(reg);
+  wire.write(value);
+  wire.endTransmission();
+}
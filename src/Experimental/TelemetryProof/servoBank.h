@@ -0,0 +1,163 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ServoBank.h - Batched, rate-limited writes to PCA9685 servo channels.
+ */
+
+#ifndef SERVO_BANK_h
+#define SERVO_BANK_h
+
+#include "Arduino.h"
+#include <Wire.h>
+
+namespace Actuator
+{
+  /* Default PCA9685 address, and its first channel register */
+  static constexpr uint8_t PCA9685_ADDRESS = 0x40;
+  static constexpr uint8_t LED0_ON_L = 0x06;
+
+  /* Mode and prescaler registers, and the MODE1 bits begin() uses */
+  static constexpr uint8_t MODE1 = 0x00;
+  static constexpr uint8_t PRESCALE = 0xFE;
+  static constexpr uint8_t MODE_RESTART = 0x80;
+  static constexpr uint8_t MODE_AUTO_INCREMENT = 0x20;
+  static constexpr uint8_t MODE_SLEEP = 0x10;
+
+  /* The oscillator needs this long after waking before PWM restarts */
+  static constexpr uint16_t OSCILLATOR_STARTUP = 500;
+
+  /* Channels 0 up to this; one register byte and 4 per channel fill the 32 byte Wire buffer */
+  static constexpr uint8_t MAX_SERVOS = 7;
+  static_assert(1 + 4 * MAX_SERVOS <= BUFFER_LENGTH, "A burst must fit the Wire buffer");
+
+  /* Fast-mode I2C; the PCA9685 is good for 1 MHz */
+  static constexpr uint32_t I2C_FAST = 400000;
+
+  /* Window bytes per second are counted over */
+  static constexpr uint32_t BUS_RATE_WINDOW = 1000000;
+
+  /*
+   * ServoBank class - Stages servo pulse widths and sends every channel
+   * that is due in a single auto-increment burst.
+   *
+   * The Adafruit driver costs a prescaler read and a 6 byte write per
+   * channel, each a blocking transaction. Here a flush is one
+   * transaction covering the lowest to highest due channel, with pulse
+   * widths turned into counts by a multiply and shift worked out once.
+   * A staged width only becomes due once it moves further than the
+   * channel's deadband from what was last sent and changes the count,
+   * and is held back until the channel's minimum interval has passed.
+   */
+  class ServoBank
+  {
+    public:
+      /*
+       * @param wire Bus the PCA9685 is on
+       * @param address Its I2C address
+       */
+      ServoBank(TwoWire& wire = Wire, uint8_t address = PCA9685_ADDRESS);
+
+      /*
+       * Set the PCA9685's prescaler for the frequency, wake it with
+       * auto-increment on and work out the count scaling. Blocks for
+       * the oscillator to start, OSCILLATOR_STARTUP. Call Wire.begin()
+       * first.
+       * @param oscillator Calibrated PCA9685 oscillator in Hz
+       * @param frequency PWM frequency in Hz
+       * @param busClock I2C clock in Hz
+       */
+      void begin(uint32_t oscillator, uint16_t frequency, uint32_t busClock = I2C_FAST);
+
+      /*
+       * Set how eagerly a channel follows its input
+       * @param channel Channel to set up
+       * @param deadband Smallest change in microseconds worth sending
+       * @param minInterval Least time between sends in microseconds
+       */
+      void configure(uint8_t channel, uint16_t deadband, uint32_t minInterval);
+
+      /*
+       * Stage a pulse width, sent by the next flush() it is due for
+       * @param channel Channel to set
+       * @param micros Pulse width in microseconds
+       */
+      void write(uint8_t channel, uint16_t micros);
+
+      /* Latest width staged for a channel, sent or not */
+      uint16_t read(uint8_t channel) const;
+
+      /* true if any staged width still has to go out */
+      bool pending() const;
+
+      /*
+       * Send every due channel in one transaction
+       * @param now Current time from micros()
+       * @return Number of channels updated
+       */
+      uint8_t flush(uint32_t now);
+
+      /* Bytes put on the bus, the address byte included, since begin() */
+      uint32_t busBytes() const;
+
+      /* Bytes put on the bus over the last whole second */
+      uint16_t busRate() const;
+
+    private:
+      /* Pulse width in PCA9685 counts */
+      uint16_t toTicks(uint16_t micros) const;
+
+      /* Write one register */
+      void writeRegister(uint8_t reg, uint8_t value);
+
+      struct Channel
+      {
+        /* Latest staged width */
+        uint16_t micros;
+
+        /* Width and count last sent */
+        uint16_t sentMicros;
+        uint16_t sentTicks;
+
+        /* Time of the last send */
+        uint32_t sentAt;
+
+        uint16_t deadband;
+        uint32_t minInterval;
+      };
+
+      TwoWire& wire;
+      uint8_t address;
+
+      /* Counts per microsecond, in 1/65536 */
+      uint32_t tickScale;
+
+      Channel channels[MAX_SERVOS];
+
+      /* One bit per channel with a width waiting to go out */
+      uint8_t dirty;
+
+      uint32_t totalBytes;
+      uint32_t windowStart;
+      uint16_t windowBytes;
+      uint16_t rate;
+  };
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "speedController.h"
+
+Motor::SpeedController::SpeedController(const SpeedGains& gains)
+  : gains(gains), integral(0), lastMeasured(0), fresh(true), duty(0)
+{
+}
+
+void Motor::SpeedController::reset(uint8_t duty)
+{
+  this->duty = duty;
+  integral = 0;
+  fresh = true;
+}
+
+uint8_t Motor::SpeedController::update(int32_t target, int32_t measured)
+{
+  int32_t error = target - measured;
+  if (fresh)
+  {
+    lastMeasured = measured;
+  }
+
+  int32_t feedForward = target > 0 ? (int32_t(gains.offset) << GAIN_SHIFT) + target * gains.kff : 0;
+  int32_t derivative = (measured - lastMeasured) * gains.kd;
+  lastMeasured = measured;
+
+  if (fresh)
+  {
+    // Bumpless start: the integral picks up whatever the motor was already getting
+    integral = (int32_t(duty) << GAIN_SHIFT) - feedForward - error * gains.kp;
+    fresh = false;
+  }
+
+  int32_t output = feedForward + error * gains.kp + integral - derivative;
+
+  // Only integrate while the output has room to move the way the error pushes it
+  bool pinnedHigh = output >= (MAX_DUTY << GAIN_SHIFT) && error > 0;
+  bool pinnedLow = output <= 0 && error < 0;
+  if (!pinnedHigh && !pinnedLow)
+  {
+    integral += error * gains.ki;
+    integral = constrain(integral, -(MAX_DUTY << GAIN_SHIFT), MAX_DUTY << GAIN_SHIFT);
+    output = feedForward + error * gains.kp + integral - derivative;
+  }
+
+  int32_t wanted = constrain(output >> GAIN_SHIFT, int32_t(0), MAX_DUTY);
+  int32_t step = constrain(wanted - int32_t(duty), -int32_t(gains.slew), int32_t(gains.slew));
+  duty = uint8_t(duty + step);
+  return duty;
+}
+
+uint8_t Motor::SpeedController::getDuty() const
+{
+  return duty;
+}
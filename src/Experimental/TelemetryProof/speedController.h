@@ -0,0 +1,108 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SpeedController.h - Fixed-point PID for closed-loop motor speed.
+ */
+
+#ifndef SPEED_CONTROLLER_h
+#define SPEED_CONTROLLER_h
+
+#include "Arduino.h"
+
+namespace Motor
+{
+  /* Gains are fixed point with this many fraction bits */
+  static constexpr uint8_t GAIN_SHIFT = 8;
+
+  /* Largest duty the controller asks for */
+  static constexpr int32_t MAX_DUTY = 255;
+
+  /*
+   * Controller tuning. kp, kd and kff are duty per rpm, ki is duty per
+   * rpm per tick, all in 1/256. offset is the duty it takes to get the
+   * shaft turning at all and slew the most the duty may move in one tick.
+   */
+  struct SpeedGains
+  {
+    int16_t kp;
+    int16_t ki;
+    int16_t kd;
+    int16_t kff;
+    uint8_t offset;
+    uint8_t slew;
+  };
+
+  /*
+   * SpeedController class - Works out the PWM duty that holds a target
+   * rpm, run once per fixed tick.
+   *
+   * duty = feed-forward + P + I - D on measurement, then limited to
+   * 0..MAX_DUTY and to slew per tick. The integral stops growing while
+   * the output is pinned in the direction it would push, so it never
+   * winds up behind a saturated output.
+   *
+   * update() is budgeted at 400 cycles (25 us at 16 MHz) per tick: four
+   * 16x32 bit multiplies, shifts and compares, with no division and no
+   * floating point.
+   */
+  class SpeedController
+  {
+    public:
+      /*
+       * @param gains Tuning for the motor being driven
+       */
+      SpeedController(const SpeedGains& gains);
+
+      /*
+       * Start over from the given duty without a bump
+       * @param duty Duty the motor is running at now
+       */
+      void reset(uint8_t duty);
+
+      /*
+       * Run one tick
+       * @param target Wanted speed in rpm, 0 or more
+       * @param measured Current speed in rpm, negative if turning the wrong way
+       * @return Duty to drive the motor with
+       */
+      uint8_t update(int32_t target, int32_t measured);
+
+      /* Duty from the last update() */
+      uint8_t getDuty() const;
+
+    private:
+      /* Tuning */
+      const SpeedGains gains;
+
+      /* Integral term, in 1/256 duty */
+      int32_t integral;
+
+      /* Measurement from the last tick, for the D term */
+      int32_t lastMeasured;
+
+      /* Set until the first update() after reset() */
+      bool fresh;
+
+      /* Duty from the last tick */
+      uint8_t duty;
+  };
+}
+
+#endif
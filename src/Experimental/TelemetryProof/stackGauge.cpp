@@ -0,0 +1,79 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stackGauge.h"
+
+Memory::StackGauge::StackGauge()
+  : bottom(nullptr), cursor(nullptr), lowest(nullptr), measured(false)
+{
+}
+
+void Memory::StackGauge::begin()
+{
+  // SP points at the next free byte, so it is painted too
+  bottom = reinterpret_cast<uint8_t*>(__malloc_heap_start);
+  uint8_t* limit = reinterpret_cast<uint8_t*>(SP) + 1;
+  for (uint8_t* p = bottom; p < limit; p++)
+  {
+    *p = PAINT;
+  }
+  cursor = bottom;
+  lowest = limit;
+  measured = false;
+}
+
+bool Memory::StackGauge::poll()
+{
+  if (bottom == nullptr)
+  {
+    return false;
+  }
+  // Bytes above the stack pointer belong to live frames
+  uint8_t* limit = reinterpret_cast<uint8_t*>(SP) + 1;
+  uint8_t* end = limit - cursor > SCAN_STEP ? cursor + SCAN_STEP : limit;
+  while (cursor < end && *cursor == PAINT)
+  {
+    cursor++;
+  }
+  if (cursor < limit && *cursor == PAINT)
+  {
+    return false;
+  }
+
+  bool deeper = cursor < lowest || !measured;
+  lowest = cursor < lowest ? cursor : lowest;
+  cursor = bottom;
+  measured = true;
+  return deeper;
+}
+
+uint16_t Memory::StackGauge::staticBytes() const
+{
+  return uint16_t(reinterpret_cast<uintptr_t>(__malloc_heap_start) - RAMSTART);
+}
+
+uint16_t Memory::StackGauge::stackPeak() const
+{
+  return lowest == nullptr ? 0 : uint16_t(RAMEND + 1 - reinterpret_cast<uintptr_t>(lowest));
+}
+
+uint16_t Memory::StackGauge::margin() const
+{
+  return uint16_t(lowest - bottom);
+}
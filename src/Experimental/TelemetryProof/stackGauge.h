@@ -0,0 +1,95 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * StackGauge.h - How much of the Mega's 8 KB of SRAM is actually in use.
+ *
+ * SRAM holds the static data (.data and .bss) from RAMSTART up, then
+ * the heap, which the sketch never uses, and the stack growing down
+ * from RAMEND. begin() paints everything between the end of the static
+ * data and the stack pointer with PAINT. Any byte the stack reaches
+ * gets overwritten, so the lowest byte no longer painted marks the
+ * deepest the stack has gone since. The painted bytes below it are the
+ * margin still free.
+ *
+ * The scan is spread over poll() calls a SCAN_STEP at a time, so a
+ * full pass never holds up the loop. A stray PAINT value written by the
+ * stack reads as unused, so the peak can come out a few bytes low. Heap
+ * use, if a library ever allocates, counts against the margin the same
+ * as stack.
+ */
+
+#ifndef STACK_GAUGE_h
+#define STACK_GAUGE_h
+
+#include "Arduino.h"
+
+namespace Memory
+{
+  /* Fill for unused RAM, unlikely as a return address or small number */
+  static constexpr uint8_t PAINT = 0xC5;
+
+  /* Bytes checked per poll(), about 50 us at 16 MHz */
+  static constexpr uint16_t SCAN_STEP = 128;
+
+  /*
+   * StackGauge class - Paints free RAM at start up and keeps track of
+   * the stack's high water mark from then on.
+   */
+  class StackGauge
+  {
+    public:
+      /* Default Constructor */
+      StackGauge();
+
+      /* Paint the free RAM. Call first thing in setup(), while the stack is shallow. */
+      void begin();
+
+      /*
+       * Carry the scan on by up to SCAN_STEP bytes
+       * @return true when the first pass finishes, and when a later one
+       * finds the stack deeper than before
+       */
+      bool poll();
+
+      /* .data and .bss, fixed at build time */
+      uint16_t staticBytes() const;
+
+      /* Deepest the stack has been as of the last pass, from RAMEND down */
+      uint16_t stackPeak() const;
+
+      /* Bytes never touched between the static data and the stack */
+      uint16_t margin() const;
+
+    private:
+      /* First byte after the static data */
+      uint8_t* bottom;
+
+      /* Next byte the scan looks at */
+      uint8_t* cursor;
+
+      /* Lowest byte the stack had touched as of the last pass */
+      uint8_t* lowest;
+
+      /* A pass has finished since begin() */
+      bool measured;
+  };
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * The TelemetryStreamTest application.
+ *
+ * Copyright (C) 2024 Jeremy D. Jones <j.jones1232@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * switchDecoder.h - Turns raw switch and knob channels into stable positions.
+ */
+
+#ifndef SWITCH_DECODER_h
+#define SWITCH_DECODER_h
+
+#include "Arduino.h"
+#include "dataUtils.h"
+
+namespace Data
+{
+  /* How far past a boundary a switch channel has to go before it counts as moved */
+  static constexpr uint16_t SWITCH_HYSTERESIS = 50;
+
+  /* Knob movement smaller than this is treated as receiver jitter */
+  static constexpr uint16_t KNOB_DEADBAND = 4;
+
+  /*
+   * Decode a multi position switch. The raw range is split into
+   * POSITIONS equal bands; leaving the current band takes
+   * SWITCH_HYSTERESIS beyond its edge, so a value sitting on a
+   * boundary can not make the switch chatter.
+   * @param raw Channel value from the receiver
+   * @param previous Position decoded from the last frame, 0 is the lowest band
+   * @return Position between 0 and POSITIONS - 1
+   */
+  template <uint8_t POSITIONS>
+  inline uint8_t decodePosition(uint16_t raw, uint8_t previous)
+  {
+    uint8_t position = 0;
+    // Fixed trip count, so this unrolls into compares against constants
+    for (uint8_t i = 0; i < POSITIONS - 1; i++)
+    {
+      uint16_t boundary = MIN_RAW_INPUT + (i + 1) * (MAX_RAW_INPUT - MIN_RAW_INPUT) / POSITIONS;
+      boundary = previous > i ? boundary - SWITCH_HYSTERESIS : boundary + SWITCH_HYSTERESIS;
+      position += raw > boundary;
+    }
+    return position;
+  }
+
+  /* Two position switch, see decodePosition() */
+  inline SwitchPos decodeSwitch(uint16_t raw, SwitchPos previous)
+  {
+    return static_cast<SwitchPos>(decodePosition<2>(raw, static_cast<uint8_t>(previous)));
+  }
+
+  /* Three position switch, see decodePosition() */
+  inline ThreeWaySwitchPos decodeSwitch(uint16_t raw, ThreeWaySwitchPos previous)
+  {
+    return static_cast<ThreeWaySwitchPos>(decodePosition<3>(raw, static_cast<uint8_t>(previous)));
+  }
+
+  /*
+   * Decode a knob, holding the last value until it moves more than
+   * KNOB_DEADBAND. The ends of the range are always reached exactly.
+   * @param raw Channel value from the receiver
+   * @param previous Value decoded from the last frame
+   * @return Knob value between MIN_RAW_INPUT and MAX_RAW_INPUT
+   */
+  inline uint16_t decodeKnob(uint16_t raw, uint16_t previous)
+  {
+    raw = constrain(raw, MIN_RAW_INPUT, MAX_RAW_INPUT);
+    int16_t moved = int16_t(raw - previous);
+    if (moved > int16_t(KNOB_DEADBAND) || moved < -int16_t(KNOB_DEADBAND) || raw == MIN_RAW_INPUT || raw == MAX_RAW_INPUT)
+    {
+      return raw;
+    }
+    return previous;
+  }
+}
+
+#endif